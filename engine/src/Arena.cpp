@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include "Arena.hpp"
+#include "Profiler.hpp"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define HOENGINE_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define HOENGINE_ASAN 1
+#endif
+#endif
+
+#ifdef HOENGINE_ASAN
+#include <sanitizer/asan_interface.h>
+#else
+#define ASAN_POISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif
+
+using namespace HOEngine;
+
+namespace {
+	constexpr std::align_val_t blockAlignment{ alignof(std::max_align_t) };
+
+	usize AlignUp(std::uintptr_t address, usize alignment) {
+		return (address + alignment - 1) & ~(static_cast<std::uintptr_t>(alignment) - 1);
+	}
+}
+
+LinearArena::LinearArena(usize blockSize, bool poison)
+	: blockSize{ blockSize }
+	, poison{ poison } {
+}
+
+LinearArena::~LinearArena() noexcept {
+	for (const auto& block : blocks) FreeBlock(block);
+}
+
+LinearArena::Block LinearArena::NewBlock(usize size) {
+	auto data = static_cast<std::byte*>(::operator new(size, blockAlignment));
+	// Only memory handed out by `do_allocate` may be touched
+	ASAN_POISON_MEMORY_REGION(data, size);
+	stats_.capacity += size;
+	++stats_.blocks;
+	return Block{ data, size };
+}
+
+void LinearArena::FreeBlock(const Block& block) {
+	ASAN_UNPOISON_MEMORY_REGION(block.data, block.size);
+	::operator delete(block.data, blockAlignment);
+	stats_.capacity -= block.size;
+	--stats_.blocks;
+}
+
+void LinearArena::Release(std::byte* begin, std::byte* end) {
+	if (begin >= end) return;
+	if (poison) {
+		// May cover block tails that were skipped and never handed out, still poisoned
+		ASAN_UNPOISON_MEMORY_REGION(begin, static_cast<usize>(end - begin));
+		std::memset(begin, poisonByte, static_cast<usize>(end - begin));
+	}
+	ASAN_POISON_MEMORY_REGION(begin, static_cast<usize>(end - begin));
+}
+
+void* LinearArena::do_allocate(usize bytes, usize alignment) {
+	bytes = std::max<usize>(bytes, 1);
+	for (;;) {
+		if (currentBlock == blocks.size()) {
+			if (!blocks.empty()) ++stats_.overflows;
+			blocks.push_back(NewBlock(std::max(blockSize, bytes + alignment)));
+		}
+
+		auto& block = blocks[currentBlock];
+		auto base = reinterpret_cast<std::uintptr_t>(block.data);
+		auto start = AlignUp(base + offset, alignment) - base;
+		if (start + bytes <= block.size) {
+			auto ptr = block.data + start;
+			ASAN_UNPOISON_MEMORY_REGION(ptr, bytes);
+			stats_.bytesUsed += start + bytes - offset;
+			stats_.peakBytes = std::max(stats_.peakBytes, stats_.bytesUsed);
+			++stats_.allocations;
+			offset = start + bytes;
+			lastAllocation = ptr;
+			return ptr;
+		}
+
+		// The tail of this block stays unused until the arena is reset
+		stats_.bytesUsed += block.size - offset;
+		++currentBlock;
+		offset = 0;
+	}
+}
+
+void LinearArena::do_deallocate(void* ptr, usize bytes, usize) {
+	bytes = std::max<usize>(bytes, 1);
+	auto begin = static_cast<std::byte*>(ptr);
+	if (begin != lastAllocation || blocks[currentBlock].data + offset != begin + bytes) return;
+
+	// Popping the latest allocation lets a growing container reuse the space
+	offset = static_cast<usize>(begin - blocks[currentBlock].data);
+	stats_.bytesUsed -= bytes;
+	lastAllocation = nullptr;
+	Release(begin, begin + bytes);
+}
+
+bool LinearArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+void LinearArena::Reset() {
+	if (blocks.size() > 1) {
+		// Needed several blocks this cycle, merge them so it fits in one next time
+		auto total = stats_.capacity;
+		for (const auto& block : blocks) FreeBlock(block);
+		blocks.clear();
+		blocks.push_back(NewBlock(total));
+	} else if (!blocks.empty()) {
+		Release(blocks[0].data, blocks[0].data + offset);
+	}
+
+	currentBlock = 0;
+	offset = 0;
+	lastAllocation = nullptr;
+	stats_.bytesUsed = 0;
+	stats_.allocations = 0;
+	++stats_.resets;
+}
+
+LinearArena::Marker LinearArena::Mark() const {
+	return Marker{ currentBlock, offset, stats_.bytesUsed, stats_.allocations };
+}
+
+void LinearArena::Rewind(const Marker& marker) {
+	if (!blocks.empty()) {
+		for (auto i = marker.block; i <= currentBlock; ++i) {
+			auto& block = blocks[i];
+			auto begin = i == marker.block ? marker.offset : 0;
+			auto end = i == currentBlock ? offset : block.size;
+			Release(block.data + begin, block.data + end);
+		}
+	}
+
+	currentBlock = marker.block;
+	offset = marker.offset;
+	lastAllocation = nullptr;
+	stats_.bytesUsed = marker.bytesUsed;
+	stats_.allocations = marker.allocations;
+}
+
+FrameArena& FrameArena::Global() {
+	static FrameArena arena;
+	return arena;
+}
+
+FrameArena::FrameArena(usize blockSize)
+	: arenas{ { LinearArena(blockSize), LinearArena(blockSize) } } {
+}
+
+void FrameArena::EndFrame() {
+	HOENGINE_PROFILE_COUNTER("Frame arena bytes", Current().stats().bytesUsed);
+	current ^= 1;
+	arenas[current].Reset();
+	++frameIndex_;
+}
+
+LinearArena& ScratchArena::ForThread() {
+	thread_local LinearArena arena;
+	return arena;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Bump allocator over a list of blocks, usable by any `std::pmr` container.
+///
+/// Individual deallocations are ignored, except for the most recent allocation
+/// which is popped so growing containers can reuse their own tail. Memory is
+/// reclaimed all at once with `Reset`, or back to a `Marker` with `Rewind`.
+/// When a cycle needed more than one block, `Reset` replaces them with a single
+/// block large enough for the whole cycle so steady state never overflows.
+///
+/// Not thread safe: each arena belongs to one thread at a time.
+class LinearArena : public std::pmr::memory_resource {
+public:
+	/// Written over released memory when poisoning is enabled.
+	static constexpr u8 poisonByte = 0xDD;
+	static constexpr usize defaultBlockSize = 64 * 1024;
+#ifdef NDEBUG
+	static constexpr bool poisonByDefault = false;
+#else
+	static constexpr bool poisonByDefault = true;
+#endif
+
+	struct Stats {
+		/// Allocations since the last `Reset`.
+		u64 allocations = 0;
+		/// Bytes handed out since the last `Reset`, including alignment padding.
+		usize bytesUsed = 0;
+		/// Highest `bytesUsed` ever reached.
+		usize peakBytes = 0;
+		/// Bytes reserved in blocks.
+		usize capacity = 0;
+		u32 blocks = 0;
+		/// Blocks allocated because the existing ones were full.
+		u64 overflows = 0;
+		u64 resets = 0;
+	};
+
+	/// Position in the arena, see `Mark` and `Rewind`.
+	struct Marker {
+		usize block;
+		usize offset;
+		usize bytesUsed;
+		u64 allocations;
+	};
+
+private:
+	struct Block {
+		std::byte* data;
+		usize size;
+	};
+
+	std::vector<Block> blocks;
+	usize blockSize;
+	usize currentBlock = 0;
+	usize offset = 0;
+	/// Start of the most recent allocation, for popping it on deallocation.
+	std::byte* lastAllocation = nullptr;
+	bool poison;
+	Stats stats_;
+
+public:
+	explicit LinearArena(usize blockSize = defaultBlockSize, bool poison = poisonByDefault);
+	~LinearArena() noexcept override;
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	/// Release every allocation at once.
+	void Reset();
+	Marker Mark() const;
+	/// Release every allocation made after `marker` was taken.
+	void Rewind(const Marker& marker);
+
+	/// Fill released memory with `poisonByte` so stale pointers read garbage.
+	/// Builds with AddressSanitizer report such accesses regardless.
+	void SetPoisoning(bool enabled) { poison = enabled; }
+	bool poisoning() const { return poison; }
+	const Stats& stats() const { return stats_; }
+
+protected:
+	void* do_allocate(usize bytes, usize alignment) override;
+	void do_deallocate(void* ptr, usize bytes, usize alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+	Block NewBlock(usize size);
+	void FreeBlock(const Block& block);
+	void Release(std::byte* begin, std::byte* end);
+};
+
+/// Double-buffered arena for per-frame transient data.
+///
+/// Allocations from `Current` stay valid until the end of the next frame, so
+/// data produced during one frame can be consumed during the following one
+/// through `Previous`. Owned by the thread calling `EndFrame`; worker threads
+/// should use a `ScratchArena` instead.
+class FrameArena {
+public:
+	static constexpr usize defaultBlockSize = 1024 * 1024;
+
+private:
+	std::array<LinearArena, 2> arenas;
+	u32 current = 0;
+	u64 frameIndex_ = 0;
+
+public:
+	/// Arena shared by the engine and the main loop.
+	static FrameArena& Global();
+
+	explicit FrameArena(usize blockSize = defaultBlockSize);
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	LinearArena& Current() { return arenas[current]; }
+	LinearArena& Previous() { return arenas[current ^ 1]; }
+	/// Flip the arenas and reset the one holding allocations from two frames ago.
+	void EndFrame();
+
+	u64 frameIndex() const { return frameIndex_; }
+	/// Bytes in use across both frames.
+	usize bytesUsed() const { return arenas[0].stats().bytesUsed + arenas[1].stats().bytesUsed; }
+};
+
+/// RAII scope over the calling thread's scratch arena. Everything allocated
+/// from it is released when the scope ends; scopes nest.
+///
+///     ScratchArena scratch;
+///     std::pmr::vector<glm::vec3> positions{ scratch.resource() };
+///
+/// Containers using it must be declared after it so they die first.
+class ScratchArena {
+private:
+	LinearArena& arena;
+	LinearArena::Marker marker;
+
+public:
+	/// Arena backing the scopes of the calling thread.
+	static LinearArena& ForThread();
+
+	ScratchArena() : arena{ ForThread() }, marker{ arena.Mark() } {}
+	~ScratchArena() noexcept { arena.Rewind(marker); }
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	LinearArena* resource() { return &arena; }
+};
+
+} // namespace HOEngine
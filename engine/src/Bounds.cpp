@@ -0,0 +1,42 @@
+#include <cmath>
+#include "Bounds.hpp"
+
+using namespace HOEngine;
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProj) {
+	// glm matrices are column major, m[col][row]
+	auto row = [&](i32 i) {
+		return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	};
+	auto r0 = row(0);
+	auto r1 = row(1);
+	auto r2 = row(2);
+	auto r3 = row(3);
+
+	Frustum result;
+	result.planes[Left] = r3 + r0;
+	result.planes[Right] = r3 - r0;
+	result.planes[Bottom] = r3 + r1;
+	result.planes[Top] = r3 - r1;
+	result.planes[Near] = r3 + r2;
+	result.planes[Far] = r3 - r2;
+	for (auto& plane : result.planes) {
+		auto len = glm::length(glm::vec3(plane));
+		if (len > 0) plane = plane / len;
+	}
+	return result;
+}
+
+Frustum::Result Frustum::Test(const AABB& box) const {
+	auto center = box.Center();
+	auto extents = box.Extents();
+	auto result = Result::Inside;
+	for (const auto& plane : planes) {
+		auto normal = glm::vec3(plane);
+		auto dist = glm::dot(normal, center) + plane.w;
+		auto radius = glm::dot(glm::abs(normal), extents);
+		if (dist < -radius) return Result::Outside;
+		if (dist < radius) result = Result::Intersecting;
+	}
+	return result;
+}
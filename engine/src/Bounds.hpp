@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Axis aligned bounding box. A default constructed box is empty (inverted), so
+/// that extending it with the first point yields a box around that point.
+struct AABB {
+	glm::vec3 min{ std::numeric_limits<f32>::max() };
+	glm::vec3 max{ std::numeric_limits<f32>::lowest() };
+
+	static AABB FromCenterExtents(const glm::vec3& center, const glm::vec3& extents) {
+		return AABB{ center - extents, center + extents };
+	}
+	static AABB Union(const AABB& a, const AABB& b) {
+		return AABB{ glm::min(a.min, b.min), glm::max(a.max, b.max) };
+	}
+
+	bool IsEmpty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+	glm::vec3 Center() const { return (min + max) * 0.5f; }
+	/// Half size along each axis.
+	glm::vec3 Extents() const { return (max - min) * 0.5f; }
+	f32 SurfaceArea() const {
+		auto d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	void Extend(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+	void Extend(const AABB& box) {
+		min = glm::min(min, box.min);
+		max = glm::max(max, box.max);
+	}
+	AABB Expanded(f32 margin) const { return AABB{ min - glm::vec3(margin), max + glm::vec3(margin) }; }
+
+	bool Contains(const AABB& that) const {
+		return min.x <= that.min.x && min.y <= that.min.y && min.z <= that.min.z &&
+			max.x >= that.max.x && max.y >= that.max.y && max.z >= that.max.z;
+	}
+	bool Overlaps(const AABB& that) const {
+		return min.x <= that.max.x && max.x >= that.min.x &&
+			min.y <= that.max.y && max.y >= that.min.y &&
+			min.z <= that.max.z && max.z >= that.min.z;
+	}
+	bool operator==(const AABB& that) const { return min == that.min && max == that.max; }
+	bool operator!=(const AABB& that) const { return !(*this == that); }
+};
+
+/// Six planes of a view frustum, with normals pointing inwards. A point `p` is
+/// inside the plane if `dot(plane.xyz, p) + plane.w >= 0`.
+struct Frustum {
+	enum Side { Left = 0, Right, Bottom, Top, Near, Far };
+	std::array<glm::vec4, 6> planes;
+
+	/// Extract the planes from a view projection matrix (`PerspectiveMat * ViewMat`),
+	/// assuming OpenGL clip space where depth goes from -w to w.
+	static Frustum FromMatrix(const glm::mat4& viewProj);
+
+	enum class Result { Outside, Intersecting, Inside };
+	Result Test(const AABB& box) const;
+	bool Overlaps(const AABB& box) const { return Test(box) != Result::Outside; }
+};
+
+} // namespace HOEngine
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include "DynamicBVH.hpp"
+
+using namespace HOEngine;
+
+u32 DynamicBVH::AllocateNode() {
+	if (freeList != nullNode) {
+		auto index = freeList;
+		freeList = nodes[index].userData;
+		return index;
+	}
+	nodes.push_back({});
+	return static_cast<u32>(nodes.size() - 1);
+}
+
+void DynamicBVH::FreeNode(u32 index) {
+	auto& node = nodes[index];
+	node.parent = nullNode;
+	node.left = nullNode;
+	node.right = nullNode;
+	node.height = -1;
+	node.userData = freeList;
+	freeList = index;
+}
+
+u32 DynamicBVH::Insert(const AABB& box, u32 userData, f32 margin) {
+	auto leaf = AllocateNode();
+	auto& node = nodes[leaf];
+	node.box = margin > 0.0f ? box.Expanded(margin) : box;
+	node.parent = nullNode;
+	node.left = nullNode;
+	node.right = nullNode;
+	node.userData = userData;
+	node.height = 0;
+	InsertLeaf(leaf);
+	++leafCount_;
+	return leaf;
+}
+
+void DynamicBVH::Remove(u32 proxy) {
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	--leafCount_;
+}
+
+bool DynamicBVH::Update(u32 proxy, const AABB& box, f32 margin) {
+	auto& node = nodes[proxy];
+	if (margin > 0.0f && node.box.Contains(box)) return false;
+	node.box = margin > 0.0f ? box.Expanded(margin) : box;
+	dirtyLeaves.push_back(proxy);
+	return true;
+}
+
+void DynamicBVH::Refit() {
+	for (auto leaf : dirtyLeaves) {
+		// The leaf might have been removed since it was marked
+		if (nodes[leaf].height != 0) continue;
+		for (auto index = nodes[leaf].parent; index != nullNode; index = nodes[index].parent) {
+			auto& node = nodes[index];
+			auto box = AABB::Union(nodes[node.left].box, nodes[node.right].box);
+			// Another walk will pick up from here if some other child changes later
+			if (box == node.box) break;
+			node.box = box;
+		}
+	}
+	dirtyLeaves.clear();
+}
+
+void DynamicBVH::IncrementalRebuild(u32 maxLeaves) {
+	Refit();
+	if (leafCount_ < 3) return;
+
+	u32 reinserted = 0;
+	for (usize scanned = 0; scanned < nodes.size() && reinserted < maxLeaves; ++scanned) {
+		if (rebuildCursor >= nodes.size()) rebuildCursor = 0;
+		auto index = rebuildCursor++;
+		if (nodes[index].height != 0) continue;
+		RemoveLeaf(index);
+		InsertLeaf(index);
+		++reinserted;
+	}
+}
+
+void DynamicBVH::InsertLeaf(u32 leaf) {
+	if (root_ == nullNode) {
+		root_ = leaf;
+		nodes[leaf].parent = nullNode;
+		return;
+	}
+
+	// Descend towards the sibling that minimizes the total surface area increase
+	auto leafBox = nodes[leaf].box;
+	auto index = root_;
+	while (!nodes[index].IsLeaf()) {
+		const auto& node = nodes[index];
+		auto area = node.box.SurfaceArea();
+		auto combinedArea = AABB::Union(node.box, leafBox).SurfaceArea();
+		// Cost of making a new parent for this node and the leaf
+		auto cost = 2.0f * combinedArea;
+		// Minimum cost of pushing the leaf further down the tree
+		auto inheritance = 2.0f * (combinedArea - area);
+
+		auto childCost = [&](u32 child) {
+			const auto& c = nodes[child];
+			auto grown = AABB::Union(leafBox, c.box).SurfaceArea();
+			return (c.IsLeaf() ? grown : grown - c.box.SurfaceArea()) + inheritance;
+		};
+		auto costLeft = childCost(node.left);
+		auto costRight = childCost(node.right);
+
+		if (cost < costLeft && cost < costRight) break;
+		index = costLeft < costRight ? node.left : node.right;
+	}
+
+	auto sibling = index;
+	auto oldParent = nodes[sibling].parent;
+	auto newParent = AllocateNode();
+	{
+		auto& parent = nodes[newParent];
+		parent.parent = oldParent;
+		parent.box = AABB::Union(leafBox, nodes[sibling].box);
+		parent.userData = nullNode;
+		parent.height = nodes[sibling].height + 1;
+		parent.left = sibling;
+		parent.right = leaf;
+	}
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == nullNode) {
+		root_ = newParent;
+	} else {
+		auto& grand = nodes[oldParent];
+		if (grand.left == sibling) {
+			grand.left = newParent;
+		} else {
+			grand.right = newParent;
+		}
+	}
+	FixUpwards(oldParent);
+}
+
+void DynamicBVH::RemoveLeaf(u32 leaf) {
+	if (leaf == root_) {
+		root_ = nullNode;
+		return;
+	}
+
+	auto parent = nodes[leaf].parent;
+	auto grand = nodes[parent].parent;
+	auto sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	if (grand != nullNode) {
+		auto& g = nodes[grand];
+		if (g.left == parent) {
+			g.left = sibling;
+		} else {
+			g.right = sibling;
+		}
+		nodes[sibling].parent = grand;
+		FreeNode(parent);
+		FixUpwards(grand);
+	} else {
+		root_ = sibling;
+		nodes[sibling].parent = nullNode;
+		FreeNode(parent);
+	}
+	nodes[leaf].parent = nullNode;
+}
+
+void DynamicBVH::FixUpwards(u32 index) {
+	while (index != nullNode) {
+		auto& node = nodes[index];
+		const auto& left = nodes[node.left];
+		const auto& right = nodes[node.right];
+		node.box = AABB::Union(left.box, right.box);
+		node.height = 1 + std::max(left.height, right.height);
+		index = node.parent;
+	}
+}
+
+f32 DynamicBVH::AreaRatio() const {
+	if (root_ == nullNode) return 0.0f;
+	auto rootArea = nodes[root_].box.SurfaceArea();
+	if (rootArea <= 0.0f) return 0.0f;
+
+	f32 total = 0.0f;
+	for (const auto& node : nodes) {
+		if (node.height > 0) total += node.box.SurfaceArea();
+	}
+	return total / rootArea;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+
+namespace HOEngine {
+
+/// Binary AABB tree over moving objects, keyed by proxies returned from `Insert`.
+///
+/// Leaves are inserted at the sibling with the lowest surface area heuristic cost.
+/// Moving objects only update their leaf box (`Update`), and ancestors are fixed up
+/// in one pass by `Refit`. As objects move the tree quality degrades, which
+/// `IncrementalRebuild` repairs a few leaves at a time by reinserting them.
+///
+/// Leaves can store a box enlarged by a margin, in which case `Update` is a no-op
+/// as long as the object stays within it (useful for physics broadphases).
+class DynamicBVH {
+public:
+	static constexpr u32 nullNode = ~0u;
+
+	struct Node {
+		AABB box;
+		u32 parent;
+		u32 left;
+		u32 right;
+		/// Caller data for leaves, next free node for unused nodes.
+		u32 userData;
+		/// Leaves have height 0, unused nodes -1.
+		i32 height;
+
+		bool IsLeaf() const { return left == nullNode; }
+	};
+
+private:
+	std::vector<Node> nodes;
+	u32 root_ = nullNode;
+	u32 freeList = nullNode;
+	usize leafCount_ = 0;
+	std::vector<u32> dirtyLeaves;
+	u32 rebuildCursor = 0;
+
+public:
+	/// Insert an object, returns its proxy. The stored box is `box` enlarged by `margin`.
+	u32 Insert(const AABB& box, u32 userData, f32 margin = 0.0f);
+	void Remove(u32 proxy);
+	/// Set the box of a proxy. If `margin` is positive and the stored (enlarged) box
+	/// still contains `box`, nothing changes and false is returned. Ancestors are not
+	/// updated until the next `Refit`.
+	bool Update(u32 proxy, const AABB& box, f32 margin = 0.0f);
+	/// Recompute the boxes of every ancestor of the leaves updated since the last refit.
+	void Refit();
+	/// Reinsert up to `maxLeaves` leaves (round robin over the whole tree), which
+	/// gradually restores the quality lost to refitting.
+	void IncrementalRebuild(u32 maxLeaves);
+
+	/// Call `func(proxy)` for each leaf overlapping `box`. Stops early if `func` returns false.
+	template <typename Func>
+	void Query(const AABB& box, Func&& func) const {
+		if (root_ == nullNode) return;
+		u32 stack[64];
+		std::vector<u32> overflow;
+		i32 top = 0;
+		stack[top++] = root_;
+		while (top > 0 || !overflow.empty()) {
+			u32 index;
+			if (!overflow.empty()) {
+				index = overflow.back();
+				overflow.pop_back();
+			} else {
+				index = stack[--top];
+			}
+			const auto& node = nodes[index];
+			if (!node.box.Overlaps(box)) continue;
+			if (node.IsLeaf()) {
+				if (!func(index)) return;
+			} else {
+				for (auto child : { node.left, node.right }) {
+					if (top < 64) {
+						stack[top++] = child;
+					} else {
+						overflow.push_back(child);
+					}
+				}
+			}
+		}
+	}
+
+	u32 root() const { return root_; }
+	const Node& node(u32 index) const { return nodes[index]; }
+	const AABB& box(u32 proxy) const { return nodes[proxy].box; }
+	u32 userData(u32 proxy) const { return nodes[proxy].userData; }
+	usize leafCount() const { return leafCount_; }
+	/// Size of the node array, including unused nodes. Valid node indices are below this.
+	usize nodeCapacity() const { return nodes.size(); }
+	i32 height() const { return root_ == nullNode ? 0 : nodes[root_].height; }
+	/// Sum of the surface area of internal nodes divided by the root's, the usual
+	/// measure of tree quality (lower is better).
+	f32 AreaRatio() const;
+
+private:
+	u32 AllocateNode();
+	void FreeNode(u32 index);
+	void InsertLeaf(u32 leaf);
+	void RemoveLeaf(u32 leaf);
+	void FixUpwards(u32 index);
+};
+
+} // namespace HOEngine
@@ -5,10 +5,13 @@
 #include <sstream>
 #include <random>
 #include <limits>
+#include <mutex>
+#include <unordered_map>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 #include "Engine.hpp"
 #include "GLWrapper.hpp"
+#include "Profiler.hpp"
 
 using namespace HOEngine;
 
@@ -76,11 +79,38 @@ std::optional<std::vector<std::string>> HOEngine::ReadFileLines(const std::strin
 	return lines;
 }
 
+namespace {
+	std::mutex assetsMutex;
+	std::unordered_map<AssetID, std::string> assetPaths;
+}
+
+AssetID HOEngine::RegisterAsset(const std::string& path) {
+	// FNV-1a
+	u64 id = 0xcbf29ce484222325;
+	for (auto c : path) {
+		id ^= static_cast<u8>(c);
+		id *= 0x100000001b3;
+	}
+	if (id == 0) id = 1;
+
+	std::lock_guard lock{assetsMutex};
+	assetPaths.insert({id, path});
+	return id;
+}
+
+std::optional<std::string> HOEngine::AssetPath(AssetID id) {
+	std::lock_guard lock{assetsMutex};
+	auto it = assetPaths.find(id);
+	if (it == assetPaths.end()) return {};
+	return it->second;
+}
+
 Window* Window::FromGLFW(GLFWwindow* handle) {
 	return static_cast<Window*>(glfwGetWindowUserPointer(handle));
 }
 
 void Window::HandleGLFWResize(GLFWwindow* handle, int32_t width, int32_t height) {
+	HOENGINE_PROFILE_SCOPE("Window::HandleGLFWResize");
 	auto window = Window::FromGLFW(handle);
 	if (window) {
 		window->Resize(width, height);
@@ -145,10 +175,16 @@ Window::~Window() noexcept {
 }
 
 void Window::Resize(int32_t width, int32_t height) {
+	HOENGINE_PROFILE_SCOPE("Window::Resize");
 	dim_.width = width;
 	dim_.height = height;
 }
 
+void Window::PollEvents() {
+	HOENGINE_PROFILE_SCOPE("Window::PollEvents");
+	glfwPollEvents();
+}
+
 ApplicationBase::ApplicationBase() {
 	if (!glfwInit()) {
 		throw std::runtime_error("Unable to initialize GLFW");
@@ -168,6 +204,11 @@ void SimpleVertex::SetupPointers() {
 	VertexAttributes<float[3], float[3], float[2]>::SetupPointers();
 }
 
+void SkinnedVertex::SetupPointers() {
+	VertexAttributes<float[3], float[3], float[2], u8[4], float[4]>::SetupPointers();
+}
+static_assert(sizeof(SkinnedVertex) == VertexAttributes<float[3], float[3], float[2], u8[4], float[4]>::bytes);
+
 bool SimpleVertex::operator==(const SimpleVertex& that) const {
 	return std::tie(pos, normal, uv) == std::tie(that.pos, that.normal, that.uv);
 }
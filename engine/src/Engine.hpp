@@ -85,6 +85,13 @@ inline void HashCombine(size_t& seed, size_t hash);
 std::optional<std::string> ReadFileAsStr(const std::string& path);
 std::optional<std::vector<std::string>> ReadFileLines(const std::string& path);
 
+/// Identifier of an asset file. A hash of its path, so IDs are stable across runs.
+using AssetID = u64;
+/// Remember `path` as an asset and return its ID. Never returns 0, which means "no asset".
+AssetID RegisterAsset(const std::string& path);
+/// Path of an asset previously passed to `RegisterAsset`.
+std::optional<std::string> AssetPath(AssetID id);
+
 template<i32 n, typename... Ts>
 using NthTypeOf = typename std::tuple_element<n, std::tuple<Ts...>>::type;
 
@@ -160,6 +167,8 @@ public:
 	~Window() noexcept;
 
 	void Resize(i32 width, i32 height);
+	/// Process pending events of every window, running their callbacks.
+	static void PollEvents();
 
 	Dimension& dim() { return dim_; }
 	const Dimension& dim() const { return dim_; }
@@ -187,6 +196,20 @@ public:
 	bool operator==(const SimpleVertex& that) const;
 };
 
+/// Vertex of a mesh deformed by up to four bones of a `Skeleton`.
+class SkinnedVertex {
+public:
+	/// Bone indices are read as (unnormalized) floats, cast them back in the shader.
+	static void SetupPointers();
+
+	glm::vec3 pos;
+	glm::vec3 normal;
+	glm::vec2 uv;
+	u8 bones[4];
+	/// Summing to 1, unused slots at 0.
+	glm::vec4 weights;
+};
+
 } // namespace HOEngine
 
 template<>
@@ -1,30 +1,49 @@
 #include <utility>
+#include <mutex>
+#include <shared_mutex>
 #include "Entity.hpp"
+#include "Profiler.hpp"
 
 using namespace HOEngine;
 
 namespace {
 	std::unordered_map<UUID, u32> runtimeCompMapping;
 	u32 nextRID = 0;
+	// Components are looked up from worker threads (e.g. parallel render recording),
+	// lookups of already known types only need a shared lock
+	std::shared_mutex runtimeCompMutex;
 
 	u32 FindCompRID(const UUID& typeID) {
-		auto it = runtimeCompMapping.find(typeID);
-		if (it == runtimeCompMapping.end()) {
-			runtimeCompMapping.insert({typeID, nextRID});
-			return nextRID++;
-		} else {
-			return it->second;
+		{
+			std::shared_lock lock{runtimeCompMutex};
+			auto it = runtimeCompMapping.find(typeID);
+			if (it != runtimeCompMapping.end()) return it->second;
 		}
+		std::unique_lock lock{runtimeCompMutex};
+		auto [it, inserted] = runtimeCompMapping.insert({typeID, nextRID});
+		if (inserted) ++nextRID;
+		return it->second;
 	}
 }
 
+void ComponentDeleter::operator()(Component* component) const noexcept {
+	if (!pool) {
+		delete component;
+		return;
+	}
+	// With virtual bases the `Component` subobject isn't necessarily at the start of the slot
+	auto slot = dynamic_cast<void*>(component);
+	component->~Component();
+	pool->Free(slot);
+}
+
 Entity Entity::New() {
 	return Entity{};
 }
 Entity Entity::NewObject() {
 	Entity entity;
-	entity.AddComponent(std::make_unique<TransformComponent>());
-	entity.AddComponent(std::make_unique<MeshComponent>());
+	entity.AddComponent(MakeComponent<TransformComponent>());
+	entity.AddComponent(MakeComponent<MeshComponent>());
 	return entity;
 }
 
@@ -32,17 +51,32 @@ Entity Entity::NewObject() {
 Entity::Entity() noexcept {
 }
 Entity::Entity(const Entity& that) {
+	HOENGINE_PROFILE_SCOPE("Entity::Clone");
 	for (const auto& [rid, compPtr] : that.components) {
 		this->components.insert({rid, compPtr->Clone()});
 	}
+	AttachComponents();
 }
 Entity& Entity::operator=(const Entity& that) {
+	HOENGINE_PROFILE_SCOPE("Entity::Clone");
 	this->components.clear();
 	for (const auto& [rid, compPtr] : that.components) {
 		this->components.insert({rid, compPtr->Clone()});
 	}
+	AttachComponents();
+	return *this;
+}
+Entity::Entity(Entity&& that) noexcept : components(std::move(that.components)) {
+	AttachComponents();
+}
+Entity& Entity::operator=(Entity&& that) noexcept {
+	components = std::move(that.components);
+	AttachComponents();
 	return *this;
 }
+void Entity::AttachComponents() {
+	for (auto& [rid, comp] : components) comp->attachedEntity = this;
+}
 
 Component* Entity::GetComponent(const UUID& typeID) {
 	auto rid = FindCompRID(typeID);
@@ -58,13 +92,13 @@ Component& Entity::GetComponentChecked(const UUID& typeID) {
 	if (!ptr) throw std::runtime_error("This entity does not contain a component that has the given UUID");
 	return *ptr;
 }
-void Entity::AddComponent(std::unique_ptr<Component> component) {
+void Entity::AddComponent(ComponentPtr<> component) {
 	if (!component) return;
 	auto rid = FindCompRID(component->GetTypeID());
 	component->attachedEntity = this;
 	components[rid] = std::move(component);
 }
-std::unique_ptr<Component> Entity::TakeComponent(const UUID &typeID) {
+ComponentPtr<> Entity::TakeComponent(const UUID &typeID) {
 	auto rid = FindCompRID(typeID);
 	auto iter = components.find(rid);
 	if (iter != components.end()) {
@@ -95,6 +129,7 @@ Entity* EntitiesStorage::Get(EntityID id) {
 	}
 }
 EntityID EntitiesStorage::Add(Entity entity) {
+	HOENGINE_PROFILE_SCOPE("EntitiesStorage::Add");
 	auto gen = nextGen++;
 	auto entry = Entry{std::move(entity), gen};
 	auto next = NextAvailableSpot();
@@ -109,11 +144,23 @@ EntityID EntitiesStorage::Add(Entity entity) {
 	return EntityID{idx, gen};
 }
 void EntitiesStorage::Remove(EntityID id) {
+	HOENGINE_PROFILE_SCOPE("EntitiesStorage::Remove");
 	entities[id.idx].value.RemoveAllComponents(); // Save space for tombstone 
 	entities[id.idx].gen = INVALID_GEN;
 	tombstones.push(id.idx);
 }
 
+EntitiesStorage EntitiesStorage::New() {
+	return EntitiesStorage{};
+}
+usize EntitiesStorage::Size() const {
+	return entities.size() - tombstones.size();
+}
+Entity* EntitiesStorage::At(usize idx) {
+	auto& candidate = entities[idx];
+	return candidate.gen == INVALID_GEN ? nullptr : &candidate.value;
+}
+
 std::optional<u64> EntitiesStorage::NextAvailableSpot() {
 	if (tombstones.empty()) return {};
 	auto result = tombstones.front();
@@ -122,34 +169,33 @@ std::optional<u64> EntitiesStorage::NextAvailableSpot() {
 }
 
 glm::mat4 TransformComponent::TranslationMat() const {
-	glm::mat4 result;
+	glm::mat4 result(1.0f);
 	// Position vector -> 4th column
 	result[3] = glm::vec4(pos, 1);
 	return result;
 };
 glm::mat4 TransformComponent::RotationMat() const {
-	glm::mat4 result;
-	result[0][0] = 1 - 2*rot.y*rot.y - 2*rot.z*rot.z;
-	result[0][1] = 2*rot.x*rot.y + 2*rot.w*rot.z;
-	result[0][2] = 2*rot.x*rot.z - 2*rot.w*rot.y;
-	result[1][0] = 2*rot.x*rot.y - 2*rot.w*rot.z;
-	result[1][1] = 1 - 2*rot.x*rot.x - 2*rot.z*rot.z;
-	result[1][2] = 2*rot.y*rot.z + 2*rot.w*rot.x;
-	result[2][0] = 2*rot.x*rot.z + 2*rot.w*rot.y;
-	result[2][1] = 2*rot.w*rot.z - 2*rot.w*rot.x;
-	result[2][2] = 1 - 2*rot.x*rot.x - 2*rot.y*rot.y;
-	return result;
+	return glm::mat4_cast(rot);
 }
 glm::mat4 TransformComponent::ScaleMat() const {
-	glm::mat4 result;
+	glm::mat4 result(1.0f);
 	result[0][0] = scale[0];
 	result[1][1] = scale[1];
 	result[2][2] = scale[2];
-	result[3][3] = scale[3];
 	return result;
 }
 glm::mat4 TransformComponent::TransformMat() const {
-	return ScaleMat() * RotationMat() * TranslationMat();
+	// Scale, then rotate, then translate, as `TransformBounds` does
+	return TranslationMat() * RotationMat() * ScaleMat();
+}
+AABB TransformComponent::TransformBounds(const AABB& local) const {
+	if (local.IsEmpty()) return local;
+	// Rotation and scale applied to the box's center and (absolute) extents
+	auto linear = glm::mat3_cast(rot);
+	for (i32 i = 0; i < 3; ++i) linear[i] *= scale[i];
+	auto absLinear = linear;
+	for (i32 i = 0; i < 3; ++i) absLinear[i] = glm::abs(linear[i]);
+	return AABB::FromCenterExtents(pos + linear * local.Center(), absLinear * local.Extents());
 }
 
 usize MeshComponent::VerticesSize() const {
@@ -158,6 +204,12 @@ usize MeshComponent::VerticesSize() const {
 usize MeshComponent::IndicesSize() const {
 	return sizeof(indices) + sizeof(decltype(indices)::value_type) * vertices.size();
 }
+void MeshComponent::RecomputeBounds() {
+	bounds = AABB{};
+	for (const auto& vert : vertices) {
+		bounds.Extend(vert.pos);
+	}
+}
 
 void MeshRendererComponent::Populate() {
 	glBindVertexArray(vao.handle());
@@ -175,3 +227,6 @@ glm::mat4 CameraComponent::PerspectiveMat(const Window* window) const {
 	float aspect = static_cast<float>(window->width() / window->height());
 	return glm::perspective(fov, aspect, nearPane, farPane);
 }
+Frustum CameraComponent::ViewFrustum(const Window* window) const {
+	return Frustum::FromMatrix(PerspectiveMat(window) * ViewMat());
+}
@@ -1,19 +1,64 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <optional>
 #include <vector>
 #include <queue>
 #include <unordered_map>
 #include <cstdint>
+#include <new>
+#include <typeinfo>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include "Engine.hpp"
+#include "Bounds.hpp"
 #include "GLWrapper.hpp"
+#include "SlabPool.hpp"
 
 namespace HOEngine {
 
 class Entity; // Fuck C++ again
+class Component;
+
+/// Deleter of component pointers. Returns pooled components to their pool, and
+/// deletes the others so `std::make_unique`'d components are still accepted.
+struct ComponentDeleter {
+	/// `nullptr` for components allocated with `new`.
+	SlabPool* pool = nullptr;
+
+	ComponentDeleter() noexcept = default;
+	explicit ComponentDeleter(SlabPool* pool) noexcept : pool{pool} {}
+	template <typename Comp>
+	ComponentDeleter(const std::default_delete<Comp>&) noexcept {}
+
+	void operator()(Component* component) const noexcept;
+};
+
+template <typename Comp = Component>
+using ComponentPtr = std::unique_ptr<Comp, ComponentDeleter>;
+
+/// Pool every `Comp` created with `MakeComponent` is allocated from. Never
+/// destroyed, since components may live in objects with static storage.
+template <typename Comp>
+SlabPool& ComponentPool() {
+	static SlabPool& pool = *new SlabPool(typeid(Comp).name(), sizeof(Comp), alignof(Comp));
+	return pool;
+}
+
+/// Pooled counterpart of `std::make_unique` for components.
+template <typename Comp, typename... Args>
+ComponentPtr<Comp> MakeComponent(Args&&... args) {
+	auto& pool = ComponentPool<Comp>();
+	auto slot = pool.Allocate();
+	try {
+		return ComponentPtr<Comp>(new (slot) Comp(std::forward<Args>(args)...), ComponentDeleter{&pool});
+	} catch (...) {
+		pool.Free(slot);
+		throw;
+	}
+}
+
 class Component {
 private:
 	Entity* attachedEntity;
@@ -25,12 +70,12 @@ public:
 	Component& operator=(const Component&) = default;
 	Component(Component&&) = default;
 	Component& operator=(Component&&) = default;
-	std::unique_ptr<Component> Clone() const { return std::unique_ptr<Component>(this->CloneImpl()); }
+	ComponentPtr<Component> Clone() const { return this->CloneImpl(); }
 
 	virtual const UUID& GetTypeID() const = 0;
 
 protected:
-	virtual Component* CloneImpl() const = 0;
+	virtual ComponentPtr<Component> CloneImpl() const = 0;
 	Entity* Ent() const { return attachedEntity; }
 	
 	friend Entity;
@@ -43,7 +88,7 @@ struct EntityID {
 
 class Entity {
 private:
-	std::unordered_map<u32, std::unique_ptr<Component>> components;
+	std::unordered_map<u32, ComponentPtr<>> components;
 
 public:
 	/// Create a new Entity that has nothing attached.
@@ -52,10 +97,12 @@ public:
 	static Entity NewObject();
 
 	Entity() noexcept;
+	/// Copies and moves attach the components to the new entity, so `Ent()` keeps
+	/// pointing at their owner when entities are moved around, e.g. into storage.
 	Entity(const Entity&);
 	Entity& operator=(const Entity&);
-	Entity(Entity&&) = default;
-	Entity& operator=(Entity&&) = default;
+	Entity(Entity&& that) noexcept;
+	Entity& operator=(Entity&& that) noexcept;
 
 	/// Attempt to get a component with the given UUID. Might return `nullptr`
 	/// if this entity does not contain the given UUID.
@@ -68,14 +115,23 @@ public:
 	Comp* GetComponent() { return dynamic_cast<Comp*>(GetComponent(Comp::uuid)); }
 
 	/// Move the given component into this entity.
-	void AddComponent(std::unique_ptr<Component> component);
+	void AddComponent(ComponentPtr<> component);
 	/// Remove a component from this entity that has the given UUID, and return
 	/// the ownership to the caller.
-	std::unique_ptr<Component> TakeComponent(const UUID& typeID);
+	ComponentPtr<> TakeComponent(const UUID& typeID);
 	/// Destroying a component from this entity that has the given UUID.
 	void RemoveComponent(const UUID& typeID);
 	/// Destroy all components from this entity.
 	void RemoveAllComponents();
+
+	/// Call `func(const Component&)` for each attached component, in no particular order.
+	template <typename Func>
+	void ForEachComponent(Func&& func) const {
+		for (const auto& [rid, comp] : components) func(*comp);
+	}
+
+private:
+	void AttachComponents();
 };
 
 class EntitiesStorage {
@@ -87,27 +143,38 @@ public:
 	static const u64 INVALID_GEN = 0;
 
 private:
+	std::vector<Entry> entities;
+	std::queue<usize> tombstones;
+	u64 nextGen = 1; // Generation 0 is reserved for static null
+
+public:
 	static EntitiesStorage New();
 
+	EntitiesStorage() = default;
 	~EntitiesStorage() noexcept = default;
 	EntitiesStorage(const EntitiesStorage&) = default;
 	EntitiesStorage& operator=(const EntitiesStorage&) = default;
 	EntitiesStorage(EntitiesStorage&&) = default;
 	EntitiesStorage& operator=(EntitiesStorage&&) = default;
 
-	std::vector<Entry> entities;
-	std::queue<usize> tombstones;
-	u64 nextGen = 1; // Generation 0 is reserved for static null
-
-public:
 	Entity* Get(EntityID id);
 	EntityID Add(Entity entity);
 	void Remove(EntityID id);
 
+	/// Number of live entities.
 	usize Size() const;
+	/// Number of slots, live or not. Valid slot indices are below this.
+	usize Capacity() const { return entities.size(); }
+	/// Entity in the given slot, or `nullptr` if the slot is a tombstone. Along with
+	/// `Capacity()`, this allows iterating (and splitting across threads) every entity.
+	Entity* At(usize idx);
+	/// ID of the entity currently in the given slot.
+	EntityID IDAt(usize idx) const { return EntityID{idx, entities[idx].gen}; }
 
 private:
 	std::optional<u64> NextAvailableSpot();
+
+	friend class Snapshot;
 };
 
 // =================== //
@@ -132,14 +199,17 @@ public:
 
 public:
 	virtual ~TransformComponent() noexcept = default;
-	std::unique_ptr<TransformComponent> Clone() const { return std::make_unique<TransformComponent>(*this); }
+	ComponentPtr<TransformComponent> Clone() const { return MakeComponent<TransformComponent>(*this); }
 	glm::mat4 TranslationMat() const;
 	glm::mat4 RotationMat() const;
 	glm::mat4 ScaleMat() const;
+	/// Local to world matrix, `TranslationMat() * RotationMat() * ScaleMat()`.
 	glm::mat4 TransformMat() const;
+	/// Bounds of the given local space box after applying `TransformMat()`.
+	AABB TransformBounds(const AABB& local) const;
 
 protected:
-	virtual TransformComponent* CloneImpl() const override { return new TransformComponent(*this); }
+	virtual ComponentPtr<Component> CloneImpl() const override { return Clone(); }
 };
 
 /// In-memory representation of an .obj model file.
@@ -147,16 +217,23 @@ class MeshComponent : public ComponentUUIDMixin<0xf4a188a7625c4116, 0xb4d9d87275
 public:
 	std::vector<SimpleVertex> vertices;
 	std::vector<GLuint> indices;
+	/// Local space bounds of `vertices`. Filled by the model loaders, call
+	/// `RecomputeBounds()` after modifying `vertices` by hand.
+	AABB bounds;
+	/// File the mesh was loaded from, 0 if it was built by hand. Snapshots store
+	/// only this ID when set, so reset it after modifying a loaded mesh.
+	AssetID asset = 0;
 
 public:
 	virtual ~MeshComponent() noexcept = default;
-	std::unique_ptr<MeshComponent> Clone() const { return std::make_unique<MeshComponent>(*this); }
+	ComponentPtr<MeshComponent> Clone() const { return MakeComponent<MeshComponent>(*this); }
 
 	usize VerticesSize() const;
 	usize IndicesSize() const;
+	void RecomputeBounds();
 
 protected:
-	virtual MeshComponent* CloneImpl() const override { return new MeshComponent(*this); }
+	virtual ComponentPtr<Component> CloneImpl() const override { return Clone(); }
 };
 
 /// Universal renderer component base class. Each component of this type will issue a
@@ -179,13 +256,52 @@ protected:
 class DotLightComponent : public ComponentUUIDMixin<0x0559640e4d14a16, 0xa9222e414f78105d> {
 public:
 	float strength;
+	/// Distance beyond which the light has no effect, used to cull it.
+	float radius = 10.0f;
+	glm::vec3 color{1.0f, 1.0f, 1.0f};
 
 public:
 	virtual ~DotLightComponent() noexcept = default;
-	std::unique_ptr<DotLightComponent> Clone() const { return std::make_unique<DotLightComponent>(*this); }
+	ComponentPtr<DotLightComponent> Clone() const { return MakeComponent<DotLightComponent>(*this); }
+
+protected:
+	virtual ComponentPtr<Component> CloneImpl() const override { return Clone(); }
+};
+
+/// Spawns particles around the entity's `TransformComponent`, simulated and drawn
+/// by a `ParticleSystem`.
+class ParticleEmitterComponent : public ComponentUUIDMixin<0x801755b5f9cefd3c, 0xafc0afe5518503f6> {
+public:
+	/// Particles spawned per second.
+	float rate = 100.0f;
+	/// Particles alive at once are capped to this.
+	u32 maxParticles = 10000;
+	/// Seconds each particle lives, picked at random in this range.
+	float lifetimeMin = 1.0f;
+	float lifetimeMax = 2.0f;
+	/// Half size of the world aligned box particles spawn in, centered on the entity.
+	glm::vec3 spawnExtents{0.0f};
+	/// Initial velocity, in the entity's local space.
+	glm::vec3 velocity{0.0f, 1.0f, 0.0f};
+	/// Up to this much is randomly added to the initial velocity along each axis.
+	glm::vec3 velocityJitter{0.5f};
+	/// Constant acceleration, e.g. gravity or wind.
+	glm::vec3 acceleration{0.0f, -9.81f, 0.0f};
+	/// Fraction of the velocity lost per second.
+	float drag = 0.0f;
+	float sizeStart = 0.1f;
+	float sizeEnd = 0.1f;
+	/// Color over a particle's life, keys evenly spaced from birth to death.
+	std::array<glm::vec4, 4> colors{ glm::vec4(1.0f), glm::vec4(1.0f), glm::vec4(1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 0.0f) };
+	/// Simulate on the GPU with transform feedback instead of on the CPU.
+	bool gpuSimulated = false;
+
+public:
+	virtual ~ParticleEmitterComponent() noexcept = default;
+	ComponentPtr<ParticleEmitterComponent> Clone() const { return MakeComponent<ParticleEmitterComponent>(*this); }
 
 protected:
-	virtual DotLightComponent* CloneImpl() const override { return new DotLightComponent(*this); }
+	virtual ComponentPtr<Component> CloneImpl() const override { return Clone(); }
 };
 
 class CameraComponent : public ComponentUUIDMixin<0xe1d462fbad2f4a68, 0x872ecda918eac742> {
@@ -198,12 +314,14 @@ public:
 
 public:
 	virtual ~CameraComponent() noexcept = default;
-	std::unique_ptr<CameraComponent> Clone() const { return std::make_unique<CameraComponent>(*this); }
+	ComponentPtr<CameraComponent> Clone() const { return MakeComponent<CameraComponent>(*this); }
 	glm::mat4 ViewMat() const;
 	glm::mat4 PerspectiveMat(const Window* window) const;
+	/// Frustum of `PerspectiveMat(window) * ViewMat()`, in world space.
+	Frustum ViewFrustum(const Window* window) const;
 
 protected:
-	virtual CameraComponent* CloneImpl() const override { return new CameraComponent(*this); }
+	virtual ComponentPtr<Component> CloneImpl() const override { return Clone(); }
 };
 
 } // namespace HOEngine
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cmath>
+#include "FramePipeline.hpp"
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+void HOEngine::CaptureTransforms(EntitiesStorage& storage, TransformSnapshot& snapshot) {
+	HOENGINE_PROFILE_SCOPE("CaptureTransforms");
+	// Reuse the vector's memory from the last time this slot was written
+	snapshot.transforms.clear();
+	for (usize idx = 0; idx < storage.Capacity(); ++idx) {
+		auto entity = storage.At(idx);
+		if (!entity) continue;
+		auto transform = entity->GetComponent<TransformComponent>();
+		if (!transform) continue;
+		auto id = storage.IDAt(idx);
+		snapshot.transforms.push_back(EntityTransform{ id.idx, id.gen, transform->pos, transform->rot, transform->scale });
+	}
+	HOENGINE_PROFILE_COUNTER("Entities", snapshot.transforms.size());
+}
+
+void SnapshotBuffer::Publish() {
+	// Hand the written slot over as the latest one and take back whichever slot was
+	// latest before; the reader never holds it, since it swaps its own slot in
+	auto old = latest.exchange(static_cast<u8>(writeSlot | freshBit), std::memory_order_acq_rel);
+	writeSlot = old & ~freshBit;
+}
+
+bool SnapshotBuffer::Acquire() {
+	if (!(latest.load(std::memory_order_relaxed) & freshBit)) return false;
+
+	if (hasCurrent_) {
+		// Keep the current snapshot as the previous one. Swapping hands the old
+		// previous' memory to the slot, which the writer will overwrite anyway
+		std::swap(previous, slots[readSlot]);
+		hasPrevious_ = true;
+	}
+	auto fresh = latest.exchange(readSlot, std::memory_order_acq_rel);
+	readSlot = fresh & ~freshBit;
+	hasCurrent_ = true;
+	return true;
+}
+
+FramePacingStats::FramePacingStats(f64 deadline, usize window)
+		: samples(std::max<usize>(window, 1))
+		, deadline{ deadline } {
+}
+
+void FramePacingStats::Record(f64 frameTime) {
+	samples[next] = frameTime;
+	next = (next + 1) % samples.size();
+	count = std::min(count + 1, samples.size());
+	++totalFrames;
+	if (frameTime > deadline) ++missedDeadlines;
+}
+
+f64 FramePacingStats::Percentile(f64 p) const {
+	if (count == 0) return 0;
+	ScratchArena scratch;
+	std::pmr::vector<f64> sorted(samples.begin(), samples.begin() + count, scratch.resource());
+	auto rank = static_cast<usize>(std::ceil(std::clamp(p, 0.0, 1.0) * count));
+	auto nth = sorted.begin() + (rank == 0 ? 0 : rank - 1);
+	std::nth_element(sorted.begin(), nth, sorted.end());
+	return *nth;
+}
+
+f64 FramePacingStats::Last() const {
+	if (count == 0) return 0;
+	return samples[(next + samples.size() - 1) % samples.size()];
+}
+
+std::pmr::vector<f32> FramePacingStats::History(std::pmr::memory_resource* resource) const {
+	std::pmr::vector<f32> result{ resource };
+	result.reserve(count);
+	auto first = count < samples.size() ? 0 : next;
+	for (usize i = 0; i < count; ++i) {
+		result.push_back(static_cast<f32>(samples[(first + i) % samples.size()]));
+	}
+	return result;
+}
+
+void FramePacingStats::Reset() {
+	next = 0;
+	count = 0;
+	totalFrames = 0;
+	missedDeadlines = 0;
+}
+
+FramePipeline::FramePipeline(SimulateFunc simulate, Config config)
+		: simulate{ std::move(simulate) }
+		, config{ config }
+		, pacing_(config.frameDeadline) {
+}
+
+FramePipeline::~FramePipeline() noexcept {
+	Stop();
+}
+
+void FramePipeline::Start() {
+	if (running.exchange(true)) return;
+	startTime = Clock::now();
+	frameStart = startTime;
+	thread = std::thread([this]() { SimulationLoop(); });
+}
+
+void FramePipeline::Stop() {
+	running.store(false);
+	if (thread.joinable()) thread.join();
+}
+
+void FramePipeline::SimulationLoop() {
+	HOENGINE_PROFILE_THREAD("Simulation");
+	using Seconds = std::chrono::duration<f64>;
+	auto step = std::chrono::duration_cast<Clock::duration>(Seconds(tickLength()));
+	auto nextTick = startTime + step;
+	u64 tick = 0;
+
+	while (running.load(std::memory_order_relaxed)) {
+		std::this_thread::sleep_until(nextTick);
+
+		u32 ran = 0;
+		while (Clock::now() >= nextTick && ran < config.maxCatchUpTicks) {
+			HOENGINE_PROFILE_SCOPE("SimulationTick");
+			auto tickStart = Clock::now();
+			auto& out = snapshots.WriteTarget();
+			simulate(tickLength(), tick, out);
+			++tick;
+			out.tick = tick;
+			out.time = static_cast<f64>(tick) * tickLength();
+			snapshots.Publish();
+
+			auto duration = Seconds(Clock::now() - tickStart).count();
+			lastTickDuration.store(duration, std::memory_order_relaxed);
+			if (duration > tickLength()) overruns.fetch_add(1, std::memory_order_relaxed);
+			ticks.fetch_add(1, std::memory_order_relaxed);
+			nextTick += step;
+			++ran;
+		}
+
+		// Too far behind to catch up: drop the missed ticks rather than spiralling
+		auto now = Clock::now();
+		if (now >= nextTick) {
+			auto behind = static_cast<u64>((now - nextTick) / step) + 1;
+			droppedTicks.fetch_add(behind, std::memory_order_relaxed);
+			nextTick += step * behind;
+			// Keep simulation time in sync with wall time for the render side
+			tick += behind;
+		}
+	}
+}
+
+void FramePipeline::BeginFrame() {
+	using Seconds = std::chrono::duration<f64>;
+	HOENGINE_PROFILE_FRAME();
+	frameStart = Clock::now();
+	snapshots.Acquire();
+
+	// Render one tick in the past, so that there are usually two snapshots around the
+	// rendered time to interpolate between
+	renderTime_ = std::max(Seconds(frameStart - startTime).count() - tickLength(), 0.0);
+	if (snapshots.hasPrevious()) {
+		auto from = snapshots.Previous().time;
+		auto to = snapshots.Current().time;
+		alpha_ = to > from ? static_cast<f32>(std::clamp((renderTime_ - from) / (to - from), 0.0, 1.0)) : 1.0f;
+	} else {
+		alpha_ = 1.0f;
+	}
+}
+
+void FramePipeline::EndFrame() {
+	using Seconds = std::chrono::duration<f64>;
+	pacing_.Record(Seconds(Clock::now() - frameStart).count());
+}
+
+void FramePipeline::Interpolate(std::vector<EntityTransform>& out) const {
+	out.clear();
+	if (!snapshots.hasCurrent()) return;
+
+	const auto& prev = snapshots.Previous().transforms;
+	const auto& curr = snapshots.Current().transforms;
+	out.reserve(curr.size());
+
+	// Both are sorted by slot, so entities are matched up with a single merge pass
+	usize p = 0;
+	for (const auto& to : curr) {
+		while (p < prev.size() && prev[p].entityIdx < to.entityIdx) ++p;
+		if (!snapshots.hasPrevious() || p == prev.size() || prev[p].entityIdx != to.entityIdx || prev[p].entityGen != to.entityGen) {
+			out.push_back(to);
+			continue;
+		}
+		const auto& from = prev[p];
+		out.push_back(EntityTransform{
+			to.entityIdx,
+			to.entityGen,
+			glm::mix(from.pos, to.pos, alpha_),
+			glm::slerp(from.rot, to.rot, alpha_),
+			glm::mix(from.scale, to.scale, alpha_),
+		});
+	}
+}
+
+FramePipeline::SimulationStats FramePipeline::simulationStats() const {
+	return SimulationStats{
+		ticks.load(std::memory_order_relaxed),
+		overruns.load(std::memory_order_relaxed),
+		droppedTicks.load(std::memory_order_relaxed),
+		lastTickDuration.load(std::memory_order_relaxed),
+	};
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "Arena.hpp"
+#include "Engine.hpp"
+#include "Entity.hpp"
+
+namespace HOEngine {
+
+/// Transform of one entity at one simulation tick.
+struct EntityTransform {
+	usize entityIdx;
+	u64 entityGen;
+	glm::vec3 pos;
+	glm::quat rot;
+	glm::vec3 scale;
+};
+
+/// State published by the simulation at the end of a tick. Never modified after
+/// being published, until the slot is recycled by the `SnapshotBuffer`.
+struct TransformSnapshot {
+	u64 tick = 0;
+	/// Simulation time at the end of the tick, in seconds.
+	f64 time = 0;
+	/// Sorted by entity slot.
+	std::vector<EntityTransform> transforms;
+};
+
+/// Fill `snapshot` with the transform of every live entity in `storage`.
+void CaptureTransforms(EntitiesStorage& storage, TransformSnapshot& snapshot);
+
+/// Lock-free triple buffer passing snapshots from one writer to one reader. The
+/// writer always has a slot to write into, and the reader always sees the most
+/// recently published snapshot; intermediate snapshots are dropped if the reader
+/// falls behind.
+///
+/// The reader additionally keeps the snapshot it previously read, so it can
+/// interpolate between the last two.
+class SnapshotBuffer {
+private:
+	static constexpr u8 freshBit = 4;
+
+	std::array<TransformSnapshot, 3> slots;
+	/// Index of the most recently published slot, ORed with `freshBit` if the
+	/// reader has not picked it up yet.
+	std::atomic<u8> latest{ 1 };
+	u8 writeSlot = 0;
+	u8 readSlot = 2;
+	TransformSnapshot previous;
+	bool hasCurrent_ = false;
+	bool hasPrevious_ = false;
+
+public:
+	/// Writer side: the snapshot to fill before calling `Publish`.
+	TransformSnapshot& WriteTarget() { return slots[writeSlot]; }
+	void Publish();
+
+	/// Reader side: pick up the latest snapshot if a new one was published.
+	/// Returns whether `Current()` changed.
+	bool Acquire();
+	const TransformSnapshot& Current() const { return slots[readSlot]; }
+	const TransformSnapshot& Previous() const { return previous; }
+	bool hasCurrent() const { return hasCurrent_; }
+	bool hasPrevious() const { return hasPrevious_; }
+};
+
+/// Rolling window of frame times with percentiles and deadline misses.
+class FramePacingStats {
+private:
+	std::vector<f64> samples;
+	usize next = 0;
+	usize count = 0;
+	u64 totalFrames = 0;
+	u64 missedDeadlines = 0;
+
+public:
+	/// Frame time budget, frames taking longer are counted as missed deadlines.
+	f64 deadline;
+
+	explicit FramePacingStats(f64 deadline = 1.0 / 60.0, usize window = 240);
+
+	void Record(f64 frameTime);
+	/// Frame time at the given percentile (0 to 1) over the window.
+	f64 Percentile(f64 p) const;
+	f64 P50() const { return Percentile(0.50); }
+	f64 P99() const { return Percentile(0.99); }
+	f64 Last() const;
+	u64 frames() const { return totalFrames; }
+	u64 missed() const { return missedDeadlines; }
+	/// Samples in the window, oldest first (e.g. for plotting). Allocated from
+	/// the current frame arena by default, so only valid until the end of the next
+	/// frame.
+	std::pmr::vector<f32> History(std::pmr::memory_resource* resource = &FrameArena::Global().Current()) const;
+	void Reset();
+};
+
+/// Runs the simulation at a fixed timestep on its own thread, decoupled from
+/// rendering. Each tick calls the simulate function, which advances the world by
+/// exactly `tickLength` seconds and fills the snapshot to publish. The render thread
+/// picks up snapshots in `BeginFrame` and interpolates between the last two, one
+/// tick behind real time, so simulation of the next tick overlaps rendering and a
+/// slow tick only holds the last pose instead of stuttering.
+///
+/// The world is owned by the simulation thread while the pipeline runs; the render
+/// thread must only read from snapshots.
+class FramePipeline {
+public:
+	struct Config {
+		f64 tickRate = 60.0;
+		/// When the simulation falls behind, at most this many ticks are run back to
+		/// back before dropping the remaining time.
+		u32 maxCatchUpTicks = 5;
+		/// Render frame time budget for the pacing stats.
+		f64 frameDeadline = 1.0 / 60.0;
+	};
+
+	using SimulateFunc = std::function<void(f64 tickLength, u64 tick, TransformSnapshot& out)>;
+
+	struct SimulationStats {
+		u64 ticks = 0;
+		/// Ticks that took longer than `tickLength` to simulate.
+		u64 overruns = 0;
+		/// Ticks skipped because the simulation fell too far behind.
+		u64 droppedTicks = 0;
+		f64 lastTickDuration = 0;
+	};
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	SimulateFunc simulate;
+	Config config;
+	SnapshotBuffer snapshots;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	Clock::time_point startTime;
+	Clock::time_point frameStart;
+	f64 renderTime_ = 0;
+	f32 alpha_ = 0;
+	FramePacingStats pacing_;
+
+	std::atomic<u64> ticks{ 0 };
+	std::atomic<u64> overruns{ 0 };
+	std::atomic<u64> droppedTicks{ 0 };
+	std::atomic<f64> lastTickDuration{ 0 };
+
+public:
+	FramePipeline(SimulateFunc simulate, Config config);
+	explicit FramePipeline(SimulateFunc simulate) : FramePipeline(std::move(simulate), Config{}) {}
+	~FramePipeline() noexcept;
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	void Start();
+	/// Stop and join the simulation thread. Safe to call multiple times.
+	void Stop();
+	bool IsRunning() const { return running.load(); }
+
+	/// Render thread: mark the beginning of a frame, pick up new snapshots and
+	/// compute the interpolation factor.
+	void BeginFrame();
+	/// Render thread: mark the end of a frame, recording its duration.
+	void EndFrame();
+
+	/// Simulation time being rendered this frame, one tick behind the latest tick.
+	f64 RenderTime() const { return renderTime_; }
+	/// Interpolation factor between `Previous()` and `Current()` for this frame.
+	f32 Alpha() const { return alpha_; }
+	const TransformSnapshot& Previous() const { return snapshots.Previous(); }
+	const TransformSnapshot& Current() const { return snapshots.Current(); }
+	/// Blend the last two snapshots by `Alpha()`. Entities missing from the previous
+	/// snapshot use their current transform.
+	void Interpolate(std::vector<EntityTransform>& out) const;
+
+	f64 tickLength() const { return 1.0 / config.tickRate; }
+	const FramePacingStats& pacing() const { return pacing_; }
+	FramePacingStats& pacing() { return pacing_; }
+	SimulationStats simulationStats() const;
+
+private:
+	void SimulationLoop();
+};
+
+} // namespace HOEngine
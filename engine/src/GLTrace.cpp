@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include "GLTrace.hpp"
+
+using namespace HOEngine;
+
+#ifdef HOENGINE_GL_TRACE
+
+namespace {
+	enum FuncID : u16 {
+#define HOENGINE_GL_ID(ret, name, params, args, hook, fake) ID_##name,
+		HOENGINE_GL_FUNCTIONS(HOENGINE_GL_ID)
+#undef HOENGINE_GL_ID
+		funcCount,
+	};
+
+	const char* const funcNames[] = {
+#define HOENGINE_GL_NAME(ret, name, params, args, hook, fake) #name,
+		HOENGINE_GL_FUNCTIONS(HOENGINE_GL_NAME)
+#undef HOENGINE_GL_NAME
+	};
+
+	/// Function pointers with the same layout as the ones gl3w exposes. `name`
+	/// expands to gl3w's pointer, so `decltype` gives its exact type.
+	struct Procs {
+#define HOENGINE_GL_PROC(ret, name, params, args, hook, fake) decltype(name) name##Proc;
+		HOENGINE_GL_FUNCTIONS(HOENGINE_GL_PROC)
+#undef HOENGINE_GL_PROC
+	};
+
+	struct Counter {
+		u64 calls;
+		u64 nanos;
+		u64 flagged;
+	};
+
+	struct State {
+		bool installed = false;
+		bool inFrame = false;
+		/// gl3w's pointers before installing, restored by `Uninstall`.
+		Procs original{};
+		/// Where the shims forward calls, either `original` or the fakes.
+		Procs target{};
+
+		Counter counters[funcCount]{};
+		u64 redundantBinds = 0;
+		u64 locationLookups = 0;
+		u64 syncPoints = 0;
+		u64 frame = 0;
+		GLTrace::Report lastReport;
+		std::ostream* reportOutput = nullptr;
+		u32 reportInterval = 1;
+
+		// Bindings as seen through the shim, for redundant bind detection
+		GLuint program = 0;
+		GLuint vertexArray = 0;
+		GLenum activeTexture = GL_TEXTURE0;
+		std::unordered_map<GLenum, GLuint> buffers;
+		std::unordered_map<GLenum, GLuint> framebuffers;
+		/// Keyed by texture unit and target.
+		std::unordered_map<u64, GLuint> textures;
+
+		void ForgetBindings() {
+			program = 0;
+			vertexArray = 0;
+			activeTexture = GL_TEXTURE0;
+			buffers.clear();
+			framebuffers.clear();
+			textures.clear();
+		}
+	};
+
+	State& GetState() {
+		static State state;
+		return state;
+	}
+
+	/// Attributes the time spent until destruction to a function.
+	class CallTimer {
+	private:
+		FuncID id;
+		std::chrono::steady_clock::time_point start;
+
+	public:
+		explicit CallTimer(FuncID id)
+				: id{ id }
+				, start{ std::chrono::steady_clock::now() } {
+		}
+		~CallTimer() noexcept {
+			auto& counter = GetState().counters[id];
+			++counter.calls;
+			counter.nanos += static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+	};
+
+	/// Checks run before forwarding a call, named by the `hook` column of
+	/// `HOENGINE_GL_FUNCTIONS`.
+	namespace Hooks {
+		void Flag(FuncID id, u64& category) {
+			++GetState().counters[id].flagged;
+			++category;
+		}
+
+		/// Flag a bind if `slot` already holds `object`, then update it.
+		void CheckBind(FuncID id, GLuint& slot, GLuint object) {
+			if (slot == object) Flag(id, GetState().redundantBinds);
+			slot = object;
+		}
+
+		template <FuncID id, typename... Args>
+		void None(Args...) {}
+
+		template <FuncID id, typename... Args>
+		void Sync(Args...) {
+			if (GetState().inFrame) Flag(id, GetState().syncPoints);
+		}
+
+		template <FuncID id, typename... Args>
+		void Lookup(Args...) {
+			if (GetState().inFrame) Flag(id, GetState().locationLookups);
+		}
+
+		template <FuncID id>
+		void ClientWaitSync(GLsync, GLbitfield, GLuint64 timeout) {
+			// Polling with a zero timeout doesn't block
+			if (timeout > 0) Sync<id>();
+		}
+
+		template <FuncID id, typename T>
+		void GetQueryObject(GLuint, GLenum pname, T*) {
+			// Only the result itself blocks until the query is done
+			if (pname == GL_QUERY_RESULT) Sync<id>();
+		}
+
+		template <FuncID id>
+		void UseProgram(GLuint program) {
+			CheckBind(id, GetState().program, program);
+		}
+
+		template <FuncID id>
+		void BindVertexArray(GLuint array) {
+			CheckBind(id, GetState().vertexArray, array);
+		}
+
+		template <FuncID id>
+		void BindBuffer(GLenum target, GLuint buffer) {
+			// The element buffer binding is part of the vertex array state
+			if (target == GL_ELEMENT_ARRAY_BUFFER) return;
+			CheckBind(id, GetState().buffers[target], buffer);
+		}
+
+		template <FuncID id>
+		void BindFramebuffer(GLenum target, GLuint framebuffer) {
+			auto& state = GetState();
+			if (target == GL_FRAMEBUFFER) {
+				// Binds both the draw and read framebuffers
+				auto redundant = state.framebuffers[GL_DRAW_FRAMEBUFFER] == framebuffer && state.framebuffers[GL_READ_FRAMEBUFFER] == framebuffer;
+				if (redundant) Flag(id, state.redundantBinds);
+				state.framebuffers[GL_DRAW_FRAMEBUFFER] = framebuffer;
+				state.framebuffers[GL_READ_FRAMEBUFFER] = framebuffer;
+			} else {
+				CheckBind(id, state.framebuffers[target], framebuffer);
+			}
+		}
+
+		template <FuncID id>
+		void ActiveTexture(GLenum texture) {
+			auto& state = GetState();
+			if (state.activeTexture == texture) Flag(id, state.redundantBinds);
+			state.activeTexture = texture;
+		}
+
+		template <FuncID id>
+		void BindTexture(GLenum target, GLuint texture) {
+			auto& state = GetState();
+			auto key = (static_cast<u64>(state.activeTexture) << 32) | target;
+			CheckBind(id, state.textures[key], texture);
+		}
+
+		// Deleting a bound object reverts the binding to 0
+		template <FuncID id>
+		void DeleteBuffers(GLsizei n, const GLuint* buffers) {
+			for (auto& [target, bound] : GetState().buffers) {
+				if (std::find(buffers, buffers + n, bound) != buffers + n) bound = 0;
+			}
+		}
+		template <FuncID id>
+		void DeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+			for (auto& [target, bound] : GetState().framebuffers) {
+				if (std::find(framebuffers, framebuffers + n, bound) != framebuffers + n) bound = 0;
+			}
+		}
+		template <FuncID id>
+		void DeleteTextures(GLsizei n, const GLuint* textures) {
+			for (auto& [key, bound] : GetState().textures) {
+				if (std::find(textures, textures + n, bound) != textures + n) bound = 0;
+			}
+		}
+		template <FuncID id>
+		void DeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+			auto& state = GetState();
+			if (std::find(arrays, arrays + n, state.vertexArray) != arrays + n) state.vertexArray = 0;
+		}
+	}
+
+	/// Fake GL implementation, named by the `fake` column of `HOENGINE_GL_FUNCTIONS`.
+	namespace Fakes {
+		struct FakeState {
+			GLuint nextName = 1;
+			uintptr_t nextSync = 1;
+			std::unordered_map<GLenum, GLuint> boundBuffers;
+			std::unordered_map<GLuint, std::vector<u8>> bufferStorage;
+		};
+
+		FakeState& GetFakeState() {
+			static FakeState state;
+			return state;
+		}
+
+		std::vector<u8>& BoundStorage(GLenum target) {
+			auto& state = GetFakeState();
+			return state.bufferStorage[state.boundBuffers[target]];
+		}
+
+		template <typename R, typename... Args>
+		R Default(Args...) {
+			return R();
+		}
+
+		template <typename R>
+		R GenNames(GLsizei n, GLuint* names) {
+			for (GLsizei i = 0; i < n; ++i) names[i] = GetFakeState().nextName++;
+		}
+
+		template <typename R, typename... Args>
+		R CreateName(Args...) {
+			return GetFakeState().nextName++;
+		}
+
+		template <typename R>
+		R BindBuffer(GLenum target, GLuint buffer) {
+			GetFakeState().boundBuffers[target] = buffer;
+		}
+
+		template <typename R, typename Flags>
+		R BufferData(GLenum target, GLsizeiptr size, const void* data, Flags) {
+			auto& storage = BoundStorage(target);
+			storage.assign(static_cast<usize>(size), 0);
+			if (data) std::memcpy(storage.data(), data, static_cast<usize>(size));
+		}
+
+		template <typename R>
+		R DeleteBuffers(GLsizei n, const GLuint* buffers) {
+			for (GLsizei i = 0; i < n; ++i) GetFakeState().bufferStorage.erase(buffers[i]);
+		}
+
+		template <typename R>
+		R MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield) {
+			auto& storage = BoundStorage(target);
+			if (storage.size() < static_cast<usize>(offset + length)) storage.resize(static_cast<usize>(offset + length));
+			return storage.data() + offset;
+		}
+
+		template <typename R>
+		R MapBuffer(GLenum target, GLenum) {
+			return BoundStorage(target).data();
+		}
+
+		template <typename R>
+		R UnmapBuffer(GLenum) {
+			return GL_TRUE;
+		}
+
+		template <typename R>
+		R FenceSync(GLenum, GLbitfield) {
+			return reinterpret_cast<GLsync>(GetFakeState().nextSync++);
+		}
+
+		template <typename R>
+		R AlreadySignaled(GLsync, GLbitfield, GLuint64) {
+			return GL_ALREADY_SIGNALED;
+		}
+
+		template <typename R>
+		R FramebufferComplete(GLenum) {
+			return GL_FRAMEBUFFER_COMPLETE;
+		}
+
+		template <typename R>
+		R GetInteger(GLenum pname, GLint* data) {
+			// Claim the most recent version, so every optional path is taken
+			switch (pname) {
+				case GL_MAJOR_VERSION: *data = 4; break;
+				case GL_MINOR_VERSION: *data = 6; break;
+				default: *data = 0; break;
+			}
+		}
+
+		template <typename R>
+		R GetBoolean(GLenum, GLboolean* data) {
+			*data = GL_FALSE;
+		}
+
+		template <typename R>
+		R GetFloat(GLenum, GLfloat* data) {
+			*data = 0;
+		}
+
+		template <typename R>
+		R GetObjectParam(GLuint, GLenum pname, GLint* params) {
+			switch (pname) {
+				case GL_COMPILE_STATUS:
+				case GL_LINK_STATUS: *params = GL_TRUE; break;
+				// Room for the null terminator of an empty log
+				case GL_INFO_LOG_LENGTH: *params = 1; break;
+				default: *params = 0; break;
+			}
+		}
+
+		template <typename R>
+		R GetInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+			if (length) *length = 0;
+			if (bufSize > 0) infoLog[0] = '\0';
+		}
+
+		template <typename R, typename T>
+		R GetQueryObject(GLuint, GLenum pname, T* params) {
+			*params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+		}
+
+		template <typename R, typename... Args>
+		R GetString(Args...) {
+			return reinterpret_cast<const GLubyte*>("");
+		}
+	}
+
+#define HOENGINE_GL_SHIM(ret, name, params, args, hook, fake) \
+	ret APIENTRY Shim_##name params { \
+		Hooks::hook<ID_##name> args; \
+		CallTimer timer{ ID_##name }; \
+		return GetState().target.name##Proc args; \
+	} \
+	ret APIENTRY Fake_##name params { \
+		return Fakes::fake<ret> args; \
+	}
+	HOENGINE_GL_FUNCTIONS(HOENGINE_GL_SHIM)
+#undef HOENGINE_GL_SHIM
+
+	Procs LoadedProcs() {
+		Procs procs;
+#define HOENGINE_GL_LOAD(ret, name, params, args, hook, fake) procs.name##Proc = name;
+		HOENGINE_GL_FUNCTIONS(HOENGINE_GL_LOAD)
+#undef HOENGINE_GL_LOAD
+		return procs;
+	}
+
+	Procs FakeProcs() {
+		Procs procs;
+#define HOENGINE_GL_FAKE(ret, name, params, args, hook, fake) procs.name##Proc = &Fake_##name;
+		HOENGINE_GL_FUNCTIONS(HOENGINE_GL_FAKE)
+#undef HOENGINE_GL_FAKE
+		return procs;
+	}
+
+	bool InstallWith(const Procs& target) {
+		auto& state = GetState();
+		if (state.installed) return false;
+		state.original = LoadedProcs();
+		state.target = target;
+		state.ForgetBindings();
+#define HOENGINE_GL_INSTALL(ret, name, params, args, hook, fake) name = &Shim_##name;
+		HOENGINE_GL_FUNCTIONS(HOENGINE_GL_INSTALL)
+#undef HOENGINE_GL_INSTALL
+		state.installed = true;
+		return true;
+	}
+}
+
+bool GLTrace::Install() {
+	return InstallWith(LoadedProcs());
+}
+
+bool GLTrace::InstallFake() {
+	return InstallWith(FakeProcs());
+}
+
+void GLTrace::Uninstall() {
+	auto& state = GetState();
+	if (!state.installed) return;
+#define HOENGINE_GL_RESTORE(ret, name, params, args, hook, fake) name = state.original.name##Proc;
+	HOENGINE_GL_FUNCTIONS(HOENGINE_GL_RESTORE)
+#undef HOENGINE_GL_RESTORE
+	state.installed = false;
+	state.inFrame = false;
+}
+
+bool GLTrace::IsInstalled() {
+	return GetState().installed;
+}
+
+void GLTrace::BeginFrame() {
+	GetState().inFrame = true;
+}
+
+void GLTrace::EndFrame() {
+	auto& state = GetState();
+	auto& report = state.lastReport;
+	report = Report{};
+	report.frame = state.frame++;
+	for (u16 id = 0; id < funcCount; ++id) {
+		const auto& counter = state.counters[id];
+		if (counter.calls == 0) continue;
+		report.calls.push_back(CallStats{ funcNames[id], counter.calls, counter.nanos, counter.flagged });
+		report.totalCalls += counter.calls;
+		report.totalNanos += counter.nanos;
+	}
+	std::sort(report.calls.begin(), report.calls.end(), [](const CallStats& a, const CallStats& b) { return a.nanos > b.nanos; });
+	report.redundantBinds = state.redundantBinds;
+	report.locationLookups = state.locationLookups;
+	report.syncPoints = state.syncPoints;
+
+	std::fill(std::begin(state.counters), std::end(state.counters), Counter{});
+	state.redundantBinds = 0;
+	state.locationLookups = 0;
+	state.syncPoints = 0;
+	state.inFrame = false;
+
+	if (state.reportOutput && report.frame % state.reportInterval == 0) {
+		WriteReport(*state.reportOutput, report);
+	}
+}
+
+const GLTrace::Report& GLTrace::LastReport() {
+	return GetState().lastReport;
+}
+
+void GLTrace::SetReportOutput(std::ostream* out, u32 interval) {
+	auto& state = GetState();
+	state.reportOutput = out;
+	state.reportInterval = std::max<u32>(interval, 1);
+}
+
+#else
+
+bool GLTrace::Install() { return false; }
+bool GLTrace::InstallFake() { return false; }
+void GLTrace::Uninstall() {}
+bool GLTrace::IsInstalled() { return false; }
+void GLTrace::BeginFrame() {}
+void GLTrace::EndFrame() {}
+const GLTrace::Report& GLTrace::LastReport() {
+	static Report empty;
+	return empty;
+}
+void GLTrace::SetReportOutput(std::ostream*, u32) {}
+
+#endif // HOENGINE_GL_TRACE
+
+void GLTrace::WriteReport(std::ostream& out, const Report& report) {
+	out << "[GL trace] frame " << report.frame << ": "
+		<< report.totalCalls << " calls, "
+		<< static_cast<f64>(report.totalNanos) / 1.0e6 << " ms in driver\n";
+	if (report.redundantBinds > 0) {
+		out << "  " << report.redundantBinds << " redundant binds\n";
+	}
+	if (report.locationLookups > 0) {
+		out << "  " << report.locationLookups << " location lookups during the frame, resolve them at load time\n";
+	}
+	if (report.syncPoints > 0) {
+		out << "  " << report.syncPoints << " calls synchronizing with the GPU during the frame\n";
+	}
+	for (const auto& call : report.calls) {
+		out << "  " << call.name << ": " << call.calls << " calls, " << static_cast<f64>(call.nanos) / 1.0e3 << " us";
+		if (call.flagged > 0) out << " (" << call.flagged << " flagged)";
+		out << "\n";
+	}
+}
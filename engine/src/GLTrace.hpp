@@ -0,0 +1,186 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <GL/gl3w.h>
+#include "Engine.hpp"
+
+/// Every GL entry point routed through the tracing shim, as
+/// `X(return type, name, parameters, arguments, hook, fake)`:
+/// - `hook` inspects the arguments before the call (see `GLTrace.cpp`), e.g. to
+///   detect redundant binds.
+/// - `fake` implements the function for the fake backend.
+///
+/// Add an entry here when the engine starts using a new GL function, otherwise
+/// calls to it bypass the shim (and crash on the fake backend).
+#define HOENGINE_GL_FUNCTIONS(X) \
+	X(void, glActiveTexture, (GLenum texture), (texture), ActiveTexture, Default) \
+	X(void, glAttachShader, (GLuint program, GLuint shader), (program, shader), None, Default) \
+	X(void, glBeginQuery, (GLenum target, GLuint id), (target, id), None, Default) \
+	X(void, glBeginTransformFeedback, (GLenum primitiveMode), (primitiveMode), None, Default) \
+	X(void, glBindBuffer, (GLenum target, GLuint buffer), (target, buffer), BindBuffer, BindBuffer) \
+	X(void, glBindBufferBase, (GLenum target, GLuint index, GLuint buffer), (target, index, buffer), None, Default) \
+	X(void, glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size), (target, index, buffer, offset, size), None, Default) \
+	X(void, glBindFramebuffer, (GLenum target, GLuint framebuffer), (target, framebuffer), BindFramebuffer, Default) \
+	X(void, glBindTexture, (GLenum target, GLuint texture), (target, texture), BindTexture, Default) \
+	X(void, glBindVertexArray, (GLuint array), (array), BindVertexArray, Default) \
+	X(void, glBlendFunc, (GLenum sfactor, GLenum dfactor), (sfactor, dfactor), None, Default) \
+	X(void, glBufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), (target, size, data, usage), None, BufferData) \
+	X(void, glBufferStorage, (GLenum target, GLsizeiptr size, const void* data, GLbitfield flags), (target, size, data, flags), None, BufferData) \
+	X(void, glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), (target, offset, size, data), None, Default) \
+	X(GLenum, glCheckFramebufferStatus, (GLenum target), (target), Sync, FramebufferComplete) \
+	X(void, glClear, (GLbitfield mask), (mask), None, Default) \
+	X(void, glClearBufferfi, (GLenum buffer, GLint drawbuffer, GLfloat depth, GLint stencil), (buffer, drawbuffer, depth, stencil), None, Default) \
+	X(void, glClearBufferfv, (GLenum buffer, GLint drawbuffer, const GLfloat* value), (buffer, drawbuffer, value), None, Default) \
+	X(void, glClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha), (red, green, blue, alpha), None, Default) \
+	X(GLenum, glClientWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout), (sync, flags, timeout), ClientWaitSync, AlreadySignaled) \
+	X(void, glCompileShader, (GLuint shader), (shader), None, Default) \
+	X(void, glCompressedTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void* data), (target, level, internalformat, width, height, border, imageSize, data), None, Default) \
+	X(void, glCopyBufferSubData, (GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size), (readTarget, writeTarget, readOffset, writeOffset, size), None, Default) \
+	X(GLuint, glCreateProgram, (void), (), None, CreateName) \
+	X(GLuint, glCreateShader, (GLenum type), (type), None, CreateName) \
+	X(void, glCullFace, (GLenum mode), (mode), None, Default) \
+	X(void, glDeleteBuffers, (GLsizei n, const GLuint* buffers), (n, buffers), DeleteBuffers, DeleteBuffers) \
+	X(void, glDeleteFramebuffers, (GLsizei n, const GLuint* framebuffers), (n, framebuffers), DeleteFramebuffers, Default) \
+	X(void, glDeleteProgram, (GLuint program), (program), None, Default) \
+	X(void, glDeleteQueries, (GLsizei n, const GLuint* ids), (n, ids), None, Default) \
+	X(void, glDeleteShader, (GLuint shader), (shader), None, Default) \
+	X(void, glDeleteSync, (GLsync sync), (sync), None, Default) \
+	X(void, glDeleteTextures, (GLsizei n, const GLuint* textures), (n, textures), DeleteTextures, Default) \
+	X(void, glDeleteVertexArrays, (GLsizei n, const GLuint* arrays), (n, arrays), DeleteVertexArrays, Default) \
+	X(void, glDepthFunc, (GLenum func), (func), None, Default) \
+	X(void, glDepthMask, (GLboolean flag), (flag), None, Default) \
+	X(void, glDisable, (GLenum cap), (cap), None, Default) \
+	X(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count), None, Default) \
+	X(void, glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount), (mode, first, count, instancecount), None, Default) \
+	X(void, glDrawBuffer, (GLenum buf), (buf), None, Default) \
+	X(void, glDrawBuffers, (GLsizei n, const GLenum* bufs), (n, bufs), None, Default) \
+	X(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void* indices), (mode, count, type, indices), None, Default) \
+	X(void, glDrawElementsBaseVertex, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex), (mode, count, type, indices, basevertex), None, Default) \
+	X(void, glDrawElementsInstancedBaseVertex, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount, GLint basevertex), (mode, count, type, indices, instancecount, basevertex), None, Default) \
+	X(void, glEnable, (GLenum cap), (cap), None, Default) \
+	X(void, glEnableVertexAttribArray, (GLuint index), (index), None, Default) \
+	X(void, glEndQuery, (GLenum target), (target), None, Default) \
+	X(void, glEndTransformFeedback, (void), (), None, Default) \
+	X(GLsync, glFenceSync, (GLenum condition, GLbitfield flags), (condition, flags), None, FenceSync) \
+	X(void, glFinish, (void), (), Sync, Default) \
+	X(void, glFlush, (void), (), None, Default) \
+	X(void, glFlushMappedBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length), (target, offset, length), None, Default) \
+	X(void, glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level), (target, attachment, textarget, texture, level), None, Default) \
+	X(void, glGenBuffers, (GLsizei n, GLuint* buffers), (n, buffers), None, GenNames) \
+	X(void, glGenFramebuffers, (GLsizei n, GLuint* framebuffers), (n, framebuffers), None, GenNames) \
+	X(void, glGenQueries, (GLsizei n, GLuint* ids), (n, ids), None, GenNames) \
+	X(void, glGenTextures, (GLsizei n, GLuint* textures), (n, textures), None, GenNames) \
+	X(void, glGenVertexArrays, (GLsizei n, GLuint* arrays), (n, arrays), None, GenNames) \
+	X(void, glGenerateMipmap, (GLenum target), (target), None, Default) \
+	X(GLint, glGetAttribLocation, (GLuint program, const GLchar* name), (program, name), Lookup, Default) \
+	X(void, glGetBooleanv, (GLenum pname, GLboolean* data), (pname, data), Sync, GetBoolean) \
+	X(void, glGetBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, void* data), (target, offset, size, data), Sync, Default) \
+	X(GLenum, glGetError, (void), (), Sync, Default) \
+	X(void, glGetFloatv, (GLenum pname, GLfloat* data), (pname, data), Sync, GetFloat) \
+	X(void, glGetIntegerv, (GLenum pname, GLint* data), (pname, data), Sync, GetInteger) \
+	X(void, glGetProgramInfoLog, (GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog), (program, bufSize, length, infoLog), Sync, GetInfoLog) \
+	X(void, glGetProgramiv, (GLuint program, GLenum pname, GLint* params), (program, pname, params), Sync, GetObjectParam) \
+	X(void, glGetQueryObjectiv, (GLuint id, GLenum pname, GLint* params), (id, pname, params), GetQueryObject, GetQueryObject) \
+	X(void, glGetQueryObjectui64v, (GLuint id, GLenum pname, GLuint64* params), (id, pname, params), GetQueryObject, GetQueryObject) \
+	X(void, glGetShaderInfoLog, (GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog), (shader, bufSize, length, infoLog), Sync, GetInfoLog) \
+	X(void, glGetShaderiv, (GLuint shader, GLenum pname, GLint* params), (shader, pname, params), Sync, GetObjectParam) \
+	X(const GLubyte*, glGetString, (GLenum name), (name), None, GetString) \
+	X(const GLubyte*, glGetStringi, (GLenum name, GLuint index), (name, index), None, GetString) \
+	X(GLint, glGetUniformLocation, (GLuint program, const GLchar* name), (program, name), Lookup, Default) \
+	X(GLboolean, glIsEnabled, (GLenum cap), (cap), None, Default) \
+	X(void, glLinkProgram, (GLuint program), (program), None, Default) \
+	X(void*, glMapBuffer, (GLenum target, GLenum access), (target, access), None, MapBuffer) \
+	X(void*, glMapBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access), (target, offset, length, access), None, MapBufferRange) \
+	X(void, glMultiDrawElementsBaseVertex, (GLenum mode, const GLsizei* count, GLenum type, const void* const* indices, GLsizei drawcount, const GLint* basevertex), (mode, count, type, indices, drawcount, basevertex), None, Default) \
+	X(void, glMultiDrawElementsIndirect, (GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride), (mode, type, indirect, drawcount, stride), None, Default) \
+	X(void, glPixelStorei, (GLenum pname, GLint param), (pname, param), None, Default) \
+	X(void, glPolygonMode, (GLenum face, GLenum mode), (face, mode), None, Default) \
+	X(void, glQueryCounter, (GLuint id, GLenum target), (id, target), None, Default) \
+	X(void, glReadBuffer, (GLenum src), (src), None, Default) \
+	X(void, glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels), (x, y, width, height, format, type, pixels), Sync, Default) \
+	X(void, glScissor, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), None, Default) \
+	X(void, glShaderSource, (GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length), (shader, count, string, length), None, Default) \
+	X(void, glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels), (target, level, internalformat, width, height, border, format, type, pixels), None, Default) \
+	X(void, glTexParameteri, (GLenum target, GLenum pname, GLint param), (target, pname, param), None, Default) \
+	X(void, glTexStorage2D, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height), (target, levels, internalformat, width, height), None, Default) \
+	X(void, glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels), (target, level, xoffset, yoffset, width, height, format, type, pixels), None, Default) \
+	X(void, glTransformFeedbackVaryings, (GLuint program, GLsizei count, const GLchar* const* varyings, GLenum bufferMode), (program, count, varyings, bufferMode), None, Default) \
+	X(void, glUniform1f, (GLint location, GLfloat v0), (location, v0), None, Default) \
+	X(void, glUniform1i, (GLint location, GLint v0), (location, v0), None, Default) \
+	X(void, glUniform1ui, (GLint location, GLuint v0), (location, v0), None, Default) \
+	X(void, glUniform2f, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1), None, Default) \
+	X(void, glUniform3fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value), None, Default) \
+	X(void, glUniform4fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value), None, Default) \
+	X(void, glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value), (location, count, transpose, value), None, Default) \
+	X(GLboolean, glUnmapBuffer, (GLenum target), (target), None, UnmapBuffer) \
+	X(void, glUseProgram, (GLuint program), (program), UseProgram, Default) \
+	X(void, glVertexAttribDivisor, (GLuint index, GLuint divisor), (index, divisor), None, Default) \
+	X(void, glVertexAttribIPointer, (GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer), (index, size, type, stride, pointer), None, Default) \
+	X(void, glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer), (index, size, type, normalized, stride, pointer), None, Default) \
+	X(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height), None, Default)
+
+namespace HOEngine {
+
+/// Debugging and profiling layer between the engine and the GL, available when
+/// built with `HOENGINE_GL_TRACE` (CMake option of the same name). Without it,
+/// `Install` and `InstallFake` fail and every other function does nothing.
+///
+/// Once installed, every function of `HOENGINE_GL_FUNCTIONS` goes through a shim
+/// that counts calls and the CPU time spent in them, and flags:
+/// - binds of objects that are already bound,
+/// - uniform/attribute location lookups during a frame,
+/// - calls forcing the CPU to wait on the GPU (`glGet*`, `glFinish`, query
+///   results, waiting on fences) during a frame.
+///
+/// Instead of the driver, calls can be forwarded to a fake GL implementation that
+/// does nothing but hand out names and mapped memory, so that submission code can
+/// be run and benchmarked without a GPU or even a context.
+///
+/// Must only be used from the thread owning the context.
+class GLTrace {
+public:
+	struct CallStats {
+		const char* name;
+		u64 calls = 0;
+		/// CPU time spent in the driver, in nanoseconds.
+		u64 nanos = 0;
+		/// Calls that were redundant binds, lookups or sync points.
+		u64 flagged = 0;
+	};
+
+	struct Report {
+		u64 frame = 0;
+		/// Functions called during the frame, most expensive first.
+		std::vector<CallStats> calls;
+		u64 totalCalls = 0;
+		u64 totalNanos = 0;
+		u64 redundantBinds = 0;
+		u64 locationLookups = 0;
+		u64 syncPoints = 0;
+	};
+
+	/// Route GL calls through the shim to the functions loaded by `gl3wInit`.
+	static bool Install();
+	/// Route GL calls through the shim to the fake implementation. Doesn't need a
+	/// context nor `gl3wInit`.
+	static bool InstallFake();
+	/// Restore the function pointers as they were before installing. GL objects
+	/// created through the fake backend must be destroyed before this.
+	static void Uninstall();
+	static bool IsInstalled();
+
+	/// Start a frame: lookups and sync points are only flagged within frames.
+	static void BeginFrame();
+	/// Close the frame, producing its report (also written to the report output,
+	/// if any) and resetting the counters.
+	static void EndFrame();
+	static const Report& LastReport();
+
+	/// Write every `interval`th frame's report to `out`, or stop if null.
+	static void SetReportOutput(std::ostream* out, u32 interval = 1);
+	static void WriteReport(std::ostream& out, const Report& report);
+};
+
+} // namespace HOEngine
@@ -1,7 +1,20 @@
+#include <algorithm>
+#include <bit>
 #include <utility>
 #include <iostream>
+#include <cstring>
 #include "GLWrapper.hpp"
 #include "MonadicUtil.hpp"
+#include "Profiler.hpp"
+#include "render/RenderStats.hpp"
+
+// S3TC is an extension, absent from the core profile header
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
 
 using namespace HOEngine;
 
@@ -70,6 +83,7 @@ ShaderProgram::~ShaderProgram() noexcept {
 	}
 }
 std::optional<ShaderProgram> ShaderProgram::FromSource(const std::string& vshSource, const std::string& fshSource) {
+	HOENGINE_PROFILE_SCOPE("ShaderProgram::FromSource");
 	return Bind(
 			ShaderProgram::New,
 			Shader::New(GL_VERTEX_SHADER, vshSource),
@@ -84,6 +98,22 @@ std::optional<ShaderProgram> ShaderProgram::New(const Shader& vsh, const Shader&
 	glAttachShader(handle, vsh);
 	glAttachShader(handle, fsh);
 
+	if (!program.Link()) return {};
+	return program;
+}
+std::optional<ShaderProgram> ShaderProgram::WithFeedback(const Shader& vsh, const std::vector<const char*>& varyings) {
+	auto handle = glCreateProgram();
+	if (handle == 0) return {};
+	ShaderProgram program(handle);
+
+	glAttachShader(handle, vsh);
+	// Must be set before linking
+	glTransformFeedbackVaryings(handle, static_cast<GLsizei>(varyings.size()), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+
+	if (!program.Link()) return {};
+	return program;
+}
+bool ShaderProgram::Link() {
 	glLinkProgram(handle);
 	GLint linkStatus;
 	glGetProgramiv(handle, GL_LINK_STATUS, &linkStatus);
@@ -94,10 +124,9 @@ std::optional<ShaderProgram> ShaderProgram::New(const Shader& vsh, const Shader&
 		log.resize(static_cast<std::string::usizeype>(logLen - 1));
 		glGetProgramInfoLog(handle, logLen, nullptr, log.data());
 		std::cerr << log << "\n";
-		return {};
+		return false;
 	}
-
-	return program;
+	return true;
 }
 ShaderProgram::ShaderProgram(ShaderProgram&& source) noexcept
 	: handle{ std::move(source.handle) } {
@@ -111,3 +140,311 @@ ShaderProgram& ShaderProgram::operator=(ShaderProgram&& source) noexcept {
 	source.handle = 0;
 	return *this;
 }
+
+bool HOEngine::HasGLExtension(const char* name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		auto ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+		if (ext && std::strcmp(ext, name) == 0) return true;
+	}
+	return false;
+}
+bool HOEngine::HasGLVersion(i32 major, i32 minor) {
+	GLint ctxMajor = 0, ctxMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &ctxMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &ctxMinor);
+	return ctxMajor > major || (ctxMajor == major && ctxMinor >= minor);
+}
+
+namespace {
+	DepthState currentDepthState;
+}
+
+const DepthState& DepthState::Current() {
+	return currentDepthState;
+}
+DepthState DepthState::Apply(const DepthState& state) {
+	auto previous = currentDepthState;
+	if (state.test != previous.test) {
+		if (state.test) {
+			glEnable(GL_DEPTH_TEST);
+		} else {
+			glDisable(GL_DEPTH_TEST);
+		}
+	}
+	if (state.func != previous.func) glDepthFunc(state.func);
+	if (state.write != previous.write) glDepthMask(state.write ? GL_TRUE : GL_FALSE);
+	currentDepthState = state;
+	return previous;
+}
+
+bool StreamingBuffer::IsPersistentMappingSupported() {
+	// gl3w loads every entry point it knows about regardless of the context version,
+	// so the function pointer alone is not enough to tell
+	return glBufferStorage != nullptr && (HasGLVersion(4, 4) || HasGLExtension("GL_ARB_buffer_storage"));
+}
+
+StreamingBuffer::StreamingBuffer(GLenum target, usize regionSize, usize regionCount)
+	: target_{ target },
+	regionSize_{ regionSize },
+	persistent_{ IsPersistentMappingSupported() },
+	fences_(regionCount, nullptr) {
+	if (regionCount == 0) {
+		throw std::runtime_error("StreamingBuffer must contain at least one region");
+	}
+	AllocateStorage();
+}
+StreamingBuffer::~StreamingBuffer() noexcept {
+	for (auto fence : fences_) {
+		if (fence) glDeleteSync(fence);
+	}
+	if (mapped_) {
+		glBindBuffer(target_, buffer_.handle());
+		glUnmapBuffer(target_);
+		glBindBuffer(target_, 0);
+	}
+}
+
+void StreamingBuffer::AllocateStorage() {
+	auto totalSize = static_cast<GLsizeiptr>(regionSize_ * fences_.size());
+	glBindBuffer(target_, buffer_.handle());
+	if (persistent_) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target_, totalSize, nullptr, flags);
+		mapped_ = static_cast<u8*>(glMapBufferRange(target_, 0, totalSize, flags));
+		if (!mapped_) {
+			glBindBuffer(target_, 0);
+			throw std::runtime_error("Unable to persistently map streaming buffer");
+		}
+	} else {
+		glBufferData(target_, totalSize, nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(target_, 0);
+}
+
+void StreamingBuffer::WaitRegion(usize region) {
+	auto fence = fences_[region];
+	if (!fence) return;
+
+	// Poll first without flushing, which is the common case when the GPU keeps up
+	auto status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		if (persistent_) {
+			++stats_.stalls;
+			do {
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 /* 1ms */);
+			} while (status == GL_TIMEOUT_EXPIRED);
+		} else {
+			// Orphan the whole storage so the driver hands out fresh memory instead of
+			// blocking. Every other region's fence now refers to the old storage.
+			++stats_.orphans;
+			glBindBuffer(target_, buffer_.handle());
+			glBufferData(target_, static_cast<GLsizeiptr>(regionSize_ * fences_.size()), nullptr, GL_STREAM_DRAW);
+			glBindBuffer(target_, 0);
+			for (auto& other : fences_) {
+				if (other) glDeleteSync(other);
+				other = nullptr;
+			}
+			return;
+		}
+	}
+	glDeleteSync(fence);
+	fences_[region] = nullptr;
+}
+
+void StreamingBuffer::BeginFrame() {
+	WaitRegion(current_);
+	used_ = 0;
+
+	if (!persistent_) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+		glBindBuffer(target_, buffer_.handle());
+		mapped_ = static_cast<u8*>(glMapBufferRange(
+				target_,
+				static_cast<GLintptr>(current_ * regionSize_),
+				static_cast<GLsizeiptr>(regionSize_),
+				flags));
+		glBindBuffer(target_, 0);
+	}
+}
+
+std::optional<StreamingBuffer::Allocation> StreamingBuffer::Allocate(usize size, usize alignment) {
+	if (!mapped_) return {};
+
+	// Region starts are not necessarily aligned, so align the absolute offset
+	auto regionStart = current_ * regionSize_;
+	auto absolute = regionStart + used_;
+	auto aligned = alignment > 1 ? (absolute + alignment - 1) / alignment * alignment : absolute;
+	auto regionOffset = aligned - regionStart;
+	if (regionOffset + size > regionSize_) {
+		++stats_.overflows;
+		return {};
+	}
+	used_ = regionOffset + size;
+	stats_.bytesAllocated += size;
+
+	// Persistent mapping covers the whole buffer, the fallback mapping only covers this region
+	auto ptr = persistent_ ? mapped_ + aligned : mapped_ + regionOffset;
+	return Allocation{ ptr, static_cast<GLintptr>(aligned), size };
+}
+
+void StreamingBuffer::Commit() {
+	// Persistent coherent mappings are visible to the GL without any further calls
+	if (persistent_ || !mapped_) return;
+
+	glBindBuffer(target_, buffer_.handle());
+	if (used_ > 0) {
+		glFlushMappedBufferRange(target_, 0, static_cast<GLsizeiptr>(used_));
+	}
+	glUnmapBuffer(target_);
+	glBindBuffer(target_, 0);
+	mapped_ = nullptr;
+}
+
+void StreamingBuffer::EndFrame() {
+	RenderStats::Global().Upload(used_);
+	Commit();
+	fences_[current_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (++current_ == fences_.size()) {
+		current_ = 0;
+		++stats_.wraps;
+	}
+}
+
+const TextureFormatInfo& HOEngine::GetTextureFormatInfo(TextureFormat format) {
+	static const TextureFormatInfo infos[] = {
+		{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, false, GL_COLOR_ATTACHMENT0 },
+		{ GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, false, GL_COLOR_ATTACHMENT0 },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_NONE, GL_NONE, 8, true, GL_NONE },
+		{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_NONE, GL_NONE, 16, true, GL_NONE },
+		{ GL_COMPRESSED_RED_RGTC1, GL_NONE, GL_NONE, 8, true, GL_NONE },
+		{ GL_COMPRESSED_RG_RGTC2, GL_NONE, GL_NONE, 16, true, GL_NONE },
+		{ GL_COMPRESSED_RGBA_BPTC_UNORM, GL_NONE, GL_NONE, 16, true, GL_NONE },
+		{ GL_COMPRESSED_RGB8_ETC2, GL_NONE, GL_NONE, 8, true, GL_NONE },
+		{ GL_COMPRESSED_RGBA8_ETC2_EAC, GL_NONE, GL_NONE, 16, true, GL_NONE },
+		{ GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, false, GL_COLOR_ATTACHMENT0 },
+		{ GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV, 4, false, GL_COLOR_ATTACHMENT0 },
+		{ GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4, false, GL_DEPTH_STENCIL_ATTACHMENT },
+		{ GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4, false, GL_DEPTH_ATTACHMENT },
+	};
+	return infos[static_cast<usize>(format)];
+}
+
+usize HOEngine::TextureLevelSize(TextureFormat format, u32 width, u32 height) {
+	const auto& info = GetTextureFormatInfo(format);
+	if (!info.compressed) return usize{ width } * height * info.unitBytes;
+	return usize{ (width + 3) / 4 } * ((height + 3) / 4) * info.unitBytes;
+}
+
+bool HOEngine::IsTextureFormatSupported(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::RGBA8:
+	case TextureFormat::SRGBA8:
+	case TextureFormat::BC4:
+	case TextureFormat::BC5:
+	case TextureFormat::RGBA16F:
+	case TextureFormat::R11G11B10F:
+	case TextureFormat::Depth24Stencil8:
+	case TextureFormat::Depth32F:
+		return true;
+	case TextureFormat::BC1:
+	case TextureFormat::BC3:
+		return HasGLExtension("GL_EXT_texture_compression_s3tc");
+	case TextureFormat::BC7:
+		return HasGLVersion(4, 2) || HasGLExtension("GL_ARB_texture_compression_bptc");
+	case TextureFormat::ETC2RGB:
+	case TextureFormat::ETC2RGBA:
+		return HasGLVersion(4, 3) || HasGLExtension("GL_ARB_ES3_compatibility");
+	}
+	return false;
+}
+
+u32 Texture::MipCount(u32 width, u32 height) {
+	return static_cast<u32>(std::bit_width(std::max({ width, height, 1u })));
+}
+
+Texture::Texture(TextureFormat format, u32 width, u32 height, u32 levels)
+	: format_{ format },
+	width_{ width },
+	height_{ height },
+	levels_{ levels == 0 ? MipCount(width, height) : levels } {
+	if (width == 0 || height == 0) {
+		throw std::runtime_error("Texture must be at least 1x1");
+	}
+	if (levels_ > MipCount(width, height)) {
+		throw std::runtime_error("Texture has more levels than its size allows");
+	}
+	baseLevel_ = levels_;
+
+	glBindTexture(GL_TEXTURE_2D, object_.handle());
+	// Clamping the level range keeps the texture complete with a partial chain
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(levels_ - 1));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels_ - 1));
+	SetSampling(levels_ > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_LINEAR, GL_REPEAT);
+}
+
+void Texture::Upload(u32 level, const void* data) {
+	if (level >= levels_) {
+		throw std::runtime_error("Texture level out of range");
+	}
+	const auto& info = GetTextureFormatInfo(format_);
+	auto width = std::max(width_ >> level, 1u);
+	auto height = std::max(height_ >> level, 1u);
+	auto size = TextureLevelSize(format_, width, height);
+
+	glBindTexture(GL_TEXTURE_2D, object_.handle());
+	if (info.compressed) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), info.internalFormat,
+			static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, static_cast<GLsizei>(size), data);
+	} else {
+		// Rows of narrow levels aren't 4 byte aligned for every format
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), static_cast<GLint>(info.internalFormat),
+			static_cast<GLsizei>(width), static_cast<GLsizei>(height), 0, info.format, info.type, data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	uploaded_ |= 1u << level;
+	auto base = levels_;
+	while (base > 0 && (uploaded_ & (1u << (base - 1)))) --base;
+	if (base != baseLevel_ && base < levels_) {
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(base));
+	}
+	baseLevel_ = base;
+}
+
+void Texture::DropBaseLevel() {
+	if (baseLevel_ + 1 >= levels_) {
+		throw std::runtime_error("Texture has no level to drop");
+	}
+	auto level = static_cast<GLint>(baseLevel_);
+	const auto& info = GetTextureFormatInfo(format_);
+	glBindTexture(GL_TEXTURE_2D, object_.handle());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+	// Respecified as empty, which releases its memory
+	if (info.compressed) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, info.internalFormat, 0, 0, 0, 0, nullptr);
+	} else {
+		glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(info.internalFormat), 0, 0, 0, info.format, info.type, nullptr);
+	}
+	uploaded_ &= ~(1u << baseLevel_);
+	++baseLevel_;
+}
+
+void Texture::SetSampling(GLenum minFilter, GLenum magFilter, GLenum wrap) {
+	glBindTexture(GL_TEXTURE_2D, object_.handle());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, static_cast<GLint>(minFilter));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, static_cast<GLint>(magFilter));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLint>(wrap));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLint>(wrap));
+}
+
+usize Texture::byteSize() const {
+	usize total = 0;
+	for (u32 level = 0; level < levels_; ++level) {
+		if (!(uploaded_ & (1u << level))) continue;
+		total += TextureLevelSize(format_, std::max(width_ >> level, 1u), std::max(height_ >> level, 1u));
+	}
+	return total;
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <optional>
 #include <array>
+#include <vector>
 #include <type_traits>
 #include <stdexcept>
 #include <GL/gl3w.h>
@@ -138,7 +139,7 @@ public:
 		std::fill(that.handles.begin(), that.handles.end(), 0);
 	}
 	GLObjects& operator=(GLObjects&& that) {
-		glDeleteBuffers(count, this->handles.data());
+		del(count, this->handles.data());
 		this->handles = std::move(that.handles);
 		std::fill(that.handles.begin(), that.handles.end(), 0);
 		return *this;
@@ -158,6 +159,10 @@ inline void GenStateObjects_Internal_(GLsizei size, GLuint* ptr) { glGenVertexAr
 inline void DelStateObjects_Internal_(GLsizei size, GLuint* ptr) { glDeleteVertexArrays(size, ptr); }
 inline void GenBufferObjects_Internal_(GLsizei size, GLuint* ptr) { glGenBuffers(size, ptr); }
 inline void DelBufferObjects_Internal_(GLsizei size, GLuint* ptr) { glDeleteBuffers(size, ptr); }
+inline void GenTextureObjects_Internal_(GLsizei size, GLuint* ptr) { glGenTextures(size, ptr); }
+inline void DelTextureObjects_Internal_(GLsizei size, GLuint* ptr) { glDeleteTextures(size, ptr); }
+inline void GenFramebufferObjects_Internal_(GLsizei size, GLuint* ptr) { glGenFramebuffers(size, ptr); }
+inline void DelFramebufferObjects_Internal_(GLsizei size, GLuint* ptr) { glDeleteFramebuffers(size, ptr); }
 
 /// Aka "vertex array object" which stores buffer binding and attribute
 /// pointer states.
@@ -173,6 +178,226 @@ using BufferObjects = GLObjects<count, GenBufferObjects_Internal_, DelBufferObje
 /// A `BufferObjects` alias with `count` defaulted to 1
 using BufferObject = BufferObjects<1>;
 
+/// Bare texture object handles, see `Texture` for one with storage attached.
+template <usize count>
+using TextureObjects = GLObjects<count, GenTextureObjects_Internal_, DelTextureObjects_Internal_>;
+/// A `TextureObjects` alias with `count` defaulted to 1
+using TextureObject = TextureObjects<1>;
+
+/// Framebuffer object handles, attachments are left to the user.
+template <usize count>
+using FramebufferObjects = GLObjects<count, GenFramebufferObjects_Internal_, DelFramebufferObjects_Internal_>;
+/// A `FramebufferObjects` alias with `count` defaulted to 1
+using FramebufferObject = FramebufferObjects<1>;
+
+/// Offset into the bound buffer, for the pointer parameters that take one (e.g.
+/// `glVertexAttribPointer`, `glDrawElements`).
+inline void* BufferOffset(usize offset) { return reinterpret_cast<void*>(offset); }
+
+/// Depth test, function and write mask. The current state is shadowed on the CPU,
+/// so passes can change it and put it back without querying GL, which would wait
+/// for the driver. Changes made with plain GL calls aren't seen.
+struct DepthState {
+	bool test = false;
+	GLenum func = GL_LESS;
+	bool write = true;
+
+	/// State last applied, GL's initial state until then.
+	static const DepthState& Current();
+	/// Set what differs from the current state, and return the previous one.
+	static DepthState Apply(const DepthState& state);
+
+	bool operator==(const DepthState&) const = default;
+};
+
+/// Check whether the current context advertises the given extension, e.g.
+/// "GL_ARB_buffer_storage". Requires a current context.
+bool HasGLExtension(const char* name);
+/// Check whether the current context is at least version `major.minor`.
+bool HasGLVersion(i32 major, i32 minor);
+
+/// A ring of equally sized regions inside a single buffer object, meant for data
+/// that the CPU rewrites every frame (per-frame transforms, particles, debug
+/// geometry). Each frame writes into its own region, and a fence guards the region
+/// until the GPU is done reading it, so the CPU never waits on the driver as long
+/// as the GPU is less than `regionCount - 1` frames behind.
+///
+/// When `GL_ARB_buffer_storage` is available the whole buffer is mapped once with
+/// persistent coherent mapping. Otherwise (plain GL 3.3) each region is mapped with
+/// `GL_MAP_UNSYNCHRONIZED_BIT` at the beginning of a frame, and the storage is
+/// orphaned instead of waiting if the region is still in use.
+///
+/// Usage per frame:
+/// ```
+/// buf.BeginFrame();
+/// auto alloc = buf.Allocate(size); // write to alloc->ptr
+/// buf.Commit();                    // before issuing draw calls that read the buffer
+/// // draw with alloc->offset
+/// buf.EndFrame();                  // after issuing those draw calls
+/// ```
+class StreamingBuffer {
+public:
+	struct Allocation {
+		void* ptr;
+		/// Offset in bytes from the beginning of the buffer object, for use in
+		/// attribute pointers, `glBindBufferRange`, etc.
+		GLintptr offset;
+		usize size;
+	};
+
+	struct Stats {
+		/// Number of times `BeginFrame` had to block on a fence because the GPU
+		/// was still reading the region.
+		u64 stalls = 0;
+		/// Number of times the ring went around back to the first region.
+		u64 wraps = 0;
+		/// Fallback path only: number of times the storage was orphaned instead
+		/// of stalling.
+		u64 orphans = 0;
+		/// Number of allocations rejected because the current region was full.
+		u64 overflows = 0;
+		u64 bytesAllocated = 0;
+	};
+
+	static constexpr usize defaultRegionCount = 3;
+
+	/// Whether the current context supports persistent coherent mapping.
+	static bool IsPersistentMappingSupported();
+
+	StreamingBuffer(GLenum target, usize regionSize, usize regionCount = defaultRegionCount);
+	~StreamingBuffer() noexcept;
+	StreamingBuffer(const StreamingBuffer&) = delete;
+	StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+	StreamingBuffer(StreamingBuffer&&) = delete;
+	StreamingBuffer& operator=(StreamingBuffer&&) = delete;
+
+	/// Make the next region writable, waiting for (or orphaning) it if the GPU
+	/// has not finished reading it yet.
+	void BeginFrame();
+	/// Sub-allocate `size` bytes from the current region. Returns an empty optional
+	/// if the region does not have enough space left for this frame.
+	std::optional<Allocation> Allocate(usize size, usize alignment = 16);
+	/// Make everything written so far visible to the GL. Must be called before
+	/// issuing draw calls that read from this frame's region.
+	void Commit();
+	/// Fence the current region and advance to the next one. Must be called after
+	/// the draw calls that read from this frame's region have been issued.
+	void EndFrame();
+
+	bool persistent() const { return persistent_; }
+	usize regionSize() const { return regionSize_; }
+	usize regionCount() const { return fences_.size(); }
+	/// Bytes already allocated from the current region.
+	usize used() const { return used_; }
+	const Stats& stats() const { return stats_; }
+	void ResetStats() { stats_ = {}; }
+
+	GLuint handle() const { return buffer_.handle(); }
+	operator GLuint() const { return buffer_.handle(); }
+
+private:
+	void AllocateStorage();
+	void WaitRegion(usize region);
+
+	BufferObject buffer_;
+	GLenum target_;
+	usize regionSize_;
+	bool persistent_;
+	/// Persistent path: base pointer of the whole buffer. Fallback path: base
+	/// pointer of the currently mapped region, or `nullptr` if not mapped.
+	u8* mapped_ = nullptr;
+	std::vector<GLsync> fences_;
+	usize current_ = 0;
+	usize used_ = 0;
+	Stats stats_;
+};
+
+/// Pixel formats of a `Texture`. The block compressed ones (BC1 to BC7, ETC2) all
+/// use 4x4 blocks and come out of offline compressors already mipmapped. The last
+/// ones are meant for render targets.
+enum class TextureFormat : u8 {
+	RGBA8,
+	SRGBA8,
+	BC1,
+	BC3,
+	BC4,
+	BC5,
+	BC7,
+	ETC2RGB,
+	ETC2RGBA,
+	RGBA16F,
+	R11G11B10F,
+	Depth24Stencil8,
+	Depth32F,
+};
+
+struct TextureFormatInfo {
+	GLenum internalFormat;
+	/// Client format and type of uncompressed formats.
+	GLenum format;
+	GLenum type;
+	/// Bytes per pixel, or per 4x4 block for compressed formats.
+	u32 unitBytes;
+	bool compressed;
+	/// Framebuffer attachment point of render targets in this format.
+	GLenum attachment;
+};
+
+const TextureFormatInfo& GetTextureFormatInfo(TextureFormat format);
+/// Bytes of one `width` by `height` image in `format`.
+usize TextureLevelSize(TextureFormat format, u32 width, u32 height);
+/// Whether the current context can sample `format`. Requires a current context.
+bool IsTextureFormatSupported(TextureFormat format);
+
+/// 2D texture with a chain of mip levels, uploaded one level at a time.
+///
+/// The base level follows the finest level whose coarser levels are all uploaded,
+/// so uploading coarsest first leaves a texture that can be sampled right away, at
+/// a resolution rising with every level.
+class Texture {
+private:
+	TextureObject object_;
+	TextureFormat format_;
+	u32 width_;
+	u32 height_;
+	u32 levels_;
+	/// Bit per uploaded level.
+	u32 uploaded_ = 0;
+	/// Finest level sampled, `levels_` while the coarsest one is missing.
+	u32 baseLevel_;
+
+public:
+	/// Levels of a full chain down to 1x1.
+	static u32 MipCount(u32 width, u32 height);
+
+	/// `levels` of 0 means a full chain. Throws if the size is 0 or `levels` is too
+	/// large. Requires a current context.
+	Texture(TextureFormat format, u32 width, u32 height, u32 levels = 0);
+
+	/// Upload one level from `data`, `TextureLevelSize` bytes, which is an offset
+	/// into the buffer bound to `GL_PIXEL_UNPACK_BUFFER` if any. Without one bound,
+	/// `nullptr` allocates the level uninitialized, e.g. for render targets. Leaves
+	/// the texture bound.
+	void Upload(u32 level, const void* data);
+	/// Stop sampling the finest uploaded level and free it. Throws unless at least
+	/// two levels are uploaded. Leaves the texture bound.
+	void DropBaseLevel();
+	/// Minification and magnification filters, and wrap mode of both axes.
+	void SetSampling(GLenum minFilter, GLenum magFilter, GLenum wrap);
+
+	TextureFormat format() const { return format_; }
+	u32 width() const { return width_; }
+	u32 height() const { return height_; }
+	u32 levels() const { return levels_; }
+	u32 baseLevel() const { return baseLevel_; }
+	bool complete() const { return baseLevel_ == 0; }
+	/// Video memory of the levels uploaded.
+	usize byteSize() const;
+
+	GLuint handle() const { return object_.handle(); }
+	operator GLuint() const { return object_.handle(); }
+};
+
 /// Wrapper around an OpenGL shader object handle.
 class Shader {
 private:
@@ -204,6 +429,9 @@ private:
 public:
 	static std::optional<ShaderProgram> FromSource(const std::string& vshSource, const std::string& fshSource);
 	static std::optional<ShaderProgram> New(const Shader& vsh, const Shader& fsh);
+	/// Vertex-only program capturing the given outputs with transform feedback,
+	/// interleaved in one buffer in the order given.
+	static std::optional<ShaderProgram> WithFeedback(const Shader& vsh, const std::vector<const char*>& varyings);
 	~ShaderProgram() noexcept;
 	ShaderProgram(const ShaderProgram&) = delete;
 	ShaderProgram& operator=(const ShaderProgram&) = delete;
@@ -212,6 +440,10 @@ public:
 
 	operator GLuint() const { return handle; }
 	GLuint id() const { return handle; }
+
+private:
+	/// Link the attached shaders, printing the log on failure.
+	bool Link();
 };
 
 } // namespace HOEngine
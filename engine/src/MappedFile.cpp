@@ -0,0 +1,116 @@
+#include <utility>
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace HOEngine;
+
+#ifdef _WIN32
+
+std::optional<MappedFile> MappedFile::Open(const std::string& path) {
+	MappedFile result;
+	result.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (result.file == INVALID_HANDLE_VALUE) {
+		result.file = nullptr;
+		return std::nullopt;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(result.file, &size)) return std::nullopt;
+	result.size_ = static_cast<usize>(size.QuadPart);
+	// Empty files can't be mapped
+	if (result.size_ == 0) return result;
+
+	result.mapping = CreateFileMappingA(result.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!result.mapping) return std::nullopt;
+	result.data_ = static_cast<const std::byte*>(MapViewOfFile(result.mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!result.data_) return std::nullopt;
+	return result;
+}
+
+void MappedFile::Close() noexcept {
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	data_ = nullptr;
+	size_ = 0;
+	mapping = nullptr;
+	file = nullptr;
+}
+
+MappedFile::MappedFile(MappedFile&& source) noexcept
+	: data_{ std::exchange(source.data_, nullptr) }
+	, size_{ std::exchange(source.size_, 0) }
+	, file{ std::exchange(source.file, nullptr) }
+	, mapping{ std::exchange(source.mapping, nullptr) } {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& source) noexcept {
+	if (this != &source) {
+		Close();
+		data_ = std::exchange(source.data_, nullptr);
+		size_ = std::exchange(source.size_, 0);
+		file = std::exchange(source.file, nullptr);
+		mapping = std::exchange(source.mapping, nullptr);
+	}
+	return *this;
+}
+
+#else
+
+std::optional<MappedFile> MappedFile::Open(const std::string& path) {
+	MappedFile result;
+	result.fd = ::open(path.c_str(), O_RDONLY);
+	if (result.fd < 0) return std::nullopt;
+
+	struct stat info;
+	if (::fstat(result.fd, &info) != 0) return std::nullopt;
+	result.size_ = static_cast<usize>(info.st_size);
+	// Empty files can't be mapped
+	if (result.size_ == 0) return result;
+
+	auto data = ::mmap(nullptr, result.size_, PROT_READ, MAP_PRIVATE, result.fd, 0);
+	if (data == MAP_FAILED) return std::nullopt;
+	result.data_ = static_cast<const std::byte*>(data);
+	return result;
+}
+
+void MappedFile::Close() noexcept {
+	if (data_) ::munmap(const_cast<std::byte*>(data_), size_);
+	if (fd >= 0) ::close(fd);
+	data_ = nullptr;
+	size_ = 0;
+	fd = -1;
+}
+
+MappedFile::MappedFile(MappedFile&& source) noexcept
+	: data_{ std::exchange(source.data_, nullptr) }
+	, size_{ std::exchange(source.size_, 0) }
+	, fd{ std::exchange(source.fd, -1) } {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& source) noexcept {
+	if (this != &source) {
+		Close();
+		data_ = std::exchange(source.data_, nullptr);
+		size_ = std::exchange(source.size_, 0);
+		fd = std::exchange(source.fd, -1);
+	}
+	return *this;
+}
+
+#endif
+
+MappedFile::~MappedFile() noexcept {
+	Close();
+}
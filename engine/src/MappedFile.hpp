@@ -0,0 +1,40 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Read-only memory mapping of a whole file.
+class MappedFile {
+private:
+	const std::byte* data_ = nullptr;
+	usize size_ = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+
+public:
+	/// Map the file at `path`, or `std::nullopt` if it can't be opened or mapped.
+	static std::optional<MappedFile> Open(const std::string& path);
+
+	MappedFile() noexcept = default;
+	~MappedFile() noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& source) noexcept;
+	MappedFile& operator=(MappedFile&& source) noexcept;
+
+	/// `nullptr` for empty files.
+	const std::byte* data() const { return data_; }
+	usize size() const { return size_; }
+
+private:
+	void Close() noexcept;
+};
+
+} // namespace HOEngine
@@ -0,0 +1,745 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <glm/gtc/quaternion.hpp>
+#include "MeshBVH.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Deepest tree built, so traversal stacks have a fixed size.
+	constexpr u32 maxDepth = 64;
+	constexpr u32 maxBins = 32;
+	/// Primitives per job when bounding or binning large nodes.
+	constexpr usize binChunk = 8192;
+	/// Triangles per job when preparing a build.
+	constexpr usize triangleGrain = 4096;
+	/// Smallest direction component, avoiding infinite inverses whose product with
+	/// zero would make slab tests NaN.
+	constexpr f32 minDir = 1e-30f;
+
+	glm::vec3 InverseDir(const glm::vec3& dir) {
+		glm::vec3 inv;
+		for (i32 i = 0; i < 3; ++i) {
+			auto d = std::fabs(dir[i]) < minDir ? std::copysign(minDir, dir[i]) : dir[i];
+			inv[i] = 1.0f / d;
+		}
+		return inv;
+	}
+
+	void ValidateIndices(const MeshComponent& mesh) {
+		auto vertexCount = mesh.vertices.size();
+		for (auto index : mesh.indices) {
+			if (index >= vertexCount) throw std::runtime_error("Mesh index out of range");
+		}
+	}
+
+	bool SlabTest(const BVHNode& node, const glm::vec3& origin, const glm::vec3& invDir, f32 tMin, f32 tMax, f32& tNear) {
+		auto t1 = (node.min - origin) * invDir;
+		auto t2 = (node.max - origin) * invDir;
+		auto lo = glm::min(t1, t2);
+		auto hi = glm::max(t1, t2);
+		tNear = std::max(std::max(lo.x, lo.y), std::max(lo.z, tMin));
+		auto tFar = std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+		return tNear <= tFar;
+	}
+
+	/// Lanes of the packet hitting the node.
+	F32x4 SlabTest(const BVHNode& node, const RayPacket& p) {
+		auto x1 = (F32x4::Set1(node.min.x) - p.ox) * p.invX;
+		auto x2 = (F32x4::Set1(node.max.x) - p.ox) * p.invX;
+		auto y1 = (F32x4::Set1(node.min.y) - p.oy) * p.invY;
+		auto y2 = (F32x4::Set1(node.max.y) - p.oy) * p.invY;
+		auto z1 = (F32x4::Set1(node.min.z) - p.oz) * p.invZ;
+		auto z2 = (F32x4::Set1(node.max.z) - p.oz) * p.invZ;
+		auto tNear = Max(Max(Min(x1, x2), Min(y1, y2)), Max(Min(z1, z2), p.tMin));
+		auto tFar = Min(Min(Max(x1, x2), Max(y1, y2)), Min(Max(z1, z2), p.tMax));
+		return And(tNear <= tFar, p.active);
+	}
+
+	/// Möller-Trumbore ray triangle test.
+	bool IntersectTriangle(const glm::vec3& v0, const glm::vec3& e1, const glm::vec3& e2, const glm::vec3& origin,
+		const glm::vec3& dir, f32 tMin, f32 tMax, f32& t, f32& u, f32& v) {
+		auto p = glm::cross(dir, e2);
+		auto det = glm::dot(e1, p);
+		if (det == 0.0f) return false;
+		auto invDet = 1.0f / det;
+		auto s = origin - v0;
+		u = glm::dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f) return false;
+		auto q = glm::cross(s, e1);
+		v = glm::dot(dir, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f) return false;
+		t = glm::dot(e2, q) * invDet;
+		return t > tMin && t < tMax;
+	}
+
+	/// Möller-Trumbore test of one triangle against four rays, returns the lanes hit
+	/// nearer than `p.tMax`. Degenerate triangles give NaNs, which fail every comparison.
+	F32x4 IntersectTriangle(const glm::vec3& v0, const glm::vec3& e1, const glm::vec3& e2, const RayPacket& p,
+		F32x4& t, F32x4& u, F32x4& v) {
+		auto e1x = F32x4::Set1(e1.x), e1y = F32x4::Set1(e1.y), e1z = F32x4::Set1(e1.z);
+		auto e2x = F32x4::Set1(e2.x), e2y = F32x4::Set1(e2.y), e2z = F32x4::Set1(e2.z);
+		auto px = p.dy * e2z - p.dz * e2y;
+		auto py = p.dz * e2x - p.dx * e2z;
+		auto pz = p.dx * e2y - p.dy * e2x;
+		auto invDet = F32x4::Set1(1.0f) / MulAdd(e1x, px, MulAdd(e1y, py, e1z * pz));
+		auto sx = p.ox - F32x4::Set1(v0.x);
+		auto sy = p.oy - F32x4::Set1(v0.y);
+		auto sz = p.oz - F32x4::Set1(v0.z);
+		u = MulAdd(sx, px, MulAdd(sy, py, sz * pz)) * invDet;
+		auto qx = sy * e1z - sz * e1y;
+		auto qy = sz * e1x - sx * e1z;
+		auto qz = sx * e1y - sy * e1x;
+		v = MulAdd(p.dx, qx, MulAdd(p.dy, qy, p.dz * qz)) * invDet;
+		t = MulAdd(e2x, qx, MulAdd(e2y, qy, e2z * qz)) * invDet;
+		auto zero = F32x4::Zero();
+		auto hit = And(u >= zero, v >= zero);
+		hit = And(hit, u + v <= F32x4::Set1(1.0f));
+		hit = And(hit, And(t > p.tMin, t < p.tMax));
+		return And(hit, p.active);
+	}
+
+	/// Visit the leaves hit by a ray, nearest child first, skipping nodes beyond
+	/// `tMax`. `leaf(first, count, tFar)` may shrink `tFar` (the current `tMax`),
+	/// and stops the traversal by returning true.
+	template <typename Leaf>
+	void Traverse(const std::vector<BVHNode>& nodes, const glm::vec3& origin, const glm::vec3& invDir, f32 tMin, f32 tMax, Leaf&& leaf) {
+		if (nodes.empty()) return;
+		struct Entry {
+			u32 node;
+			f32 tNear;
+		};
+		Entry stack[maxDepth + 1];
+		u32 top = 0;
+		f32 tNear;
+		if (!SlabTest(nodes[0], origin, invDir, tMin, tMax, tNear)) return;
+		stack[top++] = { 0, tNear };
+		while (top > 0) {
+			auto entry = stack[--top];
+			if (entry.tNear > tMax) continue;
+			const auto* node = &nodes[entry.node];
+			while (node && !node->IsLeaf()) {
+				const auto& a = nodes[node->first];
+				const auto& b = nodes[node->first + 1];
+				f32 ta, tb;
+				auto hitA = SlabTest(a, origin, invDir, tMin, tMax, ta);
+				auto hitB = SlabTest(b, origin, invDir, tMin, tMax, tb);
+				if (hitA && hitB) {
+					if (tb < ta) {
+						stack[top++] = { node->first, ta };
+						node = &b;
+					} else {
+						stack[top++] = { node->first + 1, tb };
+						node = &a;
+					}
+				} else if (hitA) {
+					node = &a;
+				} else if (hitB) {
+					node = &b;
+				} else {
+					node = nullptr;
+				}
+			}
+			if (node && leaf(node->first, node->count, tMax)) return;
+		}
+	}
+
+	/// Visit the leaves hit by any ray of the packet. Children are ordered by the
+	/// direction of the packet's first ray along the split axis.
+	template <typename Leaf>
+	void TraversePacket(const std::vector<BVHNode>& nodes, RayPacket& packet, Leaf&& leaf) {
+		auto active = MoveMask(packet.active);
+		if (nodes.empty() || active == 0) return;
+		auto lane = std::countr_zero(static_cast<u32>(active));
+		bool backward[3] = { packet.dx.Lane(lane) < 0.0f, packet.dy.Lane(lane) < 0.0f, packet.dz.Lane(lane) < 0.0f };
+		u32 stack[maxDepth + 1];
+		u32 top = 0;
+		stack[top++] = 0;
+		while (top > 0) {
+			const auto& node = nodes[stack[--top]];
+			if (MoveMask(SlabTest(node, packet)) == 0) continue;
+			if (node.IsLeaf()) {
+				leaf(node.first, node.count, packet);
+				continue;
+			}
+			auto nearChild = backward[node.axis()] ? 1u : 0u;
+			stack[top++] = node.first + (1 - nearChild);
+			stack[top++] = node.first + nearChild;
+		}
+	}
+
+	template <typename BVH>
+	void CastPackets(ThreadPool& pool, usize grain, const BVH& bvh, std::span<const Ray> rays, std::span<RayHit> hits) {
+		auto packets = (rays.size() + 3) / 4;
+		pool.ParallelFor(packets, grain, [&](usize begin, usize end) {
+			for (auto i = begin; i < end; ++i) {
+				auto first = i * 4;
+				auto count = std::min<usize>(4, rays.size() - first);
+				auto packet = RayPacket::From(&rays[first], count);
+				std::array<RayHit, 4> packetHits{};
+				bvh.Intersect(packet, packetHits);
+				std::copy_n(packetHits.begin(), count, hits.begin() + first);
+			}
+		});
+	}
+
+	/// Expected cost of a random ray, counting one per box and per primitive tested.
+	f32 SahCost(const std::vector<BVHNode>& nodes) {
+		if (nodes.empty()) return 0.0f;
+		auto areaOf = [](const BVHNode& node) { return AABB{ node.min, node.max }.SurfaceArea(); };
+		f64 cost = 0.0;
+		for (const auto& node : nodes) {
+			cost += areaOf(node) * (node.IsLeaf() ? static_cast<f64>(node.count) : 1.0);
+		}
+		auto rootArea = areaOf(nodes[0]);
+		return rootArea > 0.0f ? static_cast<f32>(cost / rootArea) : 0.0f;
+	}
+
+	struct BuildParams {
+		u32 bins;
+		u32 maxLeafSize;
+		usize parallelThreshold;
+	};
+
+	/// Top-down binned SAH build over primitive boxes, into a node array sized for
+	/// the worst case (`2 * count - 1`). Children are allocated in pairs from an
+	/// atomic counter, so subtrees can be built concurrently.
+	class Builder {
+	private:
+		struct Bounds {
+			AABB box;
+			AABB centers;
+		};
+
+		struct Bins {
+			std::array<std::array<AABB, maxBins>, 3> boxes;
+			std::array<std::array<u32, maxBins>, 3> counts{};
+		};
+
+		ThreadPool& pool;
+		BuildParams params;
+		const AABB* boxes;
+		const glm::vec3* centers;
+		u32* order;
+		BVHNode* nodes;
+		std::atomic<u32> nodeCount{ 1 };
+		std::atomic<u32> depth_{ 0 };
+
+	public:
+		Builder(ThreadPool& pool, BuildParams params, const AABB* boxes, const glm::vec3* centers, u32* order, BVHNode* nodes)
+			: pool{ pool }, params{ params }, boxes{ boxes }, centers{ centers }, order{ order }, nodes{ nodes } {
+			this->params.bins = std::clamp(params.bins, 2u, maxBins);
+			this->params.maxLeafSize = std::max(params.maxLeafSize, 1u);
+		}
+
+		/// Returns the number of nodes used.
+		u32 Build(u32 count) {
+			if (count == 0) return 0;
+			Split(0, 0, count, 0);
+			return nodeCount.load();
+		}
+
+		u32 depth() const { return depth_.load(); }
+
+	private:
+		/// Run `func(begin, end, result)` over chunks of `[begin, end)`, in parallel for
+		/// large ranges, and merge the chunk results in order.
+		template <typename T, typename Func, typename Merge>
+		T Reduce(u32 begin, u32 end, Func&& func, Merge&& merge) {
+			T result{};
+			auto count = end - begin;
+			if (count < 2 * binChunk) {
+				func(begin, end, result);
+				return result;
+			}
+			auto chunks = (count + binChunk - 1) / binChunk;
+			std::vector<T> partial(chunks);
+			pool.ParallelFor(chunks, 1, [&](usize chunkBegin, usize chunkEnd) {
+				for (auto chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+					auto first = begin + static_cast<u32>(chunk * binChunk);
+					auto last = std::min(end, static_cast<u32>(first + binChunk));
+					func(first, last, partial[chunk]);
+				}
+			});
+			for (const auto& part : partial) merge(result, part);
+			return result;
+		}
+
+		void MakeLeaf(BVHNode& node, u32 begin, u32 end) {
+			node.first = begin;
+			node.count = end - begin;
+		}
+
+		void Split(u32 index, u32 begin, u32 end, u32 level) {
+			auto count = end - begin;
+			auto bounds = Reduce<Bounds>(begin, end,
+				[&](u32 first, u32 last, Bounds& out) {
+					for (auto i = first; i < last; ++i) {
+						out.box.Extend(boxes[order[i]]);
+						out.centers.Extend(centers[order[i]]);
+					}
+				},
+				[](Bounds& out, const Bounds& part) {
+					out.box.Extend(part.box);
+					out.centers.Extend(part.centers);
+				});
+			auto& node = nodes[index];
+			node.min = bounds.box.min;
+			node.max = bounds.box.max;
+			auto deepest = depth_.load(std::memory_order_relaxed);
+			while (deepest < level + 1 && !depth_.compare_exchange_weak(deepest, level + 1, std::memory_order_relaxed)) {}
+			if (count <= 1) return MakeLeaf(node, begin, end);
+
+			auto extent = bounds.centers.max - bounds.centers.min;
+			u32 axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+			auto mid = begin + count / 2;
+			if (!(extent[axis] > 0.0f)) {
+				// Every center coincides, nothing to gain from sorting
+				if (count <= params.maxLeafSize) return MakeLeaf(node, begin, end);
+			} else if (level + std::bit_width(count) >= maxDepth) {
+				// Too deep for the traversal stacks, finish with median splits
+				std::nth_element(order + begin, order + mid, order + end,
+					[&](u32 a, u32 b) { return centers[a][axis] < centers[b][axis]; });
+			} else {
+				auto bins = params.bins;
+				glm::vec3 scale{ 0.0f };
+				for (u32 a = 0; a < 3; ++a) {
+					auto s = static_cast<f32>(bins) / extent[a];
+					if (extent[a] > 0.0f && std::isfinite(s)) scale[a] = s;
+				}
+				auto origin = bounds.centers.min;
+				auto binOf = [&](u32 a, f32 center) {
+					return std::min(bins - 1, static_cast<u32>((center - origin[a]) * scale[a]));
+				};
+				auto binned = Reduce<Bins>(begin, end,
+					[&](u32 first, u32 last, Bins& out) {
+						for (auto i = first; i < last; ++i) {
+							auto primitive = order[i];
+							for (u32 a = 0; a < 3; ++a) {
+								if (scale[a] == 0.0f) continue;
+								auto bin = binOf(a, centers[primitive][a]);
+								out.counts[a][bin]++;
+								out.boxes[a][bin].Extend(boxes[primitive]);
+							}
+						}
+					},
+					[&](Bins& out, const Bins& part) {
+						for (u32 a = 0; a < 3; ++a) {
+							for (u32 bin = 0; bin < bins; ++bin) {
+								out.counts[a][bin] += part.counts[a][bin];
+								out.boxes[a][bin].Extend(part.boxes[a][bin]);
+							}
+						}
+					});
+
+				// Cost of splitting after each bin: area times count on either side
+				auto bestCost = std::numeric_limits<f32>::max();
+				u32 bestAxis = 3;
+				u32 bestBin = 0;
+				for (u32 a = 0; a < 3; ++a) {
+					if (scale[a] == 0.0f) continue;
+					std::array<f32, maxBins> rightCost{};
+					AABB right;
+					u32 rightCount = 0;
+					for (u32 bin = bins - 1; bin > 0; --bin) {
+						right.Extend(binned.boxes[a][bin]);
+						rightCount += binned.counts[a][bin];
+						rightCost[bin] = rightCount > 0 ? right.SurfaceArea() * static_cast<f32>(rightCount) : -1.0f;
+					}
+					AABB left;
+					u32 leftCount = 0;
+					for (u32 bin = 0; bin + 1 < bins; ++bin) {
+						left.Extend(binned.boxes[a][bin]);
+						leftCount += binned.counts[a][bin];
+						if (leftCount == 0 || rightCost[bin + 1] < 0.0f) continue;
+						auto cost = left.SurfaceArea() * static_cast<f32>(leftCount) + rightCost[bin + 1];
+						if (cost < bestCost) {
+							bestCost = cost;
+							bestAxis = a;
+							bestBin = bin;
+						}
+					}
+				}
+
+				if (bestAxis < 3) {
+					// Traversing a node costs as much as testing one primitive
+					auto area = bounds.box.SurfaceArea();
+					auto splitCost = 1.0f + (area > 0.0f ? bestCost / area : 0.0f);
+					if (count <= params.maxLeafSize && splitCost >= static_cast<f32>(count)) {
+						return MakeLeaf(node, begin, end);
+					}
+					axis = bestAxis;
+					mid = static_cast<u32>(std::partition(order + begin, order + end,
+						[&](u32 primitive) { return binOf(axis, centers[primitive][axis]) <= bestBin; }) - order);
+				} else {
+					std::nth_element(order + begin, order + mid, order + end,
+						[&](u32 a, u32 b) { return centers[a][axis] < centers[b][axis]; });
+				}
+			}
+
+			auto children = nodeCount.fetch_add(2, std::memory_order_relaxed);
+			node.first = children;
+			node.count = BVHNode::interior | axis;
+			if (count >= params.parallelThreshold) {
+				pool.ParallelTasks(2, [&](usize child) {
+					if (child == 0) {
+						Split(children, begin, mid, level + 1);
+					} else {
+						Split(children + 1, mid, end, level + 1);
+					}
+				});
+			} else {
+				Split(children, begin, mid, level + 1);
+				Split(children + 1, mid, end, level + 1);
+			}
+		}
+	};
+}
+
+// ============== //
+// Ray and packet //
+// ============== //
+
+Ray Ray::FromNdc(const glm::mat4& viewProj, const glm::vec2& ndc) {
+	auto invViewProj = glm::inverse(viewProj);
+	auto unproject = [&](f32 depth) {
+		auto p = invViewProj * glm::vec4(ndc.x, ndc.y, depth, 1.0f);
+		return glm::vec3(p) / p.w;
+	};
+	auto nearPoint = unproject(-1.0f);
+	auto farPoint = unproject(1.0f);
+	auto length = glm::length(farPoint - nearPoint);
+	return Ray{ nearPoint, (farPoint - nearPoint) / length, 0.0f, length };
+}
+
+Ray Ray::FromNdc(const CameraComponent& camera, const Window* window, const glm::vec2& ndc) {
+	return FromNdc(camera.PerspectiveMat(window) * camera.ViewMat(), ndc);
+}
+
+RayPacket RayPacket::From(const Ray* rays, usize count) {
+	alignas(16) f32 lanes[8][4];
+	for (usize lane = 0; lane < 4; ++lane) {
+		// Unused lanes repeat the last ray, keeping their math finite
+		auto ray = count > 0 ? rays[std::min(lane, count - 1)] : Ray{};
+		lanes[0][lane] = ray.origin.x;
+		lanes[1][lane] = ray.origin.y;
+		lanes[2][lane] = ray.origin.z;
+		lanes[3][lane] = ray.dir.x;
+		lanes[4][lane] = ray.dir.y;
+		lanes[5][lane] = ray.dir.z;
+		lanes[6][lane] = ray.tMin;
+		lanes[7][lane] = ray.tMax;
+	}
+	RayPacket packet;
+	packet.ox = F32x4::Load(lanes[0]);
+	packet.oy = F32x4::Load(lanes[1]);
+	packet.oz = F32x4::Load(lanes[2]);
+	packet.dx = F32x4::Load(lanes[3]);
+	packet.dy = F32x4::Load(lanes[4]);
+	packet.dz = F32x4::Load(lanes[5]);
+	packet.tMin = F32x4::Load(lanes[6]);
+	packet.tMax = F32x4::Load(lanes[7]);
+	packet.active = F32x4::Set(0.0f, 1.0f, 2.0f, 3.0f) < F32x4::Set1(static_cast<f32>(count));
+	packet.UpdateInverse();
+	return packet;
+}
+
+void RayPacket::UpdateInverse() {
+	auto tiny = F32x4::Set1(minDir);
+	auto signBit = F32x4::Set1(-0.0f);
+	auto inverse = [&](F32x4 d) {
+		auto safe = Select(Abs(d) < tiny, Or(tiny, And(d, signBit)), d);
+		return F32x4::Set1(1.0f) / safe;
+	};
+	invX = inverse(dx);
+	invY = inverse(dy);
+	invZ = inverse(dz);
+}
+
+// ======= //
+// MeshBVH //
+// ======= //
+
+MeshBVH::MeshBVH(Config config)
+	: config{ config } {
+}
+
+void MeshBVH::Build(ThreadPool& pool, const MeshComponent& mesh) {
+	HOENGINE_PROFILE_SCOPE("MeshBVH::Build");
+	auto start = std::chrono::steady_clock::now();
+	ValidateIndices(mesh);
+
+	auto count = static_cast<u32>(mesh.indices.size() / 3);
+	std::vector<AABB> boxes(count);
+	std::vector<glm::vec3> centers(count);
+	auto corner = [&](u32 triangle, u32 vertex) -> const glm::vec3& {
+		return mesh.vertices[mesh.indices[triangle * 3 + vertex]].pos;
+	};
+	pool.ParallelFor(count, triangleGrain, [&](usize begin, usize end) {
+		for (auto i = static_cast<u32>(begin); i < end; ++i) {
+			auto& box = boxes[i];
+			box = AABB{ corner(i, 0), corner(i, 0) };
+			box.Extend(corner(i, 1));
+			box.Extend(corner(i, 2));
+			centers[i] = box.Center();
+		}
+	});
+
+	triangleIds.resize(count);
+	std::iota(triangleIds.begin(), triangleIds.end(), 0u);
+	nodes_.resize(count > 0 ? 2 * count - 1 : 0);
+	Builder builder(pool, { config.bins, config.maxLeafSize, config.parallelThreshold },
+		boxes.data(), centers.data(), triangleIds.data(), nodes_.data());
+	nodes_.resize(builder.Build(count));
+	nodes_.shrink_to_fit();
+
+	triangles.resize(count);
+	pool.ParallelFor(count, triangleGrain, [&](usize begin, usize end) {
+		for (auto i = begin; i < end; ++i) {
+			auto id = triangleIds[i];
+			auto v0 = corner(id, 0);
+			triangles[i] = Triangle{ v0, corner(id, 1) - v0, corner(id, 2) - v0 };
+		}
+	});
+
+	stats_.triangles = count;
+	stats_.nodes = nodes_.size();
+	stats_.depth = builder.depth();
+	stats_.sahCost = SahCost(nodes_);
+	stats_.buildTime = MillisecondsSince(start);
+}
+
+bool MeshBVH::Intersect(const Ray& ray, RayHit& hit) const {
+	return IntersectLocal(ray, InverseDir(ray.dir), ray.tMax, hit, RayHit::none);
+}
+
+bool MeshBVH::Occluded(const Ray& ray) const {
+	return OccludedLocal(ray, InverseDir(ray.dir));
+}
+
+void MeshBVH::Intersect(RayPacket& packet, std::array<RayHit, 4>& hits) const {
+	IntersectLocal(packet, hits, RayHit::none);
+}
+
+void MeshBVH::Cast(ThreadPool& pool, std::span<const Ray> rays, std::span<RayHit> hits) {
+	HOENGINE_PROFILE_SCOPE("MeshBVH::Cast");
+	auto start = std::chrono::steady_clock::now();
+	CastPackets(pool, config.packetGrain, *this, rays, hits);
+	stats_.rays = rays.size();
+	stats_.castTime = MillisecondsSince(start);
+}
+
+bool MeshBVH::IntersectLocal(const Ray& ray, const glm::vec3& invDir, f32 tMax, RayHit& hit, u32 instance) const {
+	bool found = false;
+	Traverse(nodes_, ray.origin, invDir, ray.tMin, std::min(tMax, hit.t), [&](u32 first, u32 count, f32& tFar) {
+		for (auto i = first; i < first + count; ++i) {
+			const auto& tri = triangles[i];
+			f32 t, u, v;
+			if (IntersectTriangle(tri.v0, tri.e1, tri.e2, ray.origin, ray.dir, ray.tMin, tFar, t, u, v)) {
+				tFar = t;
+				hit = RayHit{ t, u, v, triangleIds[i], instance };
+				found = true;
+			}
+		}
+		return false;
+	});
+	return found;
+}
+
+bool MeshBVH::OccludedLocal(const Ray& ray, const glm::vec3& invDir) const {
+	bool occluded = false;
+	Traverse(nodes_, ray.origin, invDir, ray.tMin, ray.tMax, [&](u32 first, u32 count, f32& tFar) {
+		for (auto i = first; i < first + count; ++i) {
+			const auto& tri = triangles[i];
+			f32 t, u, v;
+			if (IntersectTriangle(tri.v0, tri.e1, tri.e2, ray.origin, ray.dir, ray.tMin, tFar, t, u, v)) {
+				occluded = true;
+				return true;
+			}
+		}
+		return false;
+	});
+	return occluded;
+}
+
+void MeshBVH::IntersectLocal(RayPacket& packet, std::array<RayHit, 4>& hits, u32 instance) const {
+	TraversePacket(nodes_, packet, [&](u32 first, u32 count, RayPacket& p) {
+		for (auto i = first; i < first + count; ++i) {
+			const auto& tri = triangles[i];
+			F32x4 t, u, v;
+			auto hit = IntersectTriangle(tri.v0, tri.e1, tri.e2, p, t, u, v);
+			auto lanes = static_cast<u32>(MoveMask(hit));
+			if (lanes == 0) continue;
+			p.tMax = Select(hit, t, p.tMax);
+			for (; lanes != 0; lanes &= lanes - 1) {
+				auto lane = std::countr_zero(lanes);
+				hits[lane] = RayHit{ t.Lane(lane), u.Lane(lane), v.Lane(lane), triangleIds[i], instance };
+			}
+		}
+	});
+}
+
+// ======== //
+// SceneBVH //
+// ======== //
+
+SceneBVH::SceneBVH(Config config)
+	: config{ config } {
+}
+
+void SceneBVH::Build(ThreadPool& pool, EntitiesStorage& storage) {
+	HOENGINE_PROFILE_SCOPE("SceneBVH::Build");
+	auto start = std::chrono::steady_clock::now();
+
+	struct Pending {
+		const MeshComponent* mesh;
+		const TransformComponent* transform;
+		usize entityIdx;
+		u64 entityGen;
+	};
+	std::vector<Pending> pending;
+	std::vector<std::pair<const MeshComponent*, MeshBVH*>> stale;
+	for (auto& [mesh, cached] : meshes) cached.used = false;
+	for (usize idx = 0; idx < storage.Capacity(); ++idx) {
+		auto entity = storage.At(idx);
+		if (!entity) continue;
+		auto mesh = entity->GetComponent<MeshComponent>();
+		if (!mesh) continue;
+		auto transform = entity->GetComponent<TransformComponent>();
+		if (!transform) continue;
+		auto& cached = meshes[mesh];
+		if (!cached.used) {
+			cached.used = true;
+			if (!cached.bvh || cached.vertexData != mesh->vertices.data() || cached.indexData != mesh->indices.data() ||
+				cached.vertexCount != mesh->vertices.size() || cached.indexCount != mesh->indices.size()) {
+				// Checked here since jobs can't throw
+				ValidateIndices(*mesh);
+				if (!cached.bvh) cached.bvh = std::make_unique<MeshBVH>(config.meshes);
+				cached.vertexData = mesh->vertices.data();
+				cached.indexData = mesh->indices.data();
+				cached.vertexCount = mesh->vertices.size();
+				cached.indexCount = mesh->indices.size();
+				stale.emplace_back(mesh, cached.bvh.get());
+			}
+		}
+		pending.push_back({ mesh, transform, idx, storage.IDAt(idx).gen });
+	}
+	std::erase_if(meshes, [](const auto& entry) { return !entry.second.used; });
+
+	auto meshStart = std::chrono::steady_clock::now();
+	pool.ParallelTasks(stale.size(), [&](usize i) { stale[i].second->Build(pool, *stale[i].first); });
+	stats_.meshBuildTime = MillisecondsSince(meshStart);
+
+	std::vector<Instance> unordered;
+	std::vector<AABB> boxes;
+	std::vector<glm::vec3> centers;
+	for (const auto& entry : pending) {
+		const auto* bvh = meshes.find(entry.mesh)->second.bvh.get();
+		const auto& transform = *entry.transform;
+		if (bvh->nodes().empty()) continue;
+		if (transform.scale.x == 0.0f || transform.scale.y == 0.0f || transform.scale.z == 0.0f) continue;
+		// Inverse of rotating then scaling: unscale the rows of the transposed rotation
+		auto toLocal = glm::transpose(glm::mat3_cast(transform.rot));
+		auto invScale = glm::vec3(1.0f) / transform.scale;
+		for (i32 column = 0; column < 3; ++column) toLocal[column] *= invScale;
+		unordered.push_back({ bvh, toLocal, transform.pos, entry.entityIdx, entry.entityGen });
+		boxes.push_back(transform.TransformBounds(bvh->bounds()));
+		centers.push_back(boxes.back().Center());
+	}
+
+	auto count = static_cast<u32>(unordered.size());
+	std::vector<u32> order(count);
+	std::iota(order.begin(), order.end(), 0u);
+	nodes_.resize(count > 0 ? 2 * count - 1 : 0);
+	Builder builder(pool, { config.meshes.bins, config.maxLeafSize, config.meshes.parallelThreshold },
+		boxes.data(), centers.data(), order.data(), nodes_.data());
+	nodes_.resize(builder.Build(count));
+	instances.resize(count);
+	for (u32 i = 0; i < count; ++i) instances[i] = unordered[order[i]];
+
+	stats_.instances = count;
+	stats_.meshes = meshes.size();
+	stats_.meshesBuilt = stale.size();
+	stats_.nodes = nodes_.size();
+	stats_.buildTime = MillisecondsSince(start);
+}
+
+void SceneBVH::Invalidate(const MeshComponent& mesh) {
+	meshes.erase(&mesh);
+}
+
+bool SceneBVH::Intersect(const Ray& ray, RayHit& hit) const {
+	bool found = false;
+	Traverse(nodes_, ray.origin, InverseDir(ray.dir), ray.tMin, std::min(ray.tMax, hit.t), [&](u32 first, u32 count, f32& tFar) {
+		for (auto i = first; i < first + count; ++i) {
+			const auto& instance = instances[i];
+			Ray local{ instance.toLocal * (ray.origin - instance.pos), instance.toLocal * ray.dir, ray.tMin, tFar };
+			if (instance.mesh->IntersectLocal(local, InverseDir(local.dir), tFar, hit, i)) {
+				tFar = hit.t;
+				found = true;
+			}
+		}
+		return false;
+	});
+	return found;
+}
+
+bool SceneBVH::Occluded(const Ray& ray) const {
+	bool occluded = false;
+	Traverse(nodes_, ray.origin, InverseDir(ray.dir), ray.tMin, ray.tMax, [&](u32 first, u32 count, f32& tFar) {
+		for (auto i = first; i < first + count; ++i) {
+			const auto& instance = instances[i];
+			Ray local{ instance.toLocal * (ray.origin - instance.pos), instance.toLocal * ray.dir, ray.tMin, tFar };
+			if (instance.mesh->OccludedLocal(local, InverseDir(local.dir))) {
+				occluded = true;
+				return true;
+			}
+		}
+		return false;
+	});
+	return occluded;
+}
+
+void SceneBVH::Intersect(RayPacket& packet, std::array<RayHit, 4>& hits) const {
+	TraversePacket(nodes_, packet, [&](u32 first, u32 count, RayPacket& p) {
+		for (auto i = first; i < first + count; ++i) {
+			auto local = ToLocal(instances[i], p);
+			instances[i].mesh->IntersectLocal(local, hits, i);
+			p.tMax = local.tMax;
+		}
+	});
+}
+
+void SceneBVH::Cast(ThreadPool& pool, std::span<const Ray> rays, std::span<RayHit> hits) {
+	HOENGINE_PROFILE_SCOPE("SceneBVH::Cast");
+	auto start = std::chrono::steady_clock::now();
+	CastPackets(pool, config.packetGrain, *this, rays, hits);
+	stats_.rays = rays.size();
+	stats_.castTime = MillisecondsSince(start);
+}
+
+RayPacket SceneBVH::ToLocal(const Instance& instance, const RayPacket& packet) const {
+	const auto& m = instance.toLocal;
+	auto transform = [&](F32x4 x, F32x4 y, F32x4 z, i32 row) {
+		return MulAdd(F32x4::Set1(m[0][row]), x, MulAdd(F32x4::Set1(m[1][row]), y, F32x4::Set1(m[2][row]) * z));
+	};
+	auto rx = packet.ox - F32x4::Set1(instance.pos.x);
+	auto ry = packet.oy - F32x4::Set1(instance.pos.y);
+	auto rz = packet.oz - F32x4::Set1(instance.pos.z);
+	RayPacket local = packet;
+	local.ox = transform(rx, ry, rz, 0);
+	local.oy = transform(rx, ry, rz, 1);
+	local.oz = transform(rx, ry, rz, 2);
+	local.dx = transform(packet.dx, packet.dy, packet.dz, 0);
+	local.dy = transform(packet.dx, packet.dy, packet.dz, 1);
+	local.dz = transform(packet.dx, packet.dy, packet.dz, 2);
+	local.UpdateInverse();
+	return local;
+}
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "Entity.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+struct Ray {
+	glm::vec3 origin{ 0.0f };
+	/// Need not be normalized, hit distances are in multiples of its length.
+	glm::vec3 dir{ 0.0f, 0.0f, -1.0f };
+	f32 tMin = 0.0f;
+	f32 tMax = std::numeric_limits<f32>::infinity();
+
+	/// Ray through a point given in normalized device coordinates, from the near
+	/// plane to the far plane, with a unit direction.
+	static Ray FromNdc(const glm::mat4& viewProj, const glm::vec2& ndc);
+	/// Ray under a cursor for mouse picking, `ndc` being the cursor position mapped to [-1, 1].
+	static Ray FromNdc(const CameraComponent& camera, const Window* window, const glm::vec2& ndc);
+};
+
+struct RayHit {
+	static constexpr u32 none = ~0u;
+
+	f32 t = std::numeric_limits<f32>::infinity();
+	/// Barycentric weights of the triangle's second and third vertex.
+	f32 u = 0.0f;
+	f32 v = 0.0f;
+	/// Index of the triangle's first index in `MeshComponent::indices`, divided by three.
+	u32 triangle = none;
+	/// Instance hit, for `SceneBVH` queries.
+	u32 instance = none;
+
+	bool IsHit() const { return triangle != none; }
+};
+
+/// Four rays laid out for SIMD traversal. Rays in a packet should be coherent
+/// (e.g. neighbouring pixels), since a node is visited if any of them hits it.
+struct RayPacket {
+	F32x4 ox, oy, oz;
+	F32x4 dx, dy, dz;
+	F32x4 invX, invY, invZ;
+	F32x4 tMin, tMax;
+	/// Lanes holding a ray, as a mask.
+	F32x4 active;
+
+	/// Packet of up to four rays, remaining lanes are inactive.
+	static RayPacket From(const Ray* rays, usize count);
+	/// Recompute the inverse directions after changing `dx`, `dy` or `dz`.
+	void UpdateInverse();
+};
+
+/// Node shared by `MeshBVH` and `SceneBVH`, 32 bytes so two fit in a cache line.
+/// The two children of an interior node are stored next to each other.
+struct BVHNode {
+	static constexpr u32 interior = 0x80000000u;
+
+	glm::vec3 min;
+	/// First primitive for leaves, first child for interior nodes.
+	u32 first;
+	glm::vec3 max;
+	/// Primitive count for leaves, `interior` plus the split axis otherwise.
+	u32 count;
+
+	bool IsLeaf() const { return count < interior; }
+	u32 axis() const { return count & 3; }
+};
+static_assert(sizeof(BVHNode) == 32);
+
+/// Bounding volume hierarchy over the triangles of a mesh, for ray casts.
+///
+/// Built top-down with the surface area heuristic, evaluated over a fixed number
+/// of bins per axis instead of every triangle, which keeps building linear per
+/// level. Large nodes bin their triangles in parallel, and the two halves of large
+/// nodes are built as separate jobs. Leaves hold triangles as a vertex and two
+/// edges, reordered to be contiguous, so intersection needs no index lookups.
+///
+/// Single rays visit the nearest child first and skip nodes farther than the
+/// closest hit. Packets of four rays test boxes and triangles with `F32x4`,
+/// visiting a node if any ray of the packet hits it.
+class MeshBVH {
+public:
+	struct Config {
+		/// Bins per axis when evaluating splits, at most 32.
+		u32 bins = 16;
+		/// Leaves hold at most this many triangles.
+		u32 maxLeafSize = 4;
+		/// Nodes with more triangles are binned and split in parallel.
+		usize parallelThreshold = 16384;
+		/// Packets per job in `Cast`.
+		usize packetGrain = 64;
+	};
+
+	struct Stats {
+		usize triangles = 0;
+		usize nodes = 0;
+		u32 depth = 0;
+		/// Expected cost of a ray, relative to intersecting a single box.
+		f32 sahCost = 0;
+		/// CPU time of the last `Build` and `Cast`, in milliseconds.
+		f64 buildTime = 0;
+		f64 castTime = 0;
+		/// Rays of the last `Cast`.
+		usize rays = 0;
+
+		f64 MraysPerSecond() const { return castTime > 0 ? static_cast<f64>(rays) / castTime / 1000.0 : 0.0; }
+	};
+
+private:
+	struct Triangle {
+		glm::vec3 v0;
+		glm::vec3 e1;
+		glm::vec3 e2;
+	};
+
+	Config config;
+	std::vector<BVHNode> nodes_;
+	/// In leaf order.
+	std::vector<Triangle> triangles;
+	/// Mesh triangle of each entry of `triangles`.
+	std::vector<u32> triangleIds;
+	Stats stats_;
+
+public:
+	explicit MeshBVH(Config config);
+	MeshBVH() : MeshBVH(Config{}) {}
+
+	/// Build over the triangles of `mesh`. Throws if an index is out of range.
+	void Build(ThreadPool& pool, const MeshComponent& mesh);
+
+	/// Find the closest hit nearer than `hit.t`, returns whether `hit` changed.
+	bool Intersect(const Ray& ray, RayHit& hit) const;
+	/// Whether anything is hit between `ray.tMin` and `ray.tMax`, for line of sight tests.
+	bool Occluded(const Ray& ray) const;
+	/// Find the closest hit of each ray, shrinking `packet.tMax` to it.
+	void Intersect(RayPacket& packet, std::array<RayHit, 4>& hits) const;
+	/// Intersect every ray, four at a time in parallel. `hits` must be as large as `rays`.
+	void Cast(ThreadPool& pool, std::span<const Ray> rays, std::span<RayHit> hits);
+
+	AABB bounds() const { return nodes_.empty() ? AABB{} : AABB{ nodes_[0].min, nodes_[0].max }; }
+	const std::vector<BVHNode>& nodes() const { return nodes_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	bool IntersectLocal(const Ray& ray, const glm::vec3& invDir, f32 tMax, RayHit& hit, u32 instance) const;
+	bool OccludedLocal(const Ray& ray, const glm::vec3& invDir) const;
+	void IntersectLocal(RayPacket& packet, std::array<RayHit, 4>& hits, u32 instance) const;
+
+	friend class SceneBVH;
+};
+
+/// Two level hierarchy for ray casts against every entity having a `MeshComponent`
+/// and a `TransformComponent`.
+///
+/// Each mesh gets a `MeshBVH` in local space, kept across builds as long as its
+/// component lives and its vertex and index arrays keep their size and storage;
+/// call `Invalidate` after editing a mesh in place. The top level is rebuilt by
+/// every `Build` over the world bounds of the instances, which is cheap since
+/// there are far fewer instances than triangles. Rays reaching an instance are
+/// moved into its local space, where distances are unchanged.
+class SceneBVH {
+public:
+	struct Config {
+		MeshBVH::Config meshes;
+		/// Leaves of the top level hold at most this many instances.
+		u32 maxLeafSize = 1;
+		/// Packets per job in `Cast`.
+		usize packetGrain = 64;
+	};
+
+	struct Stats {
+		usize instances = 0;
+		usize meshes = 0;
+		/// Meshes whose hierarchy was built by the last `Build`.
+		usize meshesBuilt = 0;
+		usize nodes = 0;
+		/// CPU time of the last `Build`, of which building mesh hierarchies, and of
+		/// the last `Cast`, in milliseconds.
+		f64 buildTime = 0;
+		f64 meshBuildTime = 0;
+		f64 castTime = 0;
+		/// Rays of the last `Cast`.
+		usize rays = 0;
+
+		f64 MraysPerSecond() const { return castTime > 0 ? static_cast<f64>(rays) / castTime / 1000.0 : 0.0; }
+	};
+
+private:
+	struct CachedMesh {
+		std::unique_ptr<MeshBVH> bvh;
+		const void* vertexData;
+		const void* indexData;
+		usize vertexCount;
+		usize indexCount;
+		bool used = false;
+	};
+
+	struct Instance {
+		const MeshBVH* mesh;
+		/// World to local: `toLocal * (p - pos)`.
+		glm::mat3 toLocal;
+		glm::vec3 pos;
+		usize entityIdx;
+		u64 entityGen;
+	};
+
+	Config config;
+	std::unordered_map<const MeshComponent*, CachedMesh> meshes;
+	std::vector<BVHNode> nodes_;
+	/// In leaf order.
+	std::vector<Instance> instances;
+	Stats stats_;
+
+public:
+	explicit SceneBVH(Config config);
+	SceneBVH() : SceneBVH(Config{}) {}
+
+	/// Gather the instances of `storage`, building the hierarchy of new or resized meshes.
+	void Build(ThreadPool& pool, EntitiesStorage& storage);
+	/// Rebuild the hierarchy of `mesh` at the next `Build`.
+	void Invalidate(const MeshComponent& mesh);
+
+	/// Find the closest hit nearer than `hit.t`, returns whether `hit` changed.
+	bool Intersect(const Ray& ray, RayHit& hit) const;
+	/// Whether anything is hit between `ray.tMin` and `ray.tMax`, for line of sight tests.
+	bool Occluded(const Ray& ray) const;
+	/// Find the closest hit of each ray, shrinking `packet.tMax` to it.
+	void Intersect(RayPacket& packet, std::array<RayHit, 4>& hits) const;
+	/// Intersect every ray, four at a time in parallel. `hits` must be as large as `rays`.
+	void Cast(ThreadPool& pool, std::span<const Ray> rays, std::span<RayHit> hits);
+
+	usize instanceCount() const { return instances.size(); }
+	/// Entity owning the instance of a hit.
+	EntityID entity(u32 instance) const { return EntityID{ instances[instance].entityIdx, instances[instance].entityGen }; }
+	const std::vector<BVHNode>& nodes() const { return nodes_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	RayPacket ToLocal(const Instance& instance, const RayPacket& packet) const;
+};
+
+} // namespace HOEngine
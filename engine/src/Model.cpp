@@ -2,26 +2,37 @@
 #include <array>
 #include <sstream>
 #include <fstream>
+#include <memory_resource>
+#include <unordered_map>
 #include <glm/gtx/string_cast.hpp>
 #include "Model.hpp"
+#include "Arena.hpp"
+#include "Profiler.hpp"
 
 using namespace HOEngine;
 
 void HOEngine::ReadOBJ(MeshComponent& target, std::istream& data) {
+	HOENGINE_PROFILE_SCOPE("ReadOBJ");
+	// Temporaries live in the thread's scratch arena, declared first so it outlives them
+	ScratchArena scratch;
 	char ctrash;
-	std::vector<glm::vec3> posBuf;
-	std::vector<glm::vec3> normalBuf;
-	std::vector<glm::vec2> uvBuf;
-	std::unordered_map<SimpleVertex, u32> knownVerts;
+	std::pmr::vector<glm::vec3> posBuf{ scratch.resource() };
+	std::pmr::vector<glm::vec3> normalBuf{ scratch.resource() };
+	std::pmr::vector<glm::vec2> uvBuf{ scratch.resource() };
+	std::pmr::unordered_map<SimpleVertex, u32> knownVerts{ scratch.resource() };
 	u32 nextID = 0;
 	auto& indices = target.indices;
 	auto& vertices = target.vertices;
 
+	// Reused across lines so their storage is only allocated once
 	std::string line;
+	std::string start;
+	std::istringstream iss;
 	while (std::getline(data, line)) {
-		std::istringstream iss{line};
+		iss.clear();
+		iss.str(line);
 
-		std::string start;
+		start.clear();
 		iss >> start;
 		if (start == "#") {
 			continue;
@@ -78,6 +89,7 @@ void HOEngine::ReadOBJ(MeshComponent& target, std::istream& data) {
 	for (const auto& [vert, idx]: knownVerts) {
 		vertices.push_back(vert);
 	}
+	target.RecomputeBounds();
 }
 void HOEngine::ReadOBJ(MeshComponent& target, const std::string& data) {
 	std::istringstream iss(data);
@@ -88,4 +100,5 @@ void HOEngine::ReadOBJAt(MeshComponent& target, const std::string& path) {
 	ifs.open(path);
 	if (!ifs) return;
 	ReadOBJ(target, ifs);
+	target.asset = RegisterAsset(path);
 }
@@ -0,0 +1,220 @@
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	struct Chunk {
+		static constexpr u32 capacity = 4096;
+
+		std::array<Profiler::Event, capacity> events;
+		/// Published with release semantics once an event is fully written.
+		std::atomic<u32> count{ 0 };
+		std::atomic<Chunk*> next{ nullptr };
+	};
+
+	/// Events of a single thread. Only the owning thread writes to it; chunks are
+	/// kept (and reused after `Clear`) for the lifetime of the process, so exporting
+	/// works after the thread exits.
+	struct ThreadBuffer {
+		u32 threadID;
+		std::string name;
+		Chunk head;
+		/// Owned by the writer thread.
+		Chunk* tail = &head;
+		/// Generation the buffer's content belongs to, see `Profiler::Clear`.
+		std::atomic<u32> generation{ 0 };
+	};
+
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+	std::atomic<u32> currentGeneration{ 0 };
+	std::atomic<u64> frameNumber{ 0 };
+
+	ThreadBuffer& RegisterThread() {
+		std::lock_guard lock{ registryMutex };
+		auto buffer = std::make_unique<ThreadBuffer>();
+		buffer->threadID = static_cast<u32>(registry.size()) + 1;
+		buffer->name = "Thread " + std::to_string(buffer->threadID);
+		buffer->generation.store(currentGeneration.load());
+		auto& result = *buffer;
+		registry.push_back(std::move(buffer));
+		return result;
+	}
+
+	ThreadBuffer& LocalBuffer() {
+		thread_local ThreadBuffer& buffer = RegisterThread();
+		return buffer;
+	}
+
+	void ResetIfStale(ThreadBuffer& buffer) {
+		auto generation = currentGeneration.load(std::memory_order_acquire);
+		if (buffer.generation.load(std::memory_order_relaxed) == generation) return;
+		for (auto chunk = &buffer.head; chunk; chunk = chunk->next.load(std::memory_order_relaxed)) {
+			chunk->count.store(0, std::memory_order_relaxed);
+		}
+		buffer.tail = &buffer.head;
+		buffer.generation.store(generation, std::memory_order_release);
+	}
+
+	void WriteJSONString(std::ostream& out, const char* str) {
+		out << '"';
+		for (; *str; ++str) {
+			switch (*str) {
+				case '"': out << "\\\""; break;
+				case '\\': out << "\\\\"; break;
+				case '\n': out << "\\n"; break;
+				case '\t': out << "\\t"; break;
+				default:
+					if (static_cast<u8>(*str) < 0x20) {
+						out << ' ';
+					} else {
+						out << *str;
+					}
+			}
+		}
+		out << '"';
+	}
+
+	/// Call `func` with every event of the current generation, thread by thread.
+	template <typename Func>
+	void ForEachEvent(Func&& func) {
+		std::lock_guard lock{ registryMutex };
+		auto generation = currentGeneration.load(std::memory_order_acquire);
+		for (const auto& buffer : registry) {
+			if (buffer->generation.load(std::memory_order_acquire) != generation) continue;
+			for (auto chunk = &buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+				auto count = chunk->count.load(std::memory_order_acquire);
+				for (u32 i = 0; i < count; ++i) {
+					func(*buffer, chunk->events[i]);
+				}
+				if (count < Chunk::capacity) break;
+			}
+		}
+	}
+}
+
+std::atomic<bool> Profiler::enabled{ true };
+const std::chrono::steady_clock::time_point Profiler::epoch = std::chrono::steady_clock::now();
+
+void Profiler::Record(const Event& event) {
+	auto& buffer = LocalBuffer();
+	ResetIfStale(buffer);
+
+	auto chunk = buffer.tail;
+	auto count = chunk->count.load(std::memory_order_relaxed);
+	if (count == Chunk::capacity) {
+		// Reuse chunks left over from before the last `Clear`
+		auto next = chunk->next.load(std::memory_order_relaxed);
+		if (!next) {
+			next = new Chunk();
+			chunk->next.store(next, std::memory_order_release);
+		}
+		buffer.tail = chunk = next;
+		count = 0;
+	}
+	chunk->events[count] = event;
+	chunk->count.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::Counter(const char* name, f64 value) {
+	if (!IsEnabled()) return;
+	Event event;
+	event.name = name;
+	event.start = Now();
+	event.value = value;
+	event.type = EventType::Counter;
+	Record(event);
+}
+
+void Profiler::FrameMark() {
+	if (!IsEnabled()) return;
+	Event event;
+	event.name = "Frame";
+	event.start = Now();
+	event.frame = frameNumber.fetch_add(1, std::memory_order_relaxed);
+	event.type = EventType::Frame;
+	Record(event);
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+	auto& buffer = LocalBuffer();
+	std::lock_guard lock{ registryMutex };
+	buffer.name = name;
+}
+
+void Profiler::Clear() {
+	currentGeneration.fetch_add(1, std::memory_order_acq_rel);
+}
+
+usize Profiler::EventCount() {
+	usize count = 0;
+	ForEachEvent([&](const ThreadBuffer&, const Event&) { ++count; });
+	return count;
+}
+
+void Profiler::WriteChromeTrace(std::ostream& out) {
+	// Timestamps are in microseconds, keep the nanosecond precision
+	auto micros = [](u64 ns) { return static_cast<f64>(ns) / 1000.0; };
+	auto oldPrecision = out.precision(3);
+	out << std::fixed;
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	auto separator = [&]() {
+		if (!first) out << ",\n";
+		first = false;
+	};
+
+	{
+		std::lock_guard lock{ registryMutex };
+		for (const auto& buffer : registry) {
+			separator();
+			out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadID << ",\"args\":{\"name\":";
+			WriteJSONString(out, buffer->name.c_str());
+			out << "}}";
+		}
+	}
+
+	ForEachEvent([&](const ThreadBuffer& buffer, const Event& event) {
+		separator();
+		switch (event.type) {
+			case EventType::Scope:
+				out << "{\"ph\":\"X\",\"name\":";
+				WriteJSONString(out, event.name);
+				out << ",\"pid\":1,\"tid\":" << buffer.threadID
+					<< ",\"ts\":" << micros(event.start)
+					<< ",\"dur\":" << micros(event.end - event.start) << "}";
+				break;
+			case EventType::Counter:
+				out << "{\"ph\":\"C\",\"name\":";
+				WriteJSONString(out, event.name);
+				out << ",\"pid\":1,\"tid\":" << buffer.threadID
+					<< ",\"ts\":" << micros(event.start)
+					<< ",\"args\":{\"value\":" << event.value << "}}";
+				break;
+			case EventType::Frame:
+				out << "{\"ph\":\"i\",\"s\":\"g\",\"name\":";
+				WriteJSONString(out, event.name);
+				out << ",\"pid\":1,\"tid\":" << buffer.threadID
+					<< ",\"ts\":" << micros(event.start)
+					<< ",\"args\":{\"frame\":" << event.frame << "}}";
+				break;
+		}
+	});
+
+	out << "\n]}\n";
+	out.unsetf(std::ios_base::floatfield);
+	out.precision(oldPrecision);
+}
+
+bool Profiler::SaveChromeTrace(const std::string& path) {
+	std::ofstream out(path);
+	if (!out) return false;
+	WriteChromeTrace(out);
+	return static_cast<bool>(out);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include "Engine.hpp"
+
+/// Profiling macros. They expand to nothing unless `HOENGINE_PROFILE` is defined
+/// (CMake option of the same name), so instrumentation can be left in hot code.
+/// Names must be string literals or otherwise outlive the profiler.
+#ifdef HOENGINE_PROFILE
+#define HOENGINE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define HOENGINE_PROFILE_CONCAT(a, b) HOENGINE_PROFILE_CONCAT_IMPL(a, b)
+/// Time the enclosing scope.
+#define HOENGINE_PROFILE_SCOPE(name) ::HOEngine::ProfileScope HOENGINE_PROFILE_CONCAT(hoengineProfileScope, __LINE__){ name }
+#define HOENGINE_PROFILE_FUNCTION() HOENGINE_PROFILE_SCOPE(__func__)
+/// Record the current value of a named counter.
+#define HOENGINE_PROFILE_COUNTER(name, value) ::HOEngine::Profiler::Counter(name, static_cast<f64>(value))
+/// Mark the beginning of a frame.
+#define HOENGINE_PROFILE_FRAME() ::HOEngine::Profiler::FrameMark()
+/// Name the calling thread in exported traces.
+#define HOENGINE_PROFILE_THREAD(name) ::HOEngine::Profiler::SetThreadName(name)
+#else
+#define HOENGINE_PROFILE_SCOPE(name) ((void)0)
+#define HOENGINE_PROFILE_FUNCTION() ((void)0)
+#define HOENGINE_PROFILE_COUNTER(name, value) ((void)0)
+#define HOENGINE_PROFILE_FRAME() ((void)0)
+#define HOENGINE_PROFILE_THREAD(name) ((void)0)
+#endif
+
+namespace HOEngine {
+
+/// Process wide event recorder. Every thread appends to its own buffer without
+/// locking; buffers are only registered (once per thread) under a lock.
+///
+/// `Clear` and the export functions must be called from one controlling thread
+/// (e.g. the main thread between frames). Events being recorded concurrently with
+/// an export are either fully included or left out.
+class Profiler {
+public:
+	enum class EventType : u8 {
+		/// A timed scope.
+		Scope,
+		Counter,
+		Frame,
+	};
+
+	struct Event {
+		const char* name;
+		/// Nanoseconds since the profiler's epoch.
+		u64 start;
+		union {
+			u64 end;
+			f64 value;
+			u64 frame;
+		};
+		EventType type;
+	};
+
+private:
+	static std::atomic<bool> enabled;
+
+public:
+	/// Whether events are recorded. Enabled by default; disabling at runtime leaves
+	/// only a relaxed atomic load per instrumentation point.
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+	static void SetEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+	static u64 Now() {
+		return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - epoch).count());
+	}
+
+	static void Record(const Event& event);
+	static void Counter(const char* name, f64 value);
+	static void FrameMark();
+	static void SetThreadName(const std::string& name);
+
+	/// Drop every recorded event. Each thread releases its buffer lazily, the next
+	/// time it records something.
+	static void Clear();
+	/// Number of events currently recorded across all threads.
+	static usize EventCount();
+
+	/// Write every recorded event in the Chrome trace event JSON format, which can
+	/// be opened in chrome://tracing or Perfetto.
+	static void WriteChromeTrace(std::ostream& out);
+	/// Write the Chrome trace to a file, returns whether it succeeded.
+	static bool SaveChromeTrace(const std::string& path);
+
+private:
+	static const std::chrono::steady_clock::time_point epoch;
+};
+
+/// RAII scope marker, use through `HOENGINE_PROFILE_SCOPE`.
+class ProfileScope {
+private:
+	const char* name;
+	u64 start;
+
+public:
+	explicit ProfileScope(const char* name)
+			: name{ name }
+			, start{ Profiler::IsEnabled() ? Profiler::Now() : 0 } {
+	}
+	~ProfileScope() noexcept {
+		if (start == 0 || !Profiler::IsEnabled()) return;
+		Profiler::Event event;
+		event.name = name;
+		event.start = start;
+		event.end = Profiler::Now();
+		event.type = Profiler::EventType::Scope;
+		Profiler::Record(event);
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+} // namespace HOEngine
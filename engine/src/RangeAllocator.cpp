@@ -0,0 +1,251 @@
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+#include "RangeAllocator.hpp"
+
+using namespace HOEngine;
+
+RangeAllocator::RangeAllocator(u32 capacity) {
+	for (auto& row : freeHeads) row.fill(nullNode);
+	Grow(capacity);
+}
+
+void RangeAllocator::Mapping(u32 size, u32& fl, u32& sl) {
+	if (size < slCount) {
+		// Small sizes all live in the first level, one list per exact size
+		fl = 0;
+		sl = size;
+	} else {
+		auto msb = static_cast<u32>(std::bit_width(size)) - 1;
+		fl = msb - slBits + 1;
+		sl = (size >> (msb - slBits)) - slCount;
+	}
+}
+
+u32 RangeAllocator::NewNode(const Block& block) {
+	if (!unusedNodes.empty()) {
+		auto node = unusedNodes.back();
+		unusedNodes.pop_back();
+		blocks[node] = block;
+		return node;
+	}
+	blocks.push_back(block);
+	return static_cast<u32>(blocks.size() - 1);
+}
+
+void RangeAllocator::ReleaseNode(u32 node) {
+	blocks[node].free = false;
+	blocks[node].used = false;
+	unusedNodes.push_back(node);
+}
+
+void RangeAllocator::InsertFree(u32 node) {
+	auto& block = blocks[node];
+	u32 fl, sl;
+	Mapping(block.size, fl, sl);
+
+	block.free = true;
+	block.prevFree = nullNode;
+	block.nextFree = freeHeads[fl][sl];
+	if (block.nextFree != nullNode) blocks[block.nextFree].prevFree = node;
+	freeHeads[fl][sl] = node;
+	flBitmap |= 1u << fl;
+	slBitmaps[fl] |= 1u << sl;
+}
+
+void RangeAllocator::RemoveFree(u32 node) {
+	auto& block = blocks[node];
+	u32 fl, sl;
+	Mapping(block.size, fl, sl);
+
+	if (block.prevFree != nullNode) blocks[block.prevFree].nextFree = block.nextFree;
+	if (block.nextFree != nullNode) blocks[block.nextFree].prevFree = block.prevFree;
+	if (freeHeads[fl][sl] == node) {
+		freeHeads[fl][sl] = block.nextFree;
+		if (block.nextFree == nullNode) {
+			slBitmaps[fl] &= ~(1u << sl);
+			if (slBitmaps[fl] == 0) flBitmap &= ~(1u << fl);
+		}
+	}
+	block.free = false;
+}
+
+u32 RangeAllocator::FindFree(u32 size) const {
+	// Round the request up to the next list boundary so that any block found in the
+	// starting list is guaranteed to be large enough (good fit instead of first fit)
+	if (size >= slCount) {
+		auto msb = static_cast<u32>(std::bit_width(size)) - 1;
+		auto round = (1u << (msb - slBits)) - 1;
+		if (size > ~0u - round) return nullNode;
+		size += round;
+	}
+	u32 fl, sl;
+	Mapping(size, fl, sl);
+	if (fl >= flCount) return nullNode;
+
+	auto slMap = slBitmaps[fl] & (~0u << sl);
+	if (slMap == 0) {
+		auto flMap = fl + 1 < flCount ? flBitmap & (~0u << (fl + 1)) : 0;
+		if (flMap == 0) return nullNode;
+		fl = static_cast<u32>(std::countr_zero(flMap));
+		slMap = slBitmaps[fl];
+	}
+	sl = static_cast<u32>(std::countr_zero(slMap));
+	return freeHeads[fl][sl];
+}
+
+std::optional<RangeAllocator::Allocation> RangeAllocator::Allocate(u32 size) {
+	if (size == 0) return {};
+	auto node = FindFree(size);
+	if (node == nullNode) return {};
+	RemoveFree(node);
+
+	if (blocks[node].size > size) {
+		// Split the tail off into a new free block
+		auto& block = blocks[node];
+		Block rest{
+			block.offset + size,
+			block.size - size,
+			node,
+			block.nextPhys,
+			nullNode,
+			nullNode,
+			true,
+			false,
+		};
+		block.size = size;
+		auto restNode = NewNode(rest); // Invalidates `block`
+		auto& splitted = blocks[node];
+		if (splitted.nextPhys != nullNode) {
+			blocks[splitted.nextPhys].prevPhys = restNode;
+		} else {
+			tail = restNode;
+		}
+		splitted.nextPhys = restNode;
+		InsertFree(restNode);
+	}
+
+	auto& block = blocks[node];
+	block.used = true;
+	return Allocation{ node, block.offset, block.size };
+}
+
+void RangeAllocator::Free(Handle handle) {
+	// Nodes merged away keep stale fields, only `used` tells live allocations apart
+	auto live = handle < blocks.size() && blocks[handle].used;
+	assert(live && "Freeing an invalid or already freed range");
+	if (!live) {
+		throw std::runtime_error("Freeing an invalid or already freed range");
+	}
+
+	auto node = handle;
+	blocks[node].used = false;
+	// Merge with the physically next block
+	auto next = blocks[node].nextPhys;
+	if (next != nullNode && blocks[next].free) {
+		RemoveFree(next);
+		blocks[node].size += blocks[next].size;
+		blocks[node].nextPhys = blocks[next].nextPhys;
+		if (blocks[node].nextPhys != nullNode) {
+			blocks[blocks[node].nextPhys].prevPhys = node;
+		} else {
+			tail = node;
+		}
+		ReleaseNode(next);
+	}
+	// Merge with the physically previous block
+	auto prev = blocks[node].prevPhys;
+	if (prev != nullNode && blocks[prev].free) {
+		RemoveFree(prev);
+		blocks[prev].size += blocks[node].size;
+		blocks[prev].nextPhys = blocks[node].nextPhys;
+		if (blocks[prev].nextPhys != nullNode) {
+			blocks[blocks[prev].nextPhys].prevPhys = prev;
+		} else {
+			tail = prev;
+		}
+		ReleaseNode(node);
+		node = prev;
+	}
+	InsertFree(node);
+}
+
+void RangeAllocator::Grow(u32 newCapacity) {
+	if (newCapacity <= capacity_) return;
+	auto extra = newCapacity - capacity_;
+
+	if (tail != nullNode && blocks[tail].free) {
+		RemoveFree(tail);
+		blocks[tail].size += extra;
+		InsertFree(tail);
+	} else {
+		auto node = NewNode(Block{ capacity_, extra, tail, nullNode, nullNode, nullNode, true, false });
+		if (tail != nullNode) {
+			blocks[tail].nextPhys = node;
+		} else {
+			head = node;
+		}
+		tail = node;
+		InsertFree(node);
+	}
+	capacity_ = newCapacity;
+}
+
+std::vector<RangeAllocator::Relocation> RangeAllocator::Defragment() {
+	std::vector<Relocation> moves;
+	u32 cursor = 0;
+	u32 lastLive = nullNode;
+	u32 firstLive = nullNode;
+
+	for (auto node = head; node != nullNode;) {
+		auto next = blocks[node].nextPhys;
+		auto& block = blocks[node];
+		if (block.free) {
+			ReleaseNode(node);
+		} else {
+			if (block.offset != cursor) {
+				moves.push_back(Relocation{ node, block.offset, cursor, block.size });
+				block.offset = cursor;
+			}
+			cursor += block.size;
+			block.prevPhys = lastLive;
+			if (lastLive != nullNode) {
+				blocks[lastLive].nextPhys = node;
+			} else {
+				firstLive = node;
+			}
+			lastLive = node;
+		}
+		node = next;
+	}
+	if (lastLive != nullNode) blocks[lastLive].nextPhys = nullNode;
+
+	// Every free block has been released, rebuild the free lists from scratch
+	flBitmap = 0;
+	slBitmaps.fill(0);
+	for (auto& row : freeHeads) row.fill(nullNode);
+	head = firstLive;
+	tail = lastLive;
+
+	auto total = capacity_;
+	capacity_ = cursor;
+	Grow(total);
+	return moves;
+}
+
+RangeAllocator::Stats RangeAllocator::GetStats() const {
+	Stats stats;
+	stats.capacity = capacity_;
+	for (auto node = head; node != nullNode; node = blocks[node].nextPhys) {
+		const auto& block = blocks[node];
+		if (block.free) {
+			stats.freeSize += block.size;
+			stats.largestFreeBlock = std::max(stats.largestFreeBlock, block.size);
+			++stats.freeBlockCount;
+		} else {
+			stats.usedSize += block.size;
+			++stats.allocationCount;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <vector>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Two-level segregated fit (TLSF) allocator over an abstract range of `capacity`
+/// units. It never touches the memory it manages, so the same allocator works for
+/// sub-allocating GPU buffers (in vertices, indices, bytes...) and can be used
+/// without a GL context.
+///
+/// Allocation and deallocation are O(1). Handles stay valid until freed, including
+/// across `Defragment()`, which only changes the offsets they refer to.
+class RangeAllocator {
+public:
+	using Handle = u32;
+	static constexpr Handle invalidHandle = ~0u;
+
+	struct Allocation {
+		Handle handle;
+		u32 offset;
+		u32 size;
+	};
+
+	/// A block that `Defragment()` moved, the caller must copy `size` units from
+	/// `from` to `to` in the underlying storage.
+	struct Relocation {
+		Handle handle;
+		u32 from;
+		u32 to;
+		u32 size;
+	};
+
+	struct Stats {
+		u32 capacity = 0;
+		u32 usedSize = 0;
+		u32 freeSize = 0;
+		u32 largestFreeBlock = 0;
+		u32 allocationCount = 0;
+		u32 freeBlockCount = 0;
+
+		/// 0 when all free space is in one block, approaching 1 as free space gets
+		/// scattered into many small blocks.
+		f32 Fragmentation() const {
+			return freeSize == 0 ? 0.0f : 1.0f - static_cast<f32>(largestFreeBlock) / static_cast<f32>(freeSize);
+		}
+	};
+
+private:
+	static constexpr u32 slBits = 4;
+	static constexpr u32 slCount = 1 << slBits;
+	static constexpr u32 flCount = 32;
+	static constexpr u32 nullNode = ~0u;
+
+	struct Block {
+		u32 offset;
+		u32 size;
+		u32 prevPhys;
+		u32 nextPhys;
+		u32 prevFree;
+		u32 nextFree;
+		bool free;
+		/// Handed out by `Allocate` and not freed since. Blocks merged into a free
+		/// neighbour or dropped by `Defragment` are neither free nor used.
+		bool used;
+	};
+
+	std::vector<Block> blocks;
+	std::vector<u32> unusedNodes;
+	u32 head = nullNode;
+	u32 tail = nullNode;
+	u32 capacity_ = 0;
+	u32 flBitmap = 0;
+	std::array<u32, flCount> slBitmaps{};
+	std::array<std::array<u32, slCount>, flCount> freeHeads;
+
+public:
+	explicit RangeAllocator(u32 capacity = 0);
+
+	/// Allocate a range of `size` units. Returns an empty optional if there is no
+	/// free block large enough, the caller may `Grow()` and try again. A `size` of 0
+	/// also returns an empty optional, callers needing empty ranges handle them
+	/// without the allocator.
+	std::optional<Allocation> Allocate(u32 size);
+	/// Asserts, or throws when assertions are disabled, if `handle` isn't a live
+	/// allocation, e.g. when freeing twice.
+	void Free(Handle handle);
+	/// Extend the managed range to `newCapacity` units. Shrinking is not supported.
+	void Grow(u32 newCapacity);
+	/// Compact all live allocations towards offset 0 so that the free space forms a
+	/// single block at the end. Returns the moves the caller has to replicate on the
+	/// underlying storage, in ascending order of `to`.
+	std::vector<Relocation> Defragment();
+
+	u32 OffsetOf(Handle handle) const { return blocks[handle].offset; }
+	u32 SizeOf(Handle handle) const { return blocks[handle].size; }
+	u32 capacity() const { return capacity_; }
+	Stats GetStats() const;
+
+private:
+	static void Mapping(u32 size, u32& fl, u32& sl);
+	u32 NewNode(const Block& block);
+	void ReleaseNode(u32 node);
+	void InsertFree(u32 node);
+	void RemoveFree(u32 node);
+	u32 FindFree(u32 size) const;
+};
+
+} // namespace HOEngine
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include "Engine.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HOENGINE_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace HOEngine {
+
+/// Minimal 4-wide float vector used by the data oriented parts of the engine
+/// (culling, physics, particles...). Maps to SSE2 when available and falls back to
+/// plain arrays otherwise, so every kernel written against it stays portable.
+///
+/// Comparisons return lane masks (all bits set or clear) stored in an `F32x4`,
+/// to be consumed by `Select`, `And`/`Or` or `MoveMask`.
+struct F32x4 {
+#ifdef HOENGINE_SIMD_SSE2
+	__m128 v;
+
+	F32x4() = default;
+	F32x4(__m128 v) : v{ v } {}
+
+	static F32x4 Zero() { return _mm_setzero_ps(); }
+	static F32x4 Set1(f32 x) { return _mm_set1_ps(x); }
+	static F32x4 Set(f32 a, f32 b, f32 c, f32 d) { return _mm_setr_ps(a, b, c, d); }
+	/// `ptr` must be 16 byte aligned.
+	static F32x4 Load(const f32* ptr) { return _mm_load_ps(ptr); }
+	static F32x4 LoadUnaligned(const f32* ptr) { return _mm_loadu_ps(ptr); }
+	void Store(f32* ptr) const { _mm_store_ps(ptr, v); }
+	void StoreUnaligned(f32* ptr) const { _mm_storeu_ps(ptr, v); }
+
+	friend F32x4 operator+(F32x4 a, F32x4 b) { return _mm_add_ps(a.v, b.v); }
+	friend F32x4 operator-(F32x4 a, F32x4 b) { return _mm_sub_ps(a.v, b.v); }
+	friend F32x4 operator*(F32x4 a, F32x4 b) { return _mm_mul_ps(a.v, b.v); }
+	friend F32x4 operator/(F32x4 a, F32x4 b) { return _mm_div_ps(a.v, b.v); }
+	friend F32x4 operator-(F32x4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+	friend F32x4 operator<(F32x4 a, F32x4 b) { return _mm_cmplt_ps(a.v, b.v); }
+	friend F32x4 operator<=(F32x4 a, F32x4 b) { return _mm_cmple_ps(a.v, b.v); }
+	friend F32x4 operator>(F32x4 a, F32x4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+	friend F32x4 operator>=(F32x4 a, F32x4 b) { return _mm_cmpge_ps(a.v, b.v); }
+
+	friend F32x4 Min(F32x4 a, F32x4 b) { return _mm_min_ps(a.v, b.v); }
+	friend F32x4 Max(F32x4 a, F32x4 b) { return _mm_max_ps(a.v, b.v); }
+	friend F32x4 Abs(F32x4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+	friend F32x4 Sqrt(F32x4 a) { return _mm_sqrt_ps(a.v); }
+	friend F32x4 And(F32x4 a, F32x4 b) { return _mm_and_ps(a.v, b.v); }
+	friend F32x4 Or(F32x4 a, F32x4 b) { return _mm_or_ps(a.v, b.v); }
+	/// `a & ~b`
+	friend F32x4 AndNot(F32x4 a, F32x4 b) { return _mm_andnot_ps(b.v, a.v); }
+	/// Per lane `mask ? a : b`.
+	friend F32x4 Select(F32x4 mask, F32x4 a, F32x4 b) {
+		return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+	}
+	/// One bit per lane, set if the lane's sign bit is set (i.e. for masks, if the lane is true).
+	friend i32 MoveMask(F32x4 mask) { return _mm_movemask_ps(mask.v); }
+	f32 Lane(i32 i) const {
+		alignas(16) f32 lanes[4];
+		_mm_store_ps(lanes, v);
+		return lanes[i];
+	}
+#else
+	f32 v[4];
+
+	F32x4() = default;
+
+	static F32x4 Zero() { return Set1(0.0f); }
+	static F32x4 Set1(f32 x) { return Set(x, x, x, x); }
+	static F32x4 Set(f32 a, f32 b, f32 c, f32 d) {
+		F32x4 r;
+		r.v[0] = a; r.v[1] = b; r.v[2] = c; r.v[3] = d;
+		return r;
+	}
+	static F32x4 Load(const f32* ptr) { return Set(ptr[0], ptr[1], ptr[2], ptr[3]); }
+	static F32x4 LoadUnaligned(const f32* ptr) { return Load(ptr); }
+	void Store(f32* ptr) const { std::memcpy(ptr, v, sizeof(v)); }
+	void StoreUnaligned(f32* ptr) const { Store(ptr); }
+
+	template <typename F>
+	static F32x4 Map(F32x4 a, F32x4 b, F&& func) {
+		F32x4 r;
+		for (i32 i = 0; i < 4; ++i) r.v[i] = func(a.v[i], b.v[i]);
+		return r;
+	}
+	static f32 FromBits(u32 bits) { f32 f; std::memcpy(&f, &bits, sizeof(f)); return f; }
+	static u32 ToBits(f32 f) { u32 bits; std::memcpy(&bits, &f, sizeof(f)); return bits; }
+	static f32 MaskOf(bool b) { return FromBits(b ? ~0u : 0u); }
+
+	friend F32x4 operator+(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return x + y; }); }
+	friend F32x4 operator-(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return x - y; }); }
+	friend F32x4 operator*(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return x * y; }); }
+	friend F32x4 operator/(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return x / y; }); }
+	friend F32x4 operator-(F32x4 a) { return Map(a, a, [](f32 x, f32) { return -x; }); }
+	friend F32x4 operator<(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return MaskOf(x < y); }); }
+	friend F32x4 operator<=(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return MaskOf(x <= y); }); }
+	friend F32x4 operator>(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return MaskOf(x > y); }); }
+	friend F32x4 operator>=(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return MaskOf(x >= y); }); }
+
+	friend F32x4 Min(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return x < y ? x : y; }); }
+	friend F32x4 Max(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return x > y ? x : y; }); }
+	friend F32x4 Abs(F32x4 a) { return Map(a, a, [](f32 x, f32) { return std::fabs(x); }); }
+	friend F32x4 Sqrt(F32x4 a) { return Map(a, a, [](f32 x, f32) { return std::sqrt(x); }); }
+	friend F32x4 And(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return FromBits(ToBits(x) & ToBits(y)); }); }
+	friend F32x4 Or(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return FromBits(ToBits(x) | ToBits(y)); }); }
+	friend F32x4 AndNot(F32x4 a, F32x4 b) { return Map(a, b, [](f32 x, f32 y) { return FromBits(ToBits(x) & ~ToBits(y)); }); }
+	friend F32x4 Select(F32x4 mask, F32x4 a, F32x4 b) {
+		F32x4 r;
+		for (i32 i = 0; i < 4; ++i) r.v[i] = ToBits(mask.v[i]) ? a.v[i] : b.v[i];
+		return r;
+	}
+	friend i32 MoveMask(F32x4 mask) {
+		i32 bits = 0;
+		for (i32 i = 0; i < 4; ++i) bits |= static_cast<i32>(ToBits(mask.v[i]) >> 31) << i;
+		return bits;
+	}
+	f32 Lane(i32 i) const { return v[i]; }
+#endif
+
+	F32x4& operator+=(F32x4 b) { return *this = *this + b; }
+	F32x4& operator-=(F32x4 b) { return *this = *this - b; }
+	F32x4& operator*=(F32x4 b) { return *this = *this * b; }
+};
+
+/// Multiply-add `a * b + c`.
+inline F32x4 MulAdd(F32x4 a, F32x4 b, F32x4 c) { return a * b + c; }
+
+} // namespace HOEngine
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include "SlabPool.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	std::mutex registryMutex;
+	std::vector<const SlabPool*> registry;
+
+	usize AlignUp(usize value, usize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+f64 SlabPool::Stats::Occupancy() const {
+	auto capacity = chunks * slotsPerChunk;
+	return capacity == 0 ? 0.0 : static_cast<f64>(liveSlots) / static_cast<f64>(capacity);
+}
+
+f64 SlabPool::Stats::Fragmentation() const {
+	auto capacity = chunksInUse * slotsPerChunk;
+	return capacity == 0 ? 0.0 : 1.0 - static_cast<f64>(liveSlots) / static_cast<f64>(capacity);
+}
+
+void SlabPool::ForEach(const std::function<void(const SlabPool&)>& func) {
+	std::lock_guard lock{registryMutex};
+	for (auto pool : registry) func(*pool);
+}
+
+SlabPool::SlabPool(const char* name, usize slotSize, usize slotAlignment, usize chunkSize)
+	: name_{ name } {
+	slotAlignment = std::max(slotAlignment, alignof(FreeSlot));
+	this->slotSize = AlignUp(std::max(slotSize, sizeof(FreeSlot)), slotAlignment);
+	headerSize = AlignUp(sizeof(Chunk), slotAlignment);
+
+	// Chunks are aligned to their size, which must be a power of two fitting a decent number of slots
+	this->chunkSize = 1;
+	while (this->chunkSize < std::max(chunkSize, headerSize + 16 * this->slotSize)) this->chunkSize *= 2;
+	slotsPerChunk = (this->chunkSize - headerSize) / this->slotSize;
+
+	stats_.slotSize = this->slotSize;
+	stats_.slotsPerChunk = slotsPerChunk;
+
+	std::lock_guard lock{registryMutex};
+	registry.push_back(this);
+}
+
+SlabPool::~SlabPool() noexcept {
+	{
+		std::lock_guard lock{registryMutex};
+		registry.erase(std::find(registry.begin(), registry.end(), this));
+	}
+	for (auto chunk : chunks) {
+		::operator delete(chunk, std::align_val_t{ chunkSize });
+	}
+}
+
+std::byte* SlabPool::SlotAt(Chunk* chunk, usize idx) const {
+	return reinterpret_cast<std::byte*>(chunk) + headerSize + idx * slotSize;
+}
+
+void SlabPool::Link(Chunk* chunk) {
+	chunk->prev = nullptr;
+	chunk->next = available;
+	if (available) available->prev = chunk;
+	available = chunk;
+}
+
+void SlabPool::Unlink(Chunk* chunk) {
+	if (chunk->prev) chunk->prev->next = chunk->next;
+	else available = chunk->next;
+	if (chunk->next) chunk->next->prev = chunk->prev;
+	chunk->prev = nullptr;
+	chunk->next = nullptr;
+}
+
+SlabPool::Chunk* SlabPool::NewChunk() {
+	auto chunk = static_cast<Chunk*>(::operator new(chunkSize, std::align_val_t{ chunkSize }));
+	*chunk = Chunk{ nullptr, nullptr, nullptr, 0, 0 };
+	chunks.push_back(chunk);
+	Link(chunk);
+	++emptyChunks;
+	++stats_.chunks;
+	return chunk;
+}
+
+void SlabPool::ReleaseChunk(Chunk* chunk) {
+	Unlink(chunk);
+	chunks.erase(std::find(chunks.begin(), chunks.end(), chunk));
+	::operator delete(chunk, std::align_val_t{ chunkSize });
+	--emptyChunks;
+	--stats_.chunks;
+}
+
+void* SlabPool::Allocate() {
+	std::lock_guard lock{mutex};
+	auto chunk = available ? available : NewChunk();
+
+	std::byte* slot;
+	if (chunk->freeList) {
+		slot = reinterpret_cast<std::byte*>(chunk->freeList);
+		chunk->freeList = chunk->freeList->next;
+	} else {
+		slot = SlotAt(chunk, chunk->bumped++);
+	}
+
+	if (chunk->live++ == 0) --emptyChunks;
+	if (chunk->live == slotsPerChunk) Unlink(chunk);
+
+	++stats_.allocations;
+	++stats_.liveSlots;
+	stats_.peakLiveSlots = std::max(stats_.peakLiveSlots, stats_.liveSlots);
+	return slot;
+}
+
+void SlabPool::Free(void* slot) noexcept {
+	if (!slot) return;
+	auto address = reinterpret_cast<std::uintptr_t>(slot);
+	auto chunk = reinterpret_cast<Chunk*>(address & ~(static_cast<std::uintptr_t>(chunkSize) - 1));
+
+	std::lock_guard lock{mutex};
+	if (chunk->live == slotsPerChunk) Link(chunk);
+	auto freeSlot = static_cast<FreeSlot*>(slot);
+	freeSlot->next = chunk->freeList;
+	chunk->freeList = freeSlot;
+
+	++stats_.frees;
+	--stats_.liveSlots;
+	if (--chunk->live == 0) {
+		++emptyChunks;
+		// Keep a single empty chunk around so an object repeatedly created and destroyed doesn't thrash
+		if (emptyChunks > 1) ReleaseChunk(chunk);
+	}
+}
+
+SlabPool::Stats SlabPool::stats() const {
+	std::lock_guard lock{mutex};
+	auto result = stats_;
+	result.chunksInUse = stats_.chunks - emptyChunks;
+	return result;
+}
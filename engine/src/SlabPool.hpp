@@ -0,0 +1,93 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Allocator of fixed size slots, carved out of large chunks.
+///
+/// Chunks are aligned to their own size so the chunk owning a slot is found by
+/// masking its address. Each chunk keeps its own free list, and allocations are
+/// served from chunks that already have live slots, so churn (spawning and
+/// destroying many short lived objects) stays within few chunks. Empty chunks
+/// beyond the first are released right away.
+///
+/// Thread safe. A pool must outlive every slot allocated from it.
+class SlabPool {
+public:
+	static constexpr usize defaultChunkSize = 64 * 1024;
+
+	struct Stats {
+		usize slotSize = 0;
+		usize slotsPerChunk = 0;
+		usize chunks = 0;
+		/// Chunks holding at least one live slot.
+		usize chunksInUse = 0;
+		usize liveSlots = 0;
+		usize peakLiveSlots = 0;
+		u64 allocations = 0;
+		u64 frees = 0;
+
+		/// Fraction of all slots that are live.
+		f64 Occupancy() const;
+		/// Fraction of the slots of chunks in use that are free. These holes keep
+		/// chunks alive that compaction could release.
+		f64 Fragmentation() const;
+	};
+
+private:
+	struct FreeSlot {
+		FreeSlot* next;
+	};
+	struct Chunk {
+		/// Neighbours in the list of chunks with free slots.
+		Chunk* prev;
+		Chunk* next;
+		FreeSlot* freeList;
+		u32 live;
+		/// Slots handed out from the never used tail of the chunk.
+		u32 bumped;
+	};
+
+	const char* name_;
+	usize slotSize;
+	usize chunkSize;
+	usize headerSize;
+	usize slotsPerChunk;
+
+	mutable std::mutex mutex;
+	std::vector<Chunk*> chunks;
+	Chunk* available = nullptr;
+	usize emptyChunks = 0;
+	Stats stats_;
+
+public:
+	/// Every live pool, for reporting.
+	static void ForEach(const std::function<void(const SlabPool&)>& func);
+
+	/// `name` must outlive the pool, e.g. a string literal.
+	SlabPool(const char* name, usize slotSize, usize slotAlignment, usize chunkSize = defaultChunkSize);
+	~SlabPool() noexcept;
+	SlabPool(const SlabPool&) = delete;
+	SlabPool& operator=(const SlabPool&) = delete;
+
+	/// Uninitialized storage of the pool's slot size and alignment.
+	void* Allocate();
+	/// Return a slot obtained from `Allocate` of this pool.
+	void Free(void* slot) noexcept;
+
+	const char* name() const { return name_; }
+	Stats stats() const;
+
+private:
+	Chunk* NewChunk();
+	void ReleaseChunk(Chunk* chunk);
+	void Link(Chunk* chunk);
+	void Unlink(Chunk* chunk);
+	std::byte* SlotAt(Chunk* chunk, usize idx) const;
+};
+
+} // namespace HOEngine
@@ -0,0 +1,643 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <glm/gtc/quaternion.hpp>
+#include "Snapshot.hpp"
+#include "Model.hpp"
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+struct Snapshot::Header {
+	char magic[8];
+	u32 version;
+	u32 flags;
+	/// Hash of the file with this field zeroed.
+	u64 id;
+	u64 baseID;
+	u64 fileSize;
+	u64 slotCount;
+	u64 nextGen;
+	/// `slotCount` generations.
+	u64 gensOffset;
+	/// Slots in the order they'll be reused.
+	u64 tombstonesOffset;
+	u64 tombstoneCount;
+	u64 columnsOffset;
+	u64 columnCount;
+	u64 assetsOffset;
+	u64 assetCount;
+};
+
+struct Snapshot::Column {
+	u64 typeMSB;
+	u64 typeLSB;
+	u64 recordSize;
+	u64 count;
+	/// `count` slot indices, ascending.
+	u64 slotsOffset;
+	/// `count` records of `recordSize` bytes.
+	u64 recordsOffset;
+	/// `count` `BlobRange`s, relative to `blobOffset`.
+	u64 rangesOffset;
+	u64 blobOffset;
+	u64 blobSize;
+	/// Diffs only, slots whose component of this type was removed.
+	u64 removedOffset;
+	u64 removedCount;
+};
+
+struct Snapshot::Asset {
+	AssetID id;
+	u64 pathOffset;
+	u64 pathSize;
+};
+
+namespace {
+	constexpr char magic[8] = { 'H', 'O', 'S', 'N', 'A', 'P', 0, 0 };
+	constexpr u32 version = 1;
+	constexpr u32 diffFlag = 1;
+	/// Sections are aligned so records can be read in place from the mapping.
+	constexpr usize sectionAlignment = 16;
+	constexpr u64 noRecord = ~u64{0};
+
+	struct BlobRange {
+		u64 offset;
+		u64 size;
+	};
+
+	std::map<UUID, ComponentCodec>& Codecs();
+
+	/// Append only byte buffer with aligned sections.
+	class Writer {
+	public:
+		std::vector<std::byte> out;
+
+		u64 Align() {
+			out.resize((out.size() + sectionAlignment - 1) / sectionAlignment * sectionAlignment);
+			return out.size();
+		}
+		u64 Append(const void* data, usize size) {
+			auto offset = Align();
+			out.resize(offset + size);
+			if (size > 0) std::memcpy(out.data() + offset, data, size);
+			return offset;
+		}
+		template <typename T>
+		u64 Append(const std::vector<T>& items) { return Append(items.data(), items.size() * sizeof(T)); }
+	};
+
+	/// Column being written.
+	struct ColumnData {
+		usize recordSize = 0;
+		std::vector<u64> slots;
+		std::vector<std::byte> records;
+		std::vector<BlobRange> ranges;
+		std::vector<std::byte> blob;
+		std::vector<u64> removed;
+	};
+
+	/// Records of a base snapshot's column, by slot.
+	struct BaseColumn {
+		const Snapshot::Column* column;
+		std::vector<u64> recordOf;
+	};
+
+	u64 Hash(std::span<const std::byte> data) {
+		// FNV-1a over 8 byte words, the tail padded with zeros
+		u64 hash = 0xcbf29ce484222325;
+		for (usize i = 0; i < data.size(); i += 8) {
+			u64 word = 0;
+			std::memcpy(&word, data.data() + i, std::min<usize>(8, data.size() - i));
+			hash = (hash ^ word) * 0x100000001b3;
+		}
+		return hash == 0 ? 1 : hash;
+	}
+
+	bool InBounds(u64 fileSize, u64 offset, u64 count, u64 elementSize) {
+		if (offset > fileSize || offset % sectionAlignment != 0) return false;
+		return elementSize == 0 || count <= (fileSize - offset) / elementSize;
+	}
+
+	/// Whether every slot index of `slots` is below `slotCount`, and a live slot if `live`.
+	bool ValidSlots(const u64* slots, u64 count, const u64* gens, u64 slotCount, bool live) {
+		return std::all_of(slots, slots + count, [&](u64 slot) {
+			return slot < slotCount && (!live || gens[slot] != EntitiesStorage::INVALID_GEN);
+		});
+	}
+
+	template <typename Record>
+	Record ReadRecord(const std::byte* record) {
+		Record result;
+		std::memcpy(&result, record, sizeof(Record));
+		return result;
+	}
+	template <typename Record>
+	void WriteRecord(std::byte* record, const Record& value) {
+		std::memcpy(record, &value, sizeof(Record));
+	}
+
+	struct TransformRecord {
+		glm::vec3 pos;
+		glm::quat rot;
+		glm::vec3 scale;
+	};
+	struct MeshRecord {
+		AssetID asset;
+		u64 vertexCount;
+		u64 indexCount;
+		AABB bounds;
+	};
+	struct DotLightRecord {
+		f32 strength;
+		f32 radius;
+		glm::vec3 color;
+	};
+	struct ParticleEmitterRecord {
+		f32 rate;
+		u32 maxParticles;
+		f32 lifetimeMin;
+		f32 lifetimeMax;
+		glm::vec3 spawnExtents;
+		glm::vec3 velocity;
+		glm::vec3 velocityJitter;
+		glm::vec3 acceleration;
+		f32 drag;
+		f32 sizeStart;
+		f32 sizeEnd;
+		std::array<glm::vec4, 4> colors;
+		u32 gpuSimulated;
+	};
+	struct CameraRecord {
+		f32 fov;
+		f32 nearPane;
+		f32 farPane;
+		glm::vec3 up;
+		glm::vec3 viewRay;
+	};
+
+	std::map<UUID, ComponentCodec> BuiltinCodecs() {
+		std::map<UUID, ComponentCodec> codecs;
+		auto add = [&](ComponentCodec codec) {
+			auto type = codec.type;
+			codecs.insert({type, std::move(codec)});
+		};
+
+		add(ComponentCodec{
+			TransformComponent::uuid,
+			sizeof(TransformRecord),
+			[](const Component& component, std::byte* record, SaveContext&) {
+				auto& transform = dynamic_cast<const TransformComponent&>(component);
+				WriteRecord(record, TransformRecord{ transform.pos, transform.rot, transform.scale });
+			},
+			[](const std::byte* record, std::span<const std::byte>, RestoreContext&) -> ComponentPtr<> {
+				auto data = ReadRecord<TransformRecord>(record);
+				auto transform = MakeComponent<TransformComponent>();
+				transform->pos = data.pos;
+				transform->rot = data.rot;
+				transform->scale = data.scale;
+				return transform;
+			},
+		});
+
+		add(ComponentCodec{
+			MeshComponent::uuid,
+			sizeof(MeshRecord),
+			[](const Component& component, std::byte* record, SaveContext& context) {
+				auto& mesh = dynamic_cast<const MeshComponent&>(component);
+				if (mesh.asset != 0 && context.UseAsset(mesh.asset)) {
+					WriteRecord(record, MeshRecord{ mesh.asset, 0, 0, mesh.bounds });
+					return;
+				}
+				WriteRecord(record, MeshRecord{ 0, mesh.vertices.size(), mesh.indices.size(), mesh.bounds });
+				context.Write(mesh.vertices.data(), mesh.vertices.size() * sizeof(SimpleVertex));
+				context.Write(mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+			},
+			[](const std::byte* record, std::span<const std::byte> blob, RestoreContext& context) -> ComponentPtr<> {
+				auto data = ReadRecord<MeshRecord>(record);
+				auto mesh = MakeComponent<MeshComponent>();
+				if (data.asset != 0) {
+					auto source = context.Mesh(data.asset);
+					if (!source) throw std::runtime_error("Snapshot references a mesh asset that can't be loaded");
+					mesh->vertices = source->vertices;
+					mesh->indices = source->indices;
+					mesh->asset = data.asset;
+				} else {
+					auto vertexBytes = data.vertexCount * sizeof(SimpleVertex);
+					auto indexBytes = data.indexCount * sizeof(GLuint);
+					if (data.vertexCount > blob.size() / sizeof(SimpleVertex) || blob.size() != vertexBytes + indexBytes) {
+						throw std::runtime_error("Snapshot mesh data doesn't match its vertex and index counts");
+					}
+					mesh->vertices.resize(data.vertexCount);
+					mesh->indices.resize(data.indexCount);
+					if (vertexBytes > 0) std::memcpy(mesh->vertices.data(), blob.data(), vertexBytes);
+					if (indexBytes > 0) std::memcpy(mesh->indices.data(), blob.data() + vertexBytes, indexBytes);
+				}
+				mesh->bounds = data.bounds;
+				return mesh;
+			},
+		});
+
+		add(ComponentCodec{
+			DotLightComponent::uuid,
+			sizeof(DotLightRecord),
+			[](const Component& component, std::byte* record, SaveContext&) {
+				auto& light = dynamic_cast<const DotLightComponent&>(component);
+				WriteRecord(record, DotLightRecord{ light.strength, light.radius, light.color });
+			},
+			[](const std::byte* record, std::span<const std::byte>, RestoreContext&) -> ComponentPtr<> {
+				auto data = ReadRecord<DotLightRecord>(record);
+				auto light = MakeComponent<DotLightComponent>();
+				light->strength = data.strength;
+				light->radius = data.radius;
+				light->color = data.color;
+				return light;
+			},
+		});
+
+		add(ComponentCodec{
+			ParticleEmitterComponent::uuid,
+			sizeof(ParticleEmitterRecord),
+			[](const Component& component, std::byte* record, SaveContext&) {
+				auto& emitter = dynamic_cast<const ParticleEmitterComponent&>(component);
+				WriteRecord(record, ParticleEmitterRecord{
+					emitter.rate, emitter.maxParticles, emitter.lifetimeMin, emitter.lifetimeMax,
+					emitter.spawnExtents, emitter.velocity, emitter.velocityJitter, emitter.acceleration,
+					emitter.drag, emitter.sizeStart, emitter.sizeEnd, emitter.colors, emitter.gpuSimulated ? 1u : 0u,
+				});
+			},
+			[](const std::byte* record, std::span<const std::byte>, RestoreContext&) -> ComponentPtr<> {
+				auto data = ReadRecord<ParticleEmitterRecord>(record);
+				auto emitter = MakeComponent<ParticleEmitterComponent>();
+				emitter->rate = data.rate;
+				emitter->maxParticles = data.maxParticles;
+				emitter->lifetimeMin = data.lifetimeMin;
+				emitter->lifetimeMax = data.lifetimeMax;
+				emitter->spawnExtents = data.spawnExtents;
+				emitter->velocity = data.velocity;
+				emitter->velocityJitter = data.velocityJitter;
+				emitter->acceleration = data.acceleration;
+				emitter->drag = data.drag;
+				emitter->sizeStart = data.sizeStart;
+				emitter->sizeEnd = data.sizeEnd;
+				emitter->colors = data.colors;
+				emitter->gpuSimulated = data.gpuSimulated != 0;
+				return emitter;
+			},
+		});
+
+		add(ComponentCodec{
+			CameraComponent::uuid,
+			sizeof(CameraRecord),
+			[](const Component& component, std::byte* record, SaveContext&) {
+				auto& camera = dynamic_cast<const CameraComponent&>(component);
+				WriteRecord(record, CameraRecord{ camera.fov, camera.nearPane, camera.farPane, camera.up, camera.viewRay });
+			},
+			[](const std::byte* record, std::span<const std::byte>, RestoreContext&) -> ComponentPtr<> {
+				auto data = ReadRecord<CameraRecord>(record);
+				auto camera = MakeComponent<CameraComponent>();
+				camera->fov = data.fov;
+				camera->nearPane = data.nearPane;
+				camera->farPane = data.farPane;
+				camera->up = data.up;
+				camera->viewRay = data.viewRay;
+				return camera;
+			},
+		});
+
+		return codecs;
+	}
+
+	std::map<UUID, ComponentCodec>& Codecs() {
+		static std::map<UUID, ComponentCodec> codecs = BuiltinCodecs();
+		return codecs;
+	}
+}
+
+void HOEngine::RegisterComponentCodec(ComponentCodec codec) {
+	auto type = codec.type;
+	Codecs().insert_or_assign(type, std::move(codec));
+}
+
+void SaveContext::Write(const void* data, usize size) {
+	auto offset = blob.size();
+	blob.resize(offset + size);
+	if (size > 0) std::memcpy(blob.data() + offset, data, size);
+}
+
+bool SaveContext::UseAsset(AssetID id) {
+	if (assets.contains(id)) return true;
+	auto path = AssetPath(id);
+	if (!path) return false;
+	assets.insert({id, std::move(*path)});
+	return true;
+}
+
+const MeshComponent* RestoreContext::Mesh(AssetID id) {
+	auto it = meshes.find(id);
+	if (it != meshes.end()) return it->second.get();
+
+	auto& mesh = meshes[id];
+	auto path = snapshot.AssetPathOf(id);
+	if (!path) path = AssetPath(id);
+	if (path) {
+		mesh = std::make_unique<MeshComponent>();
+		ReadOBJAt(*mesh, *path);
+		++assetsLoaded;
+		if (mesh->vertices.empty()) mesh.reset();
+	}
+	return mesh.get();
+}
+
+std::vector<std::byte> Snapshot::Save(const EntitiesStorage& storage) {
+	return Write(storage, nullptr);
+}
+
+std::vector<std::byte> Snapshot::SaveDiff(const EntitiesStorage& storage, const Snapshot& base) {
+	if (base.isDiff()) throw std::runtime_error("Snapshot diffs must be based on a full snapshot");
+	return Write(storage, &base);
+}
+
+std::vector<std::byte> Snapshot::Write(const EntitiesStorage& storage, const Snapshot* base) {
+	HOENGINE_PROFILE_SCOPE("Snapshot::Write");
+	auto& codecs = Codecs();
+
+	const u64* baseGens = nullptr;
+	u64 baseSlots = 0;
+	std::map<UUID, BaseColumn> baseColumns;
+	if (base) {
+		// Every offset, range and slot index of `base` was checked by `Validate`
+		baseGens = base->At<u64>(base->header().gensOffset);
+		baseSlots = base->header().slotCount;
+		for (const auto& column : base->columns()) {
+			auto& entry = baseColumns[UUID{column.typeMSB, column.typeLSB}];
+			entry.column = &column;
+			entry.recordOf.assign(baseSlots, noRecord);
+			auto slots = base->At<u64>(column.slotsOffset);
+			for (u64 i = 0; i < column.count; ++i) entry.recordOf[slots[i]] = i;
+		}
+	}
+
+	SaveContext context;
+	std::map<UUID, ColumnData> columns;
+	std::vector<std::byte> record;
+	std::vector<UUID> present;
+	for (usize slot = 0; slot < storage.entities.size(); ++slot) {
+		const auto& entry = storage.entities[slot];
+		if (entry.gen == EntitiesStorage::INVALID_GEN) continue;
+		// Components of a replaced entity are all new, and the old ones get dropped along with it
+		bool sameEntity = base && slot < baseSlots && baseGens[slot] == entry.gen;
+
+		present.clear();
+		entry.value.ForEachComponent([&](const Component& component) {
+			auto type = component.GetTypeID();
+			auto codec = codecs.find(type);
+			if (codec == codecs.end()) return;
+			present.push_back(type);
+
+			record.assign(codec->second.recordSize, std::byte{0});
+			context.blob.clear();
+			codec->second.save(component, record.data(), context);
+
+			if (sameEntity) {
+				auto baseColumn = baseColumns.find(type);
+				if (baseColumn != baseColumns.end() && baseColumn->second.recordOf[slot] != noRecord) {
+					const auto& column = *baseColumn->second.column;
+					auto idx = baseColumn->second.recordOf[slot];
+					auto baseRecord = base->At<std::byte>(column.recordsOffset + idx * column.recordSize);
+					auto range = base->At<BlobRange>(column.rangesOffset)[idx];
+					auto baseBlob = base->At<std::byte>(column.blobOffset + range.offset);
+					bool unchanged = column.recordSize == record.size()
+						&& std::memcmp(baseRecord, record.data(), record.size()) == 0
+						&& range.size == context.blob.size()
+						&& (range.size == 0 || std::memcmp(baseBlob, context.blob.data(), range.size) == 0);
+					if (unchanged) return;
+				}
+			}
+
+			auto& column = columns[type];
+			column.recordSize = record.size();
+			column.slots.push_back(slot);
+			column.records.insert(column.records.end(), record.begin(), record.end());
+			column.ranges.push_back(BlobRange{ column.blob.size(), context.blob.size() });
+			column.blob.insert(column.blob.end(), context.blob.begin(), context.blob.end());
+		});
+
+		if (sameEntity) {
+			for (const auto& [type, baseColumn] : baseColumns) {
+				if (baseColumn.recordOf[slot] == noRecord) continue;
+				if (std::find(present.begin(), present.end(), type) != present.end()) continue;
+				auto& column = columns[type];
+				column.recordSize = baseColumn.column->recordSize;
+				column.removed.push_back(slot);
+			}
+		}
+	}
+
+	Writer writer;
+	Header header{};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.flags = base ? diffFlag : 0;
+	header.baseID = base ? base->id() : 0;
+	header.slotCount = storage.entities.size();
+	header.nextGen = storage.nextGen;
+	writer.Append(&header, sizeof(header));
+
+	std::vector<u64> gens(storage.entities.size());
+	for (usize slot = 0; slot < gens.size(); ++slot) gens[slot] = storage.entities[slot].gen;
+	header.gensOffset = writer.Append(gens);
+
+	std::vector<u64> tombstones;
+	for (auto queue = storage.tombstones; !queue.empty(); queue.pop()) tombstones.push_back(queue.front());
+	header.tombstonesOffset = writer.Append(tombstones);
+	header.tombstoneCount = tombstones.size();
+
+	std::vector<Column> columnTable;
+	for (const auto& [type, data] : columns) {
+		Column column{};
+		column.typeMSB = type.msb();
+		column.typeLSB = type.lsb();
+		column.recordSize = data.recordSize;
+		column.count = data.slots.size();
+		column.slotsOffset = writer.Append(data.slots);
+		column.recordsOffset = writer.Append(data.records);
+		column.rangesOffset = writer.Append(data.ranges);
+		column.blobOffset = writer.Append(data.blob);
+		column.blobSize = data.blob.size();
+		column.removedOffset = writer.Append(data.removed);
+		column.removedCount = data.removed.size();
+		columnTable.push_back(column);
+	}
+	header.columnsOffset = writer.Append(columnTable);
+	header.columnCount = columnTable.size();
+
+	// Sorted so identical worlds produce identical files
+	std::map<AssetID, std::string> sortedAssets(context.assets.begin(), context.assets.end());
+	std::vector<Asset> assetTable;
+	for (const auto& [id, path] : sortedAssets) {
+		assetTable.push_back(Asset{ id, writer.Append(path.data(), path.size()), path.size() });
+	}
+	header.assetsOffset = writer.Append(assetTable);
+	header.assetCount = assetTable.size();
+
+	writer.Align();
+	header.fileSize = writer.out.size();
+	std::memcpy(writer.out.data(), &header, sizeof(header));
+	header.id = Hash(writer.out);
+	std::memcpy(writer.out.data(), &header, sizeof(header));
+	return std::move(writer.out);
+}
+
+bool Snapshot::WriteFile(const std::string& path, std::span<const std::byte> data) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) return false;
+	out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	return static_cast<bool>(out);
+}
+
+std::optional<Snapshot> Snapshot::Open(const std::string& path) {
+	auto file = MappedFile::Open(path);
+	if (!file) return {};
+
+	Snapshot snapshot;
+	snapshot.data_ = file->data();
+	snapshot.size_ = file->size();
+	snapshot.file = std::move(file);
+	if (!snapshot.Validate()) return {};
+	return snapshot;
+}
+
+std::optional<Snapshot> Snapshot::FromBytes(std::vector<std::byte> data) {
+	Snapshot snapshot;
+	snapshot.bytes = std::move(data);
+	snapshot.data_ = snapshot.bytes.data();
+	snapshot.size_ = snapshot.bytes.size();
+	if (!snapshot.Validate()) return {};
+	return snapshot;
+}
+
+bool Snapshot::Validate() const {
+	if (size_ < sizeof(Header)) return false;
+	const auto& h = header();
+	if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version) return false;
+	if (h.fileSize != size_) return false;
+	if (((h.flags & diffFlag) != 0) != (h.baseID != 0)) return false;
+	if (!InBounds(size_, h.gensOffset, h.slotCount, sizeof(u64))) return false;
+	if (!InBounds(size_, h.tombstonesOffset, h.tombstoneCount, sizeof(u64))) return false;
+	if (!InBounds(size_, h.columnsOffset, h.columnCount, sizeof(Column))) return false;
+	if (!InBounds(size_, h.assetsOffset, h.assetCount, sizeof(Asset))) return false;
+	auto gens = At<u64>(h.gensOffset);
+	if (!ValidSlots(At<u64>(h.tombstonesOffset), h.tombstoneCount, gens, h.slotCount, false)) return false;
+
+	// Restore and SaveDiff index the sections without checking them again
+	for (const auto& column : columns()) {
+		if (!InBounds(size_, column.slotsOffset, column.count, sizeof(u64))) return false;
+		if (!InBounds(size_, column.recordsOffset, column.count, column.recordSize)) return false;
+		if (!InBounds(size_, column.rangesOffset, column.count, sizeof(BlobRange))) return false;
+		if (!InBounds(size_, column.blobOffset, column.blobSize, 1)) return false;
+		if (!InBounds(size_, column.removedOffset, column.removedCount, sizeof(u64))) return false;
+		if (!ValidSlots(At<u64>(column.slotsOffset), column.count, gens, h.slotCount, true)) return false;
+		if (!ValidSlots(At<u64>(column.removedOffset), column.removedCount, gens, h.slotCount, false)) return false;
+		auto ranges = At<BlobRange>(column.rangesOffset);
+		for (u64 i = 0; i < column.count; ++i) {
+			if (ranges[i].offset > column.blobSize || ranges[i].size > column.blobSize - ranges[i].offset) return false;
+		}
+	}
+	auto assets = At<Asset>(h.assetsOffset);
+	for (u64 i = 0; i < h.assetCount; ++i) {
+		if (assets[i].pathOffset > size_ || assets[i].pathSize > size_ - assets[i].pathOffset) return false;
+	}
+	return true;
+}
+
+const Snapshot::Header& Snapshot::header() const {
+	return *At<Header>(0);
+}
+
+std::span<const Snapshot::Column> Snapshot::columns() const {
+	return { At<Column>(header().columnsOffset), header().columnCount };
+}
+
+u64 Snapshot::id() const {
+	return header().id;
+}
+
+u64 Snapshot::baseID() const {
+	return header().baseID;
+}
+
+std::optional<std::string> Snapshot::AssetPathOf(AssetID id) const {
+	auto assets = At<Asset>(header().assetsOffset);
+	for (u64 i = 0; i < header().assetCount; ++i) {
+		if (assets[i].id == id) return std::string(reinterpret_cast<const char*>(data_ + assets[i].pathOffset), assets[i].pathSize);
+	}
+	return {};
+}
+
+Snapshot::RestoreStats Snapshot::Restore(EntitiesStorage& storage) const {
+	HOENGINE_PROFILE_SCOPE("Snapshot::Restore");
+	const auto& h = header();
+	auto gens = At<u64>(h.gensOffset);
+	auto& entities = storage.entities;
+	RestoreStats stats;
+
+	if (h.flags & diffFlag) {
+		// Storages never shrink, so a larger one can't have been restored from the base
+		if (entities.size() > h.slotCount) throw std::runtime_error("Snapshot diff doesn't match the storage it is applied to");
+		entities.resize(h.slotCount, EntitiesStorage::Entry{ Entity{}, EntitiesStorage::INVALID_GEN });
+		for (u64 slot = 0; slot < h.slotCount; ++slot) {
+			if (entities[slot].gen == gens[slot]) continue;
+			entities[slot].value.RemoveAllComponents();
+			entities[slot].gen = gens[slot];
+		}
+	} else {
+		entities.clear();
+		entities.reserve(h.slotCount);
+		for (u64 slot = 0; slot < h.slotCount; ++slot) {
+			entities.push_back(EntitiesStorage::Entry{ Entity{}, gens[slot] });
+		}
+	}
+
+	storage.tombstones = {};
+	auto tombstones = At<u64>(h.tombstonesOffset);
+	for (u64 i = 0; i < h.tombstoneCount; ++i) storage.tombstones.push(tombstones[i]);
+	storage.nextGen = h.nextGen;
+	for (u64 slot = 0; slot < h.slotCount; ++slot) {
+		if (gens[slot] != EntitiesStorage::INVALID_GEN) ++stats.entities;
+	}
+
+	// Fixup pass: recreate components from the records, in place in the mapping
+	auto& codecs = Codecs();
+	RestoreContext context{ *this };
+	for (const auto& column : columns()) {
+		UUID type{ column.typeMSB, column.typeLSB };
+
+		auto removed = At<u64>(column.removedOffset);
+		for (u64 i = 0; i < column.removedCount; ++i) {
+			entities[removed[i]].value.RemoveComponent(type);
+			++stats.removedComponents;
+		}
+
+		auto codec = codecs.find(type);
+		if (codec == codecs.end() || codec->second.recordSize != column.recordSize) {
+			++stats.skippedColumns;
+			continue;
+		}
+
+		auto slots = At<u64>(column.slotsOffset);
+		auto records = At<std::byte>(column.recordsOffset);
+		auto ranges = At<BlobRange>(column.rangesOffset);
+		auto blob = At<std::byte>(column.blobOffset);
+		for (u64 i = 0; i < column.count; ++i) {
+			auto range = ranges[i];
+			auto component = codec->second.load(records + i * column.recordSize, { blob + range.offset, range.size }, context);
+			if (!component || component->GetTypeID() != type) throw std::runtime_error("Snapshot codec produced the wrong component type");
+			entities[slots[i]].value.AddComponent(std::move(component));
+			++stats.components;
+		}
+	}
+	stats.assetsLoaded = context.assetsLoaded;
+	return stats;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Engine.hpp"
+#include "Entity.hpp"
+#include "MappedFile.hpp"
+
+namespace HOEngine {
+
+class SaveContext;
+class RestoreContext;
+
+/// How one component type is written to and read back from snapshots.
+///
+/// Each component is stored as a fixed size record, copied around as raw bytes,
+/// plus an optional variable sized blob (e.g. mesh vertices). Records must not
+/// contain pointers; blob positions are implied by the snapshot. Diffs compare
+/// records byte by byte, so they shouldn't contain uninitialized padding either.
+struct ComponentCodec {
+	/// Type tag of the column, the component's `ComponentUUIDMixin` UUID.
+	UUID type;
+	usize recordSize;
+	/// Fill `record` (`recordSize` zeroed bytes), writing variable sized data through `context`.
+	std::function<void(const Component& component, std::byte* record, SaveContext& context)> save;
+	/// Recreate the component from what `save` produced.
+	std::function<ComponentPtr<>(const std::byte* record, std::span<const std::byte> blob, RestoreContext& context)> load;
+};
+
+/// Make snapshots store components of `codec.type`, replacing any previous codec
+/// of that type. Built-in components are registered already, components without
+/// a codec are left out of snapshots. Not thread safe, register at startup.
+void RegisterComponentCodec(ComponentCodec codec);
+
+/// Binary image of an `EntitiesStorage`.
+///
+/// Holds the generation of every slot (0 for tombstones), the tombstone queue, and
+/// one column per component type, each made of the slots having that component,
+/// their records and their blobs. Meshes loaded from files are stored as asset
+/// IDs, and reloaded from the paths in the snapshot's asset table on restore.
+///
+/// A diff snapshot only holds the components that changed since a full base
+/// snapshot, plus the components removed from entities still alive.
+///
+/// Restoring maps the file and runs a single fixup pass recreating components in
+/// place from their records.
+class Snapshot {
+public:
+	struct Header;
+	struct Column;
+	struct Asset;
+
+	struct RestoreStats {
+		usize entities = 0;
+		usize components = 0;
+		usize removedComponents = 0;
+		/// Columns of types without a registered codec.
+		usize skippedColumns = 0;
+		usize assetsLoaded = 0;
+	};
+
+private:
+	std::optional<MappedFile> file;
+	std::vector<std::byte> bytes;
+	const std::byte* data_ = nullptr;
+	usize size_ = 0;
+
+public:
+	/// Write a full snapshot of `storage`.
+	static std::vector<std::byte> Save(const EntitiesStorage& storage);
+	/// Write what changed in `storage` since `base`, which must be a full snapshot.
+	static std::vector<std::byte> SaveDiff(const EntitiesStorage& storage, const Snapshot& base);
+	static bool WriteFile(const std::string& path, std::span<const std::byte> data);
+
+	/// Map the snapshot file at `path`. `std::nullopt` if missing or malformed.
+	static std::optional<Snapshot> Open(const std::string& path);
+	/// Snapshot over in-memory data. `std::nullopt` if malformed.
+	static std::optional<Snapshot> FromBytes(std::vector<std::byte> data);
+
+	Snapshot(Snapshot&&) noexcept = default;
+	Snapshot& operator=(Snapshot&&) noexcept = default;
+
+	/// Replace the content of `storage` with a full snapshot, or apply a diff
+	/// snapshot to a `storage` restored from its base and unmodified since.
+	/// Throws `std::runtime_error` on inconsistent data.
+	RestoreStats Restore(EntitiesStorage& storage) const;
+
+	/// Hash of the content, shared by identical snapshots.
+	u64 id() const;
+	/// ID of the base of a diff snapshot, 0 for full snapshots.
+	u64 baseID() const;
+	bool isDiff() const { return baseID() != 0; }
+	std::span<const std::byte> data() const { return { data_, size_ }; }
+
+private:
+	Snapshot() = default;
+	static std::vector<std::byte> Write(const EntitiesStorage& storage, const Snapshot* base);
+	/// Check every offset, blob range and slot index against the data, so that
+	/// nothing else needs to. Run once by `Open` and `FromBytes`.
+	bool Validate() const;
+	const Header& header() const;
+	std::span<const Column> columns() const;
+	std::optional<std::string> AssetPathOf(AssetID id) const;
+
+	template <typename T>
+	const T* At(u64 offset) const { return reinterpret_cast<const T*>(data_ + offset); }
+
+	friend RestoreContext;
+};
+
+/// Output of the component being saved, available to codecs.
+class SaveContext {
+private:
+	std::vector<std::byte> blob;
+	std::unordered_map<AssetID, std::string> assets;
+
+public:
+	/// Append variable sized data to the blob of the current component.
+	void Write(const void* data, usize size);
+	/// Reference an asset from the snapshot. False if its path is unknown, in
+	/// which case the data itself should be written instead.
+	bool UseAsset(AssetID id);
+
+	friend Snapshot;
+};
+
+/// Shared state of a restore pass, available to codecs.
+class RestoreContext {
+private:
+	const Snapshot& snapshot;
+	std::unordered_map<AssetID, std::unique_ptr<MeshComponent>> meshes;
+
+public:
+	usize assetsLoaded = 0;
+
+	explicit RestoreContext(const Snapshot& snapshot) : snapshot{ snapshot } {}
+
+	/// Mesh of the given asset, loaded once per restore. `nullptr` if it can't be loaded.
+	const MeshComponent* Mesh(AssetID id);
+};
+
+} // namespace HOEngine
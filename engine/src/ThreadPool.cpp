@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <memory>
+#include "ThreadPool.hpp"
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+usize ThreadPool::DefaultThreadCount() {
+	auto hw = static_cast<usize>(std::thread::hardware_concurrency());
+	return hw > 1 ? hw - 1 : 0;
+}
+
+ThreadPool& ThreadPool::Global() {
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::ThreadPool(usize threadCount) {
+	workers.reserve(threadCount);
+	for (usize i = 0; i < threadCount; ++i) {
+		workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool() noexcept {
+	{
+		std::lock_guard lock{ mutex };
+		stopping = true;
+	}
+	cv.notify_all();
+	for (auto& worker : workers) worker.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job) {
+	if (workers.empty()) {
+		// Nobody would ever pick it up
+		job();
+		return;
+	}
+	{
+		std::lock_guard lock{ mutex };
+		jobs.push_back(std::move(job));
+	}
+	cv.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+	HOENGINE_PROFILE_THREAD("Worker");
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock lock{ mutex };
+			cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty()) return; // Stopping and drained
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		job();
+	}
+}
+
+namespace {
+	struct ParallelForState {
+		std::atomic<usize> nextChunk{ 0 };
+		std::atomic<usize> doneChunks{ 0 };
+		usize chunkCount;
+		usize count;
+		usize grain;
+		const std::function<void(usize, usize)>* func;
+		std::mutex mutex;
+		std::condition_variable cv;
+
+		/// Process chunks until there are none left. Returns true if this call
+		/// completed the last chunk.
+		bool Drain() {
+			bool completedLast = false;
+			while (true) {
+				auto chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= chunkCount) break;
+				auto begin = chunk * grain;
+				auto end = std::min(begin + grain, count);
+				(*func)(begin, end);
+				if (doneChunks.fetch_add(1, std::memory_order_acq_rel) + 1 == chunkCount) {
+					completedLast = true;
+				}
+			}
+			return completedLast;
+		}
+	};
+}
+
+void ThreadPool::ParallelFor(usize count, usize grain, const std::function<void(usize, usize)>& func) {
+	if (count == 0) return;
+	grain = std::max<usize>(grain, 1);
+	auto chunkCount = (count + grain - 1) / grain;
+	if (chunkCount == 1 || workers.empty()) {
+		func(0, count);
+		return;
+	}
+
+	// Helpers might still be queued when all chunks are done, so they share ownership
+	// of the state. They only touch `func` after grabbing a chunk, which can only
+	// happen while the caller is still waiting.
+	auto state = std::make_shared<ParallelForState>();
+	state->chunkCount = chunkCount;
+	state->count = count;
+	state->grain = grain;
+	state->func = &func;
+
+	auto helpers = std::min(workers.size(), chunkCount - 1);
+	for (usize i = 0; i < helpers; ++i) {
+		Submit([state]() {
+			if (state->Drain()) {
+				std::lock_guard lock{ state->mutex };
+				state->cv.notify_all();
+			}
+		});
+	}
+
+	state->Drain();
+	std::unique_lock lock{ state->mutex };
+	state->cv.wait(lock, [&]() { return state->doneChunks.load(std::memory_order_acquire) == chunkCount; });
+}
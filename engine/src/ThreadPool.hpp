@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Fixed set of worker threads consuming a shared job queue. Meant for short,
+/// CPU bound, fork-join work (culling, simulation kernels, mesh generation...),
+/// not for blocking IO.
+class ThreadPool {
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+
+public:
+	/// Number of workers to use when none is specified: one per hardware thread,
+	/// minus the calling thread which participates in `ParallelFor`.
+	static usize DefaultThreadCount();
+	/// Lazily created pool shared by engine subsystems.
+	static ThreadPool& Global();
+
+	explicit ThreadPool(usize threadCount = DefaultThreadCount());
+	~ThreadPool() noexcept;
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	ThreadPool& operator=(ThreadPool&&) = delete;
+
+	/// Number of worker threads, not counting threads calling `ParallelFor`.
+	usize threadCount() const { return workers.size(); }
+
+	/// Queue a job to be run on some worker.
+	void Submit(std::function<void()> job);
+
+	/// Split `[0, count)` into chunks of `grain` elements and call `func(begin, end)`
+	/// for each of them across the workers and the calling thread. Returns once
+	/// every chunk has been processed. Safe to call from inside a job.
+	void ParallelFor(usize count, usize grain, const std::function<void(usize, usize)>& func);
+
+	/// Run `func(task)` for each `task` in `[0, taskCount)`, one task per chunk.
+	void ParallelTasks(usize taskCount, const std::function<void(usize)>& func) {
+		ParallelFor(taskCount, 1, [&](usize begin, usize end) {
+			for (auto i = begin; i < end; ++i) func(i);
+		});
+	}
+
+private:
+	void WorkerLoop();
+};
+
+} // namespace HOEngine
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <chrono>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Wall clock time elapsed since `start`, in milliseconds. Used for the `...Time`
+/// fields of subsystem stats.
+inline f64 MillisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace HOEngine
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include "WorldPartition.hpp"
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Entities moved in between two checks of the time budget.
+	constexpr usize budgetCheckInterval = 32;
+}
+
+MemoryCellSource::MemoryCellSource(std::map<CellCoord, std::vector<std::byte>> cells, std::chrono::duration<f64> latency)
+	: cells{ std::move(cells) }
+	, latency{ latency } {
+}
+
+std::vector<std::pair<CellCoord, usize>> MemoryCellSource::Cells() const {
+	std::vector<std::pair<CellCoord, usize>> result;
+	for (const auto& [coord, data] : cells) result.push_back({coord, data.size()});
+	return result;
+}
+
+std::optional<Snapshot> MemoryCellSource::Load(CellCoord coord) {
+	if (latency.count() > 0) std::this_thread::sleep_for(latency);
+	auto it = cells.find(coord);
+	if (it == cells.end()) return {};
+	return Snapshot::FromBytes(it->second);
+}
+
+bool DirectoryCellSource::Write(const std::string& directory, const std::map<CellCoord, std::vector<std::byte>>& cells) {
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error) return false;
+	DirectoryCellSource target{ directory };
+	for (const auto& [coord, data] : cells) {
+		if (!Snapshot::WriteFile(target.PathOf(coord), data)) return false;
+	}
+	return true;
+}
+
+DirectoryCellSource::DirectoryCellSource(std::string directory)
+	: directory{ std::move(directory) } {
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(this->directory, error)) {
+		if (!entry.is_regular_file()) continue;
+		CellCoord coord;
+		char tail = 0;
+		auto name = entry.path().filename().string();
+		if (std::sscanf(name.c_str(), "cell_%d_%d.snap%c", &coord.x, &coord.z, &tail) != 2) continue;
+		cells.push_back({coord, static_cast<usize>(entry.file_size())});
+	}
+}
+
+std::string DirectoryCellSource::PathOf(CellCoord coord) const {
+	return directory + "/cell_" + std::to_string(coord.x) + "_" + std::to_string(coord.z) + ".snap";
+}
+
+std::optional<Snapshot> DirectoryCellSource::Load(CellCoord coord) {
+	return Snapshot::Open(PathOf(coord));
+}
+
+std::map<CellCoord, std::vector<std::byte>> WorldPartition::Split(EntitiesStorage& world, f32 cellSize) {
+	HOENGINE_PROFILE_SCOPE("WorldPartition::Split");
+	std::map<CellCoord, EntitiesStorage> parts;
+	for (usize idx = 0; idx < world.Capacity(); ++idx) {
+		auto entity = world.At(idx);
+		if (!entity) continue;
+		auto transform = entity->GetComponent<TransformComponent>();
+		if (!transform) continue;
+		CellCoord coord{
+			static_cast<i32>(std::floor(transform->pos.x / cellSize)),
+			static_cast<i32>(std::floor(transform->pos.z / cellSize)),
+		};
+		parts[coord].Add(*entity);
+	}
+
+	std::map<CellCoord, std::vector<std::byte>> result;
+	for (const auto& [coord, storage] : parts) result[coord] = Snapshot::Save(storage);
+	return result;
+}
+
+std::optional<glm::vec3> WorldPartition::CameraPosition(EntitiesStorage& world) {
+	for (usize idx = 0; idx < world.Capacity(); ++idx) {
+		auto entity = world.At(idx);
+		if (!entity || !entity->GetComponent<CameraComponent>()) continue;
+		auto transform = entity->GetComponent<TransformComponent>();
+		if (transform) return transform->pos;
+	}
+	return {};
+}
+
+WorldPartition::WorldPartition(std::unique_ptr<CellSource> source, Config config)
+	: config{ config }
+	, source{ std::move(source) }
+	, loadLatency_{ config.latencyTarget, 256 } {
+	for (const auto& [coord, bytes] : this->source->Cells()) {
+		cells[coord].bytes = bytes;
+	}
+	for (usize i = 0; i < std::max<usize>(config.threads, 1); ++i) {
+		threads.emplace_back([this]() { LoaderLoop(); });
+	}
+}
+
+WorldPartition::~WorldPartition() noexcept {
+	{
+		std::lock_guard lock{mutex};
+		stopping = true;
+	}
+	cv.notify_all();
+	for (auto& thread : threads) thread.join();
+}
+
+void WorldPartition::LoaderLoop() {
+	HOENGINE_PROFILE_THREAD("Streaming");
+	while (true) {
+		CellCoord coord;
+		{
+			std::unique_lock lock{mutex};
+			cv.wait(lock, [&]() { return stopping || !requests.empty(); });
+			if (stopping) return;
+			coord = requests.front();
+			requests.pop_front();
+		}
+
+		std::unique_ptr<EntitiesStorage> storage;
+		{
+			HOENGINE_PROFILE_SCOPE("WorldPartition::LoadCell");
+			try {
+				auto snapshot = source->Load(coord);
+				if (snapshot && !snapshot->isDiff()) {
+					storage = std::make_unique<EntitiesStorage>();
+					snapshot->Restore(*storage);
+				}
+			} catch (const std::exception&) {
+				storage.reset();
+			}
+		}
+
+		std::lock_guard lock{mutex};
+		results.push_back(LoadResult{ coord, std::move(storage) });
+	}
+}
+
+CellCoord WorldPartition::CellOf(const glm::vec3& pos) const {
+	return CellCoord{
+		static_cast<i32>(std::floor(pos.x / config.cellSize)),
+		static_cast<i32>(std::floor(pos.z / config.cellSize)),
+	};
+}
+
+bool WorldPartition::IsResident(CellCoord coord) const {
+	auto it = cells.find(coord);
+	return it != cells.end() && it->second.state == CellState::Resident;
+}
+
+f32 WorldPartition::DistanceTo(CellCoord coord, const glm::vec3& focus) const {
+	// Distance to the closest point of the cell, 0 inside it
+	auto minX = static_cast<f32>(coord.x) * config.cellSize;
+	auto minZ = static_cast<f32>(coord.z) * config.cellSize;
+	auto dx = std::max({ minX - focus.x, 0.0f, focus.x - (minX + config.cellSize) });
+	auto dz = std::max({ minZ - focus.z, 0.0f, focus.z - (minZ + config.cellSize) });
+	return std::sqrt(dx * dx + dz * dz);
+}
+
+void WorldPartition::CollectResults() {
+	std::vector<LoadResult> finished;
+	{
+		std::lock_guard lock{mutex};
+		finished.swap(results);
+	}
+
+	for (auto& result : finished) {
+		auto& cell = cells[result.coord];
+		// Cancelled, or a duplicate of a load that already finished
+		if (cell.state != CellState::Loading) continue;
+
+		stats_.bytesInFlight -= cell.bytes;
+		--stats_.loadingCells;
+		if (!result.storage) {
+			++stats_.failures;
+			cell.state = CellState::Unloaded;
+			cell.failed = true;
+			continue;
+		}
+		cell.state = CellState::Staged;
+		cell.staged = std::move(result.storage);
+		cell.nextStaged = 0;
+		stats_.residentBytes += cell.bytes;
+		++stats_.stagedCells;
+	}
+}
+
+void WorldPartition::Request(CellCoord coord, Cell& cell) {
+	cell.state = CellState::Loading;
+	cell.requested = std::chrono::steady_clock::now();
+	stats_.bytesInFlight += cell.bytes;
+	++stats_.loadingCells;
+	{
+		std::lock_guard lock{mutex};
+		requests.push_back(coord);
+	}
+	cv.notify_one();
+}
+
+void WorldPartition::Unload(EntitiesStorage& world, Cell& cell) {
+	// Gameplay code may have destroyed some of them already, and their slots reused
+	for (const auto& id : cell.entities) {
+		if (world.Get(id)) world.Remove(id);
+	}
+	cell.entities.clear();
+	cell.staged.reset();
+
+	if (cell.state == CellState::Staged) --stats_.stagedCells;
+	if (cell.state == CellState::Resident) --stats_.residentCells;
+	stats_.residentBytes -= cell.bytes;
+	++stats_.unloads;
+	cell.state = CellState::Unloaded;
+}
+
+void WorldPartition::Update(EntitiesStorage& world) {
+	auto focus = CameraPosition(world);
+	if (focus) Update(world, *focus);
+}
+
+void WorldPartition::Update(EntitiesStorage& world, const glm::vec3& focus) {
+	HOENGINE_PROFILE_SCOPE("WorldPartition::Update");
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<f64>(config.integrationBudget));
+	CollectResults();
+
+	auto unloadRadius = config.loadRadius + config.hysteresis;
+	for (auto& [coord, cell] : cells) cell.distance = DistanceTo(coord, focus);
+
+	// Drop what went out of range, pending loads first since they are free to cancel
+	for (auto& [coord, cell] : cells) {
+		if (cell.distance <= unloadRadius || cell.state != CellState::Loading) continue;
+		cell.state = CellState::Unloaded;
+		stats_.bytesInFlight -= cell.bytes;
+		--stats_.loadingCells;
+		++stats_.cancelled;
+		std::lock_guard lock{mutex};
+		auto queued = std::find(requests.begin(), requests.end(), coord);
+		if (queued != requests.end()) requests.erase(queued);
+	}
+	for (auto& [coord, cell] : cells) {
+		if (std::chrono::steady_clock::now() > deadline) break;
+		if (cell.distance <= unloadRadius) continue;
+		if (cell.state == CellState::Staged || cell.state == CellState::Resident) Unload(world, cell);
+	}
+
+	// Request missing cells nearest first, within the memory budget
+	std::vector<std::pair<f32, CellCoord>> candidates;
+	std::vector<std::pair<f32, CellCoord>> evictable;
+	for (const auto& [coord, cell] : cells) {
+		if (cell.state == CellState::Unloaded && !cell.failed && cell.distance <= config.loadRadius) {
+			candidates.push_back({cell.distance, coord});
+		} else if (cell.state == CellState::Resident && cell.distance > config.loadRadius) {
+			evictable.push_back({cell.distance, coord});
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+	// Farthest last, so they are popped first
+	std::sort(evictable.begin(), evictable.end());
+	for (const auto& [distance, coord] : candidates) {
+		if (stats_.loadingCells >= config.maxInFlight) break;
+		auto& cell = cells[coord];
+		while (stats_.residentBytes + stats_.bytesInFlight + cell.bytes > config.memoryBudget && !evictable.empty()) {
+			Unload(world, cells[evictable.back().second]);
+			evictable.pop_back();
+		}
+		// Farther cells wouldn't fit either, or would jump the queue
+		if (stats_.residentBytes + stats_.bytesInFlight + cell.bytes > config.memoryBudget) break;
+		Request(coord, cell);
+	}
+
+	// Move decoded cells into the world, nearest first, within the time budget
+	std::vector<std::pair<f32, CellCoord>> staged;
+	for (const auto& [coord, cell] : cells) {
+		if (cell.state == CellState::Staged) staged.push_back({cell.distance, coord});
+	}
+	std::sort(staged.begin(), staged.end());
+	usize moved = 0;
+	bool outOfTime = false;
+	for (const auto& [distance, coord] : staged) {
+		auto& cell = cells[coord];
+		auto& source = *cell.staged;
+		for (; cell.nextStaged < source.Capacity(); ++cell.nextStaged) {
+			if (++moved % budgetCheckInterval == 0 && std::chrono::steady_clock::now() > deadline) {
+				outOfTime = true;
+				break;
+			}
+			auto entity = source.At(cell.nextStaged);
+			if (entity) cell.entities.push_back(world.Add(std::move(*entity)));
+		}
+		if (outOfTime) break;
+
+		cell.staged.reset();
+		cell.state = CellState::Resident;
+		--stats_.stagedCells;
+		++stats_.residentCells;
+		++stats_.loads;
+		loadLatency_.Record(std::chrono::duration<f64>(std::chrono::steady_clock::now() - cell.requested).count());
+	}
+
+	HOENGINE_PROFILE_COUNTER("Resident cells", stats_.residentCells);
+	HOENGINE_PROFILE_COUNTER("Streaming bytes in flight", stats_.bytesInFlight);
+}
+
+void WorldPartition::UnloadAll(EntitiesStorage& world) {
+	{
+		std::lock_guard lock{mutex};
+		requests.clear();
+	}
+	CollectResults();
+	for (auto& [coord, cell] : cells) {
+		if (cell.state == CellState::Loading) {
+			cell.state = CellState::Unloaded;
+			stats_.bytesInFlight -= cell.bytes;
+			--stats_.loadingCells;
+			++stats_.cancelled;
+		} else if (cell.state != CellState::Unloaded) {
+			Unload(world, cell);
+		}
+	}
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <chrono>
+#include <compare>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Entity.hpp"
+#include "FramePipeline.hpp"
+#include "Snapshot.hpp"
+
+namespace HOEngine {
+
+/// Cell of the world partition grid, on the XZ plane.
+struct CellCoord {
+	i32 x;
+	i32 z;
+
+	auto operator<=>(const CellCoord&) const = default;
+};
+
+/// Where the serialized cells of a world come from. Each cell is a full `Snapshot`
+/// of the entities inside it.
+class CellSource {
+public:
+	virtual ~CellSource() noexcept = default;
+
+	/// Every cell with content, along with its serialized size in bytes.
+	virtual std::vector<std::pair<CellCoord, usize>> Cells() const = 0;
+	/// Snapshot of the given cell, `std::nullopt` on failure. Called from the
+	/// streaming threads, possibly several at once.
+	virtual std::optional<Snapshot> Load(CellCoord coord) = 0;
+};
+
+/// Cells held in memory, e.g. straight out of `WorldPartition::Split`. Can
+/// simulate IO latency for testing streaming without any files.
+class MemoryCellSource : public CellSource {
+private:
+	std::map<CellCoord, std::vector<std::byte>> cells;
+	std::chrono::duration<f64> latency;
+
+public:
+	explicit MemoryCellSource(std::map<CellCoord, std::vector<std::byte>> cells, std::chrono::duration<f64> latency = {});
+
+	std::vector<std::pair<CellCoord, usize>> Cells() const override;
+	std::optional<Snapshot> Load(CellCoord coord) override;
+};
+
+/// Cells stored as `cell_<x>_<z>.snap` files in a directory, memory mapped on load.
+class DirectoryCellSource : public CellSource {
+private:
+	std::string directory;
+	std::vector<std::pair<CellCoord, usize>> cells;
+
+public:
+	/// Write `cells` to `directory` in the layout this source reads.
+	static bool Write(const std::string& directory, const std::map<CellCoord, std::vector<std::byte>>& cells);
+
+	explicit DirectoryCellSource(std::string directory);
+
+	std::vector<std::pair<CellCoord, usize>> Cells() const override { return cells; }
+	std::optional<Snapshot> Load(CellCoord coord) override;
+
+private:
+	std::string PathOf(CellCoord coord) const;
+};
+
+/// Streams grid cells of a world in and out of an `EntitiesStorage` around a focus
+/// point, usually the camera.
+///
+/// Cells within `loadRadius` are requested nearest first, decoded on streaming
+/// threads, then moved into the world by `Update` within a time budget. Cells are
+/// only unloaded once farther than `loadRadius + hysteresis`, so moving back and
+/// forth over a cell border doesn't thrash. Serialized sizes are used as memory
+/// estimate: loads never push resident plus in flight bytes over the budget,
+/// evicting cells in the hysteresis band first if needed.
+///
+/// Entities stay owned by the cell they were loaded with, and are removed from the
+/// world along with it. `Update` and `UnloadAll` must be called from a single thread.
+class WorldPartition {
+public:
+	struct Config {
+		f32 cellSize = 64.0f;
+		f32 loadRadius = 192.0f;
+		/// Extra distance before loaded cells are unloaded.
+		f32 hysteresis = 32.0f;
+		usize memoryBudget = 256 * 1024 * 1024;
+		usize maxInFlight = 4;
+		/// Time `Update` may spend moving entities in and out of the world, in seconds.
+		f64 integrationBudget = 0.002;
+		/// Load latency considered too slow, for `loadLatency().missed()`.
+		f64 latencyTarget = 0.5;
+		usize threads = 1;
+	};
+
+	struct Stats {
+		usize residentCells = 0;
+		/// Requested cells not yet decoded.
+		usize loadingCells = 0;
+		/// Decoded cells waiting for or being moved into the world.
+		usize stagedCells = 0;
+		usize residentBytes = 0;
+		usize bytesInFlight = 0;
+		u64 loads = 0;
+		u64 unloads = 0;
+		/// Loads dropped because the cell went out of range first.
+		u64 cancelled = 0;
+		u64 failures = 0;
+	};
+
+private:
+	enum class CellState {
+		Unloaded,
+		Loading,
+		Staged,
+		Resident,
+	};
+
+	struct Cell {
+		CellState state = CellState::Unloaded;
+		usize bytes = 0;
+		f32 distance = 0;
+		/// Failed to load once, not requested again.
+		bool failed = false;
+		std::chrono::steady_clock::time_point requested;
+		/// Decoded cell, drained into the world by `Update`.
+		std::unique_ptr<EntitiesStorage> staged;
+		usize nextStaged = 0;
+		std::vector<EntityID> entities;
+	};
+
+	struct LoadResult {
+		CellCoord coord;
+		std::unique_ptr<EntitiesStorage> storage;
+	};
+
+	Config config;
+	std::unique_ptr<CellSource> source;
+	std::map<CellCoord, Cell> cells;
+	Stats stats_;
+	FramePacingStats loadLatency_;
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<CellCoord> requests;
+	std::vector<LoadResult> results;
+	bool stopping = false;
+
+public:
+	/// Split the entities of `world` with a `TransformComponent` into cells, and
+	/// serialize each. The world itself is left untouched.
+	static std::map<CellCoord, std::vector<std::byte>> Split(EntitiesStorage& world, f32 cellSize);
+	/// Position of the first entity with both a camera and a transform.
+	static std::optional<glm::vec3> CameraPosition(EntitiesStorage& world);
+
+	WorldPartition(std::unique_ptr<CellSource> source, Config config);
+	~WorldPartition() noexcept;
+	WorldPartition(const WorldPartition&) = delete;
+	WorldPartition& operator=(const WorldPartition&) = delete;
+
+	/// Stream around the camera found by `CameraPosition`, if any.
+	void Update(EntitiesStorage& world);
+	/// Stream around `focus`.
+	void Update(EntitiesStorage& world, const glm::vec3& focus);
+	/// Remove every resident cell from the world and drop pending loads.
+	void UnloadAll(EntitiesStorage& world);
+
+	CellCoord CellOf(const glm::vec3& pos) const;
+	bool IsResident(CellCoord coord) const;
+	const Stats& stats() const { return stats_; }
+	/// Seconds from requesting a cell to it being fully in the world.
+	const FramePacingStats& loadLatency() const { return loadLatency_; }
+
+private:
+	void LoaderLoop();
+	f32 DistanceTo(CellCoord coord, const glm::vec3& focus) const;
+	void CollectResults();
+	void Request(CellCoord coord, Cell& cell);
+	void Unload(EntitiesStorage& world, Cell& cell);
+};
+
+} // namespace HOEngine
@@ -0,0 +1,135 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory_resource>
+#include <stdexcept>
+#include "Animation.hpp"
+#include "Arena.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "Simd.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	void Evaluate(AnimatorComponent& animator) {
+		// Poses live in the thread's scratch arena, declared first so it outlives them
+		ScratchArena scratch;
+		const auto& skeleton = *animator.skeleton;
+		auto groups = BoneGroupCount(skeleton.boneCount());
+		std::pmr::vector<BoneGroup> pose(groups, scratch.resource());
+		std::pmr::vector<BoneGroup> layerPose(groups, scratch.resource());
+		std::pmr::vector<glm::mat4> model(skeleton.boneCount(), scratch.resource());
+
+		bool posed = false;
+		for (const auto& layer : animator.layers) {
+			if (!layer.clip || !(layer.weight > 0.0f)) continue;
+			if (layer.weight >= 1.0f) {
+				// Replaces everything below, no need to blend
+				layer.clip->Sample(layer.time, layer.loop, pose);
+			} else {
+				if (!posed) skeleton.RestPose(pose);
+				layer.clip->Sample(layer.time, layer.loop, layerPose);
+				BlendPoses(pose, layerPose, layer.weight);
+			}
+			posed = true;
+		}
+		if (!posed) skeleton.RestPose(pose);
+		skeleton.ComputePalette(pose, model, animator.palette);
+	}
+}
+
+void SkinnedMeshComponent::RecomputeBounds() {
+	bounds = AABB{};
+	for (const auto& vert : vertices) {
+		bounds.Extend(vert.pos);
+	}
+}
+
+AnimationSystem::AnimationSystem(Config config)
+	: config{ config } {
+}
+
+void AnimationSystem::Update(ThreadPool& pool, EntitiesStorage& storage, f32 dt) {
+	HOENGINE_PROFILE_SCOPE("AnimationSystem::Update");
+	auto start = std::chrono::steady_clock::now();
+	animators.clear();
+	stats_.bones = 0;
+	for (usize idx = 0; idx < storage.Capacity(); ++idx) {
+		auto entity = storage.At(idx);
+		if (!entity) continue;
+		auto animator = entity->GetComponent<AnimatorComponent>();
+		if (!animator || !animator->skeleton) continue;
+		auto bones = animator->skeleton->boneCount();
+		for (const auto& layer : animator->layers) {
+			if (layer.clip && layer.clip->boneCount() != bones) {
+				throw std::runtime_error("Animation clip doesn't match the bone count of its skeleton");
+			}
+		}
+		animators.push_back(animator);
+		stats_.bones += bones;
+	}
+
+	for (auto animator : animators) {
+		animator->palette.resize(animator->skeleton->boneCount());
+		for (auto& layer : animator->layers) {
+			if (!layer.clip) continue;
+			layer.time += dt * layer.speed;
+			// Wrap here too, so the time keeps its precision however long the clip plays
+			auto duration = layer.clip->duration();
+			if (layer.loop && duration > 0.0f) {
+				layer.time = std::fmod(layer.time, duration);
+				if (layer.time < 0.0f) layer.time += duration;
+			}
+		}
+	}
+
+	pool.ParallelFor(animators.size(), config.characterGrain, [&](usize begin, usize end) {
+		for (auto i = begin; i < end; ++i) Evaluate(*animators[i]);
+	});
+	stats_.characters = animators.size();
+	HOENGINE_PROFILE_COUNTER("Animated bones", stats_.bones);
+	stats_.updateTime = MillisecondsSince(start);
+}
+
+void AnimationSystem::Skin(ThreadPool& pool, const SkinnedMeshComponent& mesh, std::span<const glm::mat4> palette, std::span<SimpleVertex> out) {
+	HOENGINE_PROFILE_SCOPE("AnimationSystem::Skin");
+	auto start = std::chrono::steady_clock::now();
+	if (out.size() < mesh.vertices.size()) throw std::runtime_error("Skinning output is smaller than the mesh");
+
+	std::atomic<bool> outOfRange{ false };
+	pool.ParallelFor(mesh.vertices.size(), config.vertexGrain, [&](usize begin, usize end) {
+		for (auto i = begin; i < end; ++i) {
+			const auto& vert = mesh.vertices[i];
+			if (vert.bones[0] >= palette.size() || vert.bones[1] >= palette.size() ||
+				vert.bones[2] >= palette.size() || vert.bones[3] >= palette.size()) {
+				outOfRange.store(true, std::memory_order_relaxed);
+				continue;
+			}
+
+			// Weighted sum of the bone matrices, by column
+			F32x4 columns[4];
+			for (i32 c = 0; c < 4; ++c) {
+				columns[c] = F32x4::LoadUnaligned(&palette[vert.bones[0]][c][0]) * F32x4::Set1(vert.weights[0]);
+				for (i32 b = 1; b < 4; ++b) {
+					columns[c] = MulAdd(F32x4::LoadUnaligned(&palette[vert.bones[b]][c][0]), F32x4::Set1(vert.weights[b]), columns[c]);
+				}
+			}
+			auto pos = MulAdd(columns[0], F32x4::Set1(vert.pos.x),
+				MulAdd(columns[1], F32x4::Set1(vert.pos.y), MulAdd(columns[2], F32x4::Set1(vert.pos.z), columns[3])));
+			auto normal = MulAdd(columns[0], F32x4::Set1(vert.normal.x),
+				MulAdd(columns[1], F32x4::Set1(vert.normal.y), columns[2] * F32x4::Set1(vert.normal.z)));
+
+			alignas(16) f32 p[4];
+			alignas(16) f32 n[4];
+			pos.Store(p);
+			normal.Store(n);
+			auto length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			auto scale = length > 0.0f ? 1.0f / length : 0.0f;
+			out[i] = SimpleVertex{ glm::vec3(p[0], p[1], p[2]), glm::vec3(n[0] * scale, n[1] * scale, n[2] * scale), vert.uv };
+		}
+	});
+	stats_.vertices = mesh.vertices.size();
+	stats_.skinTime = MillisecondsSince(start);
+	if (outOfRange.load()) throw std::runtime_error("Skinned vertex refers to a bone outside the palette");
+}
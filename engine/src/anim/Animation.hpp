@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "Entity.hpp"
+#include "ThreadPool.hpp"
+#include "AnimationClip.hpp"
+#include "Skeleton.hpp"
+
+namespace HOEngine {
+
+/// Mesh deformed by the palette of its entity's `AnimatorComponent`, on the GPU
+/// through `SkinnedVertex::SetupPointers`, or on the CPU with `AnimationSystem::Skin`.
+class SkinnedMeshComponent : public ComponentUUIDMixin<0x0dda5498197773bb, 0xc2f410c26b313880> {
+public:
+	std::vector<SkinnedVertex> vertices;
+	std::vector<GLuint> indices;
+	/// Bounds of `vertices` in the bind pose.
+	AABB bounds;
+
+public:
+	virtual ~SkinnedMeshComponent() noexcept = default;
+	ComponentPtr<SkinnedMeshComponent> Clone() const { return MakeComponent<SkinnedMeshComponent>(*this); }
+
+	void RecomputeBounds();
+
+protected:
+	virtual ComponentPtr<Component> CloneImpl() const override { return Clone(); }
+};
+
+/// Plays up to `maxLayers` clips on a skeleton, each blended over the ones before
+/// it, starting from the rest pose. Clips are shared between characters.
+class AnimatorComponent : public ComponentUUIDMixin<0x006103bff47db180, 0x565fb1cfde56c83a> {
+public:
+	static constexpr usize maxLayers = 4;
+
+	struct Layer {
+		/// `nullptr` for unused layers.
+		std::shared_ptr<const AnimationClip> clip;
+		/// Playback position, in seconds.
+		f32 time = 0.0f;
+		f32 speed = 1.0f;
+		/// 1 replaces the layers below, 0 disables the layer.
+		f32 weight = 1.0f;
+		bool loop = true;
+	};
+
+	std::shared_ptr<const Skeleton> skeleton;
+	std::array<Layer, maxLayers> layers;
+	/// Skinning matrix of each bone as of the last `AnimationSystem::Update`,
+	/// ready for `glUniformMatrix4fv`.
+	std::vector<glm::mat4> palette;
+
+public:
+	virtual ~AnimatorComponent() noexcept = default;
+	ComponentPtr<AnimatorComponent> Clone() const { return MakeComponent<AnimatorComponent>(*this); }
+
+protected:
+	virtual ComponentPtr<Component> CloneImpl() const override { return Clone(); }
+};
+
+/// Advances every `AnimatorComponent` and evaluates its palette.
+///
+/// Characters are independent, so they are split across the pool. Each samples
+/// its layers into poses of `BoneGroup`s living in the thread's scratch arena,
+/// blends them and resolves the hierarchy, all four bones at a time; the only
+/// allocations are palettes changing size.
+class AnimationSystem {
+public:
+	struct Config {
+		/// Characters per job in `Update`.
+		usize characterGrain = 4;
+		/// Vertices per job in `Skin`.
+		usize vertexGrain = 4096;
+	};
+
+	struct Stats {
+		usize characters = 0;
+		usize bones = 0;
+		/// Vertices of the last `Skin`.
+		usize vertices = 0;
+		/// CPU time of the last `Update` and `Skin`, in milliseconds.
+		f64 updateTime = 0;
+		f64 skinTime = 0;
+	};
+
+private:
+	Config config;
+	std::vector<AnimatorComponent*> animators;
+	Stats stats_;
+
+public:
+	explicit AnimationSystem(Config config);
+	AnimationSystem() : AnimationSystem(Config{}) {}
+
+	/// Advance the layers of every animator by `dt` seconds and evaluate their
+	/// palettes. Throws, before touching any animator, if a clip was compressed
+	/// for a different number of bones than its animator's skeleton.
+	void Update(ThreadPool& pool, EntitiesStorage& storage, f32 dt);
+
+	/// Deform `mesh` by `palette` on the CPU, into `out` which holds as many
+	/// vertices as the mesh. Normals are renormalized. Throws if a vertex refers to
+	/// a bone outside the palette, such vertices are left untouched in `out`.
+	void Skin(ThreadPool& pool, const SkinnedMeshComponent& mesh, std::span<const glm::mat4> palette, std::span<SimpleVertex> out);
+
+	const Stats& stats() const { return stats_; }
+};
+
+} // namespace HOEngine
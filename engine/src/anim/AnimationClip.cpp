@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include "AnimationClip.hpp"
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	constexpr char magic[8] = { 'H', 'O', 'C', 'L', 'I', 'P', 0, 0 };
+	constexpr u32 version = 1;
+	constexpr u32 maxFrames = 65536;
+	constexpr f32 quantizationLevels = 65535.0f;
+
+	struct Header {
+		char magic[8];
+		u32 version;
+		f32 frameRate;
+		u32 frameCount;
+		u32 boneCount;
+		u64 trackCount;
+		u64 keyCount;
+	};
+
+	/// Components of each track kind, and their rows in the sampling tables.
+	constexpr u32 componentCount[3] = { 3, 4, 3 };
+	constexpr u32 firstRow[3] = { 0, 3, 7 };
+	constexpr u32 rowCount = 10;
+
+	f32 MaxError(const glm::vec4& a, const glm::vec4& b) {
+		auto d = glm::abs(a - b);
+		return std::max(std::max(d.x, d.y), std::max(d.z, d.w));
+	}
+}
+
+AnimationClip AnimationClip::Compress(const RawClip& raw, const CompressionSettings& settings) {
+	HOENGINE_PROFILE_SCOPE("AnimationClip::Compress");
+	if (raw.frameCount == 0 || raw.frameCount > maxFrames) {
+		throw std::runtime_error("Clips must have between 1 and 65536 frames");
+	}
+	if (!(raw.frameRate > 0.0f)) throw std::runtime_error("Clip frame rate must be positive");
+	for (const auto& track : raw.tracks) {
+		if (track.size() != raw.frameCount) throw std::runtime_error("Clip track size doesn't match its frame count");
+	}
+
+	AnimationClip clip;
+	clip.frameRate_ = raw.frameRate;
+	clip.frameCount_ = raw.frameCount;
+	clip.boneCount_ = static_cast<u32>(raw.tracks.size());
+	clip.tracks.reserve(raw.tracks.size() * 3);
+
+	// Reused across tracks
+	std::vector<glm::vec4> source(raw.frameCount);
+	std::vector<glm::vec4> quantized(raw.frameCount);
+	std::vector<std::array<u16, 4>> values(raw.frameCount);
+	std::vector<bool> keep(raw.frameCount);
+	std::vector<std::pair<u32, u32>> segments;
+	const f32 tolerances[3] = { settings.translationTolerance, settings.rotationTolerance, settings.scaleTolerance };
+
+	for (const auto& bone : raw.tracks) {
+		for (u32 kind = 0; kind < 3; ++kind) {
+			for (u32 f = 0; f < raw.frameCount; ++f) {
+				const auto& t = bone[f];
+				if (kind == 0) {
+					source[f] = glm::vec4(t.translation, 0.0f);
+				} else if (kind == 1) {
+					auto q = glm::normalize(t.rotation);
+					source[f] = glm::vec4(q.x, q.y, q.z, q.w);
+					// Keep consecutive rotations on the same hemisphere so they interpolate
+					if (f > 0 && glm::dot(source[f], source[f - 1]) < 0.0f) source[f] = -source[f];
+				} else {
+					source[f] = glm::vec4(t.scale, 0.0f);
+				}
+			}
+
+			Track track;
+			track.min = source[0];
+			auto max = source[0];
+			for (const auto& v : source) {
+				track.min = glm::min(track.min, v);
+				max = glm::max(max, v);
+			}
+			auto range = max - track.min;
+			track.step = range / quantizationLevels;
+			for (u32 f = 0; f < raw.frameCount; ++f) {
+				for (i32 c = 0; c < 4; ++c) {
+					auto q = track.step[c] > 0.0f ? std::round((source[f][c] - track.min[c]) / track.step[c]) : 0.0f;
+					values[f][c] = static_cast<u16>(std::clamp(q, 0.0f, quantizationLevels));
+					quantized[f][c] = track.min[c] + static_cast<f32>(values[f][c]) * track.step[c];
+				}
+			}
+
+			// Keep the frames the interpolated curve can't do without, largest error first
+			auto tolerance = tolerances[kind];
+			auto last = raw.frameCount - 1;
+			std::fill(keep.begin(), keep.end(), false);
+			keep[0] = true;
+			if (std::max(std::max(range.x, range.y), std::max(range.z, range.w)) > tolerance) {
+				keep[last] = true;
+				segments.assign(1, { 0, last });
+				while (!segments.empty()) {
+					auto [begin, end] = segments.back();
+					segments.pop_back();
+					f32 worst = tolerance;
+					u32 split = 0;
+					for (auto f = begin + 1; f < end; ++f) {
+						auto alpha = static_cast<f32>(f - begin) / static_cast<f32>(end - begin);
+						auto error = MaxError(glm::mix(quantized[begin], quantized[end], alpha), source[f]);
+						if (error > worst) {
+							worst = error;
+							split = f;
+						}
+					}
+					if (split == 0) continue;
+					keep[split] = true;
+					segments.push_back({ begin, split });
+					segments.push_back({ split, end });
+				}
+			}
+
+			track.firstKey = static_cast<u32>(clip.keyFrames.size());
+			for (u32 f = 0; f < raw.frameCount; ++f) {
+				if (!keep[f]) continue;
+				clip.keyFrames.push_back(static_cast<u16>(f));
+				clip.keyValues.push_back(values[f]);
+			}
+			track.keyCount = static_cast<u32>(clip.keyFrames.size()) - track.firstKey;
+			clip.tracks.push_back(track);
+		}
+	}
+	return clip;
+}
+
+void AnimationClip::Sample(f32 time, bool loop, std::span<BoneGroup> pose) const {
+	auto last = static_cast<f32>(frameCount_ - 1);
+	auto position = time * frameRate_;
+	if (loop && last > 0.0f) {
+		position = std::fmod(position, last);
+		if (position < 0.0f) position += last;
+	}
+	position = std::clamp(position, 0.0f, last);
+
+	// Identity for the lanes past the last bone: zero translation, unit w and scale
+	constexpr f32 identity[rowCount] = { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1 };
+	for (usize g = 0; g < pose.size(); ++g) {
+		// Quantized keys around `position`, and how to dequantize them, per lane
+		alignas(16) f32 from[rowCount][4], to[rowCount][4], min[rowCount][4], step[rowCount][4];
+		alignas(16) f32 alpha[3][4];
+		for (u32 lane = 0; lane < 4; ++lane) {
+			auto bone = g * 4 + lane;
+			for (u32 kind = 0; kind < 3; ++kind) {
+				auto row = firstRow[kind];
+				if (bone >= boneCount_) {
+					alpha[kind][lane] = 0.0f;
+					for (u32 c = 0; c < componentCount[kind]; ++c) {
+						from[row + c][lane] = to[row + c][lane] = step[row + c][lane] = 0.0f;
+						min[row + c][lane] = identity[row + c];
+					}
+					continue;
+				}
+
+				const auto& track = tracks[bone * 3 + kind];
+				auto frames = keyFrames.data() + track.firstKey;
+				auto next = static_cast<u32>(std::upper_bound(frames, frames + track.keyCount, position,
+					[](f32 p, u16 frame) { return p < static_cast<f32>(frame); }) - frames);
+				auto k1 = std::min(next, track.keyCount - 1);
+				auto k0 = next > 0 ? next - 1 : 0;
+				alpha[kind][lane] = k0 == k1 ? 0.0f :
+					(position - static_cast<f32>(frames[k0])) / static_cast<f32>(frames[k1] - frames[k0]);
+				const auto& a = keyValues[track.firstKey + k0];
+				const auto& b = keyValues[track.firstKey + k1];
+				for (u32 c = 0; c < componentCount[kind]; ++c) {
+					from[row + c][lane] = static_cast<f32>(a[c]);
+					to[row + c][lane] = static_cast<f32>(b[c]);
+					min[row + c][lane] = track.min[c];
+					step[row + c][lane] = track.step[c];
+				}
+			}
+		}
+
+		F32x4 rows[rowCount];
+		for (u32 kind = 0; kind < 3; ++kind) {
+			auto t = F32x4::Load(alpha[kind]);
+			for (u32 c = 0; c < componentCount[kind]; ++c) {
+				auto row = firstRow[kind] + c;
+				auto a = F32x4::Load(from[row]);
+				auto q = MulAdd(F32x4::Load(to[row]) - a, t, a);
+				rows[row] = MulAdd(q, F32x4::Load(step[row]), F32x4::Load(min[row]));
+			}
+		}
+		auto& out = pose[g];
+		out.tx = rows[0];
+		out.ty = rows[1];
+		out.tz = rows[2];
+		auto invLength = F32x4::Set1(1.0f) / Sqrt(MulAdd(rows[3], rows[3], MulAdd(rows[4], rows[4], MulAdd(rows[5], rows[5], rows[6] * rows[6]))));
+		out.qx = rows[3] * invLength;
+		out.qy = rows[4] * invLength;
+		out.qz = rows[5] * invLength;
+		out.qw = rows[6] * invLength;
+		out.sx = rows[7];
+		out.sy = rows[8];
+		out.sz = rows[9];
+	}
+}
+
+void AnimationClip::Serialize(std::vector<std::byte>& out) const {
+	Header header;
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.frameRate = frameRate_;
+	header.frameCount = frameCount_;
+	header.boneCount = boneCount_;
+	header.trackCount = tracks.size();
+	header.keyCount = keyFrames.size();
+
+	auto append = [&](const void* data, usize size) {
+		auto offset = out.size();
+		out.resize(offset + size);
+		if (size > 0) std::memcpy(out.data() + offset, data, size);
+	};
+	append(&header, sizeof(header));
+	append(tracks.data(), tracks.size() * sizeof(Track));
+	append(keyFrames.data(), keyFrames.size() * sizeof(u16));
+	append(keyValues.data(), keyValues.size() * sizeof(keyValues[0]));
+}
+
+std::optional<AnimationClip> AnimationClip::Deserialize(std::span<const std::byte> data) {
+	Header header;
+	if (data.size() < sizeof(header)) return {};
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version) return {};
+	if (header.frameCount == 0 || header.frameCount > maxFrames || !(header.frameRate > 0.0f)) return {};
+	if (header.trackCount != u64{ header.boneCount } * 3) return {};
+	auto keyBytes = sizeof(u16) + sizeof(std::array<u16, 4>);
+	auto remaining = data.size() - sizeof(header);
+	if (header.trackCount > remaining / sizeof(Track)) return {};
+	if (header.keyCount > (remaining - header.trackCount * sizeof(Track)) / keyBytes) return {};
+
+	AnimationClip clip;
+	clip.frameRate_ = header.frameRate;
+	clip.frameCount_ = header.frameCount;
+	clip.boneCount_ = header.boneCount;
+	clip.tracks.resize(header.trackCount);
+	clip.keyFrames.resize(header.keyCount);
+	clip.keyValues.resize(header.keyCount);
+	auto read = data.data() + sizeof(header);
+	auto take = [&](void* target, usize size) {
+		if (size > 0) std::memcpy(target, read, size);
+		read += size;
+	};
+	take(clip.tracks.data(), clip.tracks.size() * sizeof(Track));
+	take(clip.keyFrames.data(), clip.keyFrames.size() * sizeof(u16));
+	take(clip.keyValues.data(), clip.keyValues.size() * sizeof(clip.keyValues[0]));
+
+	for (const auto& track : clip.tracks) {
+		if (track.keyCount == 0 || track.firstKey > header.keyCount || track.keyCount > header.keyCount - track.firstKey) return {};
+		for (u32 k = 0; k < track.keyCount; ++k) {
+			auto frame = clip.keyFrames[track.firstKey + k];
+			if (frame >= header.frameCount) return {};
+			if (k > 0 && frame <= clip.keyFrames[track.firstKey + k - 1]) return {};
+		}
+	}
+	return clip;
+}
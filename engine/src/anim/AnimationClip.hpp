@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Skeleton.hpp"
+
+namespace HOEngine {
+
+/// Uncompressed clip, as exported: every bone sampled at every frame.
+struct RawClip {
+	f32 frameRate = 30.0f;
+	u32 frameCount = 0;
+	/// `tracks[bone][frame]`, one track per bone of the skeleton.
+	std::vector<std::vector<BoneTransform>> tracks;
+};
+
+/// Keyframe clip compressed for playback of many characters at once.
+///
+/// The translation, rotation and scale of each bone are separate tracks, each
+/// quantized to 16 bits per component over the track's own range. Keys are then
+/// fitted to the quantized curve: a frame is only kept when linear interpolation
+/// between its neighbours strays further than the channel's tolerance from the
+/// source, so static or linear motion costs two keys however long the clip is.
+/// Constant tracks keep a single key.
+///
+/// `Sample` finds the keys around the sample time for each bone, then dequantizes,
+/// interpolates and normalizes four bones at a time.
+class AnimationClip {
+public:
+	struct CompressionSettings {
+		/// Largest error allowed, in model units for translations and scales,
+		/// per quaternion component for rotations.
+		f32 translationTolerance = 1e-3f;
+		f32 rotationTolerance = 1e-4f;
+		f32 scaleTolerance = 1e-3f;
+	};
+
+private:
+	struct Track {
+		glm::vec4 min;
+		/// Value of one quantization step per component.
+		glm::vec4 step;
+		u32 firstKey;
+		u32 keyCount;
+	};
+
+	f32 frameRate_ = 30.0f;
+	u32 frameCount_ = 0;
+	u32 boneCount_ = 0;
+	/// Translation, rotation and scale of each bone.
+	std::vector<Track> tracks;
+	/// Frame of each key, ascending within a track.
+	std::vector<u16> keyFrames;
+	std::vector<std::array<u16, 4>> keyValues;
+
+public:
+	/// Throws if the tracks don't all hold `frameCount` samples, or if there are more
+	/// than 65536 frames.
+	static AnimationClip Compress(const RawClip& raw, const CompressionSettings& settings);
+	static AnimationClip Compress(const RawClip& raw) { return Compress(raw, CompressionSettings{}); }
+
+	/// Read a clip written by `Serialize`, or `std::nullopt` if `data` isn't one.
+	static std::optional<AnimationClip> Deserialize(std::span<const std::byte> data);
+	void Serialize(std::vector<std::byte>& out) const;
+
+	/// Pose at `time` seconds, wrapped around the clip if `loop`, clamped to it
+	/// otherwise. `pose` holds `BoneGroupCount(boneCount())` groups.
+	void Sample(f32 time, bool loop, std::span<BoneGroup> pose) const;
+
+	f32 duration() const { return frameCount_ > 1 ? static_cast<f32>(frameCount_ - 1) / frameRate_ : 0.0f; }
+	f32 frameRate() const { return frameRate_; }
+	u32 frameCount() const { return frameCount_; }
+	u32 boneCount() const { return boneCount_; }
+	usize keyCount() const { return keyFrames.size(); }
+	/// Size of the compressed data, against `frameCount() * boneCount() * sizeof(BoneTransform)` raw.
+	usize byteSize() const { return tracks.size() * sizeof(Track) + keyFrames.size() * (sizeof(u16) + sizeof(keyValues[0])); }
+};
+
+} // namespace HOEngine
@@ -0,0 +1,218 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "Skeleton.hpp"
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	void SetLane(F32x4& value, u32 lane, f32 x) {
+		alignas(16) f32 lanes[4];
+		value.Store(lanes);
+		lanes[lane] = x;
+		value = F32x4::Load(lanes);
+	}
+
+	struct Columns {
+		F32x4 c[4];
+	};
+
+	Columns LoadColumns(const glm::mat4& m) {
+		return { F32x4::LoadUnaligned(&m[0][0]), F32x4::LoadUnaligned(&m[1][0]), F32x4::LoadUnaligned(&m[2][0]), F32x4::LoadUnaligned(&m[3][0]) };
+	}
+
+	void StoreColumns(const Columns& columns, glm::mat4& m) {
+		for (i32 c = 0; c < 4; ++c) columns.c[c].StoreUnaligned(&m[c][0]);
+	}
+
+	/// `a * b`, with `b` given by the elements of its columns.
+	Columns Multiply(const Columns& a, const f32 (&b)[4][4]) {
+		Columns result;
+		for (i32 c = 0; c < 4; ++c) {
+			result.c[c] = MulAdd(a.c[3], F32x4::Set1(b[c][3]), MulAdd(a.c[2], F32x4::Set1(b[c][2]),
+				MulAdd(a.c[1], F32x4::Set1(b[c][1]), a.c[0] * F32x4::Set1(b[c][0]))));
+		}
+		return result;
+	}
+
+	const Columns identityColumns{ {
+		F32x4::Set(1.0f, 0.0f, 0.0f, 0.0f), F32x4::Set(0.0f, 1.0f, 0.0f, 0.0f),
+		F32x4::Set(0.0f, 0.0f, 1.0f, 0.0f), F32x4::Set(0.0f, 0.0f, 0.0f, 1.0f),
+	} };
+}
+
+glm::mat4 BoneTransform::Matrix() const {
+	auto result = glm::mat4_cast(rotation);
+	result[0] = result[0] * scale.x;
+	result[1] = result[1] * scale.y;
+	result[2] = result[2] * scale.z;
+	result[3] = glm::vec4(translation, 1.0f);
+	return result;
+}
+
+BoneTransform BoneGroup::Get(u32 lane) const {
+	auto i = static_cast<i32>(lane);
+	return BoneTransform{
+		glm::vec3(tx.Lane(i), ty.Lane(i), tz.Lane(i)),
+		glm::quat(qw.Lane(i), qx.Lane(i), qy.Lane(i), qz.Lane(i)),
+		glm::vec3(sx.Lane(i), sy.Lane(i), sz.Lane(i)),
+	};
+}
+
+void BoneGroup::Set(u32 lane, const BoneTransform& transform) {
+	SetLane(tx, lane, transform.translation.x);
+	SetLane(ty, lane, transform.translation.y);
+	SetLane(tz, lane, transform.translation.z);
+	SetLane(qx, lane, transform.rotation.x);
+	SetLane(qy, lane, transform.rotation.y);
+	SetLane(qz, lane, transform.rotation.z);
+	SetLane(qw, lane, transform.rotation.w);
+	SetLane(sx, lane, transform.scale.x);
+	SetLane(sy, lane, transform.scale.y);
+	SetLane(sz, lane, transform.scale.z);
+}
+
+u32 Skeleton::AddBone(std::string name, i32 parent, const BoneTransform& rest) {
+	auto index = static_cast<u32>(bones_.size());
+	if (parent < -1 || parent >= static_cast<i32>(index)) {
+		throw std::runtime_error("Parent of bone " + name + " must be added before it");
+	}
+	auto model = rest.Matrix();
+	if (parent >= 0) model = glm::inverse(bones_[parent].inverseBind) * model;
+	bones_.push_back(Bone{ std::move(name), parent, rest, glm::inverse(model) });
+	return index;
+}
+
+void Skeleton::SetInverseBind(u32 bone, const glm::mat4& inverseBind) {
+	bones_[bone].inverseBind = inverseBind;
+}
+
+std::optional<u32> Skeleton::Find(const std::string& name) const {
+	for (usize i = 0; i < bones_.size(); ++i) {
+		if (bones_[i].name == name) return static_cast<u32>(i);
+	}
+	return {};
+}
+
+void Skeleton::RestPose(std::span<BoneGroup> pose) const {
+	for (usize g = 0; g < pose.size(); ++g) {
+		for (u32 lane = 0; lane < 4; ++lane) {
+			auto bone = g * 4 + lane;
+			pose[g].Set(lane, bone < bones_.size() ? bones_[bone].rest : BoneTransform{});
+		}
+	}
+}
+
+void Skeleton::ComputePalette(std::span<const BoneGroup> pose, std::span<glm::mat4> model, std::span<glm::mat4> palette) const {
+	auto one = F32x4::Set1(1.0f);
+	for (usize g = 0; g < pose.size(); ++g) {
+		const auto& p = pose[g];
+		// Rotation and scale columns of the four local matrices, lane per bone
+		auto x2 = p.qx + p.qx, y2 = p.qy + p.qy, z2 = p.qz + p.qz;
+		auto xx = p.qx * x2, yy = p.qy * y2, zz = p.qz * z2;
+		auto xy = p.qx * y2, xz = p.qx * z2, yz = p.qy * z2;
+		auto wx = p.qw * x2, wy = p.qw * y2, wz = p.qw * z2;
+		alignas(16) f32 local[12][4];
+		((one - (yy + zz)) * p.sx).Store(local[0]);
+		((xy + wz) * p.sx).Store(local[1]);
+		((xz - wy) * p.sx).Store(local[2]);
+		((xy - wz) * p.sy).Store(local[3]);
+		((one - (xx + zz)) * p.sy).Store(local[4]);
+		((yz + wx) * p.sy).Store(local[5]);
+		((xz + wy) * p.sz).Store(local[6]);
+		((yz - wx) * p.sz).Store(local[7]);
+		((one - (xx + yy)) * p.sz).Store(local[8]);
+		p.tx.Store(local[9]);
+		p.ty.Store(local[10]);
+		p.tz.Store(local[11]);
+
+		for (u32 lane = 0; lane < 4; ++lane) {
+			auto bone = g * 4 + lane;
+			if (bone >= bones_.size()) break;
+			f32 columns[4][4];
+			for (i32 c = 0; c < 4; ++c) {
+				for (i32 r = 0; r < 3; ++r) columns[c][r] = local[c * 3 + r][lane];
+				columns[c][3] = c == 3 ? 1.0f : 0.0f;
+			}
+			auto parent = bones_[bone].parent;
+			auto world = Multiply(parent >= 0 ? LoadColumns(model[parent]) : identityColumns, columns);
+			StoreColumns(world, model[bone]);
+
+			f32 inverseBind[4][4];
+			for (i32 c = 0; c < 4; ++c) {
+				for (i32 r = 0; r < 4; ++r) inverseBind[c][r] = bones_[bone].inverseBind[c][r];
+			}
+			StoreColumns(Multiply(world, inverseBind), palette[bone]);
+		}
+	}
+}
+
+void HOEngine::BlendPoses(std::span<BoneGroup> pose, std::span<const BoneGroup> other, f32 weight) {
+	auto w = F32x4::Set1(weight);
+	auto zero = F32x4::Zero();
+	auto one = F32x4::Set1(1.0f);
+	for (usize g = 0; g < pose.size(); ++g) {
+		auto& a = pose[g];
+		const auto& b = other[g];
+		a.tx = MulAdd(b.tx - a.tx, w, a.tx);
+		a.ty = MulAdd(b.ty - a.ty, w, a.ty);
+		a.tz = MulAdd(b.tz - a.tz, w, a.tz);
+		a.sx = MulAdd(b.sx - a.sx, w, a.sx);
+		a.sy = MulAdd(b.sy - a.sy, w, a.sy);
+		a.sz = MulAdd(b.sz - a.sz, w, a.sz);
+
+		// Flip `b` onto the hemisphere of `a` so the blend takes the shortest arc
+		auto dot = MulAdd(a.qx, b.qx, MulAdd(a.qy, b.qy, MulAdd(a.qz, b.qz, a.qw * b.qw)));
+		auto wb = Select(dot < zero, -w, w);
+		auto wa = one - w;
+		auto qx = MulAdd(b.qx, wb, a.qx * wa);
+		auto qy = MulAdd(b.qy, wb, a.qy * wa);
+		auto qz = MulAdd(b.qz, wb, a.qz * wa);
+		auto qw = MulAdd(b.qw, wb, a.qw * wa);
+		auto invLength = one / Sqrt(MulAdd(qx, qx, MulAdd(qy, qy, MulAdd(qz, qz, qw * qw))));
+		a.qx = qx * invLength;
+		a.qy = qy * invLength;
+		a.qz = qz * invLength;
+		a.qw = qw * invLength;
+	}
+}
+
+void HOEngine::ReadSkeleton(Skeleton& target, std::istream& data) {
+	HOENGINE_PROFILE_SCOPE("ReadSkeleton");
+	std::string line;
+	std::string start;
+	std::istringstream iss;
+	while (std::getline(data, line)) {
+		iss.clear();
+		iss.str(line);
+
+		start.clear();
+		iss >> start;
+		if (start != "bone") continue;
+
+		std::string name, parentName;
+		BoneTransform rest;
+		iss >> name >> parentName;
+		for (i32 i = 0; i < 3; ++i) iss >> rest.translation[i];
+		iss >> rest.rotation.w >> rest.rotation.x >> rest.rotation.y >> rest.rotation.z;
+		for (i32 i = 0; i < 3; ++i) iss >> rest.scale[i];
+		if (!iss) throw std::runtime_error("Malformed bone line: " + line);
+		rest.rotation = glm::normalize(rest.rotation);
+
+		i32 parent = -1;
+		if (parentName != "-") {
+			auto found = target.Find(parentName);
+			if (!found) throw std::runtime_error("Unknown parent bone " + parentName);
+			parent = static_cast<i32>(*found);
+		}
+		target.AddBone(std::move(name), parent, rest);
+	}
+}
+
+void HOEngine::ReadSkeletonAt(Skeleton& target, const std::string& path) {
+	std::ifstream ifs;
+	ifs.open(path);
+	if (!ifs) return;
+	ReadSkeleton(target, ifs);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <istream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "Engine.hpp"
+#include "Simd.hpp"
+
+namespace HOEngine {
+
+/// Transform of a bone relative to its parent.
+struct BoneTransform {
+	glm::vec3 translation{ 0.0f };
+	glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+	glm::vec3 scale{ 1.0f };
+
+	glm::mat4 Matrix() const;
+};
+
+/// Local transforms of four consecutive bones, one per lane, so poses are sampled,
+/// blended and turned into matrices with `F32x4`. A pose of `n` bones is a span of
+/// `BoneGroupCount(n)` groups; lanes past the last bone hold identity transforms.
+struct BoneGroup {
+	F32x4 tx, ty, tz;
+	F32x4 qx, qy, qz, qw;
+	F32x4 sx, sy, sz;
+
+	BoneTransform Get(u32 lane) const;
+	void Set(u32 lane, const BoneTransform& transform);
+};
+
+inline usize BoneGroupCount(usize bones) { return (bones + 3) / 4; }
+
+/// Bone hierarchy shared by the skinned meshes and the clips animating it.
+/// Bones are stored parents first, so a pose resolves in a single forward pass.
+class Skeleton {
+public:
+	struct Bone {
+		std::string name;
+		/// Index of the parent bone, -1 for roots.
+		i32 parent;
+		BoneTransform rest;
+		/// Model space to the bone's space in the bind pose.
+		glm::mat4 inverseBind;
+	};
+
+private:
+	std::vector<Bone> bones_;
+
+public:
+	/// Append a bone, returns its index. Throws unless `parent` is -1 or an existing
+	/// bone. The inverse bind matrix is that of the rest pose.
+	u32 AddBone(std::string name, i32 parent, const BoneTransform& rest);
+	/// Override the inverse bind matrix of a bone, for meshes bound in another pose.
+	void SetInverseBind(u32 bone, const glm::mat4& inverseBind);
+	std::optional<u32> Find(const std::string& name) const;
+
+	/// Write the rest pose, `BoneGroupCount(boneCount())` groups.
+	void RestPose(std::span<BoneGroup> pose) const;
+	/// Resolve a pose into skinning matrices, `model * inverseBind` for each bone.
+	/// `model` receives the model space transform of each bone. Both hold
+	/// `boneCount()` matrices.
+	void ComputePalette(std::span<const BoneGroup> pose, std::span<glm::mat4> model, std::span<glm::mat4> palette) const;
+
+	usize boneCount() const { return bones_.size(); }
+	const Bone& bone(u32 index) const { return bones_[index]; }
+	const std::vector<Bone>& bones() const { return bones_; }
+};
+
+/// Blend `other` into `pose` by `weight`, 0 keeping `pose`. Rotations are
+/// interpolated along the shortest arc and renormalized.
+void BlendPoses(std::span<BoneGroup> pose, std::span<const BoneGroup> other, f32 weight);
+
+/// Read a skeleton from text, one bone per line, parents first:
+///
+///     bone <name> <parent name, or - for roots> <tx ty tz> <qw qx qy qz> <sx sy sz>
+///
+/// Lines starting with `#` are ignored. Throws on unknown parents.
+void ReadSkeleton(Skeleton& target, std::istream& data);
+void ReadSkeletonAt(Skeleton& target, const std::string& path);
+
+} // namespace HOEngine
@@ -0,0 +1,840 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include <tuple>
+#include <glm/gtc/quaternion.hpp>
+#include "NavMesh.hpp"
+#include "Arena.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	constexpr u32 none = ~0u;
+	constexpr u32 maxTiles = 65536;
+	constexpr u32 maxPolysPerTile = 0xffff;
+	/// Neighbour offsets, in the order of the tile edges: -x, +x, -z, +z.
+	constexpr i32 dirX[4] = { -1, 1, 0, 0 };
+	constexpr i32 dirZ[4] = { 0, 0, -1, 1 };
+
+	/// Solid voxels of a column, from `min` to `max` in cells.
+	struct Span {
+		u16 min;
+		u16 max;
+		bool walkable;
+		u32 next;
+	};
+
+	/// Top of a walkable span with enough headroom.
+	struct Cell {
+		u16 x;
+		u16 z;
+		u16 floor;
+		u16 ceiling;
+		u32 neighbours[4];
+		u32 poly;
+		bool removed;
+	};
+
+	/// Clip a convex polygon to the side of `axis = value` where `sign * (p[axis] - value) >= 0`.
+	u32 ClipPolygon(const glm::vec3* in, u32 count, glm::vec3* out, i32 axis, f32 value, f32 sign) {
+		u32 result = 0;
+		for (u32 i = 0, j = count - 1; i < count; j = i++) {
+			auto dj = sign * (in[j][axis] - value);
+			auto di = sign * (in[i][axis] - value);
+			if ((dj >= 0.0f) != (di >= 0.0f)) {
+				out[result++] = in[j] + (in[i] - in[j]) * (dj / (dj - di));
+			}
+			if (di >= 0.0f) out[result++] = in[i];
+		}
+		return result;
+	}
+
+	/// Twice the signed area of `a, b, c` on the ground plane, positive if `c` is left
+	/// of the line from `a` to `b` (looking down, +x right, +z forward).
+	f32 Cross2D(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+		return (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z);
+	}
+
+	f32 Distance(const glm::vec3& a, const glm::vec3& b) {
+		return glm::length(b - a);
+	}
+}
+
+NavQuery::NavQuery(u32 maxNodes)
+	: maxNodes_{ std::max(maxNodes, 1u) } {
+	nodes.reserve(maxNodes_);
+	table.assign(std::bit_ceil(maxNodes_ * 2), 0);
+	open.reserve(maxNodes_);
+}
+
+u32 NavQuery::Find(PolyRef poly) const {
+	auto mask = static_cast<u32>(table.size() - 1);
+	for (auto slot = (poly * 0x9e3779b1u) & mask;; slot = (slot + 1) & mask) {
+		auto entry = table[slot];
+		if (entry == 0) return none;
+		if (nodes[entry - 1].poly == poly) return entry - 1;
+	}
+}
+
+NavQuery::Node* NavQuery::Insert(PolyRef poly) {
+	if (nodes.size() >= maxNodes_) return nullptr;
+	auto mask = static_cast<u32>(table.size() - 1);
+	auto slot = (poly * 0x9e3779b1u) & mask;
+	while (table[slot] != 0) slot = (slot + 1) & mask;
+	nodes.push_back(Node{ poly, none, glm::vec3(0.0f), 0.0f, 0.0f, slot, false });
+	table[slot] = static_cast<u32>(nodes.size());
+	return &nodes.back();
+}
+
+void NavQuery::Reset() {
+	for (const auto& node : nodes) table[node.slot] = 0;
+	nodes.clear();
+	open.clear();
+	polys.clear();
+	portals.clear();
+}
+
+NavMesh::NavMesh(Config config)
+	: config{ config } {
+	this->config.tileSize = std::clamp(config.tileSize, 1u, 255u);
+	this->config.queryGrain = std::max<usize>(config.queryGrain, 1);
+}
+
+u32 NavMesh::BorderCells() const {
+	return static_cast<u32>(std::ceil(config.agentRadius / config.cellSize)) + 1;
+}
+
+AABB NavMesh::TileBounds(u32 tileX, u32 tileZ) const {
+	auto size = static_cast<f32>(config.tileSize) * config.cellSize;
+	auto min = glm::vec3(bounds_.min.x + static_cast<f32>(tileX) * size, bounds_.min.y, bounds_.min.z + static_cast<f32>(tileZ) * size);
+	return AABB{ min, glm::vec3(min.x + size, bounds_.max.y, min.z + size) };
+}
+
+std::span<const NavMesh::Link> NavMesh::links(PolyRef ref) const {
+	const auto& tile = tiles[ref >> 16];
+	const auto& p = tile.polys[ref & 0xffff];
+	return { tile.links.data() + p.firstLink, p.linkCount };
+}
+
+void NavMesh::GatherTriangles(EntitiesStorage& storage, const AABB& region, std::vector<Triangle>& out) const {
+	HOENGINE_PROFILE_SCOPE("NavMesh::GatherTriangles");
+	auto all = region.IsEmpty();
+	auto overlaps = [&](const AABB& box) {
+		return all || (box.min.x <= region.max.x && box.max.x >= region.min.x && box.min.z <= region.max.z && box.max.z >= region.min.z);
+	};
+	for (usize idx = 0; idx < storage.Capacity(); ++idx) {
+		auto entity = storage.At(idx);
+		if (!entity) continue;
+		auto mesh = entity->GetComponent<MeshComponent>();
+		auto transform = entity->GetComponent<TransformComponent>();
+		if (!mesh || !transform) continue;
+		if (!all && !overlaps(transform->TransformBounds(mesh->bounds))) continue;
+
+		auto rotation = glm::mat3_cast(transform->rot);
+		const auto& vertices = mesh->vertices;
+		const auto& indices = mesh->indices;
+		for (usize i = 0; i + 2 < indices.size(); i += 3) {
+			Triangle tri;
+			AABB box;
+			for (usize k = 0; k < 3; ++k) {
+				auto index = indices[i + k];
+				if (index >= vertices.size()) throw std::runtime_error("Mesh index out of range");
+				tri.v[k] = transform->pos + rotation * (transform->scale * vertices[index].pos);
+				box.Extend(tri.v[k]);
+			}
+			if (overlaps(box)) out.push_back(tri);
+		}
+	}
+}
+
+void NavMesh::Build(ThreadPool& pool, EntitiesStorage& storage) {
+	HOENGINE_PROFILE_SCOPE("NavMesh::Build");
+	auto start = std::chrono::steady_clock::now();
+	std::vector<Triangle> triangles;
+	GatherTriangles(storage, AABB{}, triangles);
+
+	bounds_ = config.bounds;
+	if (bounds_.IsEmpty()) {
+		for (const auto& tri : triangles) {
+			for (const auto& v : tri.v) bounds_.Extend(v);
+		}
+	}
+	tiles.clear();
+	tilesX = tilesZ = 0;
+	if (bounds_.IsEmpty()) {
+		stats_.tiles = stats_.polys = stats_.tilesBuilt = 0;
+		stats_.buildTime = MillisecondsSince(start);
+		return;
+	}
+	// Room above the highest floor for the agent
+	bounds_.max.y += config.agentHeight;
+
+	auto tileWorld = static_cast<f32>(config.tileSize) * config.cellSize;
+	auto countX = std::max(std::ceil((bounds_.max.x - bounds_.min.x) / tileWorld), 1.0f);
+	auto countZ = std::max(std::ceil((bounds_.max.z - bounds_.min.z) / tileWorld), 1.0f);
+	if (countX * countZ > static_cast<f32>(maxTiles)) throw std::runtime_error("Navigation mesh needs too many tiles, increase the tile or cell size");
+	tilesX = static_cast<u32>(countX);
+	tilesZ = static_cast<u32>(countZ);
+	tiles.resize(tilesX * tilesZ);
+	std::vector<u32> dirty(tiles.size());
+	for (u32 t = 0; t < tiles.size(); ++t) {
+		tiles[t].bounds = TileBounds(t % tilesX, t / tilesX);
+		dirty[t] = t;
+	}
+	BuildTiles(pool, triangles, dirty);
+	stats_.buildTime = MillisecondsSince(start);
+}
+
+void NavMesh::Rebuild(ThreadPool& pool, EntitiesStorage& storage, const AABB& changed) {
+	if (tiles.empty()) {
+		Build(pool, storage);
+		return;
+	}
+	if (changed.IsEmpty()) return;
+	HOENGINE_PROFILE_SCOPE("NavMesh::Rebuild");
+	auto start = std::chrono::steady_clock::now();
+
+	// Tiles whose border reaches into the changed area
+	auto tileWorld = static_cast<f32>(config.tileSize) * config.cellSize;
+	auto reach = changed.Expanded(static_cast<f32>(BorderCells()) * config.cellSize);
+	auto toTile = [&](f32 value, f32 origin, u32 count) {
+		return static_cast<u32>(std::clamp(std::floor((value - origin) / tileWorld), 0.0f, static_cast<f32>(count - 1)));
+	};
+	if (reach.max.x < bounds_.min.x || reach.max.z < bounds_.min.z) return;
+	if (reach.min.x > bounds_.min.x + tileWorld * static_cast<f32>(tilesX)) return;
+	if (reach.min.z > bounds_.min.z + tileWorld * static_cast<f32>(tilesZ)) return;
+	std::vector<u32> dirty;
+	AABB region;
+	for (auto z = toTile(reach.min.z, bounds_.min.z, tilesZ); z <= toTile(reach.max.z, bounds_.min.z, tilesZ); ++z) {
+		for (auto x = toTile(reach.min.x, bounds_.min.x, tilesX); x <= toTile(reach.max.x, bounds_.min.x, tilesX); ++x) {
+			dirty.push_back(z * tilesX + x);
+			region.Extend(tiles[z * tilesX + x].bounds);
+		}
+	}
+
+	std::vector<Triangle> triangles;
+	region = region.Expanded(static_cast<f32>(BorderCells()) * config.cellSize);
+	GatherTriangles(storage, region, triangles);
+	BuildTiles(pool, triangles, dirty);
+	stats_.buildTime = MillisecondsSince(start);
+}
+
+void NavMesh::BuildTiles(ThreadPool& pool, const std::vector<Triangle>& triangles, const std::vector<u32>& dirty) {
+	// Bin the triangles into the tiles they overlap, border included
+	std::vector<i32> slotOf(tiles.size(), -1);
+	for (usize i = 0; i < dirty.size(); ++i) slotOf[dirty[i]] = static_cast<i32>(i);
+	std::vector<std::vector<u32>> binned(dirty.size());
+	auto tileWorld = static_cast<f32>(config.tileSize) * config.cellSize;
+	auto border = static_cast<f32>(BorderCells()) * config.cellSize;
+	auto toTile = [&](f32 value, f32 origin, u32 count) {
+		return static_cast<i32>(std::clamp(std::floor((value - origin) / tileWorld), -1.0f, static_cast<f32>(count)));
+	};
+	for (u32 i = 0; i < triangles.size(); ++i) {
+		AABB box;
+		for (const auto& v : triangles[i].v) box.Extend(v);
+		auto x0 = std::max(toTile(box.min.x - border, bounds_.min.x, tilesX), 0);
+		auto x1 = std::min(toTile(box.max.x + border, bounds_.min.x, tilesX), static_cast<i32>(tilesX) - 1);
+		auto z0 = std::max(toTile(box.min.z - border, bounds_.min.z, tilesZ), 0);
+		auto z1 = std::min(toTile(box.max.z + border, bounds_.min.z, tilesZ), static_cast<i32>(tilesZ) - 1);
+		for (auto z = z0; z <= z1; ++z) {
+			for (auto x = x0; x <= x1; ++x) {
+				auto slot = slotOf[z * tilesX + x];
+				if (slot >= 0) binned[slot].push_back(i);
+			}
+		}
+	}
+
+	pool.ParallelTasks(dirty.size(), [&](usize i) { BuildTile(dirty[i], triangles, binned[i]); });
+	for (auto tile : dirty) Stitch(tile);
+
+	stats_.tiles = tiles.size();
+	stats_.tilesBuilt = dirty.size();
+	stats_.polys = 0;
+	for (const auto& tile : tiles) stats_.polys += tile.polys.size();
+}
+
+void NavMesh::BuildTile(u32 index, const std::vector<Triangle>& triangles, std::span<const u32> indices) {
+	HOENGINE_PROFILE_SCOPE("NavMesh::BuildTile");
+	auto start = std::chrono::steady_clock::now();
+	auto& tile = tiles[index];
+	const auto cs = config.cellSize;
+	const auto ch = config.cellHeight;
+	const auto border = BorderCells();
+	const auto size = config.tileSize + 2 * border;
+	const auto originX = tile.bounds.min.x - static_cast<f32>(border) * cs;
+	const auto originZ = tile.bounds.min.z - static_cast<f32>(border) * cs;
+	const auto originY = bounds_.min.y;
+	const auto heightCells = static_cast<i32>(std::ceil(config.agentHeight / ch));
+	const auto climbCells = static_cast<i32>(std::floor(config.agentClimb / ch));
+	const auto radiusCells = static_cast<u32>(std::ceil(config.agentRadius / cs));
+	const auto walkableY = std::cos(glm::radians(config.maxSlope));
+	const auto maxHeight = static_cast<f32>(std::numeric_limits<u16>::max());
+
+	// Temporaries live in the thread's scratch arena, declared first so it outlives them
+	ScratchArena scratch;
+	std::pmr::vector<u32> columns(size * size, none, scratch.resource());
+	std::pmr::vector<Span> spans{ scratch.resource() };
+
+	auto addSpan = [&](u32 column, u16 min, u16 max, bool walkable) {
+		Span span{ min, max, walkable, none };
+		auto prev = none;
+		auto cur = columns[column];
+		while (cur != none) {
+			auto& c = spans[cur];
+			if (c.min > span.max) break;
+			if (c.max < span.min) {
+				prev = cur;
+				cur = c.next;
+				continue;
+			}
+			// Merge the overlapping span, its top decides walkability if it's the higher one
+			span.min = std::min(span.min, c.min);
+			if (std::abs(static_cast<i32>(span.max) - static_cast<i32>(c.max)) <= climbCells) {
+				span.walkable = span.walkable || c.walkable;
+			} else if (c.max > span.max) {
+				span.walkable = c.walkable;
+			}
+			span.max = std::max(span.max, c.max);
+			auto next = c.next;
+			if (prev == none) columns[column] = next; else spans[prev].next = next;
+			cur = next;
+		}
+		span.next = prev == none ? columns[column] : spans[prev].next;
+		spans.push_back(span);
+		auto added = static_cast<u32>(spans.size() - 1);
+		if (prev == none) columns[column] = added; else spans[prev].next = added;
+	};
+
+	// Rasterize, clipping each triangle to the rows then the cells it covers
+	for (auto i : indices) {
+		const auto& tri = triangles[i];
+		auto normal = glm::cross(tri.v[1] - tri.v[0], tri.v[2] - tri.v[0]);
+		auto length = glm::length(normal);
+		if (!(length > 0.0f)) continue;
+		// Either winding, so meshes facing the wrong way still produce floors
+		auto walkable = std::abs(normal.y) / length >= walkableY;
+
+		AABB box;
+		for (const auto& v : tri.v) box.Extend(v);
+		auto x0 = static_cast<i32>(std::floor((box.min.x - originX) / cs));
+		auto x1 = static_cast<i32>(std::floor((box.max.x - originX) / cs));
+		auto z0 = static_cast<i32>(std::floor((box.min.z - originZ) / cs));
+		auto z1 = static_cast<i32>(std::floor((box.max.z - originZ) / cs));
+		if (x1 < 0 || z1 < 0 || x0 >= static_cast<i32>(size) || z0 >= static_cast<i32>(size)) continue;
+		x0 = std::max(x0, 0);
+		z0 = std::max(z0, 0);
+		x1 = std::min(x1, static_cast<i32>(size) - 1);
+		z1 = std::min(z1, static_cast<i32>(size) - 1);
+
+		glm::vec3 polygon[3] = { tri.v[0], tri.v[1], tri.v[2] };
+		glm::vec3 rowA[8], row[8], cellA[8], cell[8];
+		for (auto z = z0; z <= z1; ++z) {
+			auto cz = originZ + static_cast<f32>(z) * cs;
+			auto n = ClipPolygon(polygon, 3, rowA, 2, cz, 1.0f);
+			if (n < 3) continue;
+			n = ClipPolygon(rowA, n, row, 2, cz + cs, -1.0f);
+			if (n < 3) continue;
+			for (auto x = x0; x <= x1; ++x) {
+				auto cx = originX + static_cast<f32>(x) * cs;
+				auto m = ClipPolygon(row, n, cellA, 0, cx, 1.0f);
+				if (m < 3) continue;
+				m = ClipPolygon(cellA, m, cell, 0, cx + cs, -1.0f);
+				if (m < 3) continue;
+				auto ymin = cell[0].y, ymax = cell[0].y;
+				for (u32 k = 1; k < m; ++k) {
+					ymin = std::min(ymin, cell[k].y);
+					ymax = std::max(ymax, cell[k].y);
+				}
+				auto smin = std::clamp(std::floor((ymin - originY) / ch), 0.0f, maxHeight);
+				auto smax = std::clamp(std::ceil((ymax - originY) / ch), 0.0f, maxHeight);
+				addSpan(static_cast<u32>(z) * size + static_cast<u32>(x), static_cast<u16>(smin), static_cast<u16>(std::max(smax, smin)), walkable);
+			}
+		}
+	}
+
+	// Walkable tops with enough headroom become cells
+	std::pmr::vector<Cell> cells{ scratch.resource() };
+	std::pmr::vector<u32> cellStart(size * size + 1, 0, scratch.resource());
+	for (u32 column = 0; column < size * size; ++column) {
+		cellStart[column] = static_cast<u32>(cells.size());
+		for (auto s = columns[column]; s != none; s = spans[s].next) {
+			const auto& span = spans[s];
+			auto ceiling = span.next != none ? spans[span.next].min : std::numeric_limits<u16>::max();
+			if (!span.walkable || static_cast<i32>(ceiling) - static_cast<i32>(span.max) < heightCells) continue;
+			cells.push_back(Cell{ static_cast<u16>(column % size), static_cast<u16>(column / size), span.max, ceiling,
+				{ none, none, none, none }, none, false });
+		}
+	}
+	cellStart[size * size] = static_cast<u32>(cells.size());
+
+	for (auto& c : cells) {
+		for (u32 d = 0; d < 4; ++d) {
+			auto nx = static_cast<i32>(c.x) + dirX[d];
+			auto nz = static_cast<i32>(c.z) + dirZ[d];
+			if (nx < 0 || nz < 0 || nx >= static_cast<i32>(size) || nz >= static_cast<i32>(size)) continue;
+			auto column = static_cast<u32>(nz) * size + static_cast<u32>(nx);
+			for (auto k = cellStart[column]; k < cellStart[column + 1]; ++k) {
+				const auto& n = cells[k];
+				auto headroom = static_cast<i32>(std::min(c.ceiling, n.ceiling)) - static_cast<i32>(std::max(c.floor, n.floor));
+				if (std::abs(static_cast<i32>(n.floor) - static_cast<i32>(c.floor)) <= climbCells && headroom >= heightCells) {
+					c.neighbours[d] = k;
+					break;
+				}
+			}
+		}
+	}
+
+	// Erode by the agent radius: chessboard distance from cells missing a neighbour,
+	// which never exceeds the true distance so corners are cut conservatively
+	if (radiusCells > 0) {
+		std::pmr::vector<u16> distance(cells.size(), std::numeric_limits<u16>::max(), scratch.resource());
+		std::pmr::vector<u32> queue{ scratch.resource() };
+		for (u32 i = 0; i < cells.size(); ++i) {
+			const auto& n = cells[i].neighbours;
+			if (n[0] == none || n[1] == none || n[2] == none || n[3] == none) {
+				distance[i] = 0;
+				queue.push_back(i);
+			}
+		}
+		for (usize head = 0; head < queue.size(); ++head) {
+			auto i = queue[head];
+			auto next = static_cast<u16>(distance[i] + 1);
+			if (next >= radiusCells) continue;
+			auto visit = [&](u32 k) {
+				if (k != none && distance[k] > next) {
+					distance[k] = next;
+					queue.push_back(k);
+				}
+			};
+			for (u32 d = 0; d < 4; ++d) {
+				auto k = cells[i].neighbours[d];
+				visit(k);
+				// Diagonals, through either side
+				if (k != none) visit(cells[k].neighbours[d < 2 ? 2 : 0]), visit(cells[k].neighbours[d < 2 ? 3 : 1]);
+			}
+		}
+		for (u32 i = 0; i < cells.size(); ++i) cells[i].removed = distance[i] < radiusCells;
+	}
+
+	// Merge the cells inside the tile into rectangles
+	tile.polys.clear();
+	tile.internal.clear();
+	// Restitched once every dirty tile is built
+	tile.external.clear();
+	for (auto& edge : tile.edges) edge.clear();
+	auto inside = [&](const Cell& c) {
+		return c.x >= border && c.z >= border && c.x < border + config.tileSize && c.z < border + config.tileSize;
+	};
+	auto usable = [&](u32 k, u16 floor) {
+		if (k == none) return false;
+		const auto& c = cells[k];
+		return !c.removed && c.poly == none && inside(c) && std::abs(static_cast<i32>(c.floor) - static_cast<i32>(floor)) <= climbCells;
+	};
+	std::pmr::vector<u32> rect{ scratch.resource() };
+	u32 walkableCells = 0;
+	for (u32 seed = 0; seed < cells.size(); ++seed) {
+		if (!usable(seed, cells[seed].floor)) continue;
+		if (tile.polys.size() >= maxPolysPerTile) break;
+		auto floor = cells[seed].floor;
+		rect.assign(1, seed);
+		while (usable(cells[rect.back()].neighbours[1], floor)) rect.push_back(cells[rect.back()].neighbours[1]);
+		auto width = static_cast<u32>(rect.size());
+		u32 rows = 1;
+		for (;;) {
+			auto rowStart = rect.size();
+			bool complete = true;
+			for (u32 k = 0; k < width && complete; ++k) {
+				auto next = cells[rect[rowStart - width + k]].neighbours[3];
+				complete = usable(next, floor) && (k == 0 || cells[rect.back()].neighbours[1] == next);
+				if (complete) rect.push_back(next);
+			}
+			if (!complete) {
+				rect.resize(rowStart);
+				break;
+			}
+			++rows;
+		}
+
+		auto polyIndex = static_cast<u32>(tile.polys.size());
+		f32 sum = 0.0f;
+		u16 lowest = floor, highest = floor;
+		for (auto k : rect) {
+			cells[k].poly = polyIndex;
+			sum += static_cast<f32>(cells[k].floor);
+			lowest = std::min(lowest, cells[k].floor);
+			highest = std::max(highest, cells[k].floor);
+		}
+		walkableCells += static_cast<u32>(rect.size());
+		const auto& first = cells[seed];
+		Poly poly;
+		poly.min = glm::vec3(originX + static_cast<f32>(first.x) * cs, originY + static_cast<f32>(lowest) * ch, originZ + static_cast<f32>(first.z) * cs);
+		poly.max = glm::vec3(poly.min.x + static_cast<f32>(width) * cs, originY + static_cast<f32>(highest) * ch, poly.min.z + static_cast<f32>(rows) * cs);
+		poly.height = originY + sum / static_cast<f32>(rect.size()) * ch;
+		poly.firstLink = poly.linkCount = 0;
+		tile.polys.push_back(poly);
+	}
+
+	// Sides of cells facing another polygon, and the cells on the tile's edges
+	struct Side {
+		u16 poly;
+		u16 target;
+		u16 dir;
+		/// Cell along the polygon's side, and its floor.
+		u16 along;
+		u16 floor;
+	};
+	std::pmr::vector<Side> sides{ scratch.resource() };
+	for (u32 k = 0; k < cells.size(); ++k) {
+		const auto& c = cells[k];
+		if (c.poly == none) continue;
+		for (u32 d = 0; d < 4; ++d) {
+			auto n = c.neighbours[d];
+			if (n == none || cells[n].removed) continue;
+			if (!inside(cells[n])) {
+				auto along = d < 2 ? c.z - border : c.x - border;
+				tile.edges[d].push_back(EdgeCell{ static_cast<u16>(along), static_cast<u16>(c.poly), originY + static_cast<f32>(c.floor) * ch });
+				continue;
+			}
+			if (cells[n].poly == none || cells[n].poly == c.poly) continue;
+			sides.push_back(Side{ static_cast<u16>(c.poly), static_cast<u16>(cells[n].poly), static_cast<u16>(d), d < 2 ? c.z : c.x, c.floor });
+		}
+	}
+
+	// A polygon's side is a straight line, so consecutive cells leading to the same
+	// polygon make up one portal
+	std::sort(sides.begin(), sides.end(), [](const Side& a, const Side& b) {
+		return std::tie(a.poly, a.dir, a.target, a.along) < std::tie(b.poly, b.dir, b.target, b.along);
+	});
+	for (usize i = 0; i < sides.size();) {
+		auto j = i + 1;
+		while (j < sides.size() && sides[j].poly == sides[i].poly && sides[j].dir == sides[i].dir &&
+			sides[j].target == sides[i].target && sides[j].along == sides[j - 1].along + 1) ++j;
+		const auto& first = sides[i];
+		const auto& last = sides[j - 1];
+		const auto& p = tile.polys[first.poly];
+		auto from = static_cast<f32>(first.along) * cs;
+		auto to = static_cast<f32>(last.along + 1) * cs;
+		auto y0 = originY + static_cast<f32>(first.floor) * ch;
+		auto y1 = originY + static_cast<f32>(last.floor) * ch;
+		glm::vec3 a, b;
+		if (first.dir < 2) {
+			auto x = first.dir == 0 ? p.min.x : p.max.x;
+			a = glm::vec3(x, y0, originZ + from);
+			b = glm::vec3(x, y1, originZ + to);
+		} else {
+			auto z = first.dir == 2 ? p.min.z : p.max.z;
+			a = glm::vec3(originX + from, y0, z);
+			b = glm::vec3(originX + to, y1, z);
+		}
+		tile.internal.push_back({ first.poly, Link{ (index << 16) | first.target, a, b } });
+		i = j;
+	}
+	for (auto& edge : tile.edges) {
+		std::sort(edge.begin(), edge.end(), [](const EdgeCell& a, const EdgeCell& b) { return a.along < b.along; });
+	}
+
+	tile.stats.triangles = static_cast<u32>(indices.size());
+	tile.stats.cells = walkableCells;
+	tile.stats.polys = static_cast<u32>(tile.polys.size());
+	tile.stats.buildTime = MillisecondsSince(start);
+}
+
+void NavMesh::Stitch(u32 index) {
+	auto tx = index % tilesX;
+	auto tz = index / tilesX;
+	tiles[index].external.clear();
+	for (u32 d = 0; d < 4; ++d) {
+		auto nx = static_cast<i32>(tx) + dirX[d];
+		auto nz = static_cast<i32>(tz) + dirZ[d];
+		if (nx < 0 || nz < 0 || nx >= static_cast<i32>(tilesX) || nz >= static_cast<i32>(tilesZ)) continue;
+		auto neighbour = static_cast<u32>(nz) * tilesX + static_cast<u32>(nx);
+		std::erase_if(tiles[neighbour].external, [&](const auto& entry) { return entry.second.target >> 16 == index; });
+		StitchEdge(index, neighbour, d);
+		FlattenLinks(tiles[neighbour]);
+	}
+	FlattenLinks(tiles[index]);
+}
+
+void NavMesh::StitchEdge(u32 indexA, u32 indexB, u32 edgeA) {
+	auto& a = tiles[indexA];
+	auto& b = tiles[indexB];
+	const auto& cellsA = a.edges[edgeA];
+	const auto& cellsB = b.edges[edgeA ^ 1];
+	const auto cs = config.cellSize;
+
+	// Runs of matching edge cells leading to the same pair of polygons
+	struct Run {
+		u16 polyA;
+		u16 polyB;
+		u16 first;
+		u16 last;
+		f32 floorFirst;
+		f32 floorLast;
+	};
+	std::vector<Run> runs;
+	usize j = 0;
+	for (const auto& ca : cellsA) {
+		while (j < cellsB.size() && cellsB[j].along < ca.along) ++j;
+		for (auto k = j; k < cellsB.size() && cellsB[k].along == ca.along; ++k) {
+			const auto& cb = cellsB[k];
+			if (std::abs(cb.floor - ca.floor) > config.agentClimb) continue;
+			auto run = std::find_if(runs.begin(), runs.end(), [&](const Run& r) {
+				return r.polyA == ca.poly && r.polyB == cb.poly && r.last + 1 == ca.along;
+			});
+			if (run != runs.end()) {
+				run->last = ca.along;
+				run->floorLast = ca.floor;
+			} else {
+				runs.push_back(Run{ ca.poly, cb.poly, ca.along, ca.along, ca.floor, ca.floor });
+			}
+			break;
+		}
+	}
+
+	for (const auto& run : runs) {
+		auto from = static_cast<f32>(run.first) * cs;
+		auto to = static_cast<f32>(run.last + 1) * cs;
+		glm::vec3 p, q;
+		if (edgeA < 2) {
+			auto x = edgeA == 0 ? a.bounds.min.x : a.bounds.max.x;
+			p = glm::vec3(x, run.floorFirst, a.bounds.min.z + from);
+			q = glm::vec3(x, run.floorLast, a.bounds.min.z + to);
+		} else {
+			auto z = edgeA == 2 ? a.bounds.min.z : a.bounds.max.z;
+			p = glm::vec3(a.bounds.min.x + from, run.floorFirst, z);
+			q = glm::vec3(a.bounds.min.x + to, run.floorLast, z);
+		}
+		a.external.push_back({ run.polyA, Link{ (indexB << 16) | run.polyB, p, q } });
+		b.external.push_back({ run.polyB, Link{ (indexA << 16) | run.polyA, p, q } });
+	}
+}
+
+void NavMesh::FlattenLinks(Tile& tile) {
+	for (auto& poly : tile.polys) poly.linkCount = 0;
+	for (const auto& [poly, link] : tile.internal) ++tile.polys[poly].linkCount;
+	for (const auto& [poly, link] : tile.external) ++tile.polys[poly].linkCount;
+	u32 offset = 0;
+	for (auto& poly : tile.polys) {
+		poly.firstLink = offset;
+		offset += poly.linkCount;
+		poly.linkCount = 0;
+	}
+	tile.links.resize(offset);
+	for (const auto& [poly, link] : tile.internal) {
+		auto& p = tile.polys[poly];
+		tile.links[p.firstLink + p.linkCount++] = link;
+	}
+	for (const auto& [poly, link] : tile.external) {
+		auto& p = tile.polys[poly];
+		tile.links[p.firstLink + p.linkCount++] = link;
+	}
+}
+
+PolyRef NavMesh::FindNearestPoly(const glm::vec3& point, f32 maxDistance) const {
+	if (tiles.empty()) return noPoly;
+	auto tileWorld = static_cast<f32>(config.tileSize) * config.cellSize;
+	auto toTile = [&](f32 value, f32 origin, u32 count) {
+		return static_cast<i32>(std::clamp(std::floor((value - origin) / tileWorld), -1.0f, static_cast<f32>(count)));
+	};
+	auto x0 = std::max(toTile(point.x - maxDistance, bounds_.min.x, tilesX), 0);
+	auto x1 = std::min(toTile(point.x + maxDistance, bounds_.min.x, tilesX), static_cast<i32>(tilesX) - 1);
+	auto z0 = std::max(toTile(point.z - maxDistance, bounds_.min.z, tilesZ), 0);
+	auto z1 = std::min(toTile(point.z + maxDistance, bounds_.min.z, tilesZ), static_cast<i32>(tilesZ) - 1);
+
+	auto best = noPoly;
+	auto bestDistance = maxDistance * maxDistance;
+	for (auto z = z0; z <= z1; ++z) {
+		for (auto x = x0; x <= x1; ++x) {
+			auto index = static_cast<u32>(z) * tilesX + static_cast<u32>(x);
+			const auto& polys = tiles[index].polys;
+			for (u32 i = 0; i < polys.size(); ++i) {
+				const auto& p = polys[i];
+				auto closest = glm::vec3(std::clamp(point.x, p.min.x, p.max.x), p.height, std::clamp(point.z, p.min.z, p.max.z));
+				auto d = point - closest;
+				auto distance = glm::dot(d, d);
+				if (distance <= bestDistance) {
+					bestDistance = distance;
+					best = (index << 16) | i;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+void NavMesh::FindPath(NavQuery& query, const PathRequest& request, PathResult& result) const {
+	result.points.clear();
+	result.nodes = 0;
+	result.status = PathStatus::Failed;
+	auto startRef = FindNearestPoly(request.start, config.agentHeight);
+	auto endRef = FindNearestPoly(request.end, config.agentHeight);
+	if (startRef == noPoly || endRef == noPoly) return;
+
+	query.Reset();
+	auto byTotal = [](const std::pair<f32, u32>& a, const std::pair<f32, u32>& b) { return a.first > b.first; };
+	auto startNode = query.Insert(startRef);
+	startNode->pos = request.start;
+	startNode->total = Distance(request.start, request.end);
+	query.open.push_back({ startNode->total, 0 });
+
+	u32 best = 0;
+	f32 bestHeuristic = startNode->total;
+	u32 goal = none;
+	bool exhausted = false;
+	while (!query.open.empty()) {
+		std::pop_heap(query.open.begin(), query.open.end(), byTotal);
+		auto [total, current] = query.open.back();
+		query.open.pop_back();
+		if (query.nodes[current].closed || total != query.nodes[current].total) continue;
+		query.nodes[current].closed = true;
+		++result.nodes;
+		if (query.nodes[current].poly == endRef) {
+			goal = current;
+			break;
+		}
+
+		auto parentPoly = query.nodes[current].parent != none ? query.nodes[query.nodes[current].parent].poly : noPoly;
+		for (const auto& link : links(query.nodes[current].poly)) {
+			if (link.target == parentPoly) continue;
+			auto mid = (link.a + link.b) * 0.5f;
+			auto cost = query.nodes[current].cost + Distance(query.nodes[current].pos, mid);
+			auto heuristic = Distance(mid, request.end);
+			if (link.target == endRef) {
+				cost += heuristic;
+				heuristic = 0.0f;
+			}
+
+			auto existing = query.Find(link.target);
+			NavQuery::Node* node;
+			if (existing != none) {
+				node = &query.nodes[existing];
+				if (cost >= node->cost) continue;
+			} else {
+				node = query.Insert(link.target);
+				if (!node) {
+					exhausted = true;
+					continue;
+				}
+				existing = static_cast<u32>(query.nodes.size() - 1);
+			}
+			node->parent = current;
+			node->pos = mid;
+			node->cost = cost;
+			node->total = cost + heuristic;
+			node->closed = false;
+			query.open.push_back({ node->total, existing });
+			std::push_heap(query.open.begin(), query.open.end(), byTotal);
+			if (heuristic < bestHeuristic) {
+				bestHeuristic = heuristic;
+				best = existing;
+			}
+		}
+	}
+
+	glm::vec3 end = request.end;
+	if (goal != none) {
+		result.status = PathStatus::Found;
+	} else if (exhausted) {
+		result.status = PathStatus::Partial;
+		goal = best;
+		const auto& p = poly(query.nodes[goal].poly);
+		end = glm::vec3(std::clamp(end.x, p.min.x, p.max.x), p.height, std::clamp(end.z, p.min.z, p.max.z));
+	} else {
+		return;
+	}
+
+	for (auto n = goal; n != none; n = query.nodes[n].parent) query.polys.push_back(query.nodes[n].poly);
+	std::reverse(query.polys.begin(), query.polys.end());
+
+	// Portals as (left, right) pairs seen walking the path, start and end as empty portals
+	auto& portals = query.portals;
+	portals.push_back(request.start);
+	portals.push_back(request.start);
+	for (usize i = 0; i + 1 < query.polys.size(); ++i) {
+		const auto& from = poly(query.polys[i]);
+		auto center = (from.min + from.max) * 0.5f;
+		for (const auto& link : links(query.polys[i])) {
+			if (link.target != query.polys[i + 1]) continue;
+			auto mid = (link.a + link.b) * 0.5f;
+			auto aLeft = Cross2D(center, mid, link.a) > 0.0f;
+			portals.push_back(aLeft ? link.a : link.b);
+			portals.push_back(aLeft ? link.b : link.a);
+			break;
+		}
+	}
+	portals.push_back(end);
+	portals.push_back(end);
+
+	// Funnel: narrow the left and right edges portal by portal, turning at a corner
+	// whenever one edge crosses over the other
+	auto count = portals.size() / 2;
+	auto apex = portals[0], left = portals[0], right = portals[1];
+	usize apexIndex = 0, leftIndex = 0, rightIndex = 0;
+	result.points.push_back(apex);
+	for (usize i = 1; i < count; ++i) {
+		auto newLeft = portals[i * 2];
+		auto newRight = portals[i * 2 + 1];
+
+		if (Cross2D(apex, right, newRight) >= 0.0f) {
+			if (apex == right || Cross2D(apex, left, newRight) < 0.0f) {
+				right = newRight;
+				rightIndex = i;
+			} else {
+				apex = left;
+				apexIndex = leftIndex;
+				result.points.push_back(apex);
+				left = right = apex;
+				leftIndex = rightIndex = apexIndex;
+				i = apexIndex;
+				continue;
+			}
+		}
+
+		if (Cross2D(apex, left, newLeft) <= 0.0f) {
+			if (apex == left || Cross2D(apex, right, newLeft) > 0.0f) {
+				left = newLeft;
+				leftIndex = i;
+			} else {
+				apex = right;
+				apexIndex = rightIndex;
+				result.points.push_back(apex);
+				left = right = apex;
+				leftIndex = rightIndex = apexIndex;
+				i = apexIndex;
+				continue;
+			}
+		}
+	}
+	if (result.points.back() != end) result.points.push_back(end);
+}
+
+void NavMesh::FindPaths(ThreadPool& pool, std::span<const PathRequest> requests, std::span<PathResult> results) {
+	HOENGINE_PROFILE_SCOPE("NavMesh::FindPaths");
+	auto start = std::chrono::steady_clock::now();
+	if (results.size() < requests.size()) throw std::runtime_error("Path results are fewer than the requests");
+	auto grain = config.queryGrain;
+	auto jobs = (requests.size() + grain - 1) / grain;
+	// Jobs run on the workers and the calling thread, one at a time on each
+	auto threads = std::min(jobs, pool.threadCount() + 1);
+	while (queries.size() < threads) queries.push_back(std::make_unique<NavQuery>(config.maxSearchNodes));
+	if (queriesBusy.size() != queries.size()) queriesBusy = std::vector<std::atomic<bool>>(queries.size());
+
+	pool.ParallelFor(requests.size(), grain, [&](usize begin, usize end) {
+		// There are at least as many queries as jobs running, so one is free
+		usize slot = 0;
+		while (queriesBusy[slot].exchange(true, std::memory_order_acquire)) slot = (slot + 1) % queriesBusy.size();
+		for (auto i = begin; i < end; ++i) FindPath(*queries[slot], requests[i], results[i]);
+		queriesBusy[slot].store(false, std::memory_order_release);
+	});
+
+	stats_.queries = requests.size();
+	stats_.nodes = 0;
+	for (usize i = 0; i < requests.size(); ++i) stats_.nodes += results[i].nodes;
+	stats_.queryTime = MillisecondsSince(start);
+}
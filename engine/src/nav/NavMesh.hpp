@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "Entity.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+/// Polygon of a `NavMesh`: tile index in the high 16 bits, polygon in the tile below.
+using PolyRef = u32;
+constexpr PolyRef noPoly = ~0u;
+
+enum class PathStatus : u8 {
+	Found,
+	/// The search ran out of nodes, the path leads to the closest polygon reached.
+	Partial,
+	/// Start or end is off the mesh, or the end can't be reached.
+	Failed,
+};
+
+struct PathRequest {
+	glm::vec3 start;
+	glm::vec3 end;
+};
+
+struct PathResult {
+	PathStatus status = PathStatus::Failed;
+	/// Straightened path from start to end, both included. Reuses its storage
+	/// across queries.
+	std::vector<glm::vec3> points;
+	/// Nodes expanded by the search.
+	u32 nodes = 0;
+};
+
+class NavMesh;
+
+/// Scratch state of an A* search, reused across queries so searching doesn't
+/// allocate: node pool, open addressing table from polygons to nodes and the open
+/// heap are all sized once for `maxNodes`. One per thread searching.
+class NavQuery {
+private:
+	struct Node {
+		PolyRef poly;
+		u32 parent;
+		/// Where the path enters the polygon, the middle of the portal crossed.
+		glm::vec3 pos;
+		f32 cost;
+		/// `cost` plus the estimate to the end.
+		f32 total;
+		/// Slot of the node in `table`.
+		u32 slot;
+		bool closed;
+	};
+
+	u32 maxNodes_;
+	std::vector<Node> nodes;
+	/// Node index plus one, 0 for empty slots.
+	std::vector<u32> table;
+	/// Min heap of (total, node). Nodes are pushed again when their cost improves,
+	/// stale entries are skipped when popped.
+	std::vector<std::pair<f32, u32>> open;
+	/// Polygons of the last path, then its portals.
+	std::vector<PolyRef> polys;
+	std::vector<glm::vec3> portals;
+
+public:
+	explicit NavQuery(u32 maxNodes);
+
+	u32 maxNodes() const { return maxNodes_; }
+
+private:
+	u32 Find(PolyRef poly) const;
+	/// `nullptr` once the pool is exhausted.
+	Node* Insert(PolyRef poly);
+	void Reset();
+
+	friend class NavMesh;
+};
+
+/// Navigation mesh over the `MeshComponent`s of a scene, built by voxelization.
+///
+/// The world is split into square tiles of `tileSize` cells, built independently
+/// and in parallel. A tile rasterizes the triangles overlapping it (plus a border)
+/// into columns of solid spans, keeps the tops of walkable spans with enough
+/// headroom, erodes them by the agent radius, then merges neighbouring cells of
+/// similar height into rectangles, which are the mesh's polygons. Polygons are
+/// linked through portals within tiles, and tiles through their shared edges, so
+/// `Rebuild` only redoes the tiles touching changed geometry and restitches them.
+///
+/// Paths are searched with A* over polygons, then straightened through the
+/// portals crossed. `FindPaths` runs batches of requests across the pool, with a
+/// `NavQuery` per thread kept from one batch to the next.
+class NavMesh {
+public:
+	struct Config {
+		/// Horizontal and vertical size of a voxel.
+		f32 cellSize = 0.3f;
+		f32 cellHeight = 0.2f;
+		/// Headroom needed above a walkable surface.
+		f32 agentHeight = 2.0f;
+		/// Walkable cells are kept at least this far from walls and ledges.
+		f32 agentRadius = 0.6f;
+		/// Highest step between neighbouring cells.
+		f32 agentClimb = 0.4f;
+		/// Steepest walkable slope, in degrees.
+		f32 maxSlope = 45.0f;
+		/// Cells along each side of a tile, at most 255.
+		u32 tileSize = 64;
+		/// Area covered by the mesh, that of the geometry when empty.
+		AABB bounds;
+		/// Nodes of each `NavQuery` made by `FindPaths`.
+		u32 maxSearchNodes = 4096;
+		/// Requests per job in `FindPaths`.
+		usize queryGrain = 8;
+	};
+
+	struct TileStats {
+		u32 triangles = 0;
+		/// Walkable cells after erosion.
+		u32 cells = 0;
+		u32 polys = 0;
+		/// CPU time of the tile's last build, in milliseconds.
+		f64 buildTime = 0;
+	};
+
+	struct Stats {
+		usize tiles = 0;
+		usize polys = 0;
+		/// Tiles built by the last `Build` or `Rebuild`, and its CPU time in milliseconds.
+		usize tilesBuilt = 0;
+		f64 buildTime = 0;
+		/// Requests of the last `FindPaths`, its CPU time in milliseconds and the
+		/// nodes its searches expanded.
+		usize queries = 0;
+		f64 queryTime = 0;
+		usize nodes = 0;
+
+		f64 QueriesPerSecond() const { return queryTime > 0 ? static_cast<f64>(queries) * 1000.0 / queryTime : 0.0; }
+	};
+
+	struct Poly {
+		/// World space rectangle, `min.y` and `max.y` bounding its cells' floors.
+		glm::vec3 min;
+		glm::vec3 max;
+		/// Average floor height.
+		f32 height;
+		u32 firstLink;
+		u32 linkCount;
+	};
+
+	struct Link {
+		PolyRef target;
+		/// Ends of the portal to `target`.
+		glm::vec3 a;
+		glm::vec3 b;
+	};
+
+private:
+	/// Walkable cell on the edge of a tile, for stitching tiles together.
+	struct EdgeCell {
+		/// Cell along the edge.
+		u16 along;
+		u16 poly;
+		f32 floor;
+	};
+
+	struct Tile {
+		AABB bounds;
+		std::vector<Poly> polys;
+		/// Grouped by polygon, links to this tile's polygons first.
+		std::vector<Link> links;
+		/// Links within the tile, and to the neighbouring tiles, by source polygon.
+		std::vector<std::pair<u16, Link>> internal;
+		std::vector<std::pair<u16, Link>> external;
+		/// Walkable cells along each edge: -x, +x, -z, +z.
+		std::vector<EdgeCell> edges[4];
+		TileStats stats;
+	};
+
+	struct Triangle {
+		glm::vec3 v[3];
+	};
+
+	Config config;
+	AABB bounds_;
+	u32 tilesX = 0;
+	u32 tilesZ = 0;
+	std::vector<Tile> tiles;
+	/// Queries of `FindPaths`, one per thread that may run its jobs. Each job
+	/// claims a query whose flag isn't set.
+	std::vector<std::unique_ptr<NavQuery>> queries;
+	std::vector<std::atomic<bool>> queriesBusy;
+	Stats stats_;
+
+public:
+	explicit NavMesh(Config config);
+	NavMesh() : NavMesh(Config{}) {}
+
+	/// Build every tile from the entities having a `MeshComponent` and a
+	/// `TransformComponent`. Throws if the bounds need more than 65536 tiles.
+	void Build(ThreadPool& pool, EntitiesStorage& storage);
+	/// Rebuild the tiles overlapping `changed`, after geometry in it moved, appeared
+	/// or disappeared. Builds everything if `Build` wasn't called yet.
+	void Rebuild(ThreadPool& pool, EntitiesStorage& storage, const AABB& changed);
+
+	/// Polygon under (or closest to) `point`, looking at most `maxDistance` away.
+	PolyRef FindNearestPoly(const glm::vec3& point, f32 maxDistance) const;
+	/// Search a path, using `query` as scratch state.
+	void FindPath(NavQuery& query, const PathRequest& request, PathResult& result) const;
+	/// Search every path, spread over the pool. `results` must be as large as `requests`.
+	void FindPaths(ThreadPool& pool, std::span<const PathRequest> requests, std::span<PathResult> results);
+
+	usize tileCount() const { return tiles.size(); }
+	/// Queries kept by `FindPaths`.
+	usize queryCount() const { return queries.size(); }
+	const TileStats& tileStats(usize tile) const { return tiles[tile].stats; }
+	const Poly& poly(PolyRef ref) const { return tiles[ref >> 16].polys[ref & 0xffff]; }
+	std::span<const Link> links(PolyRef ref) const;
+	AABB bounds() const { return bounds_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	void GatherTriangles(EntitiesStorage& storage, const AABB& region, std::vector<Triangle>& out) const;
+	void BuildTiles(ThreadPool& pool, const std::vector<Triangle>& triangles, const std::vector<u32>& dirty);
+	void BuildTile(u32 tile, const std::vector<Triangle>& triangles, std::span<const u32> indices);
+	void Stitch(u32 tile);
+	void StitchEdge(u32 tileA, u32 tileB, u32 edgeA);
+	void FlattenLinks(Tile& tile);
+	AABB TileBounds(u32 tileX, u32 tileZ) const;
+	/// Border of cells around a tile, rasterized to erode and connect its edges correctly.
+	u32 BorderCells() const;
+};
+
+} // namespace HOEngine
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include "Broadphase.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "Simd.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Extra elements at the end of the sorted arrays, so 4-wide loads past the last
+	/// body stay in bounds. Their minimum is infinite, which ends every sweep.
+	constexpr usize simdPadding = 4;
+}
+
+Broadphase::Broadphase(Config config)
+	: config{ config } {
+}
+
+u32 Broadphase::Add(const AABB& box, BodyKind kind) {
+	u32 body;
+	if (!freeBodies.empty()) {
+		body = freeBodies.back();
+		freeBodies.pop_back();
+	} else {
+		body = static_cast<u32>(bodies.size());
+		bodies.push_back({});
+		for (u32 axis = 0; axis < 3; ++axis) {
+			mins[axis].push_back(0.0f);
+			maxs[axis].push_back(0.0f);
+		}
+	}
+	for (u32 axis = 0; axis < 3; ++axis) {
+		mins[axis][body] = box.min[axis];
+		maxs[axis][body] = box.max[axis];
+	}
+
+	bodies[body] = Body{ kind, true, DynamicBVH::nullNode };
+	if (kind == BodyKind::Static) {
+		bodies[body].treeProxy = tree.Insert(box, body, config.staticMargin);
+		++stats_.staticBodies;
+	} else {
+		addedBodies.push_back(body);
+		++stats_.dynamicBodies;
+	}
+	return body;
+}
+
+void Broadphase::Remove(u32 body) {
+	auto& b = bodies[body];
+	b.alive = false;
+	if (b.kind == BodyKind::Static) {
+		tree.Remove(b.treeProxy);
+		b.treeProxy = DynamicBVH::nullNode;
+		--stats_.staticBodies;
+		freeBodies.push_back(body);
+	} else {
+		// Still referenced by the endpoint arrays, or by the added list
+		removedBodies.push_back(body);
+		--stats_.dynamicBodies;
+	}
+}
+
+void Broadphase::Move(u32 body, const AABB& box) {
+	for (u32 axis = 0; axis < 3; ++axis) {
+		mins[axis][body] = box.min[axis];
+		maxs[axis][body] = box.max[axis];
+	}
+	if (bodies[body].kind == BodyKind::Static) tree.Update(bodies[body].treeProxy, box, config.staticMargin);
+}
+
+AABB Broadphase::box(u32 body) const {
+	return AABB{
+		glm::vec3(mins[0][body], mins[1][body], mins[2][body]),
+		glm::vec3(maxs[0][body], maxs[1][body], maxs[2][body]),
+	};
+}
+
+void Broadphase::SortAxis(u32 axis, bool full) {
+	auto& array = endpoints[axis];
+	const auto& min = mins[axis];
+	const auto& max = maxs[axis];
+
+	if (!removedBodies.empty()) {
+		std::erase_if(array, [&](const Endpoint& e) { return !bodies[e.body].alive; });
+	}
+	for (auto body : addedBodies) {
+		if (bodies[body].alive) array.push_back(Endpoint{ 0.0f, body });
+	}
+
+	// Refresh the keys, measuring how the bodies are spread along the way
+	f64 sum = 0.0;
+	f64 sumSquares = 0.0;
+	f64 sizes = 0.0;
+	auto lo = std::numeric_limits<f32>::max();
+	auto hi = std::numeric_limits<f32>::lowest();
+	for (auto& e : array) {
+		e.value = min[e.body];
+		auto center = 0.5f * (min[e.body] + max[e.body]);
+		sum += center;
+		sumSquares += static_cast<f64>(center) * center;
+		sizes += max[e.body] - min[e.body];
+		lo = std::min(lo, center);
+		hi = std::max(hi, center);
+	}
+	auto count = static_cast<f64>(std::max<usize>(array.size(), 1));
+	spread[axis] = sumSquares / count - (sum / count) * (sum / count);
+	centerMin[axis] = array.empty() ? 0.0f : lo;
+	centerMax[axis] = array.empty() ? 0.0f : hi;
+	sizeSum[axis] = sizes;
+
+	// Also start over when the last insertion sort was no better than a full sort
+	auto n = static_cast<usize>(count);
+	if (full || shifts[axis] > n * static_cast<usize>(std::bit_width(n))) {
+		std::sort(array.begin(), array.end());
+		// Keep the estimate, so the next update tries insertion sort again
+		shifts[axis] = shifts[axis] / 2;
+		fullSorted[axis] = true;
+		return;
+	}
+	usize moved = 0;
+	for (usize i = 1; i < array.size(); ++i) {
+		auto e = array[i];
+		auto j = i;
+		for (; j > 0 && e < array[j - 1]; --j) array[j] = array[j - 1];
+		array[j] = e;
+		moved += i - j;
+	}
+	shifts[axis] = moved;
+	fullSorted[axis] = false;
+}
+
+u32 Broadphase::CellOf(u32 gridAxis, f32 value) const {
+	auto cell = std::floor((value - gridOrigin[gridAxis]) * gridInvCell[gridAxis]);
+	return static_cast<u32>(std::clamp(cell, 0.0f, static_cast<f32>(gridSize[gridAxis] - 1)));
+}
+
+void Broadphase::BuildRegions() {
+	const auto& array = endpoints[sweepAxis];
+	auto count = array.size();
+	gridAxes = { (sweepAxis + 1) % 3, (sweepAxis + 2) % 3 };
+
+	// Square grid of about `count / regionSize` regions, with cells no smaller than
+	// twice the average body so few bodies straddle them
+	auto target = std::max<usize>(count / std::max<usize>(config.regionSize, 1), 1);
+	auto cellsPerAxis = static_cast<f32>(std::ceil(std::sqrt(static_cast<f32>(target))));
+	for (u32 g = 0; g < 2; ++g) {
+		auto axis = gridAxes[g];
+		auto extent = centerMax[axis] - centerMin[axis];
+		auto averageSize = static_cast<f32>(sizeSum[axis] / static_cast<f64>(std::max<usize>(count, 1)));
+		auto cell = std::max(extent / cellsPerAxis, 2.0f * averageSize);
+		gridOrigin[g] = centerMin[axis];
+		if (cell > 0.0f) {
+			gridSize[g] = static_cast<u32>(std::clamp(std::ceil(extent / cell), 1.0f, cellsPerAxis));
+			gridInvCell[g] = 1.0f / cell;
+		} else {
+			gridSize[g] = 1;
+			gridInvCell[g] = 0.0f;
+		}
+	}
+	auto regions = gridSize[0] * gridSize[1];
+	auto a0 = gridAxes[0];
+	auto a1 = gridAxes[1];
+
+	// Count, then scatter the bodies in sweep order
+	regionStart.assign(regions + 1, 0);
+	for (const auto& e : array) {
+		auto x0 = CellOf(0, mins[a0][e.body]), x1 = CellOf(0, maxs[a0][e.body]);
+		auto y0 = CellOf(1, mins[a1][e.body]), y1 = CellOf(1, maxs[a1][e.body]);
+		for (auto y = y0; y <= y1; ++y) {
+			for (auto x = x0; x <= x1; ++x) ++regionStart[y * gridSize[0] + x + 1];
+		}
+	}
+	for (u32 r = 0; r < regions; ++r) regionStart[r + 1] += regionStart[r] + static_cast<u32>(simdPadding);
+	auto total = regionStart[regions];
+	stats_.regions = regions;
+	stats_.regionEntries = total - regions * simdPadding;
+
+	regionBodies.resize(total);
+	sweepMin.resize(total);
+	sweepMax.resize(total);
+	for (u32 g = 0; g < 2; ++g) {
+		otherMin[g].resize(total);
+		otherMax[g].resize(total);
+	}
+	std::vector<u32> cursor(regionStart.begin(), regionStart.end() - 1);
+	for (const auto& e : array) {
+		auto body = e.body;
+		auto x0 = CellOf(0, mins[a0][body]), x1 = CellOf(0, maxs[a0][body]);
+		auto y0 = CellOf(1, mins[a1][body]), y1 = CellOf(1, maxs[a1][body]);
+		for (auto y = y0; y <= y1; ++y) {
+			for (auto x = x0; x <= x1; ++x) {
+				auto i = cursor[y * gridSize[0] + x]++;
+				regionBodies[i] = body;
+				sweepMin[i] = mins[sweepAxis][body];
+				sweepMax[i] = maxs[sweepAxis][body];
+				otherMin[0][i] = mins[a0][body];
+				otherMax[0][i] = maxs[a0][body];
+				otherMin[1][i] = mins[a1][body];
+				otherMax[1][i] = maxs[a1][body];
+			}
+		}
+	}
+	for (u32 r = 0; r < regions; ++r) {
+		for (auto i = cursor[r]; i < regionStart[r + 1]; ++i) {
+			regionBodies[i] = nullBody;
+			sweepMin[i] = sweepMax[i] = std::numeric_limits<f32>::infinity();
+			otherMin[0][i] = otherMin[1][i] = std::numeric_limits<f32>::infinity();
+			otherMax[0][i] = otherMax[1][i] = -std::numeric_limits<f32>::infinity();
+		}
+	}
+}
+
+void Broadphase::SweepRegion(u32 region) {
+	auto& out = regionPairs[region];
+	out.clear();
+	auto begin = regionStart[region];
+	auto end = regionStart[region + 1] - static_cast<u32>(simdPadding);
+
+	for (auto i = begin; i < end; ++i) {
+		auto body = regionBodies[i];
+		auto max = F32x4::Set1(sweepMax[i]);
+		auto min0 = F32x4::Set1(otherMin[0][i]);
+		auto max0 = F32x4::Set1(otherMax[0][i]);
+		auto min1 = F32x4::Set1(otherMin[1][i]);
+		auto max1 = F32x4::Set1(otherMax[1][i]);
+
+		// Following bodies overlap along the sweep axis until one starts past our end
+		for (auto j = i + 1; ; j += 4) {
+			auto inRange = F32x4::LoadUnaligned(&sweepMin[j]) <= max;
+			auto overlap = And(
+				And(F32x4::LoadUnaligned(&otherMin[0][j]) <= max0, F32x4::LoadUnaligned(&otherMax[0][j]) >= min0),
+				And(F32x4::LoadUnaligned(&otherMin[1][j]) <= max1, F32x4::LoadUnaligned(&otherMax[1][j]) >= min1));
+			auto hits = MoveMask(And(inRange, overlap));
+			for (; hits; hits &= hits - 1) {
+				auto k = j + static_cast<u32>(std::countr_zero(static_cast<u32>(hits)));
+				// Both bodies are in the region holding the overlap's minimum corner,
+				// only that one reports the pair
+				auto x = CellOf(0, std::max(otherMin[0][i], otherMin[0][k]));
+				auto y = CellOf(1, std::max(otherMin[1][i], otherMin[1][k]));
+				if (y * gridSize[0] + x != region) continue;
+				auto other = regionBodies[k];
+				out.push_back(BodyPair{ std::min(body, other), std::max(body, other) });
+			}
+			if (MoveMask(inRange) != 0xf) break;
+		}
+	}
+}
+
+void Broadphase::QueryStatic(usize chunk) {
+	auto& out = staticPairs[chunk];
+	out.clear();
+	const auto& array = endpoints[sweepAxis];
+	auto begin = chunk * config.regionSize;
+	auto end = std::min(begin + config.regionSize, array.size());
+	for (auto i = begin; i < end; ++i) {
+		auto body = array[i].body;
+		auto bodyBox = box(body);
+		tree.Query(bodyBox, [&](u32 proxy) {
+			auto other = tree.userData(proxy);
+			// The tree stores enlarged boxes
+			if (box(other).Overlaps(bodyBox)) out.push_back(BodyPair{ std::min(body, other), std::max(body, other) });
+			return true;
+		});
+	}
+}
+
+const std::vector<BodyPair>& Broadphase::Update(ThreadPool& pool) {
+	HOENGINE_PROFILE_SCOPE("Broadphase::Update");
+	auto start = std::chrono::steady_clock::now();
+
+	tree.Refit();
+	tree.IncrementalRebuild(config.treeRebuildLeaves);
+
+	// Insertion sort degrades to quadratic when many bodies come in at once
+	auto full = addedBodies.size() > endpoints[0].size() / 8 + 64;
+	pool.ParallelTasks(3, [&](usize axis) {
+		SortAxis(static_cast<u32>(axis), full);
+	});
+	freeBodies.insert(freeBodies.end(), removedBodies.begin(), removedBodies.end());
+	removedBodies.clear();
+	addedBodies.clear();
+
+	sweepAxis = 0;
+	for (u32 axis = 1; axis < 3; ++axis) {
+		if (spread[axis] > spread[sweepAxis]) sweepAxis = axis;
+	}
+	stats_.sweepAxis = sweepAxis;
+	stats_.sortShifts = shifts[0] + shifts[1] + shifts[2];
+	for (auto sorted : fullSorted) stats_.fullSorts += sorted ? 1 : 0;
+	stats_.sortTime = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	BuildRegions();
+	auto regions = static_cast<u32>(regionStart.size() - 1);
+	if (regionPairs.size() < regions) regionPairs.resize(regions);
+	pool.ParallelTasks(regions, [&](usize region) {
+		SweepRegion(static_cast<u32>(region));
+	});
+	auto chunks = tree.leafCount() > 0 ? (endpoints[sweepAxis].size() + config.regionSize - 1) / config.regionSize : 0;
+	if (staticPairs.size() < chunks) staticPairs.resize(chunks);
+	pool.ParallelTasks(chunks, [&](usize chunk) {
+		QueryStatic(chunk);
+	});
+
+	pairs_.clear();
+	for (u32 region = 0; region < regions; ++region) {
+		pairs_.insert(pairs_.end(), regionPairs[region].begin(), regionPairs[region].end());
+	}
+	for (usize chunk = 0; chunk < chunks; ++chunk) {
+		pairs_.insert(pairs_.end(), staticPairs[chunk].begin(), staticPairs[chunk].end());
+	}
+	// Sorting makes the order independent of the history and of the regions
+	std::sort(pairs_.begin(), pairs_.end());
+	pairs_.erase(std::unique(pairs_.begin(), pairs_.end()), pairs_.end());
+
+	stats_.pairs = pairs_.size();
+	stats_.pairTime = MillisecondsSince(start);
+	HOENGINE_PROFILE_COUNTER("Broadphase pairs", stats_.pairs);
+	return pairs_;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+#include <compare>
+#include <vector>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "DynamicBVH.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+/// Two bodies whose boxes overlap, with `a < b`.
+struct BodyPair {
+	u32 a;
+	u32 b;
+
+	auto operator<=>(const BodyPair&) const = default;
+};
+
+enum class BodyKind : u8 {
+	/// Rarely moving body, kept in an AABB tree. Never paired with other static bodies.
+	Static,
+	/// Body moving every step, kept in the sweep and prune arrays.
+	Dynamic,
+};
+
+/// Finds the pairs of bodies whose boxes overlap.
+///
+/// Dynamic bodies are sorted along each axis by their box minimum. Since bodies
+/// move little between steps the arrays stay nearly sorted, and an insertion sort
+/// restores them in close to linear time, one axis per job. The axis along which
+/// the bodies are most spread out is then swept. To keep sweeps short in dense
+/// worlds, the bodies are first split into a grid of regions over the two other
+/// axes, keeping their order; a body straddling regions goes in each of them.
+/// Regions are swept in parallel, testing a body against the following ones four
+/// at a time until their minimum passes its maximum, and a pair is only reported
+/// by the region holding the corner of the overlap. Static bodies live in a
+/// `DynamicBVH`, queried with the box of each dynamic body.
+///
+/// Pairs come out sorted and without duplicates, in an order which only depends on
+/// the bodies and their boxes.
+class Broadphase {
+public:
+	static constexpr u32 nullBody = ~0u;
+
+	struct Config {
+		/// Margin of the static bodies' boxes in the tree, so small moves are free.
+		f32 staticMargin = 0.1f;
+		/// Dynamic bodies per sweep region, on average.
+		usize regionSize = 1024;
+		/// Tree leaves reinserted per update to keep its quality up.
+		u32 treeRebuildLeaves = 16;
+	};
+
+	struct Stats {
+		usize staticBodies = 0;
+		usize dynamicBodies = 0;
+		usize pairs = 0;
+		/// Elements moved by the insertion sorts of the last update.
+		usize sortShifts = 0;
+		/// Axes sorted from scratch instead of incrementally, after many bodies
+		/// were added or moved far.
+		u64 fullSorts = 0;
+		u32 sweepAxis = 0;
+		usize regions = 0;
+		/// Bodies in more than one region count once per region.
+		usize regionEntries = 0;
+		/// CPU time of the last update's sorting and pair finding, in milliseconds.
+		f64 sortTime = 0;
+		f64 pairTime = 0;
+	};
+
+private:
+	struct Body {
+		BodyKind kind;
+		bool alive;
+		/// Leaf in the tree, for static bodies.
+		u32 treeProxy;
+	};
+
+	struct Endpoint {
+		f32 value;
+		u32 body;
+
+		bool operator<(const Endpoint& that) const {
+			return value < that.value || (value == that.value && body < that.body);
+		}
+	};
+
+	Config config;
+	std::vector<Body> bodies;
+	/// Box of every body, structure-of-arrays, indexed by body.
+	std::array<std::vector<f32>, 3> mins, maxs;
+	std::vector<u32> freeBodies;
+	/// Removed since the last update, only reused once gone from the endpoint arrays.
+	std::vector<u32> removedBodies;
+	/// Dynamic bodies added since the last update, not yet in the endpoint arrays.
+	std::vector<u32> addedBodies;
+
+	std::array<std::vector<Endpoint>, 3> endpoints;
+	/// Per axis: variance and bounds of the body centers, sum of the body sizes.
+	std::array<f64, 3> spread{};
+	std::array<f32, 3> centerMin{}, centerMax{};
+	std::array<f64, 3> sizeSum{};
+	std::array<usize, 3> shifts{};
+	std::array<bool, 3> fullSorted{};
+	DynamicBVH tree;
+
+	/// Region grid over the two axes other than the sweep axis.
+	u32 sweepAxis = 0;
+	std::array<u32, 2> gridAxes{};
+	std::array<u32, 2> gridSize{};
+	std::array<f32, 2> gridOrigin{}, gridInvCell{};
+
+	/// Bodies of each region in sweep order, structure-of-arrays. Region `r` is
+	/// `[regionStart[r], regionStart[r + 1])`, followed by padding for 4-wide loads.
+	std::vector<u32> regionStart;
+	std::vector<u32> regionBodies;
+	std::vector<f32> sweepMin, sweepMax;
+	std::array<std::vector<f32>, 2> otherMin, otherMax;
+
+	std::vector<std::vector<BodyPair>> regionPairs;
+	std::vector<std::vector<BodyPair>> staticPairs;
+	std::vector<BodyPair> pairs_;
+	Stats stats_;
+
+public:
+	explicit Broadphase(Config config);
+	Broadphase() : Broadphase(Config{}) {}
+
+	/// Add a body, returns its handle.
+	u32 Add(const AABB& box, BodyKind kind);
+	void Remove(u32 body);
+	/// Set the box of a body, taken into account at the next `Update`.
+	void Move(u32 body, const AABB& box);
+
+	/// Find the overlapping pairs, valid until the next update.
+	const std::vector<BodyPair>& Update(ThreadPool& pool);
+
+	AABB box(u32 body) const;
+	BodyKind kind(u32 body) const { return bodies[body].kind; }
+	bool IsAlive(u32 body) const { return body < bodies.size() && bodies[body].alive; }
+	/// Handles are below this.
+	usize bodyCapacity() const { return bodies.size(); }
+	const std::vector<BodyPair>& pairs() const { return pairs_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	void SortAxis(u32 axis, bool full);
+	void BuildRegions();
+	u32 CellOf(u32 gridAxis, f32 value) const;
+	void SweepRegion(u32 region);
+	void QueryStatic(usize chunk);
+};
+
+} // namespace HOEngine
@@ -1,3 +1,765 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <utility>
 #include "Physics.hpp"
+#include "Arena.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "Simd.hpp"
 
 using namespace HOEngine;
+
+namespace {
+	/// Pairs per narrowphase job.
+	constexpr usize pairGrain = 256;
+
+	/// Velocities of a body while solving an island. Static bodies all share the
+	/// first entry, which has no mass and never moves.
+	struct SolverBody {
+		glm::vec3 v;
+		glm::vec3 w;
+		f32 invMass;
+		/// World space inverse inertia.
+		glm::mat3 invInertia;
+	};
+
+	glm::vec3 Perpendicular(const glm::vec3& n) {
+		auto t = std::abs(n.x) > 0.57735f ? glm::vec3(n.y, -n.x, 0.0f) : glm::vec3(0.0f, n.z, -n.y);
+		return glm::normalize(t);
+	}
+
+	f32 EffectiveMass(const SolverBody& a, const SolverBody& b, const glm::vec3& ra, const glm::vec3& rb, const glm::vec3& axis) {
+		auto raxn = glm::cross(ra, axis);
+		auto rbxn = glm::cross(rb, axis);
+		auto k = a.invMass + b.invMass + glm::dot(raxn, a.invInertia * raxn) + glm::dot(rbxn, b.invInertia * rbxn);
+		return k > 0.0f ? 1.0f / k : 0.0f;
+	}
+
+	glm::vec3 RelativeVelocity(const SolverBody& a, const SolverBody& b, const glm::vec3& ra, const glm::vec3& rb) {
+		return b.v + glm::cross(b.w, rb) - a.v - glm::cross(a.w, ra);
+	}
+
+	void ApplyImpulse(SolverBody& a, SolverBody& b, const glm::vec3& ra, const glm::vec3& rb, const glm::vec3& impulse) {
+		a.v -= impulse * a.invMass;
+		a.w -= a.invInertia * glm::cross(ra, impulse);
+		b.v += impulse * b.invMass;
+		b.w += b.invInertia * glm::cross(rb, impulse);
+	}
+
+	/// Penetration of a point into a box along its shallowest face.
+	struct BoxPenetration {
+		/// Outward normal of the face, in world space.
+		glm::vec3 normal;
+		f32 depth;
+	};
+
+	std::optional<BoxPenetration> PointInBox(const glm::vec3& point, const glm::vec3& center, const glm::quat& rot, const glm::vec3& halfSize) {
+		auto local = glm::conjugate(rot) * (point - center);
+		u32 axis = 0;
+		auto depth = std::numeric_limits<f32>::max();
+		for (u32 i = 0; i < 3; ++i) {
+			auto d = halfSize[i] - std::abs(local[i]);
+			if (d < 0.0f) return {};
+			if (d < depth) {
+				depth = d;
+				axis = i;
+			}
+		}
+		glm::vec3 normal{ 0.0f };
+		normal[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+		return BoxPenetration{ rot * normal, depth };
+	}
+	struct OrientedBox {
+		glm::vec3 center;
+		glm::vec3 axes[3];
+		glm::vec3 half;
+
+		static OrientedBox Of(const glm::vec3& center, const glm::quat& rot, const glm::vec3& half) {
+			auto m = glm::mat3_cast(rot);
+			return OrientedBox{ center, { m[0], m[1], m[2] }, half };
+		}
+
+		/// Half length of the box's projection on `axis`.
+		f32 Radius(const glm::vec3& axis) const {
+			return half.x * std::abs(glm::dot(axes[0], axis)) + half.y * std::abs(glm::dot(axes[1], axis)) + half.z * std::abs(glm::dot(axes[2], axis));
+		}
+	};
+
+	/// Contacts between the face `face` of `ref`, whose outward normal is `normal`,
+	/// and the face of `inc` most facing it. The incident face is clipped by the
+	/// sides of the reference face, and its points below the reference face kept.
+	template <typename Add>
+	void ClipFaces(const OrientedBox& ref, u32 face, const glm::vec3& normal, const OrientedBox& inc, Add&& add) {
+		u32 incFace = 0;
+		auto best = std::numeric_limits<f32>::max();
+		for (u32 i = 0; i < 3; ++i) {
+			auto d = -std::abs(glm::dot(inc.axes[i], normal));
+			if (d < best) {
+				best = d;
+				incFace = i;
+			}
+		}
+		auto incNormal = inc.axes[incFace] * (glm::dot(inc.axes[incFace], normal) > 0.0f ? -1.0f : 1.0f);
+		auto u = inc.axes[(incFace + 1) % 3] * inc.half[(incFace + 1) % 3];
+		auto v = inc.axes[(incFace + 2) % 3] * inc.half[(incFace + 2) % 3];
+		auto faceCenter = inc.center + incNormal * inc.half[incFace];
+
+		std::array<glm::vec3, 8> points{ faceCenter + u + v, faceCenter - u + v, faceCenter - u - v, faceCenter + u - v };
+		usize count = 4;
+		std::array<glm::vec3, 8> clipped;
+		for (u32 side = 1; side < 3 && count > 0; ++side) {
+			auto axis = ref.axes[(face + side) % 3];
+			auto extent = ref.half[(face + side) % 3];
+			for (auto sign : { 1.0f, -1.0f }) {
+				// Keep the part of the polygon with dot(p - center, sign * axis) <= extent
+				usize out = 0;
+				for (usize i = 0; i < count; ++i) {
+					const auto& p = points[i];
+					const auto& q = points[(i + 1) % count];
+					auto dp = sign * glm::dot(p - ref.center, axis) - extent;
+					auto dq = sign * glm::dot(q - ref.center, axis) - extent;
+					if (dp <= 0.0f) clipped[out++] = p;
+					// Strictly crossing edges only, so each plane adds at most one point
+					if ((dp < 0.0f && dq > 0.0f) || (dp > 0.0f && dq < 0.0f)) clipped[out++] = p + (q - p) * (dp / (dp - dq));
+				}
+				points = clipped;
+				count = out;
+			}
+		}
+
+		auto plane = glm::dot(ref.center, normal) + ref.half[face];
+		for (usize i = 0; i < count; ++i) {
+			auto depth = plane - glm::dot(points[i], normal);
+			if (depth >= 0.0f) add(points[i] + normal * (0.5f * depth), depth);
+		}
+	}
+
+	/// Contacts between two boxes, normals from `a` to `b`. The separating axis
+	/// test finds the axis of least penetration: a face of either box, whose
+	/// contacts are found by clipping, or a pair of edges touching at one point.
+	template <typename Add>
+	void CollideBoxes(const OrientedBox& a, const OrientedBox& b, Add&& add) {
+		auto d = b.center - a.center;
+		// Face axes win unless an edge axis is clearly better, keeping manifolds stable
+		constexpr f32 edgeTolerance = 0.01f;
+		auto bestFace = std::numeric_limits<f32>::lowest();
+		u32 faceAxis = 0;
+		for (u32 i = 0; i < 6; ++i) {
+			auto axis = i < 3 ? a.axes[i] : b.axes[i - 3];
+			auto separation = std::abs(glm::dot(d, axis)) - a.Radius(axis) - b.Radius(axis);
+			if (separation > 0.0f) return;
+			if (separation > bestFace) {
+				bestFace = separation;
+				faceAxis = i;
+			}
+		}
+		auto bestEdge = std::numeric_limits<f32>::lowest();
+		glm::vec3 edgeAxis{ 0.0f };
+		u32 edgeA = 0, edgeB = 0;
+		for (u32 i = 0; i < 3; ++i) {
+			for (u32 j = 0; j < 3; ++j) {
+				auto axis = glm::cross(a.axes[i], b.axes[j]);
+				auto length = glm::length(axis);
+				// Parallel edges, already covered by the face axes
+				if (length < 1e-4f) continue;
+				axis /= length;
+				auto separation = std::abs(glm::dot(d, axis)) - a.Radius(axis) - b.Radius(axis);
+				if (separation > 0.0f) return;
+				if (separation > bestEdge) {
+					bestEdge = separation;
+					edgeAxis = axis;
+					edgeA = i;
+					edgeB = j;
+				}
+			}
+		}
+
+		if (bestEdge > bestFace + edgeTolerance) {
+			auto normal = glm::dot(d, edgeAxis) < 0.0f ? -edgeAxis : edgeAxis;
+			// Edges of each box furthest along the normal, towards the other box
+			auto pa = a.center;
+			auto pb = b.center;
+			for (u32 k = 0; k < 3; ++k) {
+				if (k != edgeA) pa += a.axes[k] * (a.half[k] * (glm::dot(a.axes[k], normal) > 0.0f ? 1.0f : -1.0f));
+				if (k != edgeB) pb -= b.axes[k] * (b.half[k] * (glm::dot(b.axes[k], normal) > 0.0f ? 1.0f : -1.0f));
+			}
+			// Closest points of the two edge lines
+			auto ea = a.axes[edgeA];
+			auto eb = b.axes[edgeB];
+			auto r = pa - pb;
+			auto c = glm::dot(ea, eb);
+			auto denominator = 1.0f - c * c;
+			auto s = denominator > 1e-6f ? (c * glm::dot(eb, r) - glm::dot(ea, r)) / denominator : 0.0f;
+			s = std::clamp(s, -a.half[edgeA], a.half[edgeA]);
+			auto t = std::clamp(glm::dot(eb, pa + ea * s - pb), -b.half[edgeB], b.half[edgeB]);
+			auto onA = pa + ea * s;
+			auto onB = pb + eb * t;
+			add(normal, (onA + onB) * 0.5f, -bestEdge);
+		} else if (faceAxis < 3) {
+			auto normal = a.axes[faceAxis] * (glm::dot(d, a.axes[faceAxis]) < 0.0f ? -1.0f : 1.0f);
+			ClipFaces(a, faceAxis, normal, b, [&](const glm::vec3& point, f32 depth) { add(normal, point, depth); });
+		} else {
+			auto face = faceAxis - 3;
+			auto normal = b.axes[face] * (glm::dot(d, b.axes[face]) > 0.0f ? -1.0f : 1.0f);
+			ClipFaces(b, face, normal, a, [&](const glm::vec3& point, f32 depth) { add(-normal, point, depth); });
+		}
+	}
+}
+
+PhysicsSystem::PhysicsSystem(Config config)
+	: config{ config }
+	, broadphase_{ config.broadphase } {
+}
+
+u32 PhysicsSystem::AddBody(const BodyDesc& desc) {
+	u32 body;
+	if (!freeBodies.empty()) {
+		body = freeBodies.back();
+		freeBodies.pop_back();
+	} else {
+		body = static_cast<u32>(posX.size());
+		// Grow four at a time, so integration never needs a scalar tail
+		auto size = posX.size() + 4;
+		for (auto array : { &posX, &posY, &posZ, &rotX, &rotY, &rotZ, &velX, &velY, &velZ, &angX, &angY, &angZ, &invMass, &awake, &sleepTime, &friction, &restitution }) {
+			array->resize(size, 0.0f);
+		}
+		rotW.resize(size, 1.0f);
+		invInertia.resize(size, glm::vec3(0.0f));
+		shapes.resize(size, ShapeType::Sphere);
+		sizes.resize(size, glm::vec3(0.0f));
+		proxies.resize(size, Broadphase::nullBody);
+		alive.resize(size, 0);
+		entityIndex.resize(size, 0);
+		entityGen.resize(size, u64{ EntitiesStorage::INVALID_GEN });
+		parent.resize(size);
+		for (auto spare = body + 1; spare < size; ++spare) freeBodies.push_back(spare);
+		// Hand out the lowest free slot first
+		std::sort(freeBodies.begin(), freeBodies.end(), std::greater<u32>());
+	}
+
+	posX[body] = desc.pos.x;
+	posY[body] = desc.pos.y;
+	posZ[body] = desc.pos.z;
+	auto rot = glm::normalize(desc.rot);
+	rotX[body] = rot.x;
+	rotY[body] = rot.y;
+	rotZ[body] = rot.z;
+	rotW[body] = rot.w;
+	auto dynamic = desc.mass > 0.0f;
+	velX[body] = dynamic ? desc.velocity.x : 0.0f;
+	velY[body] = dynamic ? desc.velocity.y : 0.0f;
+	velZ[body] = dynamic ? desc.velocity.z : 0.0f;
+	angX[body] = dynamic ? desc.angularVelocity.x : 0.0f;
+	angY[body] = dynamic ? desc.angularVelocity.y : 0.0f;
+	angZ[body] = dynamic ? desc.angularVelocity.z : 0.0f;
+	invMass[body] = dynamic ? 1.0f / desc.mass : 0.0f;
+
+	glm::vec3 inertia;
+	if (desc.shape == ShapeType::Sphere) {
+		inertia = glm::vec3(0.4f * desc.mass * desc.size.x * desc.size.x);
+	} else {
+		auto h2 = desc.size * desc.size;
+		inertia = desc.mass / 3.0f * glm::vec3(h2.y + h2.z, h2.x + h2.z, h2.x + h2.y);
+	}
+	invInertia[body] = dynamic ? glm::vec3(1.0f) / inertia : glm::vec3(0.0f);
+
+	awake[body] = dynamic ? 1.0f : 0.0f;
+	sleepTime[body] = 0.0f;
+	shapes[body] = desc.shape;
+	sizes[body] = desc.size;
+	friction[body] = desc.friction;
+	restitution[body] = desc.restitution;
+	alive[body] = 1;
+	entityIndex[body] = 0;
+	entityGen[body] = EntitiesStorage::INVALID_GEN;
+
+	auto proxy = broadphase_.Add(BoundsOf(body), dynamic ? BodyKind::Dynamic : BodyKind::Static);
+	proxies[body] = proxy;
+	if (bodyOfProxy.size() <= proxy) bodyOfProxy.resize(proxy + 1, nullBody);
+	bodyOfProxy[proxy] = body;
+	++bodyCount;
+	return body;
+}
+
+void PhysicsSystem::RemoveBody(u32 body) {
+	broadphase_.Remove(proxies[body]);
+	bodyOfProxy[proxies[body]] = nullBody;
+	proxies[body] = Broadphase::nullBody;
+	std::erase_if(joints, [&](const Joint& j) { return j.a == body || j.b == body; });
+
+	velX[body] = velY[body] = velZ[body] = 0.0f;
+	angX[body] = angY[body] = angZ[body] = 0.0f;
+	invMass[body] = 0.0f;
+	invInertia[body] = glm::vec3(0.0f);
+	awake[body] = 0.0f;
+	alive[body] = 0;
+	entityGen[body] = EntitiesStorage::INVALID_GEN;
+	freeBodies.push_back(body);
+	--bodyCount;
+}
+
+void PhysicsSystem::Attach(u32 body, EntityID entity) {
+	entityIndex[body] = entity.idx;
+	entityGen[body] = entity.gen;
+}
+
+void PhysicsSystem::AddDistanceJoint(u32 a, u32 b, const glm::vec3& localAnchorA, const glm::vec3& localAnchorB) {
+	auto worldA = position(a) + orientation(a) * localAnchorA;
+	auto worldB = position(b) + orientation(b) * localAnchorB;
+	Joint joint{};
+	joint.a = a;
+	joint.b = b;
+	joint.localAnchorA = localAnchorA;
+	joint.localAnchorB = localAnchorB;
+	joint.length = glm::length(worldB - worldA);
+	joints.push_back(joint);
+	WakeUp(a);
+	WakeUp(b);
+}
+
+void PhysicsSystem::SetVelocity(u32 body, const glm::vec3& velocity, const glm::vec3& angularVelocity) {
+	if (invMass[body] == 0.0f) return;
+	velX[body] = velocity.x;
+	velY[body] = velocity.y;
+	velZ[body] = velocity.z;
+	angX[body] = angularVelocity.x;
+	angY[body] = angularVelocity.y;
+	angZ[body] = angularVelocity.z;
+	WakeUp(body);
+}
+
+void PhysicsSystem::WakeUp(u32 body) {
+	if (invMass[body] == 0.0f) return;
+	awake[body] = 1.0f;
+	sleepTime[body] = 0.0f;
+}
+
+AABB PhysicsSystem::BoundsOf(u32 body) const {
+	auto center = position(body);
+	if (shapes[body] == ShapeType::Sphere) return AABB::FromCenterExtents(center, glm::vec3(sizes[body].x));
+
+	auto rot = glm::mat3_cast(orientation(body));
+	glm::vec3 extents{ 0.0f };
+	for (u32 axis = 0; axis < 3; ++axis) {
+		for (u32 i = 0; i < 3; ++i) extents[i] += std::abs(rot[axis][i]) * sizes[body][axis];
+	}
+	return AABB::FromCenterExtents(center, extents);
+}
+
+void PhysicsSystem::IntegrateVelocities(ThreadPool& pool, f32 dt) {
+	HOENGINE_PROFILE_SCOPE("PhysicsSystem::IntegrateVelocities");
+	auto gx = F32x4::Set1(config.gravity.x * dt);
+	auto gy = F32x4::Set1(config.gravity.y * dt);
+	auto gz = F32x4::Set1(config.gravity.z * dt);
+	auto linear = F32x4::Set1(1.0f / (1.0f + dt * config.linearDamping));
+	auto angular = F32x4::Set1(1.0f / (1.0f + dt * config.angularDamping));
+	auto half = F32x4::Set1(0.5f);
+
+	pool.ParallelFor(posX.size() / 4, std::max<usize>(config.bodyGrain / 4, 1), [&](usize begin, usize end) {
+		for (auto i = begin * 4; i < end * 4; i += 4) {
+			auto active = F32x4::LoadUnaligned(&awake[i]) > half;
+			auto vx = F32x4::LoadUnaligned(&velX[i]);
+			auto vy = F32x4::LoadUnaligned(&velY[i]);
+			auto vz = F32x4::LoadUnaligned(&velZ[i]);
+			Select(active, (vx + gx) * linear, vx).StoreUnaligned(&velX[i]);
+			Select(active, (vy + gy) * linear, vy).StoreUnaligned(&velY[i]);
+			Select(active, (vz + gz) * linear, vz).StoreUnaligned(&velZ[i]);
+			auto wx = F32x4::LoadUnaligned(&angX[i]);
+			auto wy = F32x4::LoadUnaligned(&angY[i]);
+			auto wz = F32x4::LoadUnaligned(&angZ[i]);
+			Select(active, wx * angular, wx).StoreUnaligned(&angX[i]);
+			Select(active, wy * angular, wy).StoreUnaligned(&angY[i]);
+			Select(active, wz * angular, wz).StoreUnaligned(&angZ[i]);
+		}
+	});
+}
+
+void PhysicsSystem::IntegratePositions(ThreadPool& pool, f32 dt) {
+	HOENGINE_PROFILE_SCOPE("PhysicsSystem::IntegratePositions");
+	auto step = F32x4::Set1(dt);
+	auto halfStep = F32x4::Set1(0.5f * dt);
+	auto half = F32x4::Set1(0.5f);
+
+	pool.ParallelFor(posX.size() / 4, std::max<usize>(config.bodyGrain / 4, 1), [&](usize begin, usize end) {
+		for (auto i = begin * 4; i < end * 4; i += 4) {
+			auto active = F32x4::LoadUnaligned(&awake[i]) > half;
+			for (auto [pos, vel] : { std::pair{ &posX, &velX }, std::pair{ &posY, &velY }, std::pair{ &posZ, &velZ } }) {
+				auto p = F32x4::LoadUnaligned(&(*pos)[i]);
+				Select(active, MulAdd(F32x4::LoadUnaligned(&(*vel)[i]), step, p), p).StoreUnaligned(&(*pos)[i]);
+			}
+
+			// q += 0.5 * dt * (w, 0) * q, then normalize
+			auto wx = F32x4::LoadUnaligned(&angX[i]) * halfStep;
+			auto wy = F32x4::LoadUnaligned(&angY[i]) * halfStep;
+			auto wz = F32x4::LoadUnaligned(&angZ[i]) * halfStep;
+			auto qx = F32x4::LoadUnaligned(&rotX[i]);
+			auto qy = F32x4::LoadUnaligned(&rotY[i]);
+			auto qz = F32x4::LoadUnaligned(&rotZ[i]);
+			auto qw = F32x4::LoadUnaligned(&rotW[i]);
+			auto nx = qx + (wx * qw + wy * qz - wz * qy);
+			auto ny = qy + (wy * qw + wz * qx - wx * qz);
+			auto nz = qz + (wz * qw + wx * qy - wy * qx);
+			auto nw = qw - (wx * qx + wy * qy + wz * qz);
+			auto invLength = F32x4::Set1(1.0f) / Sqrt(nx * nx + ny * ny + nz * nz + nw * nw);
+			Select(active, nx * invLength, qx).StoreUnaligned(&rotX[i]);
+			Select(active, ny * invLength, qy).StoreUnaligned(&rotY[i]);
+			Select(active, nz * invLength, qz).StoreUnaligned(&rotZ[i]);
+			Select(active, nw * invLength, qw).StoreUnaligned(&rotW[i]);
+		}
+	});
+}
+
+void PhysicsSystem::Collide(u32 a, u32 b, std::vector<Contact>& out) const {
+	auto add = [&](const glm::vec3& normal, const glm::vec3& point, f32 depth) {
+		Contact contact{};
+		contact.a = a;
+		contact.b = b;
+		contact.normal = normal;
+		contact.point = point;
+		contact.depth = depth;
+		out.push_back(contact);
+	};
+	auto pa = position(a);
+	auto pb = position(b);
+
+	if (shapes[a] == ShapeType::Sphere && shapes[b] == ShapeType::Sphere) {
+		auto ra = sizes[a].x;
+		auto rb = sizes[b].x;
+		auto d = pb - pa;
+		auto distance = glm::length(d);
+		if (distance >= ra + rb) return;
+		auto normal = distance > 1e-6f ? d / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+		auto depth = ra + rb - distance;
+		add(normal, pa + normal * (ra - 0.5f * depth), depth);
+	} else if (shapes[a] == ShapeType::Box && shapes[b] == ShapeType::Box) {
+		CollideBoxes(OrientedBox::Of(position(a), orientation(a), sizes[a]), OrientedBox::Of(position(b), orientation(b), sizes[b]), add);
+	} else {
+		auto sphere = shapes[a] == ShapeType::Sphere ? a : b;
+		auto box = sphere == a ? b : a;
+		auto radius = sizes[sphere].x;
+		auto center = position(sphere);
+		auto boxCenter = position(box);
+		auto rot = orientation(box);
+
+		auto local = glm::conjugate(rot) * (center - boxCenter);
+		auto clamped = glm::min(glm::max(local, -sizes[box]), sizes[box]);
+		glm::vec3 outward;
+		glm::vec3 surface;
+		f32 depth;
+		if (clamped == local) {
+			// Center inside the box, push out through the nearest face
+			auto hit = PointInBox(center, boxCenter, rot, sizes[box]);
+			if (!hit) return;
+			outward = hit->normal;
+			depth = hit->depth + radius;
+			surface = center + outward * hit->depth;
+		} else {
+			auto d = local - clamped;
+			auto distance = glm::length(d);
+			if (distance >= radius) return;
+			outward = rot * (d / distance);
+			depth = radius - distance;
+			surface = boxCenter + rot * clamped;
+		}
+		add(sphere == a ? -outward : outward, surface, depth);
+	}
+}
+
+u32 PhysicsSystem::Find(u32 body) {
+	while (parent[body] != body) {
+		parent[body] = parent[parent[body]];
+		body = parent[body];
+	}
+	return body;
+}
+
+void PhysicsSystem::Union(u32 a, u32 b) {
+	a = Find(a);
+	b = Find(b);
+	// The lowest body is the root, so islands don't depend on the merge order
+	if (a < b) {
+		parent[b] = a;
+	} else if (b < a) {
+		parent[a] = b;
+	}
+}
+
+void PhysicsSystem::BuildIslands() {
+	HOENGINE_PROFILE_SCOPE("PhysicsSystem::BuildIslands");
+	auto count = static_cast<u32>(posX.size());
+	for (u32 body = 0; body < count; ++body) parent[body] = body;
+	auto dynamic = [&](u32 body) { return invMass[body] > 0.0f; };
+	for (const auto& c : contacts) {
+		if (dynamic(c.a) && dynamic(c.b)) Union(c.a, c.b);
+	}
+	for (const auto& j : joints) {
+		if (dynamic(j.a) && dynamic(j.b)) Union(j.a, j.b);
+	}
+
+	// Anything linked to an awake body wakes up
+	std::vector<u8> rootAwake(count, 0);
+	for (u32 body = 0; body < count; ++body) {
+		if (dynamic(body) && awake[body] != 0.0f) rootAwake[Find(body)] = 1;
+	}
+	for (u32 body = 0; body < count; ++body) {
+		if (dynamic(body) && rootAwake[Find(body)] && awake[body] == 0.0f) WakeUp(body);
+	}
+
+	// Islands in order of their lowest body, which is also their root
+	std::vector<u32> islandOf(count, nullBody);
+	islands.clear();
+	for (u32 body = 0; body < count; ++body) {
+		if (!dynamic(body) || awake[body] == 0.0f) continue;
+		auto root = Find(body);
+		if (islandOf[root] == nullBody) {
+			islandOf[root] = static_cast<u32>(islands.size());
+			islands.push_back({});
+		}
+		islandOf[body] = islandOf[root];
+	}
+	auto constraintIsland = [&](u32 a, u32 b) {
+		return islandOf[dynamic(a) ? a : b];
+	};
+
+	// Counting sort of the bodies and constraints by island, keeping their order
+	std::vector<u32> counts(islands.size() * 3, 0);
+	auto bodyCounts = counts.data();
+	auto contactCounts = bodyCounts + islands.size();
+	auto jointCounts = contactCounts + islands.size();
+	for (u32 body = 0; body < count; ++body) {
+		if (islandOf[body] != nullBody) ++bodyCounts[islandOf[body]];
+	}
+	for (const auto& c : contacts) {
+		auto island = constraintIsland(c.a, c.b);
+		if (island != nullBody) ++contactCounts[island];
+	}
+	for (const auto& j : joints) {
+		auto island = constraintIsland(j.a, j.b);
+		if (island != nullBody) ++jointCounts[island];
+	}
+	u32 bodyOffset = 0, contactOffset = 0, jointOffset = 0;
+	for (usize i = 0; i < islands.size(); ++i) {
+		islands[i] = Island{
+			bodyOffset, bodyOffset,
+			contactOffset, contactOffset,
+			jointOffset, jointOffset,
+		};
+		bodyOffset += bodyCounts[i];
+		contactOffset += contactCounts[i];
+		jointOffset += jointCounts[i];
+	}
+	islandBodies.resize(bodyOffset);
+	islandContacts.resize(contactOffset);
+	islandJoints.resize(jointOffset);
+	for (u32 body = 0; body < count; ++body) {
+		if (islandOf[body] != nullBody) islandBodies[islands[islandOf[body]].bodyEnd++] = body;
+	}
+	for (u32 i = 0; i < contacts.size(); ++i) {
+		auto island = constraintIsland(contacts[i].a, contacts[i].b);
+		if (island != nullBody) islandContacts[islands[island].contactEnd++] = i;
+	}
+	for (u32 i = 0; i < joints.size(); ++i) {
+		auto island = constraintIsland(joints[i].a, joints[i].b);
+		if (island != nullBody) islandJoints[islands[island].jointEnd++] = i;
+	}
+}
+
+void PhysicsSystem::SolveIsland(const Island& island, f32 dt) {
+	ScratchArena scratch;
+	std::pmr::vector<SolverBody> solverBodies(scratch.resource());
+	solverBodies.reserve(island.bodyEnd - island.bodyBegin + 1);
+	solverBodies.push_back(SolverBody{ glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, glm::mat3(0.0f) });
+	for (auto i = island.bodyBegin; i < island.bodyEnd; ++i) {
+		auto body = islandBodies[i];
+		auto rot = glm::mat3_cast(orientation(body));
+		auto inertia = rot * glm::mat3(
+			glm::vec3(invInertia[body].x, 0.0f, 0.0f),
+			glm::vec3(0.0f, invInertia[body].y, 0.0f),
+			glm::vec3(0.0f, 0.0f, invInertia[body].z)) * glm::transpose(rot);
+		solverBodies.push_back(SolverBody{ velocity(body), angularVelocity(body), invMass[body], inertia });
+	}
+	// Island bodies are sorted, so their solver index is found by binary search
+	auto first = islandBodies.begin() + island.bodyBegin;
+	auto last = islandBodies.begin() + island.bodyEnd;
+	auto solverIndex = [&](u32 body) -> usize {
+		if (invMass[body] == 0.0f) return 0;
+		return static_cast<usize>(std::lower_bound(first, last, body) - first) + 1;
+	};
+	std::pmr::vector<std::pair<u32, u32>> contactBodies(scratch.resource());
+	std::pmr::vector<std::pair<u32, u32>> jointBodies(scratch.resource());
+
+	auto invDt = 1.0f / dt;
+	for (auto i = island.contactBegin; i < island.contactEnd; ++i) {
+		auto& c = contacts[islandContacts[i]];
+		auto ia = solverIndex(c.a);
+		auto ib = solverIndex(c.b);
+		contactBodies.emplace_back(static_cast<u32>(ia), static_cast<u32>(ib));
+		const auto& a = solverBodies[ia];
+		const auto& b = solverBodies[ib];
+		c.ra = c.point - position(c.a);
+		c.rb = c.point - position(c.b);
+		c.normalMass = EffectiveMass(a, b, c.ra, c.rb, c.normal);
+		c.tangent[0] = Perpendicular(c.normal);
+		c.tangent[1] = glm::cross(c.normal, c.tangent[0]);
+		for (u32 t = 0; t < 2; ++t) c.tangentMass[t] = EffectiveMass(a, b, c.ra, c.rb, c.tangent[t]);
+
+		c.bias = config.baumgarte * invDt * std::max(c.depth - config.slop, 0.0f);
+		auto closing = glm::dot(RelativeVelocity(a, b, c.ra, c.rb), c.normal);
+		if (closing < -config.restitutionThreshold) {
+			c.bias = std::max(c.bias, -std::max(restitution[c.a], restitution[c.b]) * closing);
+		}
+		c.normalImpulse = 0.0f;
+		c.tangentImpulse[0] = c.tangentImpulse[1] = 0.0f;
+	}
+	for (auto i = island.jointBegin; i < island.jointEnd; ++i) {
+		auto& j = joints[islandJoints[i]];
+		auto ia = solverIndex(j.a);
+		auto ib = solverIndex(j.b);
+		jointBodies.emplace_back(static_cast<u32>(ia), static_cast<u32>(ib));
+		j.ra = orientation(j.a) * j.localAnchorA;
+		j.rb = orientation(j.b) * j.localAnchorB;
+		auto d = position(j.b) + j.rb - position(j.a) - j.ra;
+		auto length = glm::length(d);
+		j.axis = length > 1e-6f ? d / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		j.mass = EffectiveMass(solverBodies[ia], solverBodies[ib], j.ra, j.rb, j.axis);
+		j.bias = config.baumgarte * invDt * (length - j.length);
+		j.impulse = 0.0f;
+	}
+
+	for (u32 iteration = 0; iteration < config.velocityIterations; ++iteration) {
+		for (auto i = island.jointBegin; i < island.jointEnd; ++i) {
+			auto& j = joints[islandJoints[i]];
+			auto [ia, ib] = jointBodies[i - island.jointBegin];
+			auto& a = solverBodies[ia];
+			auto& b = solverBodies[ib];
+			auto speed = glm::dot(RelativeVelocity(a, b, j.ra, j.rb), j.axis);
+			auto lambda = -j.mass * (speed + j.bias);
+			j.impulse += lambda;
+			ApplyImpulse(a, b, j.ra, j.rb, j.axis * lambda);
+		}
+		for (auto i = island.contactBegin; i < island.contactEnd; ++i) {
+			auto& c = contacts[islandContacts[i]];
+			auto [ia, ib] = contactBodies[i - island.contactBegin];
+			auto& a = solverBodies[ia];
+			auto& b = solverBodies[ib];
+
+			// Friction first, bounded by the current normal impulse
+			auto limit = std::max(friction[c.a], friction[c.b]) * c.normalImpulse;
+			for (u32 t = 0; t < 2; ++t) {
+				auto speed = glm::dot(RelativeVelocity(a, b, c.ra, c.rb), c.tangent[t]);
+				auto total = std::clamp(c.tangentImpulse[t] - c.tangentMass[t] * speed, -limit, limit);
+				auto lambda = total - c.tangentImpulse[t];
+				c.tangentImpulse[t] = total;
+				ApplyImpulse(a, b, c.ra, c.rb, c.tangent[t] * lambda);
+			}
+
+			auto speed = glm::dot(RelativeVelocity(a, b, c.ra, c.rb), c.normal);
+			auto total = std::max(c.normalImpulse + c.normalMass * (c.bias - speed), 0.0f);
+			auto lambda = total - c.normalImpulse;
+			c.normalImpulse = total;
+			ApplyImpulse(a, b, c.ra, c.rb, c.normal * lambda);
+		}
+	}
+
+	// Store the velocities, and put the island to sleep if it stayed slow long enough
+	auto linear2 = config.linearSleepTolerance * config.linearSleepTolerance;
+	auto angular2 = config.angularSleepTolerance * config.angularSleepTolerance;
+	auto minSleepTime = std::numeric_limits<f32>::max();
+	for (auto i = island.bodyBegin; i < island.bodyEnd; ++i) {
+		auto body = islandBodies[i];
+		const auto& s = solverBodies[i - island.bodyBegin + 1];
+		velX[body] = s.v.x;
+		velY[body] = s.v.y;
+		velZ[body] = s.v.z;
+		angX[body] = s.w.x;
+		angY[body] = s.w.y;
+		angZ[body] = s.w.z;
+		if (glm::dot(s.v, s.v) > linear2 || glm::dot(s.w, s.w) > angular2) {
+			sleepTime[body] = 0.0f;
+		} else {
+			sleepTime[body] += dt;
+		}
+		minSleepTime = std::min(minSleepTime, sleepTime[body]);
+	}
+	if (minSleepTime >= config.timeToSleep) {
+		for (auto i = island.bodyBegin; i < island.bodyEnd; ++i) {
+			auto body = islandBodies[i];
+			awake[body] = 0.0f;
+			velX[body] = velY[body] = velZ[body] = 0.0f;
+			angX[body] = angY[body] = angZ[body] = 0.0f;
+		}
+	}
+}
+
+void PhysicsSystem::Step(ThreadPool& pool, f32 dt) {
+	HOENGINE_PROFILE_SCOPE("PhysicsSystem::Step");
+	auto stepStart = std::chrono::steady_clock::now();
+	IntegrateVelocities(pool, dt);
+
+	auto start = std::chrono::steady_clock::now();
+	pool.ParallelFor(posX.size(), config.bodyGrain, [&](usize begin, usize end) {
+		for (auto body = static_cast<u32>(begin); body < end; ++body) {
+			if (awake[body] != 0.0f) broadphase_.Move(proxies[body], BoundsOf(body));
+		}
+	});
+	const auto& pairs = broadphase_.Update(pool);
+	stats_.broadphaseTime = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	auto chunks = (pairs.size() + pairGrain - 1) / pairGrain;
+	if (pairContacts.size() < chunks) pairContacts.resize(chunks);
+	pool.ParallelTasks(chunks, [&](usize chunk) {
+		auto& out = pairContacts[chunk];
+		out.clear();
+		auto end = std::min(pairs.size(), (chunk + 1) * pairGrain);
+		for (auto i = chunk * pairGrain; i < end; ++i) {
+			auto a = bodyOfProxy[pairs[i].a];
+			auto b = bodyOfProxy[pairs[i].b];
+			// Sleeping bodies only collide with awake ones
+			if (awake[a] == 0.0f && awake[b] == 0.0f) continue;
+			Collide(a, b, out);
+		}
+	});
+	contacts.clear();
+	for (usize chunk = 0; chunk < chunks; ++chunk) {
+		contacts.insert(contacts.end(), pairContacts[chunk].begin(), pairContacts[chunk].end());
+	}
+	stats_.narrowphaseTime = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	BuildIslands();
+	pool.ParallelFor(islands.size(), config.islandGrain, [&](usize begin, usize end) {
+		for (auto i = begin; i < end; ++i) SolveIsland(islands[i], dt);
+	});
+	IntegratePositions(pool, dt);
+	stats_.solveTime = MillisecondsSince(start);
+
+	stats_.bodies = bodyCount;
+	stats_.awakeBodies = static_cast<usize>(std::count_if(awake.begin(), awake.end(), [](f32 a) { return a != 0.0f; }));
+	stats_.contacts = contacts.size();
+	stats_.joints = joints.size();
+	stats_.islands = islands.size();
+	stats_.stepTime = MillisecondsSince(stepStart);
+	HOENGINE_PROFILE_COUNTER("Physics contacts", stats_.contacts);
+	HOENGINE_PROFILE_COUNTER("Physics awake bodies", stats_.awakeBodies);
+}
+
+void PhysicsSystem::WriteBack(ThreadPool& pool, EntitiesStorage& storage) const {
+	HOENGINE_PROFILE_SCOPE("PhysicsSystem::WriteBack");
+	// Lookups only read the storage, and each body writes its own component
+	pool.ParallelFor(posX.size(), config.bodyGrain, [&](usize begin, usize end) {
+		for (auto body = static_cast<u32>(begin); body < end; ++body) {
+			if (!alive[body] || invMass[body] == 0.0f || entityGen[body] == EntitiesStorage::INVALID_GEN) continue;
+			auto entity = storage.Get(EntityID{ entityIndex[body], entityGen[body] });
+			if (!entity) continue;
+			auto transform = entity->GetComponent<TransformComponent>();
+			if (!transform) continue;
+			transform->pos = position(body);
+			transform->rot = orientation(body);
+		}
+	});
+}
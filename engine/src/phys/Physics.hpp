@@ -1,11 +1,206 @@
 #pragma once
 
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include "Engine.hpp"
 #include "Entity.hpp"
+#include "ThreadPool.hpp"
+#include "phys/Broadphase.hpp"
 
 namespace HOEngine {
 
+enum class ShapeType : u8 {
+	Sphere,
+	Box,
+};
+
+struct BodyDesc {
+	ShapeType shape = ShapeType::Sphere;
+	/// Radius in `x` for spheres, half extents for boxes.
+	glm::vec3 size{ 0.5f };
+	glm::vec3 pos{ 0.0f };
+	glm::quat rot{ 1.0f, 0.0f, 0.0f, 0.0f };
+	glm::vec3 velocity{ 0.0f };
+	glm::vec3 angularVelocity{ 0.0f };
+	/// Zero for static bodies.
+	f32 mass = 1.0f;
+	f32 friction = 0.5f;
+	f32 restitution = 0.0f;
+};
+
+/// Rigid body simulation: bodies stored as structure-of-arrays, contacts and
+/// joints solved with sequential impulses.
+///
+/// Each step integrates velocities four bodies at a time, finds overlapping pairs
+/// with the `Broadphase` and turns them into contact points (sphere-sphere,
+/// sphere-box, and box-box by separating axes and face clipping). Bodies linked by
+/// contacts or joints are grouped into islands with a union-find, and the islands
+/// are solved in parallel, each on a single thread. An island whose bodies all
+/// stayed slow for `timeToSleep` is put to sleep, and woken when touched by an
+/// awake body or through `SetVelocity`.
+///
+/// Every stage processes bodies, pairs and islands in an order independent of
+/// the number of threads, so results are identical for any `ThreadPool`.
 class PhysicsSystem {
+public:
+	static constexpr u32 nullBody = ~0u;
+
+	struct Config {
+		Broadphase::Config broadphase;
+		glm::vec3 gravity{ 0.0f, -9.81f, 0.0f };
+		u32 velocityIterations = 8;
+		/// Fraction of the penetration corrected per step.
+		f32 baumgarte = 0.2f;
+		/// Penetration allowed without correction, avoiding jitter in resting contacts.
+		f32 slop = 0.005f;
+		/// Closing speed below which contacts don't bounce.
+		f32 restitutionThreshold = 1.0f;
+		f32 linearDamping = 0.01f;
+		f32 angularDamping = 0.05f;
+		f32 linearSleepTolerance = 0.05f;
+		f32 angularSleepTolerance = 0.05f;
+		/// Seconds an island must stay under the tolerances before sleeping.
+		f32 timeToSleep = 0.5f;
+		/// Islands per job when solving.
+		usize islandGrain = 16;
+		/// Bodies per job when integrating.
+		usize bodyGrain = 1024;
+	};
+
+	struct Stats {
+		usize bodies = 0;
+		usize awakeBodies = 0;
+		usize contacts = 0;
+		usize joints = 0;
+		/// Awake islands solved during the last step.
+		usize islands = 0;
+		/// CPU times of the last step, in milliseconds.
+		f64 broadphaseTime = 0;
+		f64 narrowphaseTime = 0;
+		f64 solveTime = 0;
+		f64 stepTime = 0;
+	};
+
+private:
+	struct Contact {
+		u32 a;
+		u32 b;
+		/// From `a` to `b`.
+		glm::vec3 normal;
+		glm::vec3 point;
+		f32 depth;
+
+		// Filled while solving
+		glm::vec3 ra, rb;
+		glm::vec3 tangent[2];
+		f32 normalMass;
+		f32 tangentMass[2];
+		f32 bias;
+		f32 normalImpulse;
+		f32 tangentImpulse[2];
+	};
+
+	/// Keeps two anchor points at a fixed distance.
+	struct Joint {
+		u32 a;
+		u32 b;
+		glm::vec3 localAnchorA;
+		glm::vec3 localAnchorB;
+		f32 length;
+
+		// Filled while solving
+		glm::vec3 ra, rb;
+		glm::vec3 axis;
+		f32 mass;
+		f32 bias;
+		f32 impulse;
+	};
+
+	/// Ranges of `islandBodies`, `islandContacts` and `islandJoints`.
+	struct Island {
+		u32 bodyBegin, bodyEnd;
+		u32 contactBegin, contactEnd;
+		u32 jointBegin, jointEnd;
+	};
+
+	Config config;
+	Broadphase broadphase_;
+	Stats stats_;
+
+	/// Per body state, structure-of-arrays, sized to a multiple of four.
+	std::vector<f32> posX, posY, posZ;
+	std::vector<f32> rotX, rotY, rotZ, rotW;
+	std::vector<f32> velX, velY, velZ;
+	std::vector<f32> angX, angY, angZ;
+	std::vector<f32> invMass;
+	/// Inverse inertia around the local axes.
+	std::vector<glm::vec3> invInertia;
+	/// 1 for awake dynamic bodies, 0 for sleeping, static and removed ones.
+	std::vector<f32> awake;
+	std::vector<f32> sleepTime;
+	std::vector<ShapeType> shapes;
+	std::vector<glm::vec3> sizes;
+	std::vector<f32> friction, restitution;
+	std::vector<u32> proxies;
+	std::vector<u8> alive;
+	/// Entity of each body, generation 0 for none.
+	std::vector<usize> entityIndex;
+	std::vector<u64> entityGen;
+	std::vector<u32> freeBodies;
+	usize bodyCount = 0;
+	/// Body of each broadphase handle.
+	std::vector<u32> bodyOfProxy;
+
+	std::vector<Joint> joints;
+	std::vector<std::vector<Contact>> pairContacts;
+	std::vector<Contact> contacts;
+
+	std::vector<u32> parent;
+	std::vector<Island> islands;
+	std::vector<u32> islandBodies;
+	std::vector<u32> islandContacts;
+	std::vector<u32> islandJoints;
+
+public:
+	explicit PhysicsSystem(Config config);
+	PhysicsSystem() : PhysicsSystem(Config{}) {}
+
+	u32 AddBody(const BodyDesc& desc);
+	/// Remove a body, along with its joints.
+	void RemoveBody(u32 body);
+	/// Make the `TransformComponent` of `entity` follow the body in `WriteBack`.
+	void Attach(u32 body, EntityID entity);
+	/// Keep the given points of two bodies, in their local space, at their current distance.
+	void AddDistanceJoint(u32 a, u32 b, const glm::vec3& localAnchorA, const glm::vec3& localAnchorB);
+
+	/// Advance the simulation by `dt` seconds.
+	void Step(ThreadPool& pool, f32 dt);
+	/// Copy the pose of every dynamic body to the `TransformComponent` of its entity.
+	void WriteBack(ThreadPool& pool, EntitiesStorage& storage) const;
+
+	glm::vec3 position(u32 body) const { return glm::vec3(posX[body], posY[body], posZ[body]); }
+	glm::quat orientation(u32 body) const { return glm::quat(rotW[body], rotX[body], rotY[body], rotZ[body]); }
+	glm::vec3 velocity(u32 body) const { return glm::vec3(velX[body], velY[body], velZ[body]); }
+	glm::vec3 angularVelocity(u32 body) const { return glm::vec3(angX[body], angY[body], angZ[body]); }
+	bool IsAwake(u32 body) const { return awake[body] != 0.0f; }
+	/// Set the velocity of a dynamic body, waking it up.
+	void SetVelocity(u32 body, const glm::vec3& velocity, const glm::vec3& angularVelocity);
+	void WakeUp(u32 body);
+
+	Broadphase& broadphase() { return broadphase_; }
+	const Broadphase& broadphase() const { return broadphase_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	AABB BoundsOf(u32 body) const;
+	void IntegrateVelocities(ThreadPool& pool, f32 dt);
+	void IntegratePositions(ThreadPool& pool, f32 dt);
+	void Collide(u32 a, u32 b, std::vector<Contact>& out) const;
+	u32 Find(u32 body);
+	void Union(u32 a, u32 b);
+	void BuildIslands();
+	void SolveIsland(const Island& island, f32 dt);
 };
 
 } // namespace HOEngine
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include "Atlas.hpp"
+#include "Profiler.hpp"
+
+using namespace HOEngine;
+
+SkylinePacker::SkylinePacker(u32 pageSize, u32 padding, u32 maxPages)
+	: pageSize_{ pageSize }, padding_{ padding }, maxPages_{ maxPages } {
+}
+
+std::optional<std::pair<u32, usize>> SkylinePacker::FindPosition(const Page& page, u32 width, u32 height) const {
+	auto bestY = std::numeric_limits<u32>::max();
+	auto bestWidth = std::numeric_limits<u32>::max();
+	usize best = 0;
+	const auto& skyline = page.skyline;
+	for (usize i = 0; i < skyline.size(); ++i) {
+		// Segments are sorted by x, the ones after won't fit either
+		if (skyline[i].x + width > pageSize_) break;
+		// Resting on the highest segment below the rectangle
+		u32 y = 0;
+		auto remaining = width;
+		for (auto j = i; remaining > 0; ++j) {
+			y = std::max(y, skyline[j].y);
+			remaining -= std::min(remaining, skyline[j].width);
+		}
+		if (y + height > pageSize_) continue;
+		if (y < bestY || (y == bestY && skyline[i].width < bestWidth)) {
+			bestY = y;
+			bestWidth = skyline[i].width;
+			best = i;
+		}
+	}
+	if (bestY == std::numeric_limits<u32>::max()) return {};
+	return std::pair{ bestY, best };
+}
+
+void SkylinePacker::Place(Page& page, usize segment, u32 width, u32 height) {
+	auto& skyline = page.skyline;
+	auto x = skyline[segment].x;
+	u32 y = 0;
+	auto remaining = width;
+	for (auto j = segment; remaining > 0; ++j) {
+		y = std::max(y, skyline[j].y);
+		remaining -= std::min(remaining, skyline[j].width);
+	}
+
+	// The rectangle's top replaces the segments it covers
+	skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(segment), Segment{ x, y + height, width });
+	auto end = x + width;
+	auto next = segment + 1;
+	while (next < skyline.size() && skyline[next].x < end) {
+		auto covered = end - skyline[next].x;
+		if (covered >= skyline[next].width) {
+			skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(next));
+		} else {
+			skyline[next].x += covered;
+			skyline[next].width -= covered;
+			break;
+		}
+	}
+
+	// Merge neighbours at the same height
+	for (usize i = 0; i + 1 < skyline.size();) {
+		if (skyline[i].y == skyline[i + 1].y) {
+			skyline[i].width += skyline[i + 1].width;
+			skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(i + 1));
+		} else {
+			++i;
+		}
+	}
+}
+
+std::optional<AtlasRegion> SkylinePacker::Insert(u32 width, u32 height) {
+	auto paddedWidth = width + 2 * padding_;
+	auto paddedHeight = height + 2 * padding_;
+	if (width == 0 || height == 0 || paddedWidth > pageSize_ || paddedHeight > pageSize_) return {};
+
+	auto place = [&](u32 index, std::pair<u32, usize> position) {
+		auto& page = pages[index];
+		auto x = page.skyline[position.second].x;
+		Place(page, position.second, paddedWidth, paddedHeight);
+		page.usedArea += usize{ width } * height;
+		auto size = static_cast<f32>(pageSize_);
+		auto rx = x + padding_;
+		auto ry = position.first + padding_;
+		return AtlasRegion{
+			index, rx, ry, width, height,
+			glm::vec4(static_cast<f32>(rx) / size, static_cast<f32>(ry) / size,
+				static_cast<f32>(rx + width) / size, static_cast<f32>(ry + height) / size),
+		};
+	};
+
+	for (u32 index = 0; index < pages.size(); ++index) {
+		if (auto position = FindPosition(pages[index], paddedWidth, paddedHeight)) return place(index, *position);
+	}
+	if (pages.size() >= maxPages_) return {};
+	pages.push_back(Page{ { Segment{ 0, 0, pageSize_ } }, 0 });
+	auto index = static_cast<u32>(pages.size() - 1);
+	return place(index, *FindPosition(pages[index], paddedWidth, paddedHeight));
+}
+
+f32 SkylinePacker::Occupancy(u32 page) const {
+	return static_cast<f32>(static_cast<f64>(pages[page].usedArea) / (static_cast<f64>(pageSize_) * pageSize_));
+}
+
+f32 SkylinePacker::Occupancy() const {
+	if (pages.empty()) return 0.0f;
+	usize used = 0;
+	for (const auto& page : pages) used += page.usedArea;
+	return static_cast<f32>(static_cast<f64>(used) / (static_cast<f64>(pageSize_) * pageSize_ * pages.size()));
+}
+
+SpriteAtlas::SpriteAtlas(Config config)
+	: config{ config } {
+}
+
+SpriteID SpriteAtlas::Add(const Image& image) {
+	if (image.format != TextureFormat::RGBA8 && image.format != TextureFormat::SRGBA8) {
+		throw std::runtime_error("Atlas images must be uncompressed");
+	}
+	auto& added = images.emplace_back(Image::Uncompressed(image.width(), image.height(), image.format == TextureFormat::SRGBA8));
+	auto data = image.LevelData(0);
+	std::memcpy(added.data.data(), data.data(), data.size());
+	return static_cast<SpriteID>(images.size() - 1);
+}
+
+void SpriteAtlas::Build() {
+	HOENGINE_PROFILE_SCOPE("SpriteAtlas::Build");
+	std::vector<SpriteID> order(images.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](SpriteID a, SpriteID b) {
+		if (images[a].height() != images[b].height()) return images[a].height() > images[b].height();
+		return images[a].width() > images[b].width();
+	});
+
+	SkylinePacker packer(config.pageSize, config.padding, config.maxPages);
+	regions.assign(images.size(), AtlasRegion{});
+	for (auto sprite : order) {
+		auto region = packer.Insert(images[sprite].width(), images[sprite].height());
+		if (!region) throw std::runtime_error("Sprite doesn't fit in the atlas");
+		regions[sprite] = *region;
+	}
+	occupancy_ = packer.Occupancy();
+
+	pages.clear();
+	textures.clear();
+	for (u32 page = 0; page < packer.pageCount(); ++page) {
+		pages.push_back(Image::Uncompressed(config.pageSize, config.pageSize, config.srgb));
+	}
+	auto pad = static_cast<i64>(config.padding);
+	for (usize sprite = 0; sprite < images.size(); ++sprite) {
+		const auto& region = regions[sprite];
+		const auto* src = reinterpret_cast<const u32*>(images[sprite].data.data());
+		auto* dst = reinterpret_cast<u32*>(pages[region.page].data.data());
+		auto w = static_cast<i64>(region.width);
+		auto h = static_cast<i64>(region.height);
+		// Edges are repeated over the padding
+		for (auto y = -pad; y < h + pad; ++y) {
+			const auto* srcRow = src + std::clamp<i64>(y, 0, h - 1) * w;
+			auto* dstRow = dst + (static_cast<i64>(region.y) + y) * config.pageSize + region.x;
+			for (auto x = -pad; x < 0; ++x) dstRow[x] = srcRow[0];
+			std::memcpy(dstRow, srcRow, static_cast<usize>(w) * sizeof(u32));
+			for (auto x = w; x < w + pad; ++x) dstRow[x] = srcRow[w - 1];
+		}
+	}
+}
+
+void SpriteAtlas::Upload() {
+	textures.clear();
+	for (const auto& page : pages) {
+		auto& texture = textures.emplace_back(page.format, page.width(), page.height(), 1);
+		texture.Upload(0, page.data.data());
+		texture.SetSampling(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "GLWrapper.hpp"
+#include "Image.hpp"
+
+namespace HOEngine {
+
+/// Rectangle of an atlas page, padding excluded.
+struct AtlasRegion {
+	u32 page;
+	u32 x;
+	u32 y;
+	u32 width;
+	u32 height;
+	/// Texture coordinates of the lower left and upper right corners.
+	glm::vec4 uv;
+};
+
+/// Packs rectangles into square pages with the skyline bottom-left heuristic.
+///
+/// Each page only keeps the upper outline of what it holds, as horizontal
+/// segments. A rectangle goes where its top ends up lowest, ties going to the
+/// narrowest segment, and the space it hides below the outline is lost. That
+/// waste is small when rectangles come tallest first.
+class SkylinePacker {
+private:
+	struct Segment {
+		u32 x;
+		u32 y;
+		u32 width;
+	};
+
+	struct Page {
+		std::vector<Segment> skyline;
+		usize usedArea = 0;
+	};
+
+	u32 pageSize_;
+	u32 padding_;
+	u32 maxPages_;
+	std::vector<Page> pages;
+
+public:
+	/// `padding` pixels are kept free around every rectangle.
+	SkylinePacker(u32 pageSize, u32 padding, u32 maxPages);
+
+	/// Place a `width` by `height` rectangle in the first page with room for it,
+	/// opening a page if none has. `std::nullopt` if it's larger than a page or
+	/// every page is full.
+	std::optional<AtlasRegion> Insert(u32 width, u32 height);
+
+	/// Fraction of the pages' area covered by rectangles, padding excluded.
+	f32 Occupancy() const;
+	f32 Occupancy(u32 page) const;
+	u32 pageCount() const { return static_cast<u32>(pages.size()); }
+	u32 pageSize() const { return pageSize_; }
+
+private:
+	/// Lowest top of a rectangle of `width` by `height` in `page`, and the segment
+	/// it starts at, `std::nullopt` if it doesn't fit.
+	std::optional<std::pair<u32, usize>> FindPosition(const Page& page, u32 width, u32 height) const;
+	void Place(Page& page, usize segment, u32 width, u32 height);
+};
+
+using SpriteID = u32;
+
+/// Small images packed into texture pages at startup, for `SpriteBatch`.
+///
+/// Images are added first, then `Build` packs them tallest first and copies them
+/// into page images, extruding their edges into the padding so filtering never
+/// reads a neighbour. `Upload` turns the pages into textures.
+class SpriteAtlas {
+public:
+	struct Config {
+		u32 pageSize = 2048;
+		/// Extruded border around each image.
+		u32 padding = 2;
+		u32 maxPages = 16;
+		/// Format of the pages, whatever the images' own.
+		bool srgb = true;
+	};
+
+private:
+	Config config;
+	/// First level of every image added.
+	std::vector<Image> images;
+	std::vector<AtlasRegion> regions;
+	std::vector<Image> pages;
+	std::vector<Texture> textures;
+	f32 occupancy_ = 0;
+
+public:
+	explicit SpriteAtlas(Config config);
+	SpriteAtlas() : SpriteAtlas(Config{}) {}
+
+	/// Queue the first level of an RGBA8 or SRGBA8 image. Throws for other formats.
+	SpriteID Add(const Image& image);
+	/// Pack every image added so far, from scratch. Throws if one doesn't fit.
+	void Build();
+	/// Create the page textures from the built pages. Requires a current context.
+	void Upload();
+
+	const AtlasRegion& region(SpriteID sprite) const { return regions[sprite]; }
+	usize spriteCount() const { return regions.size(); }
+	u32 pageCount() const { return static_cast<u32>(pages.size()); }
+	const Image& pageImage(u32 page) const { return pages[page]; }
+	/// Valid after `Upload`.
+	GLuint pageTexture(u32 page) const { return textures[page]; }
+	/// Fraction of the pages covered by images after `Build`.
+	f32 occupancy() const { return occupancy_; }
+};
+
+} // namespace HOEngine
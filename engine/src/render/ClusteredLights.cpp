@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "ClusteredLights.hpp"
+#include "Profiler.hpp"
+#include "Simd.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Extra elements at the end of the cluster bounds, so 4-wide loads starting at
+	/// the last cluster stay in bounds.
+	constexpr usize simdPadding = 3;
+
+	u32 TileOf(f32 ndc, u32 tiles) {
+		auto tile = std::floor((ndc * 0.5f + 0.5f) * static_cast<f32>(tiles));
+		return static_cast<u32>(std::clamp(tile, 0.0f, static_cast<f32>(tiles - 1)));
+	}
+}
+
+LightClusters::LightClusters(Config config)
+	: config_{ config } {
+	clusterLists.resize(clusterCount());
+	ranges_.resize(clusterCount());
+}
+
+void LightClusters::Clear() {
+	lights_.clear();
+}
+
+void LightClusters::Add(const glm::vec3& pos, f32 radius, const glm::vec3& color, f32 strength) {
+	lights_.push_back(GpuLight{ glm::vec4(pos, radius), glm::vec4(color, strength) });
+}
+
+void LightClusters::Gather(EntitiesStorage& storage) {
+	HOENGINE_PROFILE_SCOPE("LightClusters::Gather");
+	Clear();
+	for (usize idx = 0; idx < storage.Capacity(); ++idx) {
+		auto entity = storage.At(idx);
+		if (!entity) continue;
+		auto light = entity->GetComponent<DotLightComponent>();
+		if (!light) continue;
+		auto transform = entity->GetComponent<TransformComponent>();
+		if (!transform) continue;
+		Add(transform->pos, light->radius, light->color, light->strength);
+	}
+}
+
+u32 LightClusters::SliceOf(f32 depth) const {
+	auto slice = std::floor(std::log(std::max(depth, near_)) * sliceScale() - sliceBias());
+	return static_cast<u32>(std::clamp(slice, 0.0f, static_cast<f32>(config_.slices - 1)));
+}
+
+f32 LightClusters::sliceScale() const {
+	return static_cast<f32>(config_.slices) / std::log(far_ / near_);
+}
+
+f32 LightClusters::sliceBias() const {
+	return static_cast<f32>(config_.slices) * std::log(near_) / std::log(far_ / near_);
+}
+
+void LightClusters::BuildClusterBounds(const glm::mat4& proj, f32 near, f32 far) {
+	// Only depends on the projection, which rarely changes
+	if (proj == proj_ && near == near_ && far == far_ && !minX.empty()) return;
+	proj_ = proj;
+	near_ = near;
+	far_ = far;
+
+	auto count = clusterCount() + simdPadding;
+	for (auto array : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) array->assign(count, 0.0f);
+
+	auto invProj = glm::inverse(proj);
+	auto unproject = [&](f32 ndcX, f32 ndcY) {
+		auto p = invProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+		return glm::vec3(p) / p.w;
+	};
+	for (u32 ty = 0; ty < config_.tilesY; ++ty) {
+		for (u32 tx = 0; tx < config_.tilesX; ++tx) {
+			auto x0 = -1.0f + 2.0f * static_cast<f32>(tx) / static_cast<f32>(config_.tilesX);
+			auto x1 = -1.0f + 2.0f * static_cast<f32>(tx + 1) / static_cast<f32>(config_.tilesX);
+			auto y0 = -1.0f + 2.0f * static_cast<f32>(ty) / static_cast<f32>(config_.tilesY);
+			auto y1 = -1.0f + 2.0f * static_cast<f32>(ty + 1) / static_cast<f32>(config_.tilesY);
+			// Rays through the tile corners, as points on the near plane
+			glm::vec3 corners[4] = { unproject(x0, y0), unproject(x1, y0), unproject(x0, y1), unproject(x1, y1) };
+
+			for (u32 slice = 0; slice < config_.slices; ++slice) {
+				auto depth0 = near * std::pow(far / near, static_cast<f32>(slice) / static_cast<f32>(config_.slices));
+				auto depth1 = near * std::pow(far / near, static_cast<f32>(slice + 1) / static_cast<f32>(config_.slices));
+				glm::vec3 lo{ std::numeric_limits<f32>::max() };
+				glm::vec3 hi{ std::numeric_limits<f32>::lowest() };
+				for (const auto& corner : corners) {
+					for (auto depth : { depth0, depth1 }) {
+						auto p = corner * (depth / -corner.z);
+						lo = glm::min(lo, p);
+						hi = glm::max(hi, p);
+					}
+				}
+				auto idx = ClusterIndex(tx, ty, slice);
+				minX[idx] = lo.x; minY[idx] = lo.y; minZ[idx] = lo.z;
+				maxX[idx] = hi.x; maxY[idx] = hi.y; maxZ[idx] = hi.z;
+			}
+		}
+	}
+}
+
+void LightClusters::BoundLight(usize index, const glm::mat4& view) {
+	const auto& light = lights_[index];
+	auto& b = bounds[index];
+	b.center = glm::vec3(view * glm::vec4(glm::vec3(light.posRadius), 1.0f));
+	b.radius = light.posRadius.w;
+	b.visible = false;
+
+	auto depth = -b.center.z;
+	if (depth + b.radius < near_ || depth - b.radius > far_) return;
+	b.slice0 = SliceOf(depth - b.radius);
+	b.slice1 = SliceOf(depth + b.radius);
+
+	if (depth - b.radius <= near_) {
+		// Projecting would be meaningless with points behind the camera
+		b.tileX0 = 0;
+		b.tileX1 = config_.tilesX - 1;
+		b.tileY0 = 0;
+		b.tileY1 = config_.tilesY - 1;
+	} else {
+		// The projection of the sphere's bounding box contains the sphere's
+		glm::vec2 lo{ std::numeric_limits<f32>::max() };
+		glm::vec2 hi{ std::numeric_limits<f32>::lowest() };
+		for (u32 corner = 0; corner < 8; ++corner) {
+			glm::vec3 offset{
+				corner & 1 ? b.radius : -b.radius,
+				corner & 2 ? b.radius : -b.radius,
+				corner & 4 ? b.radius : -b.radius,
+			};
+			auto clip = proj_ * glm::vec4(b.center + offset, 1.0f);
+			auto ndc = glm::vec2(clip) / clip.w;
+			lo = glm::min(lo, ndc);
+			hi = glm::max(hi, ndc);
+		}
+		if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) return;
+		b.tileX0 = TileOf(lo.x, config_.tilesX);
+		b.tileX1 = TileOf(hi.x, config_.tilesX);
+		b.tileY0 = TileOf(lo.y, config_.tilesY);
+		b.tileY1 = TileOf(hi.y, config_.tilesY);
+	}
+	b.visible = true;
+}
+
+void LightClusters::BinSlice(u32 slice) {
+	auto first = ClusterIndex(0, 0, slice);
+	for (u32 i = 0; i < config_.tilesX * config_.tilesY; ++i) clusterLists[first + i].clear();
+
+	for (usize light = 0; light < bounds.size(); ++light) {
+		const auto& b = bounds[light];
+		if (!b.visible || slice < b.slice0 || slice > b.slice1) continue;
+
+		auto cx = F32x4::Set1(b.center.x);
+		auto cy = F32x4::Set1(b.center.y);
+		auto cz = F32x4::Set1(b.center.z);
+		auto radius2 = F32x4::Set1(b.radius * b.radius);
+		auto zero = F32x4::Zero();
+		for (auto ty = b.tileY0; ty <= b.tileY1; ++ty) {
+			auto row = ClusterIndex(0, ty, slice);
+			for (auto tx = b.tileX0; tx <= b.tileX1; tx += 4) {
+				// Squared distance from the sphere center to four cluster boxes
+				auto idx = row + tx;
+				auto dx = Max(Max(F32x4::LoadUnaligned(&minX[idx]) - cx, cx - F32x4::LoadUnaligned(&maxX[idx])), zero);
+				auto dy = Max(Max(F32x4::LoadUnaligned(&minY[idx]) - cy, cy - F32x4::LoadUnaligned(&maxY[idx])), zero);
+				auto dz = Max(Max(F32x4::LoadUnaligned(&minZ[idx]) - cz, cz - F32x4::LoadUnaligned(&maxZ[idx])), zero);
+				auto hits = MoveMask(MulAdd(dx, dx, MulAdd(dy, dy, dz * dz)) <= radius2);
+				// Lanes past the light's last tile belong to other rows or to the padding
+				hits &= (1 << std::min<u32>(4, b.tileX1 - tx + 1)) - 1;
+				for (; hits; hits &= hits - 1) {
+					auto lane = static_cast<u32>(std::countr_zero(static_cast<u32>(hits)));
+					clusterLists[idx + lane].push_back(static_cast<u32>(light));
+				}
+			}
+		}
+	}
+}
+
+void LightClusters::Build(ThreadPool& pool, const glm::mat4& view, const glm::mat4& proj, f32 near, f32 far) {
+	HOENGINE_PROFILE_SCOPE("LightClusters::Build");
+	auto start = std::chrono::steady_clock::now();
+	BuildClusterBounds(proj, near, far);
+
+	bounds.resize(lights_.size());
+	pool.ParallelFor(lights_.size(), config_.lightGrain, [&](usize begin, usize end) {
+		for (auto i = begin; i < end; ++i) BoundLight(i, view);
+	});
+	pool.ParallelTasks(config_.slices, [&](usize slice) {
+		BinSlice(static_cast<u32>(slice));
+	});
+
+	// Compact the per cluster lists into one index buffer
+	u32 offset = 0;
+	stats_.maxPerCluster = 0;
+	for (u32 cluster = 0; cluster < clusterCount(); ++cluster) {
+		auto count = static_cast<u32>(clusterLists[cluster].size());
+		ranges_[cluster] = Range{ offset, count };
+		offset += count;
+		stats_.maxPerCluster = std::max(stats_.maxPerCluster, count);
+	}
+	indices_.resize(offset);
+	pool.ParallelTasks(config_.slices, [&](usize slice) {
+		auto first = ClusterIndex(0, 0, static_cast<u32>(slice));
+		for (u32 i = 0; i < config_.tilesX * config_.tilesY; ++i) {
+			const auto& list = clusterLists[first + i];
+			std::copy(list.begin(), list.end(), indices_.begin() + ranges_[first + i].offset);
+		}
+	});
+
+	stats_.lights = lights_.size();
+	stats_.visibleLights = static_cast<usize>(std::count_if(bounds.begin(), bounds.end(), [](const LightBounds& b) { return b.visible; }));
+	stats_.indices = indices_.size();
+	stats_.buildTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+	HOENGINE_PROFILE_COUNTER("Light indices", stats_.indices);
+}
+
+void LightClusters::Build(ThreadPool& pool, const CameraComponent& camera, const Window* window) {
+	Build(pool, camera.ViewMat(), camera.PerspectiveMat(window), camera.nearPane, camera.farPane);
+}
+
+std::optional<LightClusters::Upload> LightClusters::UploadTo(StreamingBuffer& buffer) const {
+	auto copy = [&](const void* data, usize size) -> std::optional<StreamingBuffer::Allocation> {
+		// std430 arrays of vec4 need 16 byte alignment, SSBO offsets may need more
+		auto alloc = buffer.Allocate(std::max<usize>(size, 16), 256);
+		if (alloc && size > 0) std::memcpy(alloc->ptr, data, size);
+		return alloc;
+	};
+	auto lights = copy(lights_.data(), lights_.size() * sizeof(GpuLight));
+	auto ranges = copy(ranges_.data(), ranges_.size() * sizeof(Range));
+	auto indices = copy(indices_.data(), indices_.size() * sizeof(u32));
+	if (!lights || !ranges || !indices) return {};
+	return Upload{ *lights, *ranges, *indices };
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Entity.hpp"
+#include "GLWrapper.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+/// Point lights binned into a 3D grid of clusters covering the view frustum, so
+/// shaders only loop over the lights touching their fragment's cluster.
+///
+/// The grid is `tilesX * tilesY` screen tiles times `slices` depth slices, spaced
+/// exponentially between the near and far planes so clusters stay roughly cubic.
+/// `Build` bins every light on the CPU, testing its bounding sphere against four
+/// cluster boxes at a time, one depth slice per job. The result is a compact
+/// index buffer: each cluster owns the range `[offset, offset + count)` of
+/// `indices()`, which refers to `lights()`, with no per-cluster capacity limit.
+///
+/// Shaders find their cluster with `tile = gl_FragCoord.xy / tileSize` and
+/// `slice = floor(log(viewDepth) * sliceScale - sliceBias)`, then
+/// `index = (slice * tilesY + tile.y) * tilesX + tile.x`.
+class LightClusters {
+public:
+	struct Config {
+		u32 tilesX = 16;
+		u32 tilesY = 9;
+		u32 slices = 24;
+		/// Lights per job when transforming and bounding them.
+		usize lightGrain = 1024;
+	};
+
+	/// Light as laid out in shader storage buffers (std430).
+	struct GpuLight {
+		/// World space position, and radius of influence.
+		glm::vec4 posRadius;
+		/// Color, and strength.
+		glm::vec4 colorStrength;
+	};
+
+	struct Range {
+		u32 offset;
+		u32 count;
+	};
+
+	struct Stats {
+		usize lights = 0;
+		/// Lights touching at least one cluster.
+		usize visibleLights = 0;
+		usize indices = 0;
+		u32 maxPerCluster = 0;
+		/// CPU time of the last `Build`, in milliseconds.
+		f64 buildTime = 0;
+	};
+
+	/// Where `Upload` put each array.
+	struct Upload {
+		StreamingBuffer::Allocation lights;
+		StreamingBuffer::Allocation ranges;
+		StreamingBuffer::Allocation indices;
+	};
+
+private:
+	/// View space bounds of a light, and the clusters they can touch.
+	struct LightBounds {
+		glm::vec3 center;
+		f32 radius;
+		bool visible;
+		u32 slice0, slice1;
+		u32 tileX0, tileX1;
+		u32 tileY0, tileY1;
+	};
+
+	Config config_;
+	f32 near_ = 0;
+	f32 far_ = 0;
+	glm::mat4 proj_{ 0.0f };
+
+	/// View space cluster boxes, structure-of-arrays, padded for 4-wide loads.
+	std::vector<f32> minX, minY, minZ;
+	std::vector<f32> maxX, maxY, maxZ;
+
+	std::vector<GpuLight> lights_;
+	std::vector<LightBounds> bounds;
+	std::vector<std::vector<u32>> clusterLists;
+	std::vector<Range> ranges_;
+	std::vector<u32> indices_;
+	Stats stats_;
+
+public:
+	explicit LightClusters(Config config);
+	LightClusters() : LightClusters(Config{}) {}
+
+	void Clear();
+	void Add(const glm::vec3& pos, f32 radius, const glm::vec3& color, f32 strength);
+	/// Replace the lights with every entity having a `DotLightComponent` and a `TransformComponent`.
+	void Gather(EntitiesStorage& storage);
+
+	/// Bin the lights for a camera. Safe to call without a GL context.
+	void Build(ThreadPool& pool, const glm::mat4& view, const glm::mat4& proj, f32 near, f32 far);
+	void Build(ThreadPool& pool, const CameraComponent& camera, const Window* window);
+
+	/// Copy the lights, ranges and indices into `buffer`, to be bound as shader
+	/// storage buffers. Empty if the buffer's region is full.
+	std::optional<Upload> UploadTo(StreamingBuffer& buffer) const;
+
+	u32 clusterCount() const { return config_.tilesX * config_.tilesY * config_.slices; }
+	u32 ClusterIndex(u32 tileX, u32 tileY, u32 slice) const { return (slice * config_.tilesY + tileY) * config_.tilesX + tileX; }
+	/// Slice containing the given view space depth (distance along the view direction).
+	u32 SliceOf(f32 depth) const;
+	f32 sliceScale() const;
+	f32 sliceBias() const;
+
+	const Config& config() const { return config_; }
+	const std::vector<GpuLight>& lights() const { return lights_; }
+	const std::vector<Range>& ranges() const { return ranges_; }
+	const std::vector<u32>& indices() const { return indices_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	void BuildClusterBounds(const glm::mat4& proj, f32 near, f32 far);
+	void BoundLight(usize index, const glm::mat4& view);
+	void BinSlice(u32 slice);
+};
+
+} // namespace HOEngine
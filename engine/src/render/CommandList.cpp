@@ -0,0 +1,269 @@
+#include <stdexcept>
+#include <string>
+#include "CommandList.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	struct BindTextureCmd { u32 unit; GLenum target; GLuint texture; };
+	struct UniformF32Cmd { GLint location; f32 value; };
+	struct UniformI32Cmd { GLint location; i32 value; };
+	struct UniformVec4Cmd { GLint location; f32 value[4]; };
+	struct UniformMat4Cmd { GLint location; f32 value[16]; };
+	struct DrawArraysCmd { GLenum mode; i32 first; i32 count; i32 instances; };
+	struct DrawElementsCmd { GLenum mode; i32 count; GLenum indexType; u64 indexOffset; i32 baseVertex; i32 instances; };
+
+	template <typename T>
+	T Read(const u8*& cursor) {
+		T payload;
+		std::memcpy(&payload, cursor, sizeof(T));
+		cursor += sizeof(T);
+		return payload;
+	}
+
+#ifndef NDEBUG
+	/// Tracks the bindings implied by a command stream to catch obviously invalid
+	/// streams before they reach the driver.
+	struct Validator {
+		bool programBound = false;
+		bool vaoBound = false;
+		usize commandIndex = 0;
+
+		[[noreturn]] void Fail(const char* message) const {
+			throw std::runtime_error(std::string("Invalid command list (command #") + std::to_string(commandIndex) + "): " + message);
+		}
+		void Uniform() const {
+			if (!programBound) Fail("setting a uniform without a program bound");
+		}
+		void Draw(i32 count, i32 instances) const {
+			if (!programBound) Fail("drawing without a program bound");
+			if (!vaoBound) Fail("drawing without a vertex array bound");
+			if (count < 0 || instances < 0) Fail("negative vertex or instance count");
+		}
+	};
+#endif
+}
+
+void CommandList::BindProgram(GLuint program) {
+	Write(CommandType::BindProgram, program);
+}
+void CommandList::BindVertexArray(GLuint vao) {
+	Write(CommandType::BindVertexArray, vao);
+}
+void CommandList::BindTexture(u32 unit, GLenum target, GLuint texture) {
+	Write(CommandType::BindTexture, BindTextureCmd{ unit, target, texture });
+}
+void CommandList::Uniform(GLint location, f32 value) {
+	Write(CommandType::UniformF32, UniformF32Cmd{ location, value });
+}
+void CommandList::Uniform(GLint location, i32 value) {
+	Write(CommandType::UniformI32, UniformI32Cmd{ location, value });
+}
+void CommandList::Uniform(GLint location, const glm::vec4& value) {
+	UniformVec4Cmd cmd{ location, {} };
+	std::memcpy(cmd.value, &value[0], sizeof(cmd.value));
+	Write(CommandType::UniformVec4, cmd);
+}
+void CommandList::Uniform(GLint location, const glm::mat4& value) {
+	UniformMat4Cmd cmd{ location, {} };
+	std::memcpy(cmd.value, &value[0][0], sizeof(cmd.value));
+	Write(CommandType::UniformMat4, cmd);
+}
+void CommandList::DrawArrays(GLenum mode, i32 first, i32 count, i32 instances) {
+	Write(CommandType::DrawArrays, DrawArraysCmd{ mode, first, count, instances });
+}
+void CommandList::DrawElements(GLenum mode, i32 count, GLenum indexType, usize indexOffset, i32 baseVertex, i32 instances) {
+	Write(CommandType::DrawElements, DrawElementsCmd{ mode, count, indexType, indexOffset, baseVertex, instances });
+}
+
+void CommandList::Clear() {
+	data.clear();
+	commandCount = 0;
+}
+
+void CommandList::Replay(RenderBackend& backend) const {
+#ifndef NDEBUG
+	Validator validator;
+#endif
+	auto cursor = data.data();
+	auto end = data.data() + data.size();
+	while (cursor < end) {
+		auto type = static_cast<CommandType>(*cursor++);
+		switch (type) {
+			case CommandType::BindProgram: {
+				auto program = Read<GLuint>(cursor);
+#ifndef NDEBUG
+				validator.programBound = program != 0;
+#endif
+				backend.BindProgram(program);
+				break;
+			}
+			case CommandType::BindVertexArray: {
+				auto vao = Read<GLuint>(cursor);
+#ifndef NDEBUG
+				validator.vaoBound = vao != 0;
+#endif
+				backend.BindVertexArray(vao);
+				break;
+			}
+			case CommandType::BindTexture: {
+				auto cmd = Read<BindTextureCmd>(cursor);
+				backend.BindTexture(cmd.unit, cmd.target, cmd.texture);
+				break;
+			}
+			case CommandType::UniformF32: {
+				auto cmd = Read<UniformF32Cmd>(cursor);
+#ifndef NDEBUG
+				validator.Uniform();
+#endif
+				backend.Uniform(cmd.location, cmd.value);
+				break;
+			}
+			case CommandType::UniformI32: {
+				auto cmd = Read<UniformI32Cmd>(cursor);
+#ifndef NDEBUG
+				validator.Uniform();
+#endif
+				backend.Uniform(cmd.location, cmd.value);
+				break;
+			}
+			case CommandType::UniformVec4: {
+				auto cmd = Read<UniformVec4Cmd>(cursor);
+#ifndef NDEBUG
+				validator.Uniform();
+#endif
+				backend.Uniform(cmd.location, glm::vec4{ cmd.value[0], cmd.value[1], cmd.value[2], cmd.value[3] });
+				break;
+			}
+			case CommandType::UniformMat4: {
+				auto cmd = Read<UniformMat4Cmd>(cursor);
+#ifndef NDEBUG
+				validator.Uniform();
+#endif
+				glm::mat4 value;
+				std::memcpy(&value[0][0], cmd.value, sizeof(cmd.value));
+				backend.Uniform(cmd.location, value);
+				break;
+			}
+			case CommandType::DrawArrays: {
+				auto cmd = Read<DrawArraysCmd>(cursor);
+#ifndef NDEBUG
+				validator.Draw(cmd.count, cmd.instances);
+#endif
+				backend.DrawArrays(cmd.mode, cmd.first, cmd.count, cmd.instances);
+				break;
+			}
+			case CommandType::DrawElements: {
+				auto cmd = Read<DrawElementsCmd>(cursor);
+#ifndef NDEBUG
+				validator.Draw(cmd.count, cmd.instances);
+#endif
+				backend.DrawElements(cmd.mode, cmd.count, cmd.indexType, static_cast<usize>(cmd.indexOffset), cmd.baseVertex, cmd.instances);
+				break;
+			}
+			default:
+				throw std::runtime_error("Corrupted command list");
+		}
+#ifndef NDEBUG
+		++validator.commandIndex;
+#endif
+	}
+}
+
+void GLBackend::Invalidate() {
+	program = 0;
+	vao = 0;
+	activeUnit = 0;
+	textures.fill(0);
+	glUseProgram(0);
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void GLBackend::BindProgram(GLuint program) {
+	if (this->program == program) return;
+	this->program = program;
+	glUseProgram(program);
+	RenderStats::Global().StateChange();
+}
+
+void GLBackend::BindVertexArray(GLuint vao) {
+	if (this->vao == vao) return;
+	this->vao = vao;
+	glBindVertexArray(vao);
+	RenderStats::Global().StateChange();
+}
+
+void GLBackend::BindTexture(u32 unit, GLenum target, GLuint texture) {
+	if (unit < textures.size() && textures[unit] == texture) return;
+	if (unit != activeUnit) {
+		activeUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	if (unit < textures.size()) textures[unit] = texture;
+	glBindTexture(target, texture);
+	RenderStats::Global().StateChange();
+}
+
+void GLBackend::Uniform(GLint location, f32 value) {
+	glUniform1f(location, value);
+}
+void GLBackend::Uniform(GLint location, i32 value) {
+	glUniform1i(location, value);
+}
+void GLBackend::Uniform(GLint location, const glm::vec4& value) {
+	glUniform4fv(location, 1, &value[0]);
+}
+void GLBackend::Uniform(GLint location, const glm::mat4& value) {
+	glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+}
+
+void GLBackend::DrawArrays(GLenum mode, i32 first, i32 count, i32 instances) {
+	RenderStats::Global().Draw(mode, count, instances);
+	if (instances == 1) {
+		glDrawArrays(mode, first, count);
+	} else {
+		glDrawArraysInstanced(mode, first, count, instances);
+	}
+}
+
+void GLBackend::DrawElements(GLenum mode, i32 count, GLenum indexType, usize indexOffset, i32 baseVertex, i32 instances) {
+	RenderStats::Global().Draw(mode, count, instances);
+	auto indices = reinterpret_cast<const void*>(indexOffset);
+	if (baseVertex == 0 && instances == 1) {
+		glDrawElements(mode, count, indexType, indices);
+	} else {
+		glDrawElementsInstancedBaseVertex(mode, count, indexType, indices, instances, baseVertex);
+	}
+}
+
+void HOEngine::RecordParallel(
+		ThreadPool& pool, usize count, usize grain,
+		std::vector<CommandList>& lists,
+		const std::function<void(CommandList& list, usize begin, usize end)>& record) {
+	grain = std::max<usize>(grain, 1);
+	auto chunks = (count + grain - 1) / grain;
+	// Reuse the lists' memory from previous frames
+	lists.resize(chunks);
+	for (auto& list : lists) list.Clear();
+
+	pool.ParallelFor(count, grain, [&](usize begin, usize end) {
+		record(lists[begin / grain], begin, end);
+	});
+}
+
+void HOEngine::RecordParallel(
+		ThreadPool& pool, EntitiesStorage& storage, usize grain,
+		std::vector<CommandList>& lists,
+		const std::function<void(CommandList& list, Entity& entity)>& record) {
+	RecordParallel(pool, storage.Capacity(), grain, lists, [&](CommandList& list, usize begin, usize end) {
+		for (auto idx = begin; idx < end; ++idx) {
+			if (auto entity = storage.At(idx)) record(list, *entity);
+		}
+	});
+}
+
+void HOEngine::ReplayAll(const std::vector<CommandList>& lists, RenderBackend& backend) {
+	for (const auto& list : lists) list.Replay(backend);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <vector>
+#include <GL/gl3w.h>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Entity.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+enum class CommandType : u8 {
+	BindProgram,
+	BindVertexArray,
+	BindTexture,
+	UniformF32,
+	UniformI32,
+	UniformVec4,
+	UniformMat4,
+	DrawArrays,
+	DrawElements,
+};
+constexpr usize commandTypeCount = static_cast<usize>(CommandType::DrawElements) + 1;
+
+/// Receiver of replayed commands. `GLBackend` issues them to the current context,
+/// anything else (null, mock, tracing backends) can be plugged in for testing and
+/// benchmarking without a GPU.
+class RenderBackend {
+public:
+	virtual ~RenderBackend() noexcept = default;
+	virtual void BindProgram(GLuint program) = 0;
+	virtual void BindVertexArray(GLuint vao) = 0;
+	virtual void BindTexture(u32 unit, GLenum target, GLuint texture) = 0;
+	virtual void Uniform(GLint location, f32 value) = 0;
+	virtual void Uniform(GLint location, i32 value) = 0;
+	virtual void Uniform(GLint location, const glm::vec4& value) = 0;
+	virtual void Uniform(GLint location, const glm::mat4& value) = 0;
+	virtual void DrawArrays(GLenum mode, i32 first, i32 count, i32 instances) = 0;
+	virtual void DrawElements(GLenum mode, i32 count, GLenum indexType, usize indexOffset, i32 baseVertex, i32 instances) = 0;
+};
+
+/// Forwards commands to the current GL context, skipping binds of objects that are
+/// already bound. Must only be used on the thread owning the context.
+class GLBackend : public RenderBackend {
+private:
+	GLuint program = 0;
+	GLuint vao = 0;
+	u32 activeUnit = 0;
+	std::array<GLuint, 16> textures{};
+
+public:
+	/// Forget the cached bindings, e.g. after other code touched GL state directly.
+	void Invalidate();
+
+	void BindProgram(GLuint program) override;
+	void BindVertexArray(GLuint vao) override;
+	void BindTexture(u32 unit, GLenum target, GLuint texture) override;
+	void Uniform(GLint location, f32 value) override;
+	void Uniform(GLint location, i32 value) override;
+	void Uniform(GLint location, const glm::vec4& value) override;
+	void Uniform(GLint location, const glm::mat4& value) override;
+	void DrawArrays(GLenum mode, i32 first, i32 count, i32 instances) override;
+	void DrawElements(GLenum mode, i32 count, GLenum indexType, usize indexOffset, i32 baseVertex, i32 instances) override;
+};
+
+/// Discards every command, only counting them.
+class NullBackend : public RenderBackend {
+public:
+	std::array<u64, commandTypeCount> counts{};
+
+	u64 CountOf(CommandType type) const { return counts[static_cast<usize>(type)]; }
+	void Reset() { counts.fill(0); }
+
+	void BindProgram(GLuint) override { Count(CommandType::BindProgram); }
+	void BindVertexArray(GLuint) override { Count(CommandType::BindVertexArray); }
+	void BindTexture(u32, GLenum, GLuint) override { Count(CommandType::BindTexture); }
+	void Uniform(GLint, f32) override { Count(CommandType::UniformF32); }
+	void Uniform(GLint, i32) override { Count(CommandType::UniformI32); }
+	void Uniform(GLint, const glm::vec4&) override { Count(CommandType::UniformVec4); }
+	void Uniform(GLint, const glm::mat4&) override { Count(CommandType::UniformMat4); }
+	void DrawArrays(GLenum, i32, i32, i32) override { Count(CommandType::DrawArrays); }
+	void DrawElements(GLenum, i32, GLenum, usize, i32, i32) override { Count(CommandType::DrawElements); }
+
+private:
+	void Count(CommandType type) { ++counts[static_cast<usize>(type)]; }
+};
+
+/// Compact, backend agnostic list of render commands. Recording only appends to a
+/// byte buffer and never touches GL, so separate lists can be recorded on separate
+/// threads and replayed later on the thread owning the context.
+///
+/// Uniforms are set by location: resolve locations once at load time rather than
+/// calling `glGetUniformLocation` while recording.
+class CommandList {
+private:
+	std::vector<u8> data;
+	usize commandCount = 0;
+
+public:
+	void BindProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+	void BindTexture(u32 unit, GLenum target, GLuint texture);
+	void Uniform(GLint location, f32 value);
+	void Uniform(GLint location, i32 value);
+	void Uniform(GLint location, const glm::vec4& value);
+	void Uniform(GLint location, const glm::mat4& value);
+	void DrawArrays(GLenum mode, i32 first, i32 count, i32 instances = 1);
+	/// `indexOffset` is in bytes into the bound element buffer.
+	void DrawElements(GLenum mode, i32 count, GLenum indexType, usize indexOffset = 0, i32 baseVertex = 0, i32 instances = 1);
+
+	/// Issue every command to `backend`, in recording order. Debug builds validate
+	/// the stream (e.g. no draw without a program and VAO bound) and throw on errors,
+	/// each list on its own, so lists must not rely on bindings from a previous one.
+	void Replay(RenderBackend& backend) const;
+	/// Remove all commands, keeping the allocated memory.
+	void Clear();
+
+	usize size() const { return commandCount; }
+	bool empty() const { return commandCount == 0; }
+	usize bytes() const { return data.size(); }
+
+private:
+	template <typename T>
+	void Write(CommandType type, const T& payload) {
+		static_assert(std::is_trivially_copyable_v<T>, "Command payloads must be trivially copyable");
+		auto offset = data.size();
+		data.resize(offset + 1 + sizeof(T));
+		data[offset] = static_cast<u8>(type);
+		std::memcpy(data.data() + offset + 1, &payload, sizeof(T));
+		++commandCount;
+	}
+};
+
+/// Record `[0, count)` into `lists` across `pool`, list `i` holding the items of
+/// chunk `i` (`grain` items per chunk). Since chunks are fixed, replaying `lists`
+/// in order gives the same command stream regardless of thread timing.
+void RecordParallel(
+		ThreadPool& pool, usize count, usize grain,
+		std::vector<CommandList>& lists,
+		const std::function<void(CommandList& list, usize begin, usize end)>& record);
+
+/// Same as `RecordParallel` over every live entity of `storage`. `record` is called
+/// once per entity, from worker threads.
+void RecordParallel(
+		ThreadPool& pool, EntitiesStorage& storage, usize grain,
+		std::vector<CommandList>& lists,
+		const std::function<void(CommandList& list, Entity& entity)>& record);
+
+/// Replay `lists` in order.
+void ReplayAll(const std::vector<CommandList>& lists, RenderBackend& backend);
+
+} // namespace HOEngine
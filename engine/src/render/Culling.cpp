@@ -0,0 +1,249 @@
+#include <algorithm>
+#include "Culling.hpp"
+#include "Simd.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Frustum planes broadcast across lanes, plus the absolute value of the normals
+	/// used to compute each box's projected radius.
+	struct SimdPlanes {
+		F32x4 nx[6], ny[6], nz[6], w[6];
+		F32x4 ax[6], ay[6], az[6];
+
+		explicit SimdPlanes(const Frustum& frustum) {
+			for (usize i = 0; i < 6; ++i) {
+				const auto& plane = frustum.planes[i];
+				nx[i] = F32x4::Set1(plane.x);
+				ny[i] = F32x4::Set1(plane.y);
+				nz[i] = F32x4::Set1(plane.z);
+				w[i] = F32x4::Set1(plane.w);
+				ax[i] = F32x4::Set1(std::abs(plane.x));
+				ay[i] = F32x4::Set1(std::abs(plane.y));
+				az[i] = F32x4::Set1(std::abs(plane.z));
+			}
+		}
+	};
+
+	/// Classify four boxes at once. On return, bit `i` of `outside` is set if box `i`
+	/// is entirely outside some plane, and bit `i` of `intersecting` is set if it
+	/// straddles at least one plane without being outside.
+	inline void Classify4(
+			const SimdPlanes& p,
+			F32x4 cx, F32x4 cy, F32x4 cz,
+			F32x4 ex, F32x4 ey, F32x4 ez,
+			i32& outside, i32& intersecting) {
+		auto out = F32x4::Zero();
+		auto straddle = F32x4::Zero();
+		for (usize i = 0; i < 6; ++i) {
+			auto dist = MulAdd(p.nx[i], cx, MulAdd(p.ny[i], cy, MulAdd(p.nz[i], cz, p.w[i])));
+			auto radius = MulAdd(p.ax[i], ex, MulAdd(p.ay[i], ey, p.az[i] * ez));
+			out = Or(out, dist < -radius);
+			straddle = Or(straddle, dist < radius);
+		}
+		outside = MoveMask(out);
+		intersecting = MoveMask(straddle) & ~outside;
+	}
+
+	/// Append the user data of every leaf under `index` without testing them.
+	void EmitSubtree(const DynamicBVH& tree, u32 index, std::vector<u32>& visible, std::vector<u32>& stack) {
+		auto base = stack.size();
+		stack.push_back(index);
+		while (stack.size() > base) {
+			auto current = stack.back();
+			stack.pop_back();
+			const auto& node = tree.node(current);
+			if (node.IsLeaf()) {
+				visible.push_back(node.userData);
+			} else {
+				stack.push_back(node.right);
+				stack.push_back(node.left);
+			}
+		}
+	}
+
+	void CullSubtree(const SimdPlanes& planes, const DynamicBVH& tree, u32 start, std::vector<u32>& visible) {
+		std::vector<u32> stack;
+		std::vector<u32> emitStack;
+		stack.push_back(start);
+
+		alignas(16) f32 cx[4], cy[4], cz[4], ex[4], ey[4], ez[4];
+		u32 batch[4];
+		while (!stack.empty()) {
+			auto count = std::min<usize>(4, stack.size());
+			for (usize i = 0; i < 4; ++i) {
+				// Unused lanes repeat the first box, their results are ignored
+				batch[i] = i < count ? stack[stack.size() - 1 - i] : batch[0];
+				const auto& box = tree.node(batch[i]).box;
+				auto center = box.Center();
+				auto extents = box.Extents();
+				cx[i] = center.x; cy[i] = center.y; cz[i] = center.z;
+				ex[i] = extents.x; ey[i] = extents.y; ez[i] = extents.z;
+			}
+			stack.resize(stack.size() - count);
+
+			i32 outside, intersecting;
+			Classify4(
+					planes,
+					F32x4::Load(cx), F32x4::Load(cy), F32x4::Load(cz),
+					F32x4::Load(ex), F32x4::Load(ey), F32x4::Load(ez),
+					outside, intersecting);
+
+			for (usize i = 0; i < count; ++i) {
+				if (outside & (1 << i)) continue;
+				const auto& node = tree.node(batch[i]);
+				if (node.IsLeaf()) {
+					visible.push_back(node.userData);
+				} else if (!(intersecting & (1 << i))) {
+					EmitSubtree(tree, batch[i], visible, emitStack);
+				} else {
+					stack.push_back(node.right);
+					stack.push_back(node.left);
+				}
+			}
+		}
+	}
+}
+
+std::optional<AABB> HOEngine::ComputeWorldBounds(Entity& entity) {
+	auto mesh = entity.GetComponent<MeshComponent>();
+	auto transform = entity.GetComponent<TransformComponent>();
+	if (!mesh || !transform || mesh->bounds.IsEmpty()) return {};
+	return transform->TransformBounds(mesh->bounds);
+}
+
+void AABBArray::Push(const AABB& box) {
+	Resize(size() + 1);
+	Set(size() - 1, box);
+}
+
+void AABBArray::Set(usize index, const AABB& box) {
+	auto center = box.Center();
+	auto extents = box.Extents();
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	extentX[index] = extents.x;
+	extentY[index] = extents.y;
+	extentZ[index] = extents.z;
+}
+
+void AABBArray::Resize(usize size) {
+	for (auto array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ }) {
+		array->resize(size);
+	}
+}
+
+void AABBArray::Clear() {
+	Resize(0);
+}
+
+void HOEngine::CullAABBs(const Frustum& frustum, const AABBArray& boxes, usize begin, usize end, std::vector<u32>& visible) {
+	SimdPlanes planes{ frustum };
+	auto i = begin;
+	for (; i + 4 <= end; i += 4) {
+		i32 outside, intersecting;
+		Classify4(
+				planes,
+				F32x4::LoadUnaligned(&boxes.centerX[i]),
+				F32x4::LoadUnaligned(&boxes.centerY[i]),
+				F32x4::LoadUnaligned(&boxes.centerZ[i]),
+				F32x4::LoadUnaligned(&boxes.extentX[i]),
+				F32x4::LoadUnaligned(&boxes.extentY[i]),
+				F32x4::LoadUnaligned(&boxes.extentZ[i]),
+				outside, intersecting);
+		if (outside == 0xf) continue;
+		for (i32 lane = 0; lane < 4; ++lane) {
+			if (!(outside & (1 << lane))) visible.push_back(static_cast<u32>(i + lane));
+		}
+	}
+
+	// Tail, padded with a copy of the last box
+	if (i < end) {
+		alignas(16) f32 lanes[6][4];
+		const std::vector<f32>* arrays[6] = {
+			&boxes.centerX, &boxes.centerY, &boxes.centerZ,
+			&boxes.extentX, &boxes.extentY, &boxes.extentZ,
+		};
+		for (usize a = 0; a < 6; ++a) {
+			for (usize lane = 0; lane < 4; ++lane) {
+				lanes[a][lane] = (*arrays[a])[std::min(i + lane, end - 1)];
+			}
+		}
+		i32 outside, intersecting;
+		Classify4(
+				planes,
+				F32x4::Load(lanes[0]), F32x4::Load(lanes[1]), F32x4::Load(lanes[2]),
+				F32x4::Load(lanes[3]), F32x4::Load(lanes[4]), F32x4::Load(lanes[5]),
+				outside, intersecting);
+		for (usize lane = 0; i + lane < end; ++lane) {
+			if (!(outside & (1 << lane))) visible.push_back(static_cast<u32>(i + lane));
+		}
+	}
+}
+
+void HOEngine::CullAABBsParallel(ThreadPool& pool, const Frustum& frustum, const AABBArray& boxes, std::vector<u32>& visible) {
+	constexpr usize grain = 16 * 1024;
+	auto count = boxes.size();
+	auto chunks = (count + grain - 1) / grain;
+	std::vector<std::vector<u32>> results(chunks);
+
+	pool.ParallelFor(count, grain, [&](usize begin, usize end) {
+		CullAABBs(frustum, boxes, begin, end, results[begin / grain]);
+	});
+	for (const auto& result : results) {
+		visible.insert(visible.end(), result.begin(), result.end());
+	}
+}
+
+void HOEngine::CullBVH(const Frustum& frustum, const DynamicBVH& tree, std::vector<u32>& visible) {
+	if (tree.root() == DynamicBVH::nullNode) return;
+	SimdPlanes planes{ frustum };
+	CullSubtree(planes, tree, tree.root(), visible);
+}
+
+void HOEngine::CullBVHParallel(ThreadPool& pool, const Frustum& frustum, const DynamicBVH& tree, std::vector<u32>& visible) {
+	if (tree.root() == DynamicBVH::nullNode) return;
+
+	struct Task {
+		u32 node;
+		/// Entirely inside the frustum, every leaf is visible
+		bool accept;
+	};
+
+	// Split the top of the tree until there are a few subtrees per thread, culling
+	// along the way so that rejected subtrees never become tasks
+	auto target = std::max<usize>(1, (pool.threadCount() + 1) * 4);
+	std::vector<Task> tasks;
+	std::vector<u32> frontier{ tree.root() };
+	while (!frontier.empty() && tasks.size() + frontier.size() < target) {
+		std::vector<u32> next;
+		for (auto index : frontier) {
+			const auto& node = tree.node(index);
+			auto result = frustum.Test(node.box);
+			if (result == Frustum::Result::Outside) continue;
+			if (result == Frustum::Result::Inside || node.IsLeaf()) {
+				tasks.push_back({ index, true });
+			} else {
+				next.push_back(node.left);
+				next.push_back(node.right);
+			}
+		}
+		frontier = std::move(next);
+	}
+	for (auto index : frontier) tasks.push_back({ index, false });
+
+	SimdPlanes planes{ frustum };
+	std::vector<std::vector<u32>> results(tasks.size());
+	pool.ParallelTasks(tasks.size(), [&](usize i) {
+		if (tasks[i].accept) {
+			std::vector<u32> stack;
+			EmitSubtree(tree, tasks[i].node, results[i], stack);
+		} else {
+			CullSubtree(planes, tree, tasks[i].node, results[i]);
+		}
+	});
+	for (const auto& result : results) {
+		visible.insert(visible.end(), result.begin(), result.end());
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "DynamicBVH.hpp"
+#include "Entity.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+/// World space bounds of an entity's mesh, or an empty optional if the entity does
+/// not have both a `MeshComponent` and a `TransformComponent`.
+std::optional<AABB> ComputeWorldBounds(Entity& entity);
+
+/// Boxes stored as center/extents structure-of-arrays, for brute force culling of
+/// large flat sets four boxes at a time.
+struct AABBArray {
+	std::vector<f32> centerX, centerY, centerZ;
+	std::vector<f32> extentX, extentY, extentZ;
+
+	void Push(const AABB& box);
+	void Set(usize index, const AABB& box);
+	void Resize(usize size);
+	void Clear();
+	usize size() const { return centerX.size(); }
+};
+
+/// Append the index of every box in `[begin, end)` of `boxes` that touches the frustum.
+void CullAABBs(const Frustum& frustum, const AABBArray& boxes, usize begin, usize end, std::vector<u32>& visible);
+/// Same as `CullAABBs` over the whole array, split across `pool`. The output is in
+/// ascending index order regardless of the number of threads.
+void CullAABBsParallel(ThreadPool& pool, const Frustum& frustum, const AABBArray& boxes, std::vector<u32>& visible);
+
+/// Append the user data of every leaf of `tree` that touches the frustum. Nodes are
+/// tested four at a time, and subtrees entirely inside the frustum are accepted
+/// without testing their descendants.
+void CullBVH(const Frustum& frustum, const DynamicBVH& tree, std::vector<u32>& visible);
+/// Same as `CullBVH`, with the top of the tree split into subtrees culled in
+/// parallel on `pool`. The output order is deterministic for a given tree.
+void CullBVHParallel(ThreadPool& pool, const Frustum& frustum, const DynamicBVH& tree, std::vector<u32>& visible);
+
+} // namespace HOEngine
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <thread>
+#include "DebugDraw.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	const char* vertexSource = R"(#version 330 core
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec4 inColor;
+uniform mat4 viewProj;
+out vec4 color;
+void main() {
+	color = inColor;
+	gl_Position = viewProj * vec4(inPos, 1.0);
+}
+)";
+
+	const char* fragmentSource = R"(#version 330 core
+in vec4 color;
+out vec4 fragColor;
+void main() {
+	fragColor = color;
+}
+)";
+
+	constexpr u32 sphereSegments = 16;
+
+	struct BatchHalf {
+		std::vector<DebugVertex> vertices[debugLayerCount];
+		std::vector<DebugVertex> timedVertices[debugLayerCount];
+		std::vector<DebugDrawFrame::Timed> timed[debugLayerCount];
+	};
+
+	/// Lines of one thread. Only the owning thread appends, to `halves[writeHalf]`,
+	/// and `Collect` empties the other half; batches are kept for the lifetime of
+	/// the process like the threads using them.
+	struct ThreadBatch {
+		/// Set while the owning thread appends a primitive.
+		std::atomic<bool> busy{ false };
+		BatchHalf halves[2];
+	};
+
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBatch>> registry;
+	std::atomic<u32> writeHalf{ 0 };
+
+	ThreadBatch& RegisterThread() {
+		std::lock_guard lock{ registryMutex };
+		return *registry.emplace_back(std::make_unique<ThreadBatch>());
+	}
+
+	ThreadBatch& LocalBatch() {
+		thread_local ThreadBatch& batch = RegisterThread();
+		return batch;
+	}
+
+	void Emit(std::span<const DebugVertex> vertices, DebugLayer layer, f32 duration) {
+		auto& batch = LocalBatch();
+		auto l = static_cast<usize>(layer);
+		// Flagged before reading which half to write: `Collect` switches halves
+		// first and then waits for the flag, so a thread that read the old half is
+		// always waited for (both sides sequentially consistent)
+		batch.busy.store(true);
+		auto& half = batch.halves[writeHalf.load()];
+		if (duration > 0.0f) {
+			half.timedVertices[l].insert(half.timedVertices[l].end(), vertices.begin(), vertices.end());
+			half.timed[l].push_back(DebugDrawFrame::Timed{ static_cast<u32>(vertices.size()), duration });
+		} else {
+			half.vertices[l].insert(half.vertices[l].end(), vertices.begin(), vertices.end());
+		}
+		batch.busy.store(false);
+	}
+
+	/// Lines along the 12 edges of a box given by its corners, bit 0 of the index
+	/// selecting x, bit 1 y and bit 2 z.
+	void EmitBox(const glm::vec3 (&corners)[8], u32 color, DebugLayer layer, f32 duration) {
+		DebugVertex vertices[24];
+		usize count = 0;
+		for (u32 i = 0; i < 8; ++i) {
+			for (u32 axis = 1; axis < 8; axis <<= 1) {
+				if (i & axis) continue;
+				vertices[count++] = DebugVertex{ corners[i], color };
+				vertices[count++] = DebugVertex{ corners[i | axis], color };
+			}
+		}
+		Emit(vertices, layer, duration);
+	}
+}
+
+std::atomic<bool> DebugDraw::enabled{ true };
+
+void DebugDraw::Line(const glm::vec3& a, const glm::vec3& b, u32 color, DebugLayer layer, f32 duration) {
+	if (!IsEnabled()) return;
+	const DebugVertex vertices[2] = { { a, color }, { b, color } };
+	Emit(vertices, layer, duration);
+}
+
+void DebugDraw::Box(const AABB& box, u32 color, DebugLayer layer, f32 duration) {
+	if (!IsEnabled() || box.IsEmpty()) return;
+	glm::vec3 corners[8];
+	for (u32 i = 0; i < 8; ++i) {
+		corners[i] = glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+	}
+	EmitBox(corners, color, layer, duration);
+}
+
+void DebugDraw::Box(const glm::mat4& transform, u32 color, DebugLayer layer, f32 duration) {
+	if (!IsEnabled()) return;
+	glm::vec3 corners[8];
+	for (u32 i = 0; i < 8; ++i) {
+		auto local = glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+		corners[i] = glm::vec3(transform * local);
+	}
+	EmitBox(corners, color, layer, duration);
+}
+
+void DebugDraw::Sphere(const glm::vec3& center, f32 radius, u32 color, DebugLayer layer, f32 duration) {
+	if (!IsEnabled()) return;
+	DebugVertex vertices[3 * sphereSegments * 2];
+	usize count = 0;
+	auto point = [&](u32 circle, u32 segment) {
+		auto angle = 2.0f * std::numbers::pi_v<f32> * static_cast<f32>(segment) / sphereSegments;
+		auto c = std::cos(angle) * radius;
+		auto s = std::sin(angle) * radius;
+		switch (circle) {
+			case 0: return center + glm::vec3(c, s, 0.0f);
+			case 1: return center + glm::vec3(0.0f, c, s);
+			default: return center + glm::vec3(s, 0.0f, c);
+		}
+	};
+	for (u32 circle = 0; circle < 3; ++circle) {
+		for (u32 segment = 0; segment < sphereSegments; ++segment) {
+			vertices[count++] = DebugVertex{ point(circle, segment), color };
+			vertices[count++] = DebugVertex{ point(circle, segment + 1), color };
+		}
+	}
+	Emit(vertices, layer, duration);
+}
+
+void DebugDraw::FrustumLines(const glm::mat4& viewProj, u32 color, DebugLayer layer, f32 duration) {
+	if (!IsEnabled()) return;
+	auto inverse = glm::inverse(viewProj);
+	glm::vec3 corners[8];
+	for (u32 i = 0; i < 8; ++i) {
+		auto clip = inverse * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+		corners[i] = glm::vec3(clip) / clip.w;
+	}
+	EmitBox(corners, color, layer, duration);
+}
+
+void DebugDraw::Cross(const glm::vec3& point, f32 size, u32 color, DebugLayer layer, f32 duration) {
+	if (!IsEnabled()) return;
+	auto half = size * 0.5f;
+	const DebugVertex vertices[6] = {
+		{ point - glm::vec3(half, 0.0f, 0.0f), color }, { point + glm::vec3(half, 0.0f, 0.0f), color },
+		{ point - glm::vec3(0.0f, half, 0.0f), color }, { point + glm::vec3(0.0f, half, 0.0f), color },
+		{ point - glm::vec3(0.0f, 0.0f, half), color }, { point + glm::vec3(0.0f, 0.0f, half), color },
+	};
+	Emit(vertices, layer, duration);
+}
+
+void DebugDraw::Lines(std::span<const DebugVertex> vertices, DebugLayer layer, f32 duration) {
+	if (!IsEnabled() || vertices.empty()) return;
+	Emit(vertices.first(vertices.size() & ~usize{ 1 }), layer, duration);
+}
+
+void DebugDraw::Collect(DebugDrawFrame& frame, f32 dt) {
+	HOENGINE_PROFILE_SCOPE("DebugDraw::Collect");
+	for (usize l = 0; l < debugLayerCount; ++l) {
+		frame.vertices[l].clear();
+
+		// Age the timed lines, compacting the survivors in order
+		auto& timed = frame.timed[l];
+		auto& timedVertices = frame.timedVertices[l];
+		usize read = 0, write = 0, kept = 0;
+		for (auto& entry : timed) {
+			entry.remaining -= dt;
+			if (entry.remaining > 0.0f) {
+				if (write != read) {
+					std::memmove(timedVertices.data() + write, timedVertices.data() + read, entry.vertices * sizeof(DebugVertex));
+				}
+				write += entry.vertices;
+				timed[kept++] = entry;
+			}
+			read += entry.vertices;
+		}
+		timed.resize(kept);
+		timedVertices.resize(write);
+	}
+
+	std::lock_guard registryLock{ registryMutex };
+	auto read = writeHalf.fetch_xor(1);
+	for (auto& batch : registry) {
+		while (batch->busy.load()) std::this_thread::yield();
+		auto& half = batch->halves[read];
+		for (usize l = 0; l < debugLayerCount; ++l) {
+			frame.vertices[l].insert(frame.vertices[l].end(), half.vertices[l].begin(), half.vertices[l].end());
+			frame.timedVertices[l].insert(frame.timedVertices[l].end(), half.timedVertices[l].begin(), half.timedVertices[l].end());
+			frame.timed[l].insert(frame.timed[l].end(), half.timed[l].begin(), half.timed[l].end());
+			half.vertices[l].clear();
+			half.timedVertices[l].clear();
+			half.timed[l].clear();
+		}
+	}
+}
+
+DebugDrawRenderer::DebugDrawRenderer(Config config)
+	: config{ config } {
+}
+
+bool DebugDrawRenderer::SetupGL() {
+	if (program) return true;
+	program = ShaderProgram::FromSource(vertexSource, fragmentSource);
+	if (!program) return false;
+	viewProjLocation = glGetUniformLocation(*program, "viewProj");
+
+	vao.emplace();
+	glBindVertexArray(*vao);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+	buffer.emplace(GL_ARRAY_BUFFER, config.bufferSize);
+	return true;
+}
+
+void DebugDrawRenderer::Draw(const glm::mat4& viewProj, f32 dt) {
+	HOENGINE_PROFILE_SCOPE("DebugDrawRenderer::Draw");
+	auto start = std::chrono::steady_clock::now();
+	DebugDraw::Collect(frame, dt);
+	stats_.draws = 0;
+	stats_.lines = 0;
+	stats_.timedLines = 0;
+	stats_.overflows = 0;
+	usize total = 0;
+	for (usize l = 0; l < debugLayerCount; ++l) {
+		total += frame.VertexCount(static_cast<DebugLayer>(l));
+		stats_.timedLines += frame.timedVertices[l].size() / 2;
+	}
+	if (total == 0 || !SetupGL()) {
+		stats_.collectTime = MillisecondsSince(start);
+		return;
+	}
+
+	buffer->BeginFrame();
+	// Whole lines only, depth tested ones first when space runs out
+	auto capacity = buffer->regionSize() / sizeof(DebugVertex) & ~usize{ 1 };
+	auto count = std::min(total, capacity);
+	auto alloc = buffer->Allocate(count * sizeof(DebugVertex), 16);
+	if (!alloc) {
+		buffer->EndFrame();
+		return;
+	}
+	auto* out = static_cast<DebugVertex*>(alloc->ptr);
+	usize written = 0;
+	usize firsts[debugLayerCount];
+	usize counts[debugLayerCount];
+	for (usize l = 0; l < debugLayerCount; ++l) {
+		firsts[l] = written;
+		for (const auto* source : { &frame.vertices[l], &frame.timedVertices[l] }) {
+			auto n = std::min(source->size(), count - written);
+			if (n > 0) std::memcpy(out + written, source->data(), n * sizeof(DebugVertex));
+			written += n;
+		}
+		counts[l] = written - firsts[l];
+	}
+	buffer->Commit();
+	stats_.lines = written / 2;
+	stats_.overflows = (total - written) / 2;
+	stats_.collectTime = MillisecondsSince(start);
+	HOENGINE_PROFILE_COUNTER("Debug lines", stats_.lines);
+
+	auto& stats = RenderStats::Global();
+	glUseProgram(*program);
+	glUniformMatrix4fv(viewProjLocation, 1, GL_FALSE, &viewProj[0][0]);
+	glBindVertexArray(*vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer->handle());
+	auto offset = static_cast<usize>(alloc->offset);
+	auto stride = static_cast<GLsizei>(sizeof(DebugVertex));
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(DebugVertex, pos)));
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, BufferOffset(offset + offsetof(DebugVertex, color)));
+	auto previousDepth = DepthState::Current();
+	stats.StateChange();
+
+	for (usize l = 0; l < debugLayerCount; ++l) {
+		if (counts[l] == 0) continue;
+		auto depth = previousDepth;
+		depth.test = static_cast<DebugLayer>(l) == DebugLayer::Depth;
+		depth.write = false;
+		DepthState::Apply(depth);
+		glDrawArrays(GL_LINES, static_cast<GLint>(firsts[l]), static_cast<GLsizei>(counts[l]));
+		stats.StateChange();
+		stats.Draw(GL_LINES, static_cast<u32>(counts[l]), 1);
+		++stats_.draws;
+	}
+
+	DepthState::Apply(previousDepth);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	buffer->EndFrame();
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "GLWrapper.hpp"
+
+/// Debug drawing macros. They expand to nothing unless `HOENGINE_DEBUG_DRAW` is
+/// defined (CMake option of the same name), arguments included, so calls can be
+/// left in hot code. Callable from any thread, see `DebugDraw`.
+#ifdef HOENGINE_DEBUG_DRAW
+#define HOENGINE_DEBUG_LINE(...) ::HOEngine::DebugDraw::Line(__VA_ARGS__)
+#define HOENGINE_DEBUG_BOX(...) ::HOEngine::DebugDraw::Box(__VA_ARGS__)
+#define HOENGINE_DEBUG_SPHERE(...) ::HOEngine::DebugDraw::Sphere(__VA_ARGS__)
+#define HOENGINE_DEBUG_FRUSTUM(...) ::HOEngine::DebugDraw::FrustumLines(__VA_ARGS__)
+#define HOENGINE_DEBUG_CROSS(...) ::HOEngine::DebugDraw::Cross(__VA_ARGS__)
+#else
+#define HOENGINE_DEBUG_LINE(...) ((void)0)
+#define HOENGINE_DEBUG_BOX(...) ((void)0)
+#define HOENGINE_DEBUG_SPHERE(...) ((void)0)
+#define HOENGINE_DEBUG_FRUSTUM(...) ((void)0)
+#define HOENGINE_DEBUG_CROSS(...) ((void)0)
+#endif
+
+namespace HOEngine {
+
+struct DebugVertex {
+	glm::vec3 pos;
+	/// RGBA, 8 bits per channel, red in the lowest byte.
+	u32 color;
+};
+
+enum class DebugLayer : u8 {
+	/// Hidden behind scene geometry.
+	Depth,
+	/// Drawn over everything.
+	Overlay,
+};
+constexpr usize debugLayerCount = 2;
+
+/// Lines gathered by `DebugDraw::Collect`, per layer: those of this frame, then
+/// those drawn with a duration, kept until it runs out.
+struct DebugDrawFrame {
+	struct Timed {
+		u32 vertices;
+		f32 remaining;
+	};
+
+	std::vector<DebugVertex> vertices[debugLayerCount];
+	std::vector<DebugVertex> timedVertices[debugLayerCount];
+	std::vector<Timed> timed[debugLayerCount];
+
+	usize VertexCount(DebugLayer layer) const {
+		auto l = static_cast<usize>(layer);
+		return vertices[l].size() + timedVertices[l].size();
+	}
+};
+
+/// Immediate mode debug lines, drawn from anywhere, worker threads included.
+///
+/// Each thread appends to its own batch without locking. Batches are double
+/// buffered: once per frame, `Collect` switches threads to the other half of their
+/// batch and merges the half they were writing, only waiting for threads in the
+/// middle of a primitive. `DebugDrawRenderer` then draws everything with one line
+/// draw per layer.
+/// Primitives with a duration stay for that many seconds, the others for one
+/// frame. Prefer the `HOENGINE_DEBUG_*` macros, which compile out.
+class DebugDraw {
+public:
+	static constexpr u32 red = 0xff0000ff;
+	static constexpr u32 green = 0xff00ff00;
+	static constexpr u32 blue = 0xffff0000;
+	static constexpr u32 yellow = 0xff00ffff;
+	static constexpr u32 cyan = 0xffffff00;
+	static constexpr u32 magenta = 0xffff00ff;
+	static constexpr u32 white = 0xffffffff;
+
+private:
+	static std::atomic<bool> enabled;
+
+public:
+	/// Disabling at runtime leaves only a relaxed atomic load per call.
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+	static void SetEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+	static void Line(const glm::vec3& a, const glm::vec3& b, u32 color, DebugLayer layer = DebugLayer::Depth, f32 duration = 0.0f);
+	static void Box(const AABB& box, u32 color, DebugLayer layer = DebugLayer::Depth, f32 duration = 0.0f);
+	/// Cube from -1 to 1 transformed by `transform`, for oriented boxes.
+	static void Box(const glm::mat4& transform, u32 color, DebugLayer layer = DebugLayer::Depth, f32 duration = 0.0f);
+	/// Three great circles.
+	static void Sphere(const glm::vec3& center, f32 radius, u32 color, DebugLayer layer = DebugLayer::Depth, f32 duration = 0.0f);
+	/// Edges of the frustum of a view projection matrix, in OpenGL clip space.
+	static void FrustumLines(const glm::mat4& viewProj, u32 color, DebugLayer layer = DebugLayer::Depth, f32 duration = 0.0f);
+	/// Three axis aligned lines through `point`.
+	static void Cross(const glm::vec3& point, f32 size, u32 color, DebugLayer layer = DebugLayer::Depth, f32 duration = 0.0f);
+	/// Line list, two vertices per line.
+	static void Lines(std::span<const DebugVertex> vertices, DebugLayer layer = DebugLayer::Depth, f32 duration = 0.0f);
+
+	/// Move every thread's batch into `frame`, replacing its lines of the previous
+	/// frame, and age its timed lines by `dt` seconds, dropping those run out.
+	/// Call once per frame from one thread.
+	static void Collect(DebugDrawFrame& frame, f32 dt);
+};
+
+/// Draws what `DebugDraw` collected, through a `StreamingBuffer`: one draw for
+/// depth tested lines, one for the overlay. Requires a current context.
+class DebugDrawRenderer {
+public:
+	struct Config {
+		/// Bytes of vertices per frame, 16 per vertex.
+		usize bufferSize = 4 * 1024 * 1024;
+	};
+
+	struct Stats {
+		usize lines = 0;
+		/// Of which kept from previous frames.
+		usize timedLines = 0;
+		usize draws = 0;
+		/// Lines left out because the buffer was full.
+		usize overflows = 0;
+		/// CPU time of collecting and writing the lines, in milliseconds.
+		f64 collectTime = 0;
+	};
+
+private:
+	Config config;
+	DebugDrawFrame frame;
+	Stats stats_;
+
+	std::optional<ShaderProgram> program;
+	/// Location of `viewProj`, resolved once by `SetupGL`.
+	GLint viewProjLocation = -1;
+	std::optional<StateObject> vao;
+	std::optional<StreamingBuffer> buffer;
+
+public:
+	explicit DebugDrawRenderer(Config config);
+	DebugDrawRenderer() : DebugDrawRenderer(Config{}) {}
+
+	/// Collect the lines of this frame and draw them with the current depth buffer.
+	void Draw(const glm::mat4& viewProj, f32 dt);
+
+	const Stats& stats() const { return stats_; }
+
+private:
+	bool SetupGL();
+};
+
+} // namespace HOEngine
@@ -0,0 +1,142 @@
+#include "GpuTimer.hpp"
+#include "GLWrapper.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	constexpr u32 queryBatchSize = 32;
+
+	f64 NanosToMillis(GLuint64 ns) {
+		return static_cast<f64>(ns) / 1.0e6;
+	}
+}
+
+GpuTimer::GpuTimer()
+	: supported_{ IsSupported() } {
+}
+
+GpuTimer::~GpuTimer() noexcept {
+	if (!allQueries.empty()) {
+		glDeleteQueries(static_cast<GLsizei>(allQueries.size()), allQueries.data());
+	}
+}
+
+bool GpuTimer::IsSupported() {
+	return HasGLVersion(3, 3) || HasGLExtension("GL_ARB_timer_query");
+}
+
+GLuint GpuTimer::AcquireQuery() {
+	if (freeQueries.empty()) {
+		GLuint batch[queryBatchSize];
+		glGenQueries(queryBatchSize, batch);
+		allQueries.insert(allQueries.end(), batch, batch + queryBatchSize);
+		freeQueries.insert(freeQueries.end(), batch, batch + queryBatchSize);
+		stats_.queriesAllocated += queryBatchSize;
+	}
+	auto query = freeQueries.back();
+	freeQueries.pop_back();
+	return query;
+}
+
+void GpuTimer::Release(PendingFrame& frame) {
+	freeQueries.push_back(frame.elapsed);
+	freeQueries.push_back(frame.start);
+	for (const auto& pass : frame.passes) {
+		freeQueries.push_back(pass.begin);
+		if (pass.end) freeQueries.push_back(pass.end);
+	}
+	frame.passes.clear();
+	frame.active = false;
+}
+
+bool GpuTimer::IsAvailable(const PendingFrame& frame) const {
+	auto available = [](GLuint query) {
+		GLint result = GL_FALSE;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &result);
+		return result == GL_TRUE;
+	};
+	if (!available(frame.elapsed)) return false;
+	for (const auto& pass : frame.passes) {
+		if (pass.end && !available(pass.end)) return false;
+	}
+	return true;
+}
+
+void GpuTimer::Resolve(PendingFrame& frame) {
+	GLuint64 elapsed = 0;
+	GLuint64 start = 0;
+	glGetQueryObjectui64v(frame.elapsed, GL_QUERY_RESULT, &elapsed);
+	glGetQueryObjectui64v(frame.start, GL_QUERY_RESULT, &start);
+
+	latestPasses_.clear();
+	for (const auto& pass : frame.passes) {
+		// Passes left open are closed by `EndFrame`, so this only skips broken frames
+		if (!pass.end) continue;
+		GLuint64 begin = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(pass.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(pass.end, GL_QUERY_RESULT, &end);
+		latestPasses_.push_back(PassTiming{
+			pass.name,
+			pass.depth,
+			begin > start ? NanosToMillis(begin - start) : 0.0,
+			end > begin ? NanosToMillis(end - begin) : 0.0,
+		});
+	}
+	latestFrameTime_ = NanosToMillis(elapsed);
+	latestFrameIndex_ = frame.index;
+	++stats_.framesResolved;
+	Release(frame);
+}
+
+void GpuTimer::BeginFrame() {
+	if (!supported_) return;
+	if (inFrame) EndFrame();
+
+	// Oldest frame first, so the latest results end up being from the newest frame
+	auto next = (current + 1) % framesInFlight;
+	for (u32 i = 0; i < framesInFlight; ++i) {
+		auto& frame = frames[(next + i) % framesInFlight];
+		if (frame.active && IsAvailable(frame)) Resolve(frame);
+	}
+
+	auto& frame = frames[next];
+	if (frame.active) {
+		// Reusing the queries discards their pending results
+		++stats_.framesDropped;
+		Release(frame);
+	}
+	current = next;
+
+	frame.active = true;
+	frame.index = ++frameCounter;
+	frame.start = AcquireQuery();
+	frame.elapsed = AcquireQuery();
+	glQueryCounter(frame.start, GL_TIMESTAMP);
+	glBeginQuery(GL_TIME_ELAPSED, frame.elapsed);
+	inFrame = true;
+}
+
+void GpuTimer::EndFrame() {
+	if (!supported_ || !inFrame) return;
+	while (!openPasses.empty()) EndPass();
+	glEndQuery(GL_TIME_ELAPSED);
+	inFrame = false;
+}
+
+void GpuTimer::BeginPass(const char* name) {
+	if (!supported_ || !inFrame) return;
+	auto& frame = frames[current];
+	auto begin = AcquireQuery();
+	glQueryCounter(begin, GL_TIMESTAMP);
+	openPasses.push_back(frame.passes.size());
+	frame.passes.push_back(PendingPass{ name, static_cast<u32>(openPasses.size() - 1), begin, 0 });
+}
+
+void GpuTimer::EndPass() {
+	if (!supported_ || openPasses.empty()) return;
+	auto& pass = frames[current].passes[openPasses.back()];
+	openPasses.pop_back();
+	pass.end = AcquireQuery();
+	glQueryCounter(pass.end, GL_TIMESTAMP);
+}
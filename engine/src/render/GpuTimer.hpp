@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <GL/gl3w.h>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Measures GPU time of whole frames and of named passes within them.
+///
+/// Frames are timed with a `GL_TIME_ELAPSED` query and passes with pairs of
+/// `GL_TIMESTAMP` queries, so passes can nest. Results are read back
+/// `framesInFlight` frames later, only once the GL reports them available, so
+/// timing never stalls the pipeline. If a frame's results still aren't available
+/// when its slot comes around again, that frame is dropped instead.
+///
+/// Must only be used from the thread owning the context.
+class GpuTimer {
+public:
+	static constexpr u32 framesInFlight = 4;
+
+	struct PassTiming {
+		const char* name;
+		/// Nesting level, 0 for top level passes.
+		u32 depth;
+		/// Milliseconds from the beginning of the frame.
+		f64 start;
+		f64 duration;
+	};
+
+	struct Stats {
+		u64 framesResolved = 0;
+		/// Frames whose results weren't available in time.
+		u64 framesDropped = 0;
+		u32 queriesAllocated = 0;
+	};
+
+	/// RAII helper timing a pass.
+	class Scope {
+	private:
+		GpuTimer& timer;
+
+	public:
+		Scope(GpuTimer& timer, const char* name) : timer{ timer } { timer.BeginPass(name); }
+		~Scope() noexcept { timer.EndPass(); }
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+private:
+	struct PendingPass {
+		const char* name;
+		u32 depth;
+		GLuint begin;
+		GLuint end;
+	};
+	struct PendingFrame {
+		bool active = false;
+		u64 index = 0;
+		GLuint elapsed = 0;
+		GLuint start = 0;
+		std::vector<PendingPass> passes;
+	};
+
+	bool supported_;
+	std::vector<GLuint> allQueries;
+	std::vector<GLuint> freeQueries;
+	std::array<PendingFrame, framesInFlight> frames;
+	u32 current = 0;
+	u64 frameCounter = 0;
+	bool inFrame = false;
+	std::vector<usize> openPasses;
+
+	std::vector<PassTiming> latestPasses_;
+	f64 latestFrameTime_ = 0;
+	u64 latestFrameIndex_ = 0;
+	Stats stats_;
+
+public:
+	/// Requires a current context. Without timer query support (GL 3.3 or
+	/// ARB_timer_query) every call is a no-op and no results are produced.
+	GpuTimer();
+	~GpuTimer() noexcept;
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	static bool IsSupported();
+
+	/// Collect finished frames and start timing a new one.
+	void BeginFrame();
+	void EndFrame();
+	/// `name` must outlive the timer, e.g. a string literal.
+	void BeginPass(const char* name);
+	void EndPass();
+
+	/// GPU time of the most recently resolved frame, in milliseconds.
+	f64 latestFrameTime() const { return latestFrameTime_; }
+	/// Passes of the most recently resolved frame, in the order they began.
+	const std::vector<PassTiming>& latestPasses() const { return latestPasses_; }
+	/// How many frames ago the latest results were recorded.
+	u64 latency() const { return latestFrameIndex_ == 0 ? 0 : frameCounter - latestFrameIndex_; }
+	bool supported() const { return supported_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	GLuint AcquireQuery();
+	void Release(PendingFrame& frame);
+	bool IsAvailable(const PendingFrame& frame) const;
+	void Resolve(PendingFrame& frame);
+};
+
+} // namespace HOEngine
@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <memory_resource>
+#include <numbers>
+#include <stdexcept>
+#include "Image.hpp"
+#include "Arena.hpp"
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
+#include "Simd.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	struct CookedHeader {
+		char magic[8];
+		u32 version;
+		u32 format;
+		u32 width;
+		u32 height;
+		u32 levelCount;
+		u32 reserved;
+	};
+
+	struct CookedLevel {
+		/// From the beginning of the file.
+		u64 offset;
+		u64 size;
+	};
+
+	constexpr char cookedMagic[8] = { 'H', 'O', 'T', 'E', 'X', 0, 0, 0 };
+	constexpr u32 cookedVersion = 1;
+	constexpr usize cookedAlignment = 16;
+
+	/// Conversions between 8-bit and linear values.
+	struct ColorTables {
+		f32 unorm[256];
+		f32 srgbToLinear[256];
+		/// Indexed by the linear value times `linearSteps - 1`.
+		static constexpr usize linearSteps = 4096;
+		u8 linearToSrgb[linearSteps];
+
+		ColorTables() {
+			for (usize i = 0; i < 256; ++i) {
+				auto x = static_cast<f32>(i) / 255.0f;
+				unorm[i] = x;
+				srgbToLinear[i] = x <= 0.04045f ? x / 12.92f : std::pow((x + 0.055f) / 1.055f, 2.4f);
+			}
+			for (usize i = 0; i < linearSteps; ++i) {
+				auto x = static_cast<f32>(i) / static_cast<f32>(linearSteps - 1);
+				auto s = x <= 0.0031308f ? x * 12.92f : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+				linearToSrgb[i] = static_cast<u8>(std::lround(std::clamp(s, 0.0f, 1.0f) * 255.0f));
+			}
+		}
+	};
+
+	const ColorTables& Tables() {
+		static const ColorTables tables;
+		return tables;
+	}
+
+	/// Weights of the source pixels around each destination pixel, along one axis.
+	/// Destination pixel `x` reads source pixels `2x + first` onwards.
+	struct Kernel {
+		i64 first;
+		u32 taps;
+		F32x4 weights[6];
+	};
+
+	/// Zeroth order modified Bessel function of the first kind.
+	f64 BesselI0(f64 x) {
+		f64 sum = 1.0, term = 1.0;
+		for (i32 k = 1; k < 32; ++k) {
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	Kernel MakeKernel(MipFilter filter) {
+		Kernel kernel{};
+		if (filter == MipFilter::Box) {
+			kernel.first = 0;
+			kernel.taps = 2;
+			kernel.weights[0] = kernel.weights[1] = F32x4::Set1(0.5f);
+			return kernel;
+		}
+
+		// Sinc at half the source frequency, windowed to 3 destination pixels wide
+		constexpr f64 beta = 4.0;
+		constexpr f64 radius = 1.5;
+		kernel.first = -2;
+		kernel.taps = 6;
+		f64 weights[6];
+		f64 total = 0.0;
+		for (u32 t = 0; t < 6; ++t) {
+			// Distance from the destination pixel's center, in destination pixels
+			auto d = (static_cast<f64>(t) - 2.5) / 2.0;
+			auto sinc = std::sin(std::numbers::pi * d) / (std::numbers::pi * d);
+			auto r = d / radius;
+			auto window = BesselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / BesselI0(beta);
+			weights[t] = sinc * window;
+			total += weights[t];
+		}
+		for (u32 t = 0; t < 6; ++t) {
+			kernel.weights[t] = F32x4::Set1(static_cast<f32>(weights[t] / total));
+		}
+		return kernel;
+	}
+
+	/// One RGBA pixel, in linear space.
+	F32x4 LoadPixel(const u8* p, const f32* colorTable, const ColorTables& tables) {
+		return F32x4::Set(colorTable[p[0]], colorTable[p[1]], colorTable[p[2]], tables.unorm[p[3]]);
+	}
+
+	void StorePixel(F32x4 pixel, u8* p, bool srgb, const ColorTables& tables) {
+		// Negative lobes can overshoot
+		pixel = Min(Max(pixel, F32x4::Zero()), F32x4::Set1(1.0f));
+		alignas(16) f32 lanes[4];
+		pixel.Store(lanes);
+		for (i32 c = 0; c < 3; ++c) {
+			p[c] = srgb
+				? tables.linearToSrgb[static_cast<usize>(lanes[c] * static_cast<f32>(ColorTables::linearSteps - 1) + 0.5f)]
+				: static_cast<u8>(lanes[c] * 255.0f + 0.5f);
+		}
+		p[3] = static_cast<u8>(lanes[3] * 255.0f + 0.5f);
+	}
+
+	/// Filter `src` down into `dst`, half its size, vertically then horizontally,
+	/// one destination row at a time.
+	void Downsample(const Image::Level& srcLevel, const u8* src, const Image::Level& dstLevel, u8* dst, const Kernel& kernel, bool srgb) {
+		ScratchArena scratch;
+		const auto& tables = Tables();
+		const auto* colorTable = srgb ? tables.srgbToLinear : tables.unorm;
+		auto sw = static_cast<i64>(srcLevel.width);
+		auto sh = static_cast<i64>(srcLevel.height);
+		std::pmr::vector<F32x4> row(static_cast<usize>(sw), scratch.resource());
+
+		for (i64 y = 0; y < dstLevel.height; ++y) {
+			std::fill(row.begin(), row.end(), F32x4::Zero());
+			for (u32 t = 0; t < kernel.taps; ++t) {
+				auto sy = std::clamp<i64>(2 * y + kernel.first + t, 0, sh - 1);
+				const auto* srcRow = src + sy * sw * 4;
+				for (i64 x = 0; x < sw; ++x) {
+					row[x] = MulAdd(LoadPixel(srcRow + x * 4, colorTable, tables), kernel.weights[t], row[x]);
+				}
+			}
+
+			auto* dstRow = dst + y * static_cast<i64>(dstLevel.width) * 4;
+			for (i64 x = 0; x < dstLevel.width; ++x) {
+				auto pixel = F32x4::Zero();
+				for (u32 t = 0; t < kernel.taps; ++t) {
+					auto sx = std::clamp<i64>(2 * x + kernel.first + t, 0, sw - 1);
+					pixel = MulAdd(row[sx], kernel.weights[t], pixel);
+				}
+				StorePixel(pixel, dstRow + x * 4, srgb, tables);
+			}
+		}
+	}
+
+	bool EndsWith(const std::string& str, const char* suffix) {
+		auto len = std::strlen(suffix);
+		if (str.size() < len) return false;
+		for (usize i = 0; i < len; ++i) {
+			auto c = str[str.size() - len + i];
+			if (std::tolower(static_cast<unsigned char>(c)) != suffix[i]) return false;
+		}
+		return true;
+	}
+}
+
+Image Image::Uncompressed(u32 width, u32 height, bool srgb) {
+	Image image;
+	image.format = srgb ? TextureFormat::SRGBA8 : TextureFormat::RGBA8;
+	auto size = TextureLevelSize(image.format, width, height);
+	image.levels.push_back(Level{ 0, size, width, height });
+	image.data.resize(size);
+	return image;
+}
+
+void Image::DropLevels(u32 count) {
+	if (levels.empty()) return;
+	count = std::min(count, static_cast<u32>(levels.size()) - 1);
+	if (count == 0) return;
+	auto start = levels[count].offset;
+	data.erase(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(start));
+	levels.erase(levels.begin(), levels.begin() + count);
+	for (auto& level : levels) level.offset -= start;
+	droppedLevels += count;
+}
+
+void HOEngine::GenerateMips(Image& image, MipFilter filter) {
+	HOENGINE_PROFILE_SCOPE("GenerateMips");
+	if (image.format != TextureFormat::RGBA8 && image.format != TextureFormat::SRGBA8) {
+		throw std::runtime_error("Mips can only be generated for uncompressed images");
+	}
+	if (image.levels.empty()) return;
+
+	auto width = image.width();
+	auto height = image.height();
+	std::vector<Image::Level> levels;
+	usize total = 0;
+	for (u32 level = 0; level < Texture::MipCount(width, height); ++level) {
+		auto w = std::max(width >> level, 1u);
+		auto h = std::max(height >> level, 1u);
+		auto size = TextureLevelSize(image.format, w, h);
+		levels.push_back(Image::Level{ total, size, w, h });
+		total += size;
+	}
+
+	std::vector<std::byte> data(total);
+	std::memcpy(data.data(), image.data.data() + image.levels[0].offset, levels[0].size);
+	auto kernel = MakeKernel(filter);
+	auto srgb = image.format == TextureFormat::SRGBA8;
+	for (usize level = 1; level < levels.size(); ++level) {
+		Downsample(
+			levels[level - 1], reinterpret_cast<const u8*>(data.data() + levels[level - 1].offset),
+			levels[level], reinterpret_cast<u8*>(data.data() + levels[level].offset),
+			kernel, srgb);
+	}
+	image.levels = std::move(levels);
+	image.data = std::move(data);
+}
+
+std::optional<Image> HOEngine::DecodeTGA(std::span<const std::byte> bytes, bool srgb) {
+	HOENGINE_PROFILE_SCOPE("DecodeTGA");
+	if (bytes.size() < 18) return {};
+	auto byteAt = [&](usize i) { return static_cast<u32>(bytes[i]); };
+	auto shortAt = [&](usize i) { return byteAt(i) | (byteAt(i + 1) << 8); };
+
+	auto idLength = byteAt(0);
+	auto colorMapType = byteAt(1);
+	auto type = byteAt(2);
+	auto colorMapLength = shortAt(5);
+	auto colorMapBits = byteAt(7);
+	auto width = shortAt(12);
+	auto height = shortAt(14);
+	auto bits = byteAt(16);
+	auto descriptor = byteAt(17);
+
+	// True-color and grayscale, raw or run-length encoded
+	if (type != 2 && type != 3 && type != 10 && type != 11) return {};
+	auto grey = type == 3 || type == 11;
+	auto rle = type >= 10;
+	if (grey ? bits != 8 : bits != 24 && bits != 32) return {};
+	if (width == 0 || height == 0) return {};
+
+	auto pixelBytes = bits / 8;
+	usize pos = 18 + idLength + (colorMapType != 0 ? usize{ colorMapLength } * ((colorMapBits + 7) / 8) : 0);
+	auto count = usize{ width } * height;
+	// Checked before allocating the pixels, a packet covering at most 128 of them
+	if (pos > bytes.size()) return {};
+	auto available = bytes.size() - pos;
+	if (rle ? available / (1 + pixelBytes) * 128 < count : available / pixelBytes < count) return {};
+	auto image = Image::Uncompressed(width, height, srgb);
+	auto* out = reinterpret_cast<u8*>(image.data.data());
+	auto put = [&](usize i, usize from) {
+		auto* p = out + i * 4;
+		if (grey) {
+			p[0] = p[1] = p[2] = static_cast<u8>(byteAt(from));
+			p[3] = 255;
+		} else {
+			// Stored as BGR(A)
+			p[0] = static_cast<u8>(byteAt(from + 2));
+			p[1] = static_cast<u8>(byteAt(from + 1));
+			p[2] = static_cast<u8>(byteAt(from));
+			p[3] = pixelBytes == 4 ? static_cast<u8>(byteAt(from + 3)) : 255;
+		}
+	};
+
+	if (!rle) {
+		for (usize i = 0; i < count; ++i) put(i, pos + i * pixelBytes);
+	} else {
+		usize i = 0;
+		while (i < count) {
+			if (pos >= bytes.size()) return {};
+			auto packet = byteAt(pos++);
+			usize run = (packet & 0x7f) + 1;
+			if (run > count - i) return {};
+			// Run of one repeated pixel, or of raw pixels
+			auto repeated = (packet & 0x80) != 0;
+			auto needed = repeated ? pixelBytes : run * pixelBytes;
+			if (bytes.size() - pos < needed) return {};
+			for (usize k = 0; k < run; ++k) put(i++, repeated ? pos : pos + k * pixelBytes);
+			pos += needed;
+		}
+	}
+
+	// Rows go bottom to top unless bit 5 of the descriptor is set, pixels left to
+	// right unless bit 4 is
+	auto stride = usize{ width } * 4;
+	if (descriptor & 0x20) {
+		for (usize y = 0; y < height / 2; ++y) {
+			std::swap_ranges(out + y * stride, out + (y + 1) * stride, out + (height - 1 - y) * stride);
+		}
+	}
+	if (descriptor & 0x10) {
+		for (usize y = 0; y < height; ++y) {
+			auto* row = reinterpret_cast<u32*>(out + y * stride);
+			std::reverse(row, row + width);
+		}
+	}
+	return image;
+}
+
+std::vector<std::byte> HOEngine::CookImage(const Image& image) {
+	CookedHeader header{};
+	std::memcpy(header.magic, cookedMagic, sizeof(cookedMagic));
+	header.version = cookedVersion;
+	header.format = static_cast<u32>(image.format);
+	header.width = image.width();
+	header.height = image.height();
+	header.levelCount = static_cast<u32>(image.levels.size());
+
+	std::vector<CookedLevel> table;
+	auto offset = sizeof(CookedHeader) + sizeof(CookedLevel) * image.levels.size();
+	for (const auto& level : image.levels) {
+		offset = (offset + cookedAlignment - 1) / cookedAlignment * cookedAlignment;
+		table.push_back(CookedLevel{ offset, level.size });
+		offset += level.size;
+	}
+
+	std::vector<std::byte> bytes(offset);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	std::memcpy(bytes.data() + sizeof(header), table.data(), sizeof(CookedLevel) * table.size());
+	for (u32 level = 0; level < image.levels.size(); ++level) {
+		auto data = image.LevelData(level);
+		std::memcpy(bytes.data() + table[level].offset, data.data(), data.size());
+	}
+	return bytes;
+}
+
+std::optional<Image> HOEngine::ReadCookedImage(std::span<const std::byte> bytes, u32 firstLevel) {
+	CookedHeader header;
+	if (bytes.size() < sizeof(header)) return {};
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	if (std::memcmp(header.magic, cookedMagic, sizeof(cookedMagic)) != 0 || header.version != cookedVersion) return {};
+	if (header.format > static_cast<u32>(TextureFormat::ETC2RGBA)) return {};
+	if (header.width == 0 || header.height == 0) return {};
+	if (header.levelCount == 0 || header.levelCount > Texture::MipCount(header.width, header.height)) return {};
+	if ((bytes.size() - sizeof(header)) / sizeof(CookedLevel) < header.levelCount) return {};
+
+	Image image;
+	image.format = static_cast<TextureFormat>(header.format);
+	auto first = std::min(firstLevel, header.levelCount - 1);
+	image.droppedLevels = first;
+	usize total = 0;
+	std::vector<CookedLevel> sources;
+	for (u32 level = first; level < header.levelCount; ++level) {
+		CookedLevel entry;
+		std::memcpy(&entry, bytes.data() + sizeof(header) + sizeof(CookedLevel) * level, sizeof(entry));
+		auto width = std::max(header.width >> level, 1u);
+		auto height = std::max(header.height >> level, 1u);
+		auto size = TextureLevelSize(image.format, width, height);
+		if (entry.size != size || entry.offset > bytes.size() || bytes.size() - entry.offset < size) return {};
+		image.levels.push_back(Image::Level{ total, size, width, height });
+		sources.push_back(entry);
+		total += size;
+	}
+
+	image.data.resize(total);
+	for (usize i = 0; i < sources.size(); ++i) {
+		std::memcpy(image.data.data() + image.levels[i].offset, bytes.data() + sources[i].offset, sources[i].size);
+	}
+	return image;
+}
+
+std::optional<Image> HOEngine::ReadImageFile(const std::string& path, bool srgb, MipFilter filter, u32 firstLevel) {
+	auto file = MappedFile::Open(path);
+	if (!file) return {};
+	std::span<const std::byte> bytes{ file->data(), file->size() };
+	if (!EndsWith(path, ".tga")) return ReadCookedImage(bytes, firstLevel);
+
+	auto image = DecodeTGA(bytes, srgb);
+	if (!image) return {};
+	GenerateMips(*image, filter);
+	image->DropLevels(firstLevel);
+	return image;
+}
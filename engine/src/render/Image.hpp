@@ -0,0 +1,68 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include "Engine.hpp"
+#include "GLWrapper.hpp"
+
+namespace HOEngine {
+
+/// Texture data on the CPU: mip levels, finest first, in one allocation laid out
+/// the way they're uploaded. Rows go bottom to top, as GL expects them.
+struct Image {
+	struct Level {
+		usize offset;
+		usize size;
+		u32 width;
+		u32 height;
+	};
+
+	TextureFormat format = TextureFormat::RGBA8;
+	std::vector<Level> levels;
+	std::vector<std::byte> data;
+	/// Levels of the source left out before the first one, when it was read from
+	/// a lower resolution.
+	u32 droppedLevels = 0;
+
+	/// Single level of uninitialized RGBA8 or SRGBA8 pixels.
+	static Image Uncompressed(u32 width, u32 height, bool srgb);
+
+	u32 width() const { return levels.empty() ? 0 : levels[0].width; }
+	u32 height() const { return levels.empty() ? 0 : levels[0].height; }
+	std::span<std::byte> LevelData(u32 level) { return std::span{ data }.subspan(levels[level].offset, levels[level].size); }
+	std::span<const std::byte> LevelData(u32 level) const { return std::span{ data }.subspan(levels[level].offset, levels[level].size); }
+	/// Drop the `count` finest levels, keeping at least the coarsest one.
+	void DropLevels(u32 count);
+};
+
+enum class MipFilter : u8 {
+	/// Average of 2x2 pixels. Fast, but blurry and prone to aliasing.
+	Box,
+	/// Windowed sinc over 6x6 pixels, keeping the mips sharp.
+	Kaiser,
+};
+
+/// Replace the mips of an RGBA8 or SRGBA8 image by a full chain down to 1x1,
+/// generated from its first level. sRGB images are filtered in linear space.
+/// Throws for compressed formats, which are mipmapped when cooked.
+void GenerateMips(Image& image, MipFilter filter);
+
+/// Decode an uncompressed or RLE TGA file, true-color (24 or 32 bits) or
+/// grayscale, into a single RGBA8 level, SRGBA8 if `srgb`.
+std::optional<Image> DecodeTGA(std::span<const std::byte> bytes, bool srgb);
+
+/// Serialize `image` into the cooked texture container: a header, the level
+/// table, then the levels as they're uploaded. Meant for offline tools, along with
+/// a block compressor for the BC and ETC2 formats.
+std::vector<std::byte> CookImage(const Image& image);
+/// Read a cooked texture, skipping its `firstLevel` finest levels (the coarsest
+/// one is always kept). `std::nullopt` if the container is malformed.
+std::optional<Image> ReadCookedImage(std::span<const std::byte> bytes, u32 firstLevel = 0);
+
+/// Read a `.tga` file, mipmapped with `filter`, or a cooked texture otherwise,
+/// skipping its `firstLevel` finest levels. `std::nullopt` on failure.
+std::optional<Image> ReadImageFile(const std::string& path, bool srgb, MipFilter filter, u32 firstLevel = 0);
+
+} // namespace HOEngine
@@ -0,0 +1,230 @@
+#include <utility>
+#include <stdexcept>
+#include "MeshArena.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+MeshArena::MeshArena(usize vertexSize, SetupFunc setupAttributes, u32 vertexCapacity, u32 indexCapacity)
+	: vertexSize_{ vertexSize },
+	setupAttributes_{ setupAttributes },
+	vertexAlloc_{ vertexCapacity },
+	indexAlloc_{ indexCapacity } {
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_.handle());
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCapacity * vertexSize_), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_.handle());
+	glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(indexCapacity * sizeof(GLuint)), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	SetupVAO();
+}
+
+MeshArena MeshArena::ForSimpleVertex(u32 vertexCapacity, u32 indexCapacity) {
+	return MeshArena(sizeof(SimpleVertex), SimpleVertex::SetupPointers, vertexCapacity, indexCapacity);
+}
+
+void MeshArena::SetupVAO() {
+	glBindVertexArray(vao_.handle());
+	glBindBuffer(GL_ARRAY_BUFFER, vbo_.handle());
+	setupAttributes_();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_.handle());
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshArena::Reallocate(BufferObject& buffer, usize newSize, const std::vector<std::array<usize, 3>>& moves) {
+	BufferObject fresh;
+	glBindBuffer(GL_COPY_WRITE_BUFFER, fresh.handle());
+	glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(newSize), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer.handle());
+	for (const auto& [src, dst, size] : moves) {
+		glCopyBufferSubData(
+				GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+				static_cast<GLintptr>(src), static_cast<GLintptr>(dst), static_cast<GLsizeiptr>(size));
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer = std::move(fresh);
+}
+
+RangeAllocator::Allocation MeshArena::AllocateOrGrow(RangeAllocator& alloc, BufferObject& buffer, u32 count, usize unitSize) {
+	// Empty ranges take no space, nor a handle
+	if (count == 0) return RangeAllocator::Allocation{ RangeAllocator::invalidHandle, 0, 0 };
+	if (auto result = alloc.Allocate(count)) return *result;
+
+	auto oldCapacity = alloc.capacity();
+	auto newCapacity = std::max(oldCapacity * 2, oldCapacity + count);
+	alloc.Grow(newCapacity);
+	Reallocate(buffer, newCapacity * unitSize, { { 0, 0, oldCapacity * unitSize } });
+	// The VAO still refers to the old buffer object
+	SetupVAO();
+	++grows_;
+
+	auto result = alloc.Allocate(count);
+	if (!result) throw std::runtime_error("MeshArena failed to allocate after growing");
+	return *result;
+}
+
+MeshArena::MeshHandle MeshArena::Add(const void* vertices, u32 vertexCount, const GLuint* indices, u32 indexCount) {
+	auto vertexRange = AllocateOrGrow(vertexAlloc_, vbo_, vertexCount, vertexSize_);
+	auto indexRange = AllocateOrGrow(indexAlloc_, ibo_, indexCount, sizeof(GLuint));
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo_.handle());
+	glBufferSubData(
+			GL_COPY_WRITE_BUFFER,
+			static_cast<GLintptr>(vertexRange.offset * vertexSize_),
+			static_cast<GLsizeiptr>(vertexCount * vertexSize_),
+			vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ibo_.handle());
+	glBufferSubData(
+			GL_COPY_WRITE_BUFFER,
+			static_cast<GLintptr>(indexRange.offset * sizeof(GLuint)),
+			static_cast<GLsizeiptr>(indexCount * sizeof(GLuint)),
+			indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	RenderStats::Global().Upload(vertexCount * vertexSize_ + indexCount * sizeof(GLuint));
+
+	Entry entry{ vertexRange.handle, indexRange.handle, true };
+	if (!unusedMeshes_.empty()) {
+		auto handle = unusedMeshes_.back();
+		unusedMeshes_.pop_back();
+		meshes_[handle] = entry;
+		return handle;
+	}
+	meshes_.push_back(entry);
+	return static_cast<MeshHandle>(meshes_.size() - 1);
+}
+
+MeshArena::MeshHandle MeshArena::Add(const MeshComponent& mesh) {
+	if (vertexSize_ != sizeof(SimpleVertex)) {
+		throw std::runtime_error("MeshComponent can only be added to a SimpleVertex arena");
+	}
+	return Add(
+			mesh.vertices.data(), static_cast<u32>(mesh.vertices.size()),
+			mesh.indices.data(), static_cast<u32>(mesh.indices.size()));
+}
+
+void MeshArena::Remove(MeshHandle mesh) {
+	auto& entry = meshes_.at(mesh);
+	if (!entry.live) return;
+	if (entry.vertexHandle != RangeAllocator::invalidHandle) vertexAlloc_.Free(entry.vertexHandle);
+	if (entry.indexHandle != RangeAllocator::invalidHandle) indexAlloc_.Free(entry.indexHandle);
+	entry.live = false;
+	unusedMeshes_.push_back(mesh);
+}
+
+void MeshArena::Defragment() {
+	auto apply = [](RangeAllocator& alloc, usize unitSize) {
+		auto relocations = alloc.Defragment();
+		// Once one block moves down every block after it moves too, so everything
+		// below the first relocation kept its offset and is copied over as is
+		auto stayed = relocations.empty() ? alloc.GetStats().usedSize : relocations.front().to;
+		std::vector<std::array<usize, 3>> moves;
+		if (stayed > 0) moves.push_back({ 0, 0, stayed * unitSize });
+		for (const auto& move : relocations) {
+			moves.push_back({ move.from * unitSize, move.to * unitSize, move.size * unitSize });
+		}
+		return moves;
+	};
+
+	auto vertexMoves = apply(vertexAlloc_, vertexSize_);
+	auto indexMoves = apply(indexAlloc_, sizeof(GLuint));
+	Reallocate(vbo_, vertexAlloc_.capacity() * vertexSize_, vertexMoves);
+	Reallocate(ibo_, indexAlloc_.capacity() * sizeof(GLuint), indexMoves);
+	SetupVAO();
+	++defragmentations_;
+}
+
+MeshArena::MeshRange MeshArena::Range(MeshHandle mesh) const {
+	const auto& entry = meshes_.at(mesh);
+	auto empty = [](RangeAllocator::Handle handle) { return handle == RangeAllocator::invalidHandle; };
+	return MeshRange{
+		empty(entry.vertexHandle) ? 0 : vertexAlloc_.OffsetOf(entry.vertexHandle),
+		empty(entry.vertexHandle) ? 0 : vertexAlloc_.SizeOf(entry.vertexHandle),
+		empty(entry.indexHandle) ? 0 : indexAlloc_.OffsetOf(entry.indexHandle),
+		empty(entry.indexHandle) ? 0 : indexAlloc_.SizeOf(entry.indexHandle),
+	};
+}
+
+DrawElementsIndirectCommand MeshArena::DrawCommand(MeshHandle mesh, u32 instanceCount, u32 baseInstance) const {
+	auto range = Range(mesh);
+	return DrawElementsIndirectCommand{
+		range.indexCount,
+		instanceCount,
+		range.firstIndex,
+		static_cast<GLint>(range.firstVertex),
+		baseInstance,
+	};
+}
+
+MeshArena::Stats MeshArena::GetStats() const {
+	Stats stats;
+	stats.vertices = vertexAlloc_.GetStats();
+	stats.indices = indexAlloc_.GetStats();
+	stats.meshCount = static_cast<u32>(meshes_.size() - unusedMeshes_.size());
+	stats.grows = grows_;
+	stats.defragmentations = defragmentations_;
+	return stats;
+}
+
+DrawCommandBuffer::DrawCommandBuffer()
+	: indirectSupported_{ IsIndirectSupported() } {
+}
+
+bool DrawCommandBuffer::IsIndirectSupported() {
+	return HasGLVersion(4, 3) || HasGLExtension("GL_ARB_multi_draw_indirect");
+}
+
+void DrawCommandBuffer::Add(const MeshArena& arena, MeshArena::MeshHandle mesh, u32 instanceCount, u32 baseInstance) {
+	commands_.push_back(arena.DrawCommand(mesh, instanceCount, baseInstance));
+}
+
+void DrawCommandBuffer::Submit(const MeshArena& arena, GLenum mode) {
+	if (commands_.empty()) return;
+	glBindVertexArray(arena.vao());
+
+	auto& stats = RenderStats::Global();
+	stats.StateChange();
+	for (const auto& cmd : commands_) {
+		stats.Primitives(mode, cmd.count, cmd.instanceCount);
+	}
+
+	if (indirectSupported_) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_.handle());
+		// Orphan and refill, the command list is rebuilt every frame
+		glBufferData(
+				GL_DRAW_INDIRECT_BUFFER,
+				static_cast<GLsizeiptr>(commands_.size() * sizeof(DrawElementsIndirectCommand)),
+				commands_.data(),
+				GL_STREAM_DRAW);
+		glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(commands_.size()), 0);
+		stats.Upload(commands_.size() * sizeof(DrawElementsIndirectCommand));
+		stats.DrawCall();
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	} else {
+		counts_.clear();
+		offsets_.clear();
+		baseVertices_.clear();
+		for (const auto& cmd : commands_) {
+			auto offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(cmd.firstIndex) * sizeof(GLuint));
+			if (cmd.instanceCount == 1) {
+				counts_.push_back(static_cast<GLsizei>(cmd.count));
+				offsets_.push_back(offset);
+				baseVertices_.push_back(cmd.baseVertex);
+			} else if (cmd.instanceCount > 1) {
+				glDrawElementsInstancedBaseVertex(
+						mode, static_cast<GLsizei>(cmd.count), GL_UNSIGNED_INT, offset,
+						static_cast<GLsizei>(cmd.instanceCount), cmd.baseVertex);
+				stats.DrawCall();
+			}
+		}
+		if (!counts_.empty()) {
+			glMultiDrawElementsBaseVertex(
+					mode, counts_.data(), GL_UNSIGNED_INT, offsets_.data(),
+					static_cast<GLsizei>(counts_.size()), baseVertices_.data());
+			stats.DrawCall();
+		}
+	}
+
+	glBindVertexArray(0);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+#include <GL/gl3w.h>
+#include "Engine.hpp"
+#include "Entity.hpp"
+#include "GLWrapper.hpp"
+#include "RangeAllocator.hpp"
+
+namespace HOEngine {
+
+/// Command layout consumed by `glMultiDrawElementsIndirect`, do not reorder fields.
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/// A pair of large vertex/index buffers shared by every mesh of one vertex format,
+/// so that all of them can be drawn with a single VAO bind. Mesh ranges are
+/// sub-allocated with a `RangeAllocator` in units of vertices and indices, and the
+/// buffers grow (by copying on the GPU) when they run out of space.
+///
+/// Indices are stored relative to the mesh's own first vertex and are always
+/// `GLuint`, draws rebase them with `baseVertex`.
+class MeshArena {
+public:
+	using SetupFunc = void(*)();
+	using MeshHandle = u32;
+	static constexpr MeshHandle invalidMesh = ~0u;
+
+	struct MeshRange {
+		u32 firstVertex;
+		u32 vertexCount;
+		u32 firstIndex;
+		u32 indexCount;
+	};
+
+	struct Stats {
+		RangeAllocator::Stats vertices;
+		RangeAllocator::Stats indices;
+		u32 meshCount = 0;
+		/// Number of times the buffers had to be reallocated to a larger size.
+		u32 grows = 0;
+		u32 defragmentations = 0;
+	};
+
+private:
+	struct Entry {
+		RangeAllocator::Handle vertexHandle;
+		RangeAllocator::Handle indexHandle;
+		bool live;
+	};
+
+	StateObject vao_;
+	BufferObject vbo_;
+	BufferObject ibo_;
+	usize vertexSize_;
+	SetupFunc setupAttributes_;
+	RangeAllocator vertexAlloc_;
+	RangeAllocator indexAlloc_;
+	std::vector<Entry> meshes_;
+	std::vector<MeshHandle> unusedMeshes_;
+	u32 grows_ = 0;
+	u32 defragmentations_ = 0;
+
+public:
+	/// `setupAttributes` is called with the arena's VAO and vertex buffer bound,
+	/// e.g. `SimpleVertex::SetupPointers`.
+	MeshArena(usize vertexSize, SetupFunc setupAttributes, u32 vertexCapacity, u32 indexCapacity);
+	/// Arena for `SimpleVertex`, the vertex format of `MeshComponent`.
+	static MeshArena ForSimpleVertex(u32 vertexCapacity = 1 << 16, u32 indexCapacity = 1 << 18);
+	MeshArena(const MeshArena&) = delete;
+	MeshArena& operator=(const MeshArena&) = delete;
+	MeshArena(MeshArena&&) = default;
+	MeshArena& operator=(MeshArena&&) = default;
+
+	/// Upload a mesh into the arena, growing the buffers if needed. `vertices` must
+	/// point to `vertexCount` vertices of this arena's vertex format. Either count
+	/// may be 0, giving an empty range at offset 0.
+	MeshHandle Add(const void* vertices, u32 vertexCount, const GLuint* indices, u32 indexCount);
+	MeshHandle Add(const MeshComponent& mesh);
+	void Remove(MeshHandle mesh);
+	/// Compact all meshes towards the start of the buffers. Handles stay valid, but
+	/// `Range()` results obtained before this call are stale.
+	void Defragment();
+
+	MeshRange Range(MeshHandle mesh) const;
+	DrawElementsIndirectCommand DrawCommand(MeshHandle mesh, u32 instanceCount = 1, u32 baseInstance = 0) const;
+	Stats GetStats() const;
+
+	GLuint vao() const { return vao_.handle(); }
+	usize vertexSize() const { return vertexSize_; }
+
+private:
+	void SetupVAO();
+	/// Reallocate `buffer` with `newSize` bytes, copying over `moves` (src, dst, size
+	/// triplets in bytes) from the old storage.
+	void Reallocate(BufferObject& buffer, usize newSize, const std::vector<std::array<usize, 3>>& moves);
+	RangeAllocator::Allocation AllocateOrGrow(RangeAllocator& alloc, BufferObject& buffer, u32 count, usize unitSize);
+};
+
+/// CPU-side list of draws into one `MeshArena`, submitted with a single
+/// `glMultiDrawElementsIndirect` when the context supports it (GL 4.3 or
+/// `GL_ARB_multi_draw_indirect`), or `glMultiDrawElementsBaseVertex` otherwise.
+class DrawCommandBuffer {
+private:
+	std::vector<DrawElementsIndirectCommand> commands_;
+	BufferObject indirectBuffer_;
+	bool indirectSupported_;
+
+	// Scratch arrays for the base vertex fallback, kept around to avoid reallocating every frame
+	std::vector<GLsizei> counts_;
+	std::vector<const void*> offsets_;
+	std::vector<GLint> baseVertices_;
+
+public:
+	/// Requires a current context to detect indirect draw support.
+	DrawCommandBuffer();
+
+	static bool IsIndirectSupported();
+
+	void Add(const DrawElementsIndirectCommand& command) { commands_.push_back(command); }
+	void Add(const MeshArena& arena, MeshArena::MeshHandle mesh, u32 instanceCount = 1, u32 baseInstance = 0);
+	void Clear() { commands_.clear(); }
+
+	/// Bind the arena's VAO and issue every recorded command. The fallback path
+	/// ignores `baseInstance`.
+	void Submit(const MeshArena& arena, GLenum mode = GL_TRIANGLES);
+
+	const std::vector<DrawElementsIndirectCommand>& commands() const { return commands_; }
+	bool indirect() const { return indirectSupported_; }
+};
+
+} // namespace HOEngine
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cmath>
+#include "OcclusionCulling.hpp"
+#include "Simd.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Size of pyramid level `level` along an axis of `size` texels. Levels round
+	/// up, so a texel of an odd sized level always has a parent covering it.
+	i32 LevelSize(i32 size, usize level) {
+		return ((size - 1) >> level) + 1;
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer(i32 width, i32 height)
+	: width_{ (std::max(width, 1) + tileWidth - 1) / tileWidth * tileWidth },
+	height_{ (std::max(height, 1) + tileHeight - 1) / tileHeight * tileHeight },
+	tilesX{ width_ / tileWidth },
+	tilesY{ height_ / tileHeight },
+	depth(static_cast<usize>(width_ * height_), 1.0f),
+	bins(static_cast<usize>(tilesX * tilesY)) {
+	// Allocate every level once, `BuildPyramids` only overwrites them
+	for (usize level = 0;; ++level) {
+		auto w = LevelSize(width_, level);
+		auto h = LevelSize(height_, level);
+		minPyramid.emplace_back(static_cast<usize>(w * h), 1.0f);
+		maxPyramid.emplace_back(static_cast<usize>(w * h), 1.0f);
+		if (w == 1 && h == 1) break;
+	}
+}
+
+void OcclusionBuffer::Clear() {
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	triangles.clear();
+	for (auto& bin : bins) bin.clear();
+}
+
+void OcclusionBuffer::AddOccluder(const MeshComponent& mesh, const glm::mat4& modelViewProj) {
+	++stats_.occluders;
+	const auto& indices = mesh.indices;
+	const auto& vertices = mesh.vertices;
+
+	for (usize i = 0; i + 2 < indices.size(); i += 3) {
+		++stats_.trianglesIn;
+		glm::vec4 clip[3];
+		f32 nearDist[3];
+		i32 inside = 0;
+		for (usize v = 0; v < 3; ++v) {
+			clip[v] = modelViewProj * glm::vec4(vertices[indices[i + v]].pos, 1.0f);
+			// Signed distance to the near plane (z >= -w in GL clip space)
+			nearDist[v] = clip[v].z + clip[v].w;
+			if (nearDist[v] >= 0.0f) ++inside;
+		}
+
+		if (inside == 3) {
+			BinTriangle(clip[0], clip[1], clip[2]);
+		} else if (inside > 0) {
+			// Sutherland-Hodgman against the near plane, yields a triangle or a quad
+			glm::vec4 poly[4];
+			usize count = 0;
+			for (usize v = 0; v < 3; ++v) {
+				auto next = (v + 1) % 3;
+				if (nearDist[v] >= 0.0f) poly[count++] = clip[v];
+				if ((nearDist[v] >= 0.0f) != (nearDist[next] >= 0.0f)) {
+					auto t = nearDist[v] / (nearDist[v] - nearDist[next]);
+					poly[count++] = clip[v] + (clip[next] - clip[v]) * t;
+				}
+			}
+			for (usize v = 1; v + 1 < count; ++v) {
+				BinTriangle(poly[0], poly[v], poly[v + 1]);
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::BinTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+	Triangle tri;
+	const glm::vec4* verts[3] = { &a, &b, &c };
+	for (usize v = 0; v < 3; ++v) {
+		const auto& p = *verts[v];
+		auto invW = 1.0f / p.w;
+		tri.x[v] = (p.x * invW * 0.5f + 0.5f) * static_cast<f32>(width_);
+		tri.y[v] = (p.y * invW * 0.5f + 0.5f) * static_cast<f32>(height_);
+		tri.z[v] = std::clamp(p.z * invW * 0.5f + 0.5f, 0.0f, 1.0f);
+	}
+
+	auto area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+	if (area == 0.0f || (backfaceCulling && area < 0.0f)) return;
+	if (area < 0.0f) {
+		// Make double sided occluders counter-clockwise so the rasterizer only has one winding to handle
+		std::swap(tri.x[1], tri.x[2]);
+		std::swap(tri.y[1], tri.y[2]);
+		std::swap(tri.z[1], tri.z[2]);
+	}
+
+	auto minX = std::max(0, static_cast<i32>(std::floor(std::min({ tri.x[0], tri.x[1], tri.x[2] }))));
+	auto maxX = std::min(width_ - 1, static_cast<i32>(std::floor(std::max({ tri.x[0], tri.x[1], tri.x[2] }))));
+	auto minY = std::max(0, static_cast<i32>(std::floor(std::min({ tri.y[0], tri.y[1], tri.y[2] }))));
+	auto maxY = std::min(height_ - 1, static_cast<i32>(std::floor(std::max({ tri.y[0], tri.y[1], tri.y[2] }))));
+	if (minX > maxX || minY > maxY) return;
+
+	auto index = static_cast<u32>(triangles.size());
+	triangles.push_back(tri);
+	++stats_.trianglesBinned;
+	for (auto ty = minY / tileHeight; ty <= maxY / tileHeight; ++ty) {
+		for (auto tx = minX / tileWidth; tx <= maxX / tileWidth; ++tx) {
+			bins[static_cast<usize>(ty * tilesX + tx)].push_back(index);
+		}
+	}
+}
+
+void OcclusionBuffer::Rasterize(ThreadPool* pool) {
+	auto tileCount = static_cast<usize>(tilesX * tilesY);
+	if (pool) {
+		pool->ParallelTasks(tileCount, [this](usize tile) { RasterizeTile(static_cast<i32>(tile)); });
+	} else {
+		for (usize tile = 0; tile < tileCount; ++tile) RasterizeTile(static_cast<i32>(tile));
+	}
+	BuildPyramids();
+}
+
+void OcclusionBuffer::RasterizeTile(i32 tile) {
+	auto tileX0 = (tile % tilesX) * tileWidth;
+	auto tileY0 = (tile / tilesX) * tileHeight;
+	auto tileX1 = tileX0 + tileWidth - 1;
+	auto tileY1 = tileY0 + tileHeight - 1;
+	auto laneOffsets = F32x4::Set(0.5f, 1.5f, 2.5f, 3.5f);
+	auto zero = F32x4::Zero();
+
+	for (auto index : bins[static_cast<usize>(tile)]) {
+		const auto& tri = triangles[index];
+		// Edge functions E(p) = A * p.x + B * p.y + C, positive inside a counter-clockwise triangle.
+		// Edge i goes from vertex i to vertex i + 1, and weighs the vertex opposite to it.
+		f32 edgeA[3], edgeB[3], edgeC[3];
+		for (usize e = 0; e < 3; ++e) {
+			auto next = (e + 1) % 3;
+			edgeA[e] = tri.y[e] - tri.y[next];
+			edgeB[e] = tri.x[next] - tri.x[e];
+			edgeC[e] = tri.x[e] * tri.y[next] - tri.x[next] * tri.y[e];
+		}
+		auto area = edgeC[0] + edgeC[1] + edgeC[2];
+		// Depth is affine in screen space: z = zA * x + zB * y + zC
+		// Vertex 0 is weighted by edge 1, vertex 1 by edge 2 and vertex 2 by edge 0
+		auto invArea = 1.0f / area;
+		auto zA = (edgeA[1] * tri.z[0] + edgeA[2] * tri.z[1] + edgeA[0] * tri.z[2]) * invArea;
+		auto zB = (edgeB[1] * tri.z[0] + edgeB[2] * tri.z[1] + edgeB[0] * tri.z[2]) * invArea;
+		auto zC = (edgeC[1] * tri.z[0] + edgeC[2] * tri.z[1] + edgeC[0] * tri.z[2]) * invArea;
+
+		auto minX = std::max(tileX0, static_cast<i32>(std::floor(std::min({ tri.x[0], tri.x[1], tri.x[2] }))));
+		auto maxX = std::min(tileX1, static_cast<i32>(std::floor(std::max({ tri.x[0], tri.x[1], tri.x[2] }))));
+		auto minY = std::max(tileY0, static_cast<i32>(std::floor(std::min({ tri.y[0], tri.y[1], tri.y[2] }))));
+		auto maxY = std::min(tileY1, static_cast<i32>(std::floor(std::max({ tri.y[0], tri.y[1], tri.y[2] }))));
+		if (minX > maxX || minY > maxY) continue;
+		// Blocks of four pixels, tiles are a multiple of four wide so this stays in the tile
+		minX &= ~3;
+
+		auto stepA = [&](usize e) { return F32x4::Set1(edgeA[e] * 4.0f); };
+		F32x4 step[3] = { stepA(0), stepA(1), stepA(2) };
+		auto zStep = F32x4::Set1(zA * 4.0f);
+
+		for (auto y = minY; y <= maxY; ++y) {
+			auto py = static_cast<f32>(y) + 0.5f;
+			auto px = F32x4::Set1(static_cast<f32>(minX)) + laneOffsets;
+			F32x4 edges[3];
+			for (usize e = 0; e < 3; ++e) {
+				edges[e] = MulAdd(F32x4::Set1(edgeA[e]), px, F32x4::Set1(edgeB[e] * py + edgeC[e]));
+			}
+			auto z = MulAdd(F32x4::Set1(zA), px, F32x4::Set1(zB * py + zC));
+
+			auto row = &depth[static_cast<usize>(y * width_)];
+			for (auto x = minX; x <= maxX; x += 4) {
+				auto mask = And(And(edges[0] >= zero, edges[1] >= zero), edges[2] >= zero);
+				if (MoveMask(mask)) {
+					auto old = F32x4::LoadUnaligned(row + x);
+					Select(mask, Min(old, z), old).StoreUnaligned(row + x);
+				}
+				for (usize e = 0; e < 3; ++e) edges[e] += step[e];
+				z += zStep;
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::BuildPyramids() {
+	std::copy(depth.begin(), depth.end(), minPyramid[0].begin());
+	std::copy(depth.begin(), depth.end(), maxPyramid[0].begin());
+
+	for (usize level = 1; level < maxPyramid.size(); ++level) {
+		auto w = LevelSize(width_, level - 1);
+		auto h = LevelSize(height_, level - 1);
+		auto nw = LevelSize(width_, level);
+		auto nh = LevelSize(height_, level);
+		const auto& srcMin = minPyramid[level - 1];
+		const auto& srcMax = maxPyramid[level - 1];
+		auto& dstMin = minPyramid[level];
+		auto& dstMax = maxPyramid[level];
+		// The last row and column of an odd sized level fold into a parent on their own
+		for (i32 y = 0; y < nh; ++y) {
+			auto y0 = std::min(y * 2, h - 1);
+			auto y1 = std::min(y * 2 + 1, h - 1);
+			for (i32 x = 0; x < nw; ++x) {
+				auto x0 = std::min(x * 2, w - 1);
+				auto x1 = std::min(x * 2 + 1, w - 1);
+				usize texels[4] = {
+					static_cast<usize>(y0 * w + x0), static_cast<usize>(y0 * w + x1),
+					static_cast<usize>(y1 * w + x0), static_cast<usize>(y1 * w + x1),
+				};
+				auto mn = srcMin[texels[0]];
+				auto mx = srcMax[texels[0]];
+				for (usize t = 1; t < 4; ++t) {
+					mn = std::min(mn, srcMin[texels[t]]);
+					mx = std::max(mx, srcMax[texels[t]]);
+				}
+				dstMin[static_cast<usize>(y * nw + x)] = mn;
+				dstMax[static_cast<usize>(y * nw + x)] = mx;
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const AABB& box, const glm::mat4& viewProj) const {
+	f32 minX = std::numeric_limits<f32>::max(), maxX = std::numeric_limits<f32>::lowest();
+	f32 minY = minX, maxY = maxX;
+	f32 nearest = 1.0f;
+	for (i32 corner = 0; corner < 8; ++corner) {
+		glm::vec4 p{
+			corner & 1 ? box.max.x : box.min.x,
+			corner & 2 ? box.max.y : box.min.y,
+			corner & 4 ? box.max.z : box.min.z,
+			1.0f,
+		};
+		auto clip = viewProj * p;
+		// Crosses the near plane, the screen space bounds are meaningless
+		if (clip.z + clip.w < 0.0f || clip.w <= 0.0f) return true;
+		auto invW = 1.0f / clip.w;
+		auto sx = (clip.x * invW * 0.5f + 0.5f) * static_cast<f32>(width_);
+		auto sy = (clip.y * invW * 0.5f + 0.5f) * static_cast<f32>(height_);
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	auto x0 = std::max(0, static_cast<i32>(std::floor(minX)));
+	auto x1 = std::min(width_ - 1, static_cast<i32>(std::floor(maxX)));
+	auto y0 = std::max(0, static_cast<i32>(std::floor(minY)));
+	auto y1 = std::min(height_ - 1, static_cast<i32>(std::floor(maxY)));
+	// Entirely off screen, leave it to frustum culling
+	if (x0 > x1 || y0 > y1) return true;
+
+	// Pick the level where the rectangle covers at most a few texels per axis
+	usize level = 0;
+	while (level + 1 < maxPyramid.size() && std::max(x1 - x0, y1 - y0) >> level > 4) ++level;
+
+	auto levelW = LevelSize(width_, level);
+	auto levelH = LevelSize(height_, level);
+	const auto& maxLevel = maxPyramid[level];
+	const auto& minLevel = minPyramid[level];
+	auto farthest = 0.0f;
+	auto ty1 = std::min(y1 >> level, levelH - 1);
+	auto tx1 = std::min(x1 >> level, levelW - 1);
+	for (auto ty = y0 >> level; ty <= ty1; ++ty) {
+		for (auto tx = x0 >> level; tx <= tx1; ++tx) {
+			auto texel = static_cast<usize>(ty * levelW + tx);
+			// Nearer than every occluder in this texel, visible for sure
+			if (nearest <= minLevel[texel]) return true;
+			farthest = std::max(farthest, maxLevel[texel]);
+		}
+	}
+	return nearest <= farthest;
+}
+
+void OcclusionBuffer::FilterVisible(const AABBArray& boxes, const glm::mat4& viewProj, std::vector<u32>& indices) {
+	auto out = indices.begin();
+	for (auto index : indices) {
+		glm::vec3 center{ boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index] };
+		glm::vec3 extents{ boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index] };
+		++stats_.queries;
+		if (IsVisible(AABB::FromCenterExtents(center, extents), viewProj)) {
+			*out++ = index;
+		} else {
+			++stats_.occludedQueries;
+		}
+	}
+	indices.erase(out, indices.end());
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "Entity.hpp"
+#include "ThreadPool.hpp"
+#include "render/Culling.hpp"
+
+namespace HOEngine {
+
+/// Low resolution software depth buffer for occlusion culling on the CPU.
+///
+/// A handful of large, low poly occluders are transformed and binned into screen
+/// tiles by `AddOccluder`, then `Rasterize` fills the depth buffer tile by tile (in
+/// parallel if given a pool, four pixels per SIMD operation) and builds min/max
+/// depth pyramids. Afterwards, `IsVisible` tests the screen space bounds of a box
+/// against the pyramid.
+///
+/// Depth is stored as window depth in [0, 1], 1 being the far plane, and screen
+/// space has its origin at the bottom left like OpenGL. The whole class is
+/// independent of any GL context.
+class OcclusionBuffer {
+public:
+	static constexpr i32 tileWidth = 64;
+	static constexpr i32 tileHeight = 32;
+
+	struct Stats {
+		u32 occluders = 0;
+		u32 trianglesIn = 0;
+		/// Triangles that survived clipping and backface/zero area culling.
+		u32 trianglesBinned = 0;
+		u32 queries = 0;
+		u32 occludedQueries = 0;
+	};
+
+private:
+	struct Triangle {
+		// Screen space x, y and window depth of each vertex
+		f32 x[3], y[3], z[3];
+	};
+
+	i32 width_;
+	i32 height_;
+	i32 tilesX;
+	i32 tilesY;
+	std::vector<f32> depth;
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<u32>> bins;
+	/// Level 0 is the full resolution buffer.
+	std::vector<std::vector<f32>> minPyramid;
+	std::vector<std::vector<f32>> maxPyramid;
+	Stats stats_;
+
+public:
+	/// Cull triangles facing away from the camera (counter-clockwise is front facing).
+	bool backfaceCulling = true;
+
+	/// `width` and `height` are rounded up to a multiple of the tile size.
+	OcclusionBuffer(i32 width = 256, i32 height = 128);
+
+	/// Forget every occluder and reset the depth buffer to the far plane.
+	void Clear();
+	/// Transform, clip and bin the triangles of `mesh` with the given
+	/// model-view-projection matrix.
+	void AddOccluder(const MeshComponent& mesh, const glm::mat4& modelViewProj);
+	/// Rasterize every binned triangle and build the depth pyramids. Tiles are
+	/// independent and distributed over `pool` if one is given.
+	void Rasterize(ThreadPool* pool = nullptr);
+
+	/// Whether any part of the world space `box` might be visible, using the
+	/// pyramids built by the last `Rasterize`. Conservative: boxes crossing the near
+	/// plane are always visible.
+	bool IsVisible(const AABB& box, const glm::mat4& viewProj) const;
+	/// Remove from `indices` every box of `boxes` that is fully occluded,
+	/// preserving the order of the remaining ones.
+	void FilterVisible(const AABBArray& boxes, const glm::mat4& viewProj, std::vector<u32>& indices);
+
+	i32 width() const { return width_; }
+	i32 height() const { return height_; }
+	f32 DepthAt(i32 x, i32 y) const { return depth[y * width_ + x]; }
+	usize pyramidLevels() const { return maxPyramid.size(); }
+	const Stats& stats() const { return stats_; }
+	void ResetStats() { stats_ = {}; }
+
+private:
+	void RasterizeTile(i32 tile);
+	void BuildPyramids();
+	void BinTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+};
+
+} // namespace HOEngine
@@ -0,0 +1,535 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include "Particles.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "Simd.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	constexpr f32 minLifetime = 1e-3f;
+
+	const char* drawVertexSource = R"(#version 330 core
+layout(location = 0) in vec3 instancePos;
+layout(location = 1) in float instanceSize;
+layout(location = 2) in vec4 instanceColor;
+uniform mat4 viewProj;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+out vec2 corner;
+out vec4 color;
+void main() {
+	corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	color = instanceColor;
+	vec3 pos = instancePos + (cameraRight * corner.x + cameraUp * corner.y) * instanceSize;
+	gl_Position = viewProj * vec4(pos, 1.0);
+}
+)";
+
+	const char* drawFragmentSource = R"(#version 330 core
+in vec2 corner;
+in vec4 color;
+out vec4 fragColor;
+void main() {
+	float d = dot(corner, corner);
+	if (d > 1.0) discard;
+	fragColor = vec4(color.rgb, color.a * (1.0 - d));
+}
+)";
+
+	/// Advances every particle of a GPU emitter, respawning dead particles whose
+	/// index falls in `[spawnStart, spawnStart + spawnCount)`, modulo the capacity.
+	const char* simulateVertexSource = R"(#version 330 core
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inVel;
+layout(location = 2) in float inAge;
+layout(location = 3) in float inLifetime;
+uniform float dt;
+uniform vec3 origin;
+uniform vec3 spawnExtents;
+uniform vec3 velocity;
+uniform vec3 velocityJitter;
+uniform vec3 acceleration;
+uniform float damping;
+uniform vec2 lifetimeRange;
+uniform vec2 sizeRange;
+uniform vec4 colors[4];
+uniform int spawnStart;
+uniform int spawnCount;
+uniform int capacity;
+uniform uint seed;
+out vec3 outPos;
+out vec3 outVel;
+out float outAge;
+out float outLifetime;
+out float outSize;
+out vec4 outColor;
+
+uint Hash(uint x) {
+	x ^= x >> 16; x *= 0x7feb352du;
+	x ^= x >> 15; x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+float Random(inout uint state) {
+	state = Hash(state);
+	return float(state >> 8) * (1.0 / 16777216.0);
+}
+vec3 RandomSigned(inout uint state) {
+	return vec3(Random(state), Random(state), Random(state)) * 2.0 - 1.0;
+}
+
+void main() {
+	vec3 pos = inPos;
+	vec3 vel = inVel;
+	float age = inAge;
+	float lifetime = inLifetime;
+	int slot = (gl_VertexID - spawnStart + capacity) % capacity;
+	if (age >= lifetime && slot < spawnCount) {
+		uint state = seed ^ (uint(gl_VertexID) * 0x9e3779b9u);
+		pos = origin + RandomSigned(state) * spawnExtents;
+		vel = velocity + RandomSigned(state) * velocityJitter;
+		age = 0.0;
+		lifetime = mix(lifetimeRange.x, lifetimeRange.y, Random(state));
+	} else if (age < lifetime) {
+		vel = vel * damping + acceleration * dt;
+		pos += vel * dt;
+		age += dt;
+	}
+	float life = min(age / lifetime, 1.0);
+	float k = life * 3.0;
+	outColor = colors[0] + (colors[1] - colors[0]) * min(k, 1.0) +
+		(colors[2] - colors[1]) * clamp(k - 1.0, 0.0, 1.0) + (colors[3] - colors[2]) * clamp(k - 2.0, 0.0, 1.0);
+	outSize = age < lifetime ? mix(sizeRange.x, sizeRange.y, life) : 0.0;
+	outPos = pos;
+	outVel = vel;
+	outAge = age;
+	outLifetime = lifetime;
+}
+)";
+
+	/// State of a GPU simulated particle, as captured by transform feedback.
+	struct GpuParticle {
+		glm::vec3 pos;
+		glm::vec3 vel;
+		f32 age;
+		f32 lifetime;
+		f32 size;
+		glm::vec4 color;
+	};
+
+	u64 SplitMix(u64 x) {
+		x += 0x9e3779b97f4a7c15ull;
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		return x ^ (x >> 31);
+	}
+
+	/// Uniform in [0, 1), xorshift64*.
+	f32 Random(u64& state) {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return static_cast<f32>((state * 0x2545f4914f6cdd1dull) >> 40) * (1.0f / 16777216.0f);
+	}
+
+	f32 RandomSigned(u64& state) { return Random(state) * 2.0f - 1.0f; }
+
+	u32 RoundUp4(u32 count) { return (count + 3) & ~3u; }
+}
+
+/// Two state buffers for transform feedback ping-pong, each with a VAO reading it
+/// as simulation input and one reading it as draw instances.
+struct ParticleSystem::GpuEmitter {
+	BufferObjects<2> buffers;
+	StateObjects<2> simulateVaos;
+	StateObjects<2> drawVaos;
+	u32 capacity;
+	/// Buffer holding the latest state.
+	u32 current = 0;
+	/// First index of the next spawn range.
+	u32 cursor = 0;
+	f32 spawnDebt = 0.0f;
+	u32 frame = 0;
+
+	explicit GpuEmitter(u32 capacity)
+		: capacity{ capacity } {
+		// Every particle starts dead, with zero size
+		std::vector<GpuParticle> initial(capacity, GpuParticle{ glm::vec3(0.0f), glm::vec3(0.0f), 1.0f, 0.0f, 0.0f, glm::vec4(0.0f) });
+		for (u32 i = 0; i < 2; ++i) {
+			glBindBuffer(GL_ARRAY_BUFFER, buffers.handle(i));
+			glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(capacity * sizeof(GpuParticle)), initial.data(), GL_DYNAMIC_COPY);
+
+			glBindVertexArray(simulateVaos.handle(i));
+			auto stride = static_cast<GLsizei>(sizeof(GpuParticle));
+			for (GLuint attrib = 0; attrib < 4; ++attrib) glEnableVertexAttribArray(attrib);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, BufferOffset(offsetof(GpuParticle, pos)));
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, BufferOffset(offsetof(GpuParticle, vel)));
+			glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, BufferOffset(offsetof(GpuParticle, age)));
+			glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, BufferOffset(offsetof(GpuParticle, lifetime)));
+
+			glBindVertexArray(drawVaos.handle(i));
+			for (GLuint attrib = 0; attrib < 3; ++attrib) {
+				glEnableVertexAttribArray(attrib);
+				glVertexAttribDivisor(attrib, 1);
+			}
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, BufferOffset(offsetof(GpuParticle, pos)));
+			glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, BufferOffset(offsetof(GpuParticle, size)));
+			glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, BufferOffset(offsetof(GpuParticle, color)));
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+};
+
+ParticleSystem::Emitter::Emitter() = default;
+ParticleSystem::Emitter::~Emitter() = default;
+
+ParticleSystem::ParticleSystem(Config config)
+	: config{ config }, nextSeed{ config.seed } {
+	this->config.particleGrain = std::max<usize>(config.particleGrain / 4 * 4, 4);
+}
+
+ParticleSystem::~ParticleSystem() = default;
+
+void ParticleSystem::Gather(EntitiesStorage& storage) {
+	HOENGINE_PROFILE_SCOPE("ParticleSystem::Gather");
+	for (auto& [settings, emitter] : emitters) emitter.used = false;
+	active.clear();
+	for (usize idx = 0; idx < storage.Capacity(); ++idx) {
+		auto entity = storage.At(idx);
+		if (!entity) continue;
+		auto settings = entity->GetComponent<ParticleEmitterComponent>();
+		if (!settings) continue;
+		auto transform = entity->GetComponent<TransformComponent>();
+		if (!transform) continue;
+
+		auto [it, inserted] = emitters.try_emplace(settings);
+		auto& emitter = it->second;
+		if (inserted) emitter.rng = SplitMix(nextSeed++) | 1;
+		emitter.used = true;
+		emitter.settings = settings;
+		emitter.origin = transform->pos;
+		emitter.velocity = glm::mat3_cast(transform->rot) * settings->velocity;
+		if (settings->gpuSimulated) {
+			if (emitter.capacity > 0) Resize(emitter, 0);
+		} else {
+			emitter.gpu.reset();
+			if (emitter.capacity != RoundUp4(settings->maxParticles)) Resize(emitter, settings->maxParticles);
+		}
+		active.push_back(&emitter);
+	}
+	std::erase_if(emitters, [](const auto& entry) { return !entry.second.used; });
+	stats_.emitters = active.size();
+}
+
+void ParticleSystem::Resize(Emitter& emitter, u32 maxParticles) {
+	emitter.capacity = RoundUp4(maxParticles);
+	emitter.count = std::min(emitter.count, maxParticles);
+	for (auto array : { &emitter.posX, &emitter.posY, &emitter.posZ, &emitter.velX, &emitter.velY, &emitter.velZ, &emitter.age }) {
+		array->resize(emitter.capacity, 0.0f);
+		array->shrink_to_fit();
+	}
+	emitter.lifetime.resize(emitter.capacity, 1.0f);
+	emitter.lifetime.shrink_to_fit();
+	emitter.dead.resize(emitter.capacity);
+	emitter.dead.shrink_to_fit();
+}
+
+void ParticleSystem::Update(ThreadPool& pool, f32 dt) {
+	HOENGINE_PROFILE_SCOPE("ParticleSystem::Update");
+	auto start = std::chrono::steady_clock::now();
+	stats_.spawned = 0;
+	stats_.died = 0;
+	stats_.particles = 0;
+	for (auto emitter : active) {
+		const auto& settings = *emitter->settings;
+		if (settings.gpuSimulated) {
+			emitter->gpuTime += dt;
+			if (emitter->gpu) stats_.particles += emitter->gpu->capacity;
+			continue;
+		}
+		Simulate(pool, *emitter, dt);
+		RemoveDead(*emitter);
+
+		emitter->spawnDebt += std::max(settings.rate, 0.0f) * dt;
+		auto room = std::min(settings.maxParticles, emitter->capacity) - emitter->count;
+		auto spawn = static_cast<u32>(std::min(std::floor(emitter->spawnDebt), static_cast<f32>(room)));
+		emitter->spawnDebt = std::min(emitter->spawnDebt - static_cast<f32>(spawn), 1.0f);
+		Spawn(*emitter, spawn);
+		stats_.particles += emitter->count;
+	}
+	HOENGINE_PROFILE_COUNTER("Particles", stats_.particles);
+	stats_.updateTime = MillisecondsSince(start);
+}
+
+void ParticleSystem::Spawn(Emitter& emitter, u32 count) {
+	const auto& settings = *emitter.settings;
+	auto lifetimeMin = std::max(settings.lifetimeMin, minLifetime);
+	auto lifetimeMax = std::max(settings.lifetimeMax, lifetimeMin);
+	for (u32 k = 0; k < count; ++k) {
+		auto i = emitter.count++;
+		emitter.posX[i] = emitter.origin.x + RandomSigned(emitter.rng) * settings.spawnExtents.x;
+		emitter.posY[i] = emitter.origin.y + RandomSigned(emitter.rng) * settings.spawnExtents.y;
+		emitter.posZ[i] = emitter.origin.z + RandomSigned(emitter.rng) * settings.spawnExtents.z;
+		emitter.velX[i] = emitter.velocity.x + RandomSigned(emitter.rng) * settings.velocityJitter.x;
+		emitter.velY[i] = emitter.velocity.y + RandomSigned(emitter.rng) * settings.velocityJitter.y;
+		emitter.velZ[i] = emitter.velocity.z + RandomSigned(emitter.rng) * settings.velocityJitter.z;
+		emitter.age[i] = 0.0f;
+		emitter.lifetime[i] = lifetimeMin + (lifetimeMax - lifetimeMin) * Random(emitter.rng);
+	}
+	stats_.spawned += count;
+}
+
+void ParticleSystem::Simulate(ThreadPool& pool, Emitter& emitter, f32 dt) {
+	auto count = emitter.count;
+	auto grain = config.particleGrain;
+	auto chunks = (count + grain - 1) / grain;
+	emitter.deadCounts.assign(chunks, 0);
+	if (count == 0) return;
+
+	const auto& settings = *emitter.settings;
+	auto step = F32x4::Set1(dt);
+	auto damping = F32x4::Set1(std::max(1.0f - settings.drag * dt, 0.0f));
+	auto accelX = F32x4::Set1(settings.acceleration.x * dt);
+	auto accelY = F32x4::Set1(settings.acceleration.y * dt);
+	auto accelZ = F32x4::Set1(settings.acceleration.z * dt);
+	pool.ParallelFor(chunks, 1, [&](usize chunkBegin, usize chunkEnd) {
+		for (auto chunk = chunkBegin; chunk < chunkEnd; ++chunk) {
+			auto begin = chunk * grain;
+			auto end = std::min<usize>(count, begin + grain);
+			u32 deadCount = 0;
+			// The last group may run past `count`, into the padding or dead particles
+			for (auto i = begin; i < end; i += 4) {
+				auto vx = MulAdd(F32x4::LoadUnaligned(&emitter.velX[i]), damping, accelX);
+				auto vy = MulAdd(F32x4::LoadUnaligned(&emitter.velY[i]), damping, accelY);
+				auto vz = MulAdd(F32x4::LoadUnaligned(&emitter.velZ[i]), damping, accelZ);
+				MulAdd(vx, step, F32x4::LoadUnaligned(&emitter.posX[i])).StoreUnaligned(&emitter.posX[i]);
+				MulAdd(vy, step, F32x4::LoadUnaligned(&emitter.posY[i])).StoreUnaligned(&emitter.posY[i]);
+				MulAdd(vz, step, F32x4::LoadUnaligned(&emitter.posZ[i])).StoreUnaligned(&emitter.posZ[i]);
+				vx.StoreUnaligned(&emitter.velX[i]);
+				vy.StoreUnaligned(&emitter.velY[i]);
+				vz.StoreUnaligned(&emitter.velZ[i]);
+				auto age = F32x4::LoadUnaligned(&emitter.age[i]) + step;
+				age.StoreUnaligned(&emitter.age[i]);
+
+				auto died = static_cast<u32>(MoveMask(age >= F32x4::LoadUnaligned(&emitter.lifetime[i])));
+				for (; died != 0; died &= died - 1) {
+					auto index = i + std::countr_zero(died);
+					if (index < end) emitter.dead[begin + deadCount++] = static_cast<u32>(index);
+				}
+			}
+			emitter.deadCounts[chunk] = deadCount;
+		}
+	});
+}
+
+void ParticleSystem::RemoveDead(Emitter& emitter) {
+	// Dead indices in decreasing order: every particle past the current one is
+	// alive, so the last particle can always fill the hole
+	auto grain = config.particleGrain;
+	for (auto chunk = emitter.deadCounts.size(); chunk-- > 0;) {
+		for (auto k = emitter.deadCounts[chunk]; k-- > 0;) {
+			auto hole = emitter.dead[chunk * grain + k];
+			auto last = --emitter.count;
+			++stats_.died;
+			if (hole == last) continue;
+			for (auto array : { &emitter.posX, &emitter.posY, &emitter.posZ, &emitter.velX, &emitter.velY, &emitter.velZ, &emitter.age, &emitter.lifetime }) {
+				(*array)[hole] = (*array)[last];
+			}
+		}
+	}
+}
+
+void ParticleSystem::WriteInstances(ThreadPool& pool, usize index, ParticleInstance* out) const {
+	const auto& emitter = *active[index];
+	const auto& settings = *emitter.settings;
+	auto count = emitter.count;
+	auto sizeStart = F32x4::Set1(settings.sizeStart);
+	auto sizeDelta = F32x4::Set1(settings.sizeEnd - settings.sizeStart);
+	// Piecewise linear curve through the keys, as a sum of clamped ramps
+	F32x4 key0[4], delta[3][4];
+	for (i32 c = 0; c < 4; ++c) {
+		key0[c] = F32x4::Set1(settings.colors[0][c]);
+		for (i32 k = 0; k < 3; ++k) delta[k][c] = F32x4::Set1(settings.colors[k + 1][c] - settings.colors[k][c]);
+	}
+	auto zero = F32x4::Zero();
+	auto one = F32x4::Set1(1.0f);
+
+	pool.ParallelFor(count, config.particleGrain, [&](usize begin, usize end) {
+		alignas(16) f32 sizes[4];
+		alignas(16) f32 channels[4][4];
+		for (auto i = begin; i < end; i += 4) {
+			auto life = Min(F32x4::LoadUnaligned(&emitter.age[i]) / F32x4::LoadUnaligned(&emitter.lifetime[i]), one);
+			MulAdd(sizeDelta, life, sizeStart).Store(sizes);
+			auto k = life * F32x4::Set1(3.0f);
+			F32x4 ramps[3] = {
+				Min(k, one),
+				Min(Max(k - one, zero), one),
+				Min(Max(k - F32x4::Set1(2.0f), zero), one),
+			};
+			for (i32 c = 0; c < 4; ++c) {
+				auto value = MulAdd(delta[2][c], ramps[2], MulAdd(delta[1][c], ramps[1], MulAdd(delta[0][c], ramps[0], key0[c])));
+				MulAdd(Min(Max(value, zero), one), F32x4::Set1(255.0f), F32x4::Set1(0.5f)).Store(channels[c]);
+			}
+			auto lanes = std::min<usize>(4, end - i);
+			for (usize lane = 0; lane < lanes; ++lane) {
+				auto color = static_cast<u32>(channels[0][lane]) | static_cast<u32>(channels[1][lane]) << 8 |
+					static_cast<u32>(channels[2][lane]) << 16 | static_cast<u32>(channels[3][lane]) << 24;
+				out[i + lane] = ParticleInstance{
+					glm::vec3(emitter.posX[i + lane], emitter.posY[i + lane], emitter.posZ[i + lane]), sizes[lane], color };
+			}
+		}
+	});
+}
+
+void ParticleSystem::Upload(ThreadPool& pool, StreamingBuffer& buffer) {
+	HOENGINE_PROFILE_SCOPE("ParticleSystem::Upload");
+	auto start = std::chrono::steady_clock::now();
+	stats_.overflows = 0;
+	for (usize i = 0; i < active.size(); ++i) {
+		auto& emitter = *active[i];
+		emitter.instances.reset();
+		if (emitter.settings->gpuSimulated || emitter.count == 0) continue;
+		emitter.instances = buffer.Allocate(emitter.count * sizeof(ParticleInstance), 16);
+		if (!emitter.instances) {
+			++stats_.overflows;
+			continue;
+		}
+		WriteInstances(pool, i, static_cast<ParticleInstance*>(emitter.instances->ptr));
+	}
+	stats_.uploadTime = MillisecondsSince(start);
+}
+
+bool ParticleSystem::SetupGL() {
+	if (drawProgram && simulateProgram) return true;
+	drawProgram = ShaderProgram::FromSource(drawVertexSource, drawFragmentSource);
+	auto simulateShader = Shader::New(GL_VERTEX_SHADER, simulateVertexSource);
+	if (simulateShader) {
+		simulateProgram = ShaderProgram::WithFeedback(*simulateShader,
+			{ "outPos", "outVel", "outAge", "outLifetime", "outSize", "outColor" });
+	}
+	if (!drawProgram || !simulateProgram) return false;
+
+	auto draw = [&](const char* name) { return glGetUniformLocation(*drawProgram, name); };
+	drawUniforms = DrawUniforms{ draw("viewProj"), draw("cameraRight"), draw("cameraUp") };
+	auto simulate = [&](const char* name) { return glGetUniformLocation(*simulateProgram, name); };
+	simulateUniforms = SimulateUniforms{
+		simulate("dt"), simulate("origin"), simulate("spawnExtents"), simulate("velocity"), simulate("velocityJitter"),
+		simulate("acceleration"), simulate("damping"), simulate("lifetimeRange"), simulate("sizeRange"), simulate("colors"),
+		simulate("spawnStart"), simulate("spawnCount"), simulate("capacity"), simulate("seed"),
+	};
+
+	drawVao.emplace();
+	glBindVertexArray(*drawVao);
+	for (GLuint attrib = 0; attrib < 3; ++attrib) {
+		glEnableVertexAttribArray(attrib);
+		glVertexAttribDivisor(attrib, 1);
+	}
+	glBindVertexArray(0);
+	return true;
+}
+
+void ParticleSystem::SimulateGpu(Emitter& emitter) {
+	const auto& settings = *emitter.settings;
+	auto capacity = std::max(settings.maxParticles, 1u);
+	if (!emitter.gpu || emitter.gpu->capacity != capacity) emitter.gpu = std::make_unique<GpuEmitter>(capacity);
+	auto& gpu = *emitter.gpu;
+	auto dt = emitter.gpuTime;
+	emitter.gpuTime = 0.0f;
+
+	gpu.spawnDebt += std::max(settings.rate, 0.0f) * dt;
+	auto spawn = static_cast<u32>(std::min(std::floor(gpu.spawnDebt), static_cast<f32>(capacity)));
+	gpu.spawnDebt = std::min(gpu.spawnDebt - static_cast<f32>(spawn), 1.0f);
+
+	const auto& uniforms = simulateUniforms;
+	auto lifetimeMin = std::max(settings.lifetimeMin, minLifetime);
+	glUniform1f(uniforms.dt, dt);
+	glUniform3fv(uniforms.origin, 1, &emitter.origin[0]);
+	glUniform3fv(uniforms.spawnExtents, 1, &settings.spawnExtents[0]);
+	glUniform3fv(uniforms.velocity, 1, &emitter.velocity[0]);
+	glUniform3fv(uniforms.velocityJitter, 1, &settings.velocityJitter[0]);
+	glUniform3fv(uniforms.acceleration, 1, &settings.acceleration[0]);
+	glUniform1f(uniforms.damping, std::max(1.0f - settings.drag * dt, 0.0f));
+	glUniform2f(uniforms.lifetimeRange, lifetimeMin, std::max(settings.lifetimeMax, lifetimeMin));
+	glUniform2f(uniforms.sizeRange, settings.sizeStart, settings.sizeEnd);
+	glUniform4fv(uniforms.colors, 4, &settings.colors[0][0]);
+	glUniform1i(uniforms.spawnStart, static_cast<GLint>(gpu.cursor));
+	glUniform1i(uniforms.spawnCount, static_cast<GLint>(spawn));
+	glUniform1i(uniforms.capacity, static_cast<GLint>(capacity));
+	glUniform1ui(uniforms.seed, static_cast<GLuint>(SplitMix(emitter.rng + gpu.frame)));
+
+	glBindVertexArray(gpu.simulateVaos.handle(gpu.current));
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, gpu.buffers.handle(1 - gpu.current));
+	glBeginTransformFeedback(GL_POINTS);
+	glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(capacity));
+	glEndTransformFeedback();
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	RenderStats::Global().DrawCall();
+
+	gpu.current = 1 - gpu.current;
+	gpu.cursor = (gpu.cursor + spawn) % capacity;
+	++gpu.frame;
+}
+
+void ParticleSystem::Draw(const StreamingBuffer& buffer, const glm::mat4& view, const glm::mat4& proj) {
+	HOENGINE_PROFILE_SCOPE("ParticleSystem::Draw");
+	if (active.empty() || !SetupGL()) return;
+	auto& stats = RenderStats::Global();
+
+	bool anyGpu = std::any_of(active.begin(), active.end(), [](const Emitter* e) { return e->settings->gpuSimulated; });
+	if (anyGpu) {
+		glUseProgram(*simulateProgram);
+		glEnable(GL_RASTERIZER_DISCARD);
+		for (auto emitter : active) {
+			if (emitter->settings->gpuSimulated) SimulateGpu(*emitter);
+		}
+		glDisable(GL_RASTERIZER_DISCARD);
+		stats.StateChange();
+	}
+
+	glUseProgram(*drawProgram);
+	auto viewProj = proj * view;
+	auto right = glm::vec3(view[0][0], view[1][0], view[2][0]);
+	auto up = glm::vec3(view[0][1], view[1][1], view[2][1]);
+	glUniformMatrix4fv(drawUniforms.viewProj, 1, GL_FALSE, &viewProj[0][0]);
+	glUniform3fv(drawUniforms.cameraRight, 1, &right[0]);
+	glUniform3fv(drawUniforms.cameraUp, 1, &up[0]);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+	glDepthMask(GL_FALSE);
+	stats.StateChange();
+
+	auto stride = static_cast<GLsizei>(sizeof(ParticleInstance));
+	for (auto emitter : active) {
+		u32 instances;
+		if (emitter->settings->gpuSimulated) {
+			glBindVertexArray(emitter->gpu->drawVaos.handle(emitter->gpu->current));
+			instances = emitter->gpu->capacity;
+		} else if (emitter->instances) {
+			auto offset = static_cast<usize>(emitter->instances->offset);
+			glBindVertexArray(*drawVao);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer.handle());
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(ParticleInstance, pos)));
+			glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(ParticleInstance, size)));
+			glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, BufferOffset(offset + offsetof(ParticleInstance, color)));
+			instances = emitter->count;
+		} else {
+			continue;
+		}
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances));
+		stats.StateChange();
+		stats.Draw(GL_TRIANGLE_STRIP, 4, instances);
+	}
+
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
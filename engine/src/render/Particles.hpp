@@ -0,0 +1,147 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Entity.hpp"
+#include "GLWrapper.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+/// Per particle instance data, read with an attribute divisor of 1.
+struct ParticleInstance {
+	glm::vec3 pos;
+	f32 size;
+	/// RGBA, 8 bits per channel, red in the lowest byte.
+	u32 color;
+};
+
+/// Simulates and draws the particles of every `ParticleEmitterComponent`.
+///
+/// Each CPU emitter owns structure-of-arrays particle state sized for its
+/// `maxParticles`, so spawning never allocates. `Update` integrates forces and
+/// ages four particles at a time with `F32x4`, in parallel chunks which also
+/// collect the particles that died; those are then swap-removed, moving the last
+/// live particles into the holes, which keeps the arrays dense. `Upload` evaluates
+/// sizes and color curves the same way and writes instances straight into a
+/// `StreamingBuffer`, so `Draw` issues one instanced draw per emitter.
+///
+/// Emitters with `gpuSimulated` set skip the CPU entirely: their particles live in
+/// two GPU buffers, and `Draw` first advances them with a transform feedback pass
+/// from one buffer to the other (GL 3.3 core), respawning dead particles in a ring.
+///
+/// `Gather` must run each frame before `Update`, and with `Draw`, on the thread
+/// owning the GL context, since removing a GPU emitter deletes its buffers.
+/// Particles are not sorted, so blending should be order independent (additive,
+/// or alpha fading towards black).
+class ParticleSystem {
+public:
+	struct Config {
+		/// Particles per job when simulating and writing instances, a multiple of 4.
+		usize particleGrain = 16384;
+		u64 seed = 1;
+	};
+
+	struct Stats {
+		usize emitters = 0;
+		usize particles = 0;
+		/// During the last `Update`.
+		usize spawned = 0;
+		usize died = 0;
+		/// Emitters skipped by the last `Upload` because the buffer was full.
+		usize overflows = 0;
+		/// CPU time of the last `Update` and `Upload`, in milliseconds.
+		f64 updateTime = 0;
+		f64 uploadTime = 0;
+	};
+
+private:
+	struct GpuEmitter;
+
+	struct Emitter {
+		const ParticleEmitterComponent* settings;
+		glm::vec3 origin;
+		/// `settings->velocity` in world space.
+		glm::vec3 velocity;
+		/// Structure-of-arrays state, padded to a multiple of four.
+		std::vector<f32> posX, posY, posZ;
+		std::vector<f32> velX, velY, velZ;
+		std::vector<f32> age, lifetime;
+		/// Dead particles found by each simulation job, in the job's own slice.
+		std::vector<u32> dead;
+		std::vector<u32> deadCounts;
+		u32 count = 0;
+		u32 capacity = 0;
+		/// Fraction of a particle left to spawn.
+		f32 spawnDebt = 0.0f;
+		u64 rng = 0;
+		bool used = false;
+		std::optional<StreamingBuffer::Allocation> instances;
+		std::unique_ptr<GpuEmitter> gpu;
+		/// Time to simulate on the GPU at the next `Draw`.
+		f32 gpuTime = 0.0f;
+
+		Emitter();
+		~Emitter();
+	};
+
+	Config config;
+	std::unordered_map<const ParticleEmitterComponent*, Emitter> emitters;
+	/// In entity order, for deterministic updates.
+	std::vector<Emitter*> active;
+	u64 nextSeed;
+	Stats stats_;
+
+	/// Uniform locations of the programs, resolved once by `SetupGL`.
+	struct DrawUniforms {
+		GLint viewProj, cameraRight, cameraUp;
+	};
+	struct SimulateUniforms {
+		GLint dt, origin, spawnExtents, velocity, velocityJitter, acceleration, damping;
+		GLint lifetimeRange, sizeRange, colors, spawnStart, spawnCount, capacity, seed;
+	};
+
+	std::optional<ShaderProgram> drawProgram;
+	std::optional<ShaderProgram> simulateProgram;
+	DrawUniforms drawUniforms{};
+	SimulateUniforms simulateUniforms{};
+	std::optional<StateObject> drawVao;
+
+public:
+	explicit ParticleSystem(Config config);
+	ParticleSystem() : ParticleSystem(Config{}) {}
+	~ParticleSystem();
+
+	/// Find the emitters of `storage`, forgetting the particles of removed ones.
+	void Gather(EntitiesStorage& storage);
+	/// Spawn, simulate and kill the particles of CPU emitters over `dt` seconds.
+	void Update(ThreadPool& pool, f32 dt);
+	/// Write the instances of every CPU emitter into `buffer`, an `GL_ARRAY_BUFFER`
+	/// between `BeginFrame` and `Commit`.
+	void Upload(ThreadPool& pool, StreamingBuffer& buffer);
+	/// Simulate the GPU emitters, then draw every emitter as camera facing quads.
+	/// `buffer` must have been committed since `Upload`.
+	void Draw(const StreamingBuffer& buffer, const glm::mat4& view, const glm::mat4& proj);
+
+	/// Write the instances of an emitter (in `Gather` order) to `out`, which must
+	/// hold `particleCount(emitter)` elements.
+	void WriteInstances(ThreadPool& pool, usize emitter, ParticleInstance* out) const;
+
+	usize emitterCount() const { return active.size(); }
+	u32 particleCount(usize emitter) const { return active[emitter]->count; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	void Resize(Emitter& emitter, u32 maxParticles);
+	void Spawn(Emitter& emitter, u32 count);
+	void Simulate(ThreadPool& pool, Emitter& emitter, f32 dt);
+	void RemoveDead(Emitter& emitter);
+	bool SetupGL();
+	void SimulateGpu(Emitter& emitter);
+};
+
+} // namespace HOEngine
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "RenderGraph.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	bool IsColorFormat(TextureFormat format) {
+		return GetTextureFormatInfo(format).attachment == GL_COLOR_ATTACHMENT0;
+	}
+
+	void AddUnique(std::vector<RenderResourceID>& list, RenderResourceID resource) {
+		if (std::find(list.begin(), list.end(), resource) == list.end()) list.push_back(resource);
+	}
+}
+
+RenderTargetPool::RenderTargetPool(Config config)
+	: config{ config } {
+}
+
+const Texture& RenderTargetPool::Acquire(TextureFormat format, u32 width, u32 height) {
+	for (auto& entry : entries) {
+		const auto& texture = entry.texture;
+		if (entry.inUse || texture.format() != format || texture.width() != width || texture.height() != height) continue;
+		entry.inUse = true;
+		entry.lastFrame = frame;
+		return texture;
+	}
+
+	// A bound unpack buffer would turn the null data into an offset
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	auto& entry = entries.emplace_back(Entry{ Texture(format, width, height, 1), frame, true });
+	entry.texture.Upload(0, nullptr);
+	entry.texture.SetSampling(GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	++stats_.created;
+	++stats_.textures;
+	stats_.bytes += entry.texture.byteSize();
+	return entry.texture;
+}
+
+GLuint RenderTargetPool::AcquireFramebuffer(std::span<const Texture* const> colors, const Texture* depth) {
+	if (colors.size() > maxColorAttachments) {
+		throw std::runtime_error("Too many color attachments");
+	}
+	std::array<GLuint, maxColorAttachments + 1> attachments{};
+	for (usize i = 0; i < colors.size(); ++i) attachments[i] = colors[i]->handle();
+	attachments[maxColorAttachments] = depth ? depth->handle() : 0;
+
+	for (auto& framebuffer : framebuffers) {
+		if (framebuffer.attachments != attachments) continue;
+		framebuffer.lastFrame = frame;
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+		return framebuffer.fbo;
+	}
+
+	auto& framebuffer = framebuffers.emplace_back(FramebufferEntry{ attachments, FramebufferObject{}, frame });
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+	GLenum drawBuffers[maxColorAttachments];
+	for (usize i = 0; i < colors.size(); ++i) {
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[i], GL_TEXTURE_2D, attachments[i], 0);
+	}
+	if (depth) {
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GetTextureFormatInfo(depth->format()).attachment, GL_TEXTURE_2D, depth->handle(), 0);
+	}
+	if (colors.empty()) {
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	} else {
+		glDrawBuffers(static_cast<GLsizei>(colors.size()), drawBuffers);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		framebuffers.pop_back();
+		throw std::runtime_error("Render target framebuffer is incomplete");
+	}
+	++stats_.framebuffers;
+	return framebuffer.fbo;
+}
+
+void RenderTargetPool::EndFrame() {
+	++frame;
+	auto idle = [&](u64 lastFrame) { return frame - lastFrame > config.maxIdleFrames; };
+	framebuffers.remove_if([&](const FramebufferEntry& framebuffer) { return idle(framebuffer.lastFrame); });
+	for (auto it = entries.begin(); it != entries.end();) {
+		it->inUse = false;
+		if (!idle(it->lastFrame)) {
+			++it;
+			continue;
+		}
+		// Framebuffers would keep the deleted texture alive, and a recycled name
+		// would match them again
+		auto handle = it->texture.handle();
+		framebuffers.remove_if([&](const FramebufferEntry& framebuffer) {
+			return std::find(framebuffer.attachments.begin(), framebuffer.attachments.end(), handle) != framebuffer.attachments.end();
+		});
+		stats_.bytes -= it->texture.byteSize();
+		--stats_.textures;
+		++stats_.evicted;
+		it = entries.erase(it);
+	}
+	stats_.framebuffers = framebuffers.size();
+}
+
+RenderGraph::RenderGraph() {
+	resources.push_back(Resource{ "Backbuffer", RenderTargetDesc{}, true });
+}
+
+RenderResourceID RenderGraph::CreateTarget(std::string name, const RenderTargetDesc& desc) {
+	if (GetTextureFormatInfo(desc.format).attachment == GL_NONE) {
+		throw std::runtime_error("Render target " + name + " has a compressed format");
+	}
+	dirty = true;
+	resources.push_back(Resource{ std::move(name), desc });
+	return static_cast<RenderResourceID>(resources.size() - 1);
+}
+
+RenderPassID RenderGraph::AddPass(std::string name, ExecuteFunction execute) {
+	dirty = true;
+	passes.push_back(Pass{ std::move(name), std::move(execute), {}, {} });
+	return static_cast<RenderPassID>(passes.size() - 1);
+}
+
+void RenderGraph::Read(RenderPassID pass, RenderResourceID resource) {
+	dirty = true;
+	AddUnique(passes[pass].reads, resource);
+}
+
+void RenderGraph::Write(RenderPassID pass, RenderResourceID resource) {
+	dirty = true;
+	AddUnique(passes[pass].writes, resource);
+}
+
+void RenderGraph::MarkOutput(RenderResourceID resource) {
+	dirty = true;
+	resources[resource].output = true;
+}
+
+void RenderGraph::Compile(Dimension size) {
+	HOENGINE_PROFILE_SCOPE("RenderGraph::Compile");
+	auto start = std::chrono::steady_clock::now();
+	stats_ = {};
+	stats_.passes = passes.size();
+	compiled.clear();
+	physical.clear();
+	size_ = size;
+	dirty = false;
+
+	auto outputWidth = static_cast<u32>(std::max(size.width, 0));
+	auto outputHeight = static_cast<u32>(std::max(size.height, 0));
+	for (auto& resource : resources) {
+		const auto& desc = resource.desc;
+		auto scaled = [&](u32 fixed, u32 output) {
+			if (fixed > 0) return fixed;
+			return std::max(static_cast<u32>(std::lround(static_cast<f32>(output) * desc.scale)), 1u);
+		};
+		resource.width = scaled(desc.width, outputWidth);
+		resource.height = scaled(desc.height, outputHeight);
+		resource.physical = noTexture;
+	}
+	resources[backbuffer].width = outputWidth;
+	resources[backbuffer].height = outputHeight;
+
+	// Declaration order is execution order, every read needs an earlier write
+	std::vector<bool> written(resources.size(), false);
+	for (const auto& pass : passes) {
+		for (auto resource : pass.reads) {
+			const auto& name = resources[resource].name;
+			if (resource == backbuffer) {
+				throw std::runtime_error("Pass " + pass.name + " reads the backbuffer");
+			}
+			if (!written[resource]) {
+				throw std::runtime_error("Pass " + pass.name + " reads " + name + " before any pass writes it");
+			}
+			if (std::find(pass.writes.begin(), pass.writes.end(), resource) != pass.writes.end()) {
+				throw std::runtime_error("Pass " + pass.name + " reads and writes " + name);
+			}
+		}
+		usize colors = 0;
+		usize depths = 0;
+		for (auto resource : pass.writes) {
+			written[resource] = true;
+			const auto& first = resources[pass.writes[0]];
+			const auto& target = resources[resource];
+			if (resource == backbuffer ? pass.writes.size() > 1 : target.width != first.width || target.height != first.height) {
+				throw std::runtime_error("Pass " + pass.name + " writes targets that can't share a framebuffer");
+			}
+			++(IsColorFormat(target.desc.format) ? colors : depths);
+		}
+		if (colors > RenderTargetPool::maxColorAttachments || depths > 1) {
+			throw std::runtime_error("Pass " + pass.name + " writes too many targets");
+		}
+	}
+
+	// Walking backwards, a pass is kept if a later kept pass reads what it writes
+	std::vector<bool> needed(resources.size(), false);
+	for (usize i = 0; i < resources.size(); ++i) needed[i] = resources[i].output;
+	needed[backbuffer] = true;
+	std::vector<bool> kept(passes.size(), false);
+	for (auto i = passes.size(); i-- > 0;) {
+		const auto& pass = passes[i];
+		kept[i] = std::any_of(pass.writes.begin(), pass.writes.end(), [&](RenderResourceID resource) { return needed[resource]; });
+		if (!kept[i]) {
+			++stats_.culledPasses;
+			continue;
+		}
+		for (auto resource : pass.reads) needed[resource] = true;
+	}
+
+	// Lifetimes in kept passes, outputs living to the end of the frame
+	constexpr auto none = ~0u;
+	std::vector<u32> lastUse(resources.size(), none);
+	u32 keptCount = 0;
+	for (usize i = 0; i < passes.size(); ++i) {
+		if (!kept[i]) continue;
+		for (auto resource : passes[i].reads) lastUse[resource] = keptCount;
+		for (auto resource : passes[i].writes) lastUse[resource] = keptCount;
+		++keptCount;
+	}
+	for (usize i = 0; i < resources.size(); ++i) {
+		if (resources[i].output && lastUse[i] != none) lastUse[i] = keptCount;
+	}
+
+	// Textures are taken at the first write and given back after the last use, the
+	// most recently freed one first
+	std::vector<u32> freeTextures;
+	std::vector<bool> rendered(resources.size(), false);
+	auto take = [&](Resource& resource) {
+		auto match = std::find_if(freeTextures.rbegin(), freeTextures.rend(), [&](u32 index) {
+			const auto& texture = physical[index];
+			return texture.format == resource.desc.format && texture.width == resource.width && texture.height == resource.height;
+		});
+		if (match != freeTextures.rend()) {
+			resource.physical = *match;
+			freeTextures.erase(std::next(match).base());
+			return;
+		}
+		resource.physical = static_cast<u32>(physical.size());
+		physical.push_back(PhysicalTarget{ resource.desc.format, resource.width, resource.height });
+	};
+	u32 index = 0;
+	for (usize i = 0; i < passes.size(); ++i) {
+		if (!kept[i]) continue;
+		const auto& pass = passes[i];
+		auto& compiledPass = compiled.emplace_back(CompiledPass{ static_cast<RenderPassID>(i), {}, {} });
+		for (auto resource : pass.reads) {
+			if (!rendered[resource]) continue;
+			rendered[resource] = false;
+			compiledPass.barriers.push_back(resource);
+			++stats_.barriers;
+		}
+		for (auto resource : pass.writes) {
+			rendered[resource] = true;
+			auto& target = resources[resource];
+			if (resource == backbuffer || target.physical != noTexture) continue;
+			take(target);
+			compiledPass.clears.push_back(resource);
+			++stats_.targets;
+			stats_.targetBytes += TextureLevelSize(target.desc.format, target.width, target.height);
+		}
+		auto release = [&](RenderResourceID resource) {
+			if (resource != backbuffer && lastUse[resource] == index) freeTextures.push_back(resources[resource].physical);
+		};
+		std::for_each(pass.reads.begin(), pass.reads.end(), release);
+		std::for_each(pass.writes.begin(), pass.writes.end(), release);
+		++index;
+	}
+
+	stats_.textures = physical.size();
+	for (const auto& texture : physical) {
+		stats_.textureBytes += TextureLevelSize(texture.format, texture.width, texture.height);
+	}
+	stats_.compileTime = MillisecondsSince(start);
+	HOENGINE_PROFILE_COUNTER("Render graph saved bytes", stats_.SavedBytes());
+}
+
+void RenderGraph::Execute(RenderTargetPool& pool, Dimension size) {
+	if (size.width <= 0 || size.height <= 0) return;
+	if (dirty || size.width != size_.width || size.height != size_.height) Compile(size);
+	HOENGINE_PROFILE_SCOPE("RenderGraph::Execute");
+
+	textures.clear();
+	for (const auto& target : physical) {
+		textures.push_back(&pool.Acquire(target.format, target.width, target.height));
+	}
+
+	auto& stats = RenderStats::Global();
+	for (const auto& compiledPass : compiled) {
+		const auto& pass = passes[compiledPass.pass];
+		const Texture* colors[RenderTargetPool::maxColorAttachments];
+		usize colorCount = 0;
+		const Texture* depth = nullptr;
+		for (auto resource : pass.writes) {
+			if (resource == backbuffer) continue;
+			const auto* texture = textures[resources[resource].physical];
+			if (IsColorFormat(texture->format())) {
+				colors[colorCount++] = texture;
+			} else {
+				depth = texture;
+			}
+		}
+		if (colorCount > 0 || depth) {
+			pool.AcquireFramebuffer(std::span{ colors, colorCount }, depth);
+		} else {
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+		const auto& first = resources[pass.writes[0]];
+		glViewport(0, 0, static_cast<GLsizei>(first.width), static_cast<GLsizei>(first.height));
+		stats.StateChange();
+
+		for (auto resource : compiledPass.clears) {
+			const auto& desc = resources[resource].desc;
+			const auto* texture = textures[resources[resource].physical];
+			if (texture == depth) {
+				glDepthMask(GL_TRUE);
+				if (desc.format == TextureFormat::Depth24Stencil8) {
+					glClearBufferfi(GL_DEPTH_STENCIL, 0, desc.clearDepth, 0);
+				} else {
+					glClearBufferfv(GL_DEPTH, 0, &desc.clearDepth);
+				}
+			} else {
+				auto drawBuffer = std::find(colors, colors + colorCount, texture) - colors;
+				glClearBufferfv(GL_COLOR, static_cast<GLint>(drawBuffer), &desc.clearColor[0]);
+			}
+		}
+		pass.execute(*this);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	pool.EndFrame();
+}
+
+GLuint RenderGraph::texture(RenderResourceID resource) const {
+	auto index = resources[resource].physical;
+	if (resource == backbuffer || index == noTexture || index >= textures.size()) return 0;
+	return textures[index]->handle();
+}
+
+Dimension RenderGraph::targetSize(RenderResourceID resource) const {
+	const auto& target = resources[resource];
+	return Dimension{ static_cast<i32>(target.width), static_cast<i32>(target.height) };
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <list>
+#include <span>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "GLWrapper.hpp"
+
+namespace HOEngine {
+
+using RenderPassID = u32;
+using RenderResourceID = u32;
+
+/// Render target owned by a `RenderGraph`, backed by a pooled texture for the
+/// frame only.
+struct RenderTargetDesc {
+	TextureFormat format = TextureFormat::RGBA8;
+	/// Size in pixels, 0 to follow the graph's output size times `scale`.
+	u32 width = 0;
+	u32 height = 0;
+	f32 scale = 1.0f;
+	/// Cleared to on the first write of every frame, since the texture may still
+	/// hold another target's pixels. Depth formats clear to `clearDepth` and a
+	/// stencil of 0.
+	glm::vec4 clearColor{ 0.0f };
+	f32 clearDepth = 1.0f;
+};
+
+/// Render target textures and their framebuffers, kept across frames and handed
+/// out by format and size. Textures not handed out for `maxIdleFrames` frames are
+/// deleted, which is how targets of a previous window size go away.
+class RenderTargetPool {
+public:
+	struct Config {
+		u32 maxIdleFrames = 2;
+	};
+
+	struct Stats {
+		usize textures = 0;
+		/// Video memory of the textures.
+		usize bytes = 0;
+		usize framebuffers = 0;
+		u64 created = 0;
+		u64 evicted = 0;
+	};
+
+	static constexpr usize maxColorAttachments = 4;
+
+private:
+	struct Entry {
+		Texture texture;
+		u64 lastFrame;
+		bool inUse;
+	};
+
+	struct FramebufferEntry {
+		/// Color textures in draw buffer order then depth, 0 when unused.
+		std::array<GLuint, maxColorAttachments + 1> attachments;
+		FramebufferObject fbo;
+		u64 lastFrame;
+	};
+
+	Config config;
+	std::list<Entry> entries;
+	std::list<FramebufferEntry> framebuffers;
+	u64 frame = 0;
+	Stats stats_;
+
+public:
+	explicit RenderTargetPool(Config config);
+	RenderTargetPool() : RenderTargetPool(Config{}) {}
+
+	/// A texture of this format and size not handed out since the last `EndFrame`,
+	/// created if there's none. Requires a current context.
+	const Texture& Acquire(TextureFormat format, u32 width, u32 height);
+	/// Framebuffer with these attachments, created the first time. `depth` may be
+	/// `nullptr`. Throws if the framebuffer is incomplete. Leaves it bound.
+	GLuint AcquireFramebuffer(std::span<const Texture* const> colors, const Texture* depth);
+	/// Take every texture back, deleting those idle for too long.
+	void EndFrame();
+
+	const Stats& stats() const { return stats_; }
+};
+
+/// A frame described as passes reading and writing render targets.
+///
+/// Passes are declared in execution order, along with the targets they sample
+/// (`Read`) and render to (`Write`). `Compile` drops the passes whose output
+/// nothing uses, then gives every target a lifetime from its first to its last
+/// use by a remaining pass. Targets of the same format and size whose lifetimes
+/// don't overlap share a texture, so the frame needs as many textures as targets
+/// alive at once rather than one per target. OpenGL has no memory aliasing below
+/// the texture level, hence the matching format and size.
+///
+/// Passes writing the backbuffer, or a target marked with `MarkOutput`, are never
+/// dropped. Compiling makes no GL calls. `Execute` compiles again only when the
+/// declarations or the output size changed, so a graph can be declared once and
+/// follow the window size as `Window::Resize` updates it.
+class RenderGraph {
+public:
+	using ExecuteFunction = std::function<void(const RenderGraph&)>;
+
+	/// The default framebuffer, always at the output size. It can be written but
+	/// not read.
+	static constexpr RenderResourceID backbuffer = 0;
+	static constexpr u32 noTexture = ~0u;
+
+	/// Format and size of a texture shared by targets with disjoint lifetimes.
+	struct PhysicalTarget {
+		TextureFormat format;
+		u32 width;
+		u32 height;
+	};
+
+	struct CompiledPass {
+		RenderPassID pass;
+		/// Targets written for the first time this frame, cleared before the pass.
+		std::vector<RenderResourceID> clears;
+		/// Targets sampled by the pass after an earlier pass rendered to them. GL
+		/// makes those writes visible itself once the framebuffer changes, these
+		/// only document the dependency.
+		std::vector<RenderResourceID> barriers;
+	};
+
+	struct Stats {
+		usize passes = 0;
+		usize culledPasses = 0;
+		/// Targets used by the remaining passes, and the textures backing them.
+		usize targets = 0;
+		usize textures = 0;
+		usize barriers = 0;
+		/// Video memory of the targets with a texture each, and with aliasing.
+		usize targetBytes = 0;
+		usize textureBytes = 0;
+		/// CPU time of the last `Compile`, in milliseconds.
+		f64 compileTime = 0;
+
+		usize SavedBytes() const { return targetBytes - textureBytes; }
+	};
+
+private:
+	struct Resource {
+		std::string name;
+		RenderTargetDesc desc;
+		bool output = false;
+		u32 width = 0;
+		u32 height = 0;
+		/// Index into `physical`, `noTexture` when unused.
+		u32 physical = noTexture;
+	};
+
+	struct Pass {
+		std::string name;
+		ExecuteFunction execute;
+		std::vector<RenderResourceID> reads;
+		std::vector<RenderResourceID> writes;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<CompiledPass> compiled;
+	std::vector<PhysicalTarget> physical;
+	/// Pool textures of `physical`, set by `Execute`.
+	std::vector<const Texture*> textures;
+	Dimension size_{ 0, 0 };
+	bool dirty = true;
+	Stats stats_;
+
+public:
+	RenderGraph();
+
+	RenderResourceID CreateTarget(std::string name, const RenderTargetDesc& desc);
+	RenderPassID AddPass(std::string name, ExecuteFunction execute);
+	void Read(RenderPassID pass, RenderResourceID resource);
+	void Write(RenderPassID pass, RenderResourceID resource);
+	/// Keep the passes producing `resource`, and its texture unshared past its last
+	/// write, for use after `Execute`.
+	void MarkOutput(RenderResourceID resource);
+
+	/// Cull passes and assign textures for an output of `size`. Throws if a target
+	/// is read before being written, or by the pass writing it, or if the targets
+	/// written by a pass can't form one framebuffer.
+	void Compile(Dimension size);
+	/// Run the passes for an output of `size`, with textures from `pool`, skipping
+	/// the frame while `size` is empty (e.g. minimized). Requires a current context.
+	void Execute(RenderTargetPool& pool, Dimension size);
+
+	/// Texture of `resource` during the last `Execute`, valid until the next one. 0
+	/// for the backbuffer and unused targets.
+	GLuint texture(RenderResourceID resource) const;
+	/// Size of `resource` in pixels as of the last `Compile`.
+	Dimension targetSize(RenderResourceID resource) const;
+	/// Index into `physicalTargets` of `resource`, `noTexture` when unused.
+	u32 physicalTarget(RenderResourceID resource) const { return resources[resource].physical; }
+	const std::string& passName(RenderPassID pass) const { return passes[pass].name; }
+	std::span<const CompiledPass> compiledPasses() const { return compiled; }
+	std::span<const PhysicalTarget> physicalTargets() const { return physical; }
+	const Stats& stats() const { return stats_; }
+};
+
+} // namespace HOEngine
@@ -0,0 +1,33 @@
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+RenderStats& RenderStats::Global() {
+	static RenderStats stats;
+	return stats;
+}
+
+u64 RenderStats::TrianglesOf(GLenum mode, i64 count) {
+	switch (mode) {
+		case GL_TRIANGLES: return static_cast<u64>(count / 3);
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN: return count > 2 ? static_cast<u64>(count - 2) : 0;
+		case GL_TRIANGLES_ADJACENCY: return static_cast<u64>(count / 6);
+		case GL_TRIANGLE_STRIP_ADJACENCY: return count > 4 ? static_cast<u64>((count - 4) / 2) : 0;
+		default: return 0;
+	}
+}
+
+void RenderStats::Draw(GLenum mode, i64 count, i64 instances) {
+	++current.drawCalls;
+	Primitives(mode, count, instances);
+}
+
+void RenderStats::Primitives(GLenum mode, i64 count, i64 instances) {
+	current.triangles += TrianglesOf(mode, count) * static_cast<u64>(instances);
+}
+
+void RenderStats::EndFrame() {
+	last = current;
+	current = {};
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <GL/gl3w.h>
+#include "Engine.hpp"
+
+namespace HOEngine {
+
+/// Per frame counters of the work submitted to the GL. Engine code feeding the
+/// GL (backends, draw buffers, streaming buffers) reports into `Global()`, code
+/// issuing raw GL calls can report its own work the same way.
+///
+/// Must only be used from the thread owning the context.
+class RenderStats {
+public:
+	struct Counters {
+		/// GL calls issuing draws, a multi-draw call counts once.
+		u32 drawCalls = 0;
+		/// Primitives of triangle modes only, including instances.
+		u64 triangles = 0;
+		/// Program, vertex array and texture binds actually issued.
+		u32 stateChanges = 0;
+		/// Bytes written to buffers for the GPU to read this frame.
+		u64 uploadBytes = 0;
+	};
+
+private:
+	Counters current;
+	Counters last;
+
+public:
+	static RenderStats& Global();
+
+	/// Count one draw call of `count` vertices, `instances` times.
+	void Draw(GLenum mode, i64 count, i64 instances = 1);
+	/// Count the primitives of one of the draws of a multi-draw call, without
+	/// counting a draw call.
+	void Primitives(GLenum mode, i64 count, i64 instances = 1);
+	/// Count a single call drawing several meshes (multi-draw, indirect).
+	void DrawCall() { ++current.drawCalls; }
+	void StateChange(u32 count = 1) { current.stateChanges += count; }
+	void Upload(usize bytes) { current.uploadBytes += bytes; }
+
+	/// Close the current frame, making its counters available in `lastFrame()`.
+	void EndFrame();
+
+	const Counters& lastFrame() const { return last; }
+	const Counters& currentFrame() const { return current; }
+
+	static u64 TrianglesOf(GLenum mode, i64 count);
+};
+
+} // namespace HOEngine
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include "SpriteBatch.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	const char* vertexSource = R"(#version 330 core
+layout(location = 0) in vec2 instancePos;
+layout(location = 1) in vec2 instanceHalfSize;
+layout(location = 2) in vec4 instanceUv;
+layout(location = 3) in vec2 instanceRotation;
+layout(location = 4) in vec4 instanceColor;
+layout(location = 5) in float instanceDepth;
+uniform mat4 proj;
+out vec2 uv;
+out vec4 color;
+void main() {
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	uv = mix(instanceUv.xy, instanceUv.zw, corner);
+	color = instanceColor;
+	vec2 local = (corner * 2.0 - 1.0) * instanceHalfSize;
+	vec2 rotated = vec2(
+		local.x * instanceRotation.x - local.y * instanceRotation.y,
+		local.x * instanceRotation.y + local.y * instanceRotation.x);
+	gl_Position = proj * vec4(instancePos + rotated, 0.0, 1.0);
+	gl_Position.z = instanceDepth * gl_Position.w;
+}
+)";
+
+	const char* fragmentSource = R"(#version 330 core
+in vec2 uv;
+in vec4 color;
+uniform sampler2D page;
+uniform float alphaCutoff;
+out vec4 fragColor;
+void main() {
+	fragColor = texture(page, uv) * color;
+	if (fragColor.a < alphaCutoff) discard;
+}
+)";
+}
+
+SpriteBatch::SpriteBatch(Config config)
+	: config{ config } {
+}
+
+void SpriteBatch::Begin() {
+	instances.clear();
+	keys.clear();
+}
+
+void SpriteBatch::Add(const AtlasRegion& region, const glm::vec2& pos, const glm::vec2& size, i32 layer, u32 color, f32 rotation) {
+	auto layerKey = static_cast<u32>(std::clamp(layer, -32768, 32767) + 32768);
+	auto page = std::min(region.page, 0xffffu);
+	keys.push_back(config.sort == SortMode::Layer ? layerKey << 16 | page : page << 16 | layerKey);
+
+	// Higher layers nearer, strictly inside the clip volume
+	auto depth = 1.0f - 2.0f * static_cast<f32>(layerKey + 1) / 65537.0f;
+	auto turn = rotation != 0.0f ? glm::vec2(std::cos(rotation), std::sin(rotation)) : glm::vec2(1.0f, 0.0f);
+	instances.push_back(SpriteInstance{ pos, size * 0.5f, region.uv, turn, color, depth });
+}
+
+void SpriteBatch::Sort() {
+	auto count = keys.size();
+	order.resize(count);
+	sorted.resize(count);
+	std::iota(order.begin(), order.end(), 0u);
+
+	// Histograms of the four key bytes in one pass
+	u32 histograms[4][256] = {};
+	for (auto key : keys) {
+		for (u32 b = 0; b < 4; ++b) ++histograms[b][(key >> (b * 8)) & 0xff];
+	}
+
+	// Least significant byte first, each pass stable; bytes equal in every key
+	// (e.g. the high byte of the page) are skipped
+	for (u32 b = 0; b < 4; ++b) {
+		auto& histogram = histograms[b];
+		if (histogram[(keys.empty() ? 0 : keys[0] >> (b * 8)) & 0xff] == count) continue;
+		u32 offsets[256];
+		u32 sum = 0;
+		for (u32 i = 0; i < 256; ++i) {
+			offsets[i] = sum;
+			sum += histogram[i];
+		}
+		for (auto index : order) {
+			sorted[offsets[(keys[index] >> (b * 8)) & 0xff]++] = index;
+		}
+		order.swap(sorted);
+	}
+}
+
+void SpriteBatch::Write(std::span<SpriteInstance> out) {
+	HOENGINE_PROFILE_SCOPE("SpriteBatch::Write");
+	auto start = std::chrono::steady_clock::now();
+	Sort();
+	stats_.sortTime = MillisecondsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	auto count = std::min(instances.size(), out.size());
+	runs_.clear();
+	for (usize i = 0; i < count; ++i) {
+		auto index = order[i];
+		out[i] = instances[index];
+		auto page = config.sort == SortMode::Layer ? keys[index] & 0xffff : keys[index] >> 16;
+		if (runs_.empty() || runs_.back().page != page) {
+			runs_.push_back(Run{ page, static_cast<u32>(i), 0 });
+		}
+		++runs_.back().count;
+	}
+	stats_.sprites = count;
+	stats_.overflows = instances.size() - count;
+	stats_.writeTime = MillisecondsSince(start);
+	HOENGINE_PROFILE_COUNTER("Sprites", count);
+}
+
+bool SpriteBatch::SetupGL() {
+	if (program) return true;
+	program = ShaderProgram::FromSource(vertexSource, fragmentSource);
+	if (!program) return false;
+	auto location = [&](const char* name) { return glGetUniformLocation(*program, name); };
+	uniforms = Uniforms{ location("proj"), location("page"), location("alphaCutoff") };
+
+	vao.emplace();
+	glBindVertexArray(*vao);
+	for (GLuint attrib = 0; attrib < 6; ++attrib) {
+		glEnableVertexAttribArray(attrib);
+		glVertexAttribDivisor(attrib, 1);
+	}
+	glBindVertexArray(0);
+	buffer.emplace(GL_ARRAY_BUFFER, config.bufferSize);
+	return true;
+}
+
+void SpriteBatch::Draw(const SpriteAtlas& atlas, const glm::mat4& proj) {
+	HOENGINE_PROFILE_SCOPE("SpriteBatch::Draw");
+	stats_.draws = 0;
+	if (instances.empty() || !SetupGL()) return;
+
+	buffer->BeginFrame();
+	auto count = std::min(instances.size(), buffer->regionSize() / sizeof(SpriteInstance));
+	auto alloc = buffer->Allocate(count * sizeof(SpriteInstance), 16);
+	if (!alloc) {
+		buffer->EndFrame();
+		return;
+	}
+	Write(std::span{ static_cast<SpriteInstance*>(alloc->ptr), count });
+	buffer->Commit();
+
+	auto& stats = RenderStats::Global();
+	glUseProgram(*program);
+	glUniformMatrix4fv(uniforms.proj, 1, GL_FALSE, &proj[0][0]);
+	glUniform1i(uniforms.page, 0);
+	auto depth = DepthState::Current();
+	if (config.sort == SortMode::Page) {
+		depth = DepthState{ true, GL_LESS, true };
+		glUniform1f(uniforms.alphaCutoff, config.alphaCutoff);
+	} else {
+		depth.test = false;
+		glUniform1f(uniforms.alphaCutoff, 0.0f);
+	}
+	auto previousDepth = DepthState::Apply(depth);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glActiveTexture(GL_TEXTURE0);
+	glBindVertexArray(*vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer->handle());
+	stats.StateChange();
+
+	// No base instance in GL 3.3, each run points the attributes at its first sprite
+	auto stride = static_cast<GLsizei>(sizeof(SpriteInstance));
+	for (const auto& run : runs_) {
+		if (run.page >= atlas.pageCount()) continue;
+		auto offset = static_cast<usize>(alloc->offset) + run.first * sizeof(SpriteInstance);
+		glBindTexture(GL_TEXTURE_2D, atlas.pageTexture(run.page));
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(SpriteInstance, pos)));
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(SpriteInstance, halfSize)));
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(SpriteInstance, uv)));
+		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(SpriteInstance, rotation)));
+		glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, BufferOffset(offset + offsetof(SpriteInstance, color)));
+		glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, stride, BufferOffset(offset + offsetof(SpriteInstance, depth)));
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(run.count));
+		stats.StateChange();
+		stats.Draw(GL_TRIANGLE_STRIP, 4, run.count);
+		++stats_.draws;
+	}
+
+	glDisable(GL_BLEND);
+	DepthState::Apply(previousDepth);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	buffer->EndFrame();
+}
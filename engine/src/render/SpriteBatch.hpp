@@ -0,0 +1,123 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "GLWrapper.hpp"
+#include "Atlas.hpp"
+
+namespace HOEngine {
+
+/// Per sprite instance data, read with an attribute divisor of 1.
+struct SpriteInstance {
+	glm::vec2 pos;
+	glm::vec2 halfSize;
+	/// Atlas texture coordinates, lower left then upper right.
+	glm::vec4 uv;
+	/// Cosine and sine of the rotation around `pos`.
+	glm::vec2 rotation;
+	/// RGBA, 8 bits per channel, red in the lowest byte, multiplying the texture.
+	u32 color;
+	/// Clip space depth derived from the layer, only used when sorting by page.
+	f32 depth;
+};
+
+/// Collects the sprites of 2D and UI layers over a frame, then draws them with one
+/// instanced draw per run of sprites sharing an atlas page.
+///
+/// Sprites are sorted on a 32-bit key of their layer and page with a stable radix
+/// sort, so sprites with equal keys keep their submission order. Sorting by layer
+/// first keeps blending right, at the cost of a draw each time the page changes
+/// between layers. Sorting by page first gives exactly one draw per page, layers
+/// being resolved by depth testing instead, which suits opaque and alpha-tested
+/// sprites: fragments below `alphaCutoff` are discarded so they don't write depth.
+/// Instances are written straight into a `StreamingBuffer`.
+class SpriteBatch {
+public:
+	enum class SortMode : u8 {
+		Layer,
+		/// Depth tested against the bound depth buffer, cleared beforehand.
+		Page,
+	};
+
+	struct Config {
+		/// Bytes of instances per frame, 48 per sprite.
+		usize bufferSize = 4 * 1024 * 1024;
+		SortMode sort = SortMode::Layer;
+		/// Alpha under which fragments are discarded when sorting by page.
+		f32 alphaCutoff = 0.5f;
+	};
+
+	struct Stats {
+		usize sprites = 0;
+		usize draws = 0;
+		/// Sprites left out of the last `Draw` because the buffer was full.
+		usize overflows = 0;
+		/// CPU time of sorting and writing the instances of the last frame, in milliseconds.
+		f64 sortTime = 0;
+		f64 writeTime = 0;
+
+		f64 SpritesPerMillisecond() const {
+			auto time = sortTime + writeTime;
+			return time > 0 ? static_cast<f64>(sprites) / time : 0.0;
+		}
+	};
+
+	/// Sprites in `[first, first + count)` of the sorted instances, all on `page`.
+	struct Run {
+		u32 page;
+		u32 first;
+		u32 count;
+	};
+
+	static constexpr u32 white = 0xffffffff;
+
+private:
+	Config config;
+	/// In submission order.
+	std::vector<SpriteInstance> instances;
+	std::vector<u32> keys;
+	/// Radix sort passes ping-pong between these.
+	std::vector<u32> order;
+	std::vector<u32> sorted;
+	std::vector<Run> runs_;
+	Stats stats_;
+
+	/// Uniform locations of `program`, resolved once by `SetupGL`.
+	struct Uniforms {
+		GLint proj, page, alphaCutoff;
+	};
+
+	std::optional<ShaderProgram> program;
+	Uniforms uniforms{};
+	std::optional<StateObject> vao;
+	std::optional<StreamingBuffer> buffer;
+
+public:
+	explicit SpriteBatch(Config config);
+	SpriteBatch() : SpriteBatch(Config{}) {}
+
+	/// Drop the sprites of the previous frame.
+	void Begin();
+	/// Queue a sprite of `size` centered on `pos`. Layers go from -32768 to 32767,
+	/// higher ones drawn over lower ones.
+	void Add(const AtlasRegion& region, const glm::vec2& pos, const glm::vec2& size, i32 layer = 0, u32 color = white, f32 rotation = 0.0f);
+	/// Sort the queued sprites and write the first `out.size()` of them into `out`,
+	/// filling `runs`. Doesn't touch GL, `Draw` calls it with the streaming buffer.
+	void Write(std::span<SpriteInstance> out);
+	/// Draw the queued sprites with the pages of `atlas`, `proj` mapping sprite
+	/// coordinates to clip space (e.g. an orthographic projection in pixels).
+	void Draw(const SpriteAtlas& atlas, const glm::mat4& proj);
+
+	usize size() const { return instances.size(); }
+	std::span<const Run> runs() const { return runs_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	void Sort();
+	bool SetupGL();
+};
+
+} // namespace HOEngine
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <imgui.h>
+#include "StatsOverlay.hpp"
+
+using namespace HOEngine;
+
+void StatsOverlay::Update(f64 cpuFrameTime, const GpuTimer* gpu, const RenderStats::Counters& frameCounters) {
+	hasGpu = gpu && gpu->supported();
+	cpuHistory[next] = static_cast<f32>(cpuFrameTime);
+	gpuHistory[next] = hasGpu ? static_cast<f32>(gpu->latestFrameTime()) : 0.0f;
+	next = (next + 1) % historySize;
+	count = std::min(count + 1, historySize);
+	counters = frameCounters;
+	if (hasGpu) {
+		passes = gpu->latestPasses();
+	} else {
+		passes.clear();
+	}
+}
+
+f32 StatsOverlay::Average(const std::array<f32, historySize>& history) const {
+	if (count == 0) return 0.0f;
+	f32 sum = 0;
+	for (usize i = 0; i < count; ++i) sum += history[i];
+	return sum / static_cast<f32>(count);
+}
+
+StatsOverlay::Bottleneck StatsOverlay::bottleneck() const {
+	if (!hasGpu || count == 0) return Bottleneck::Unknown;
+	// The GPU time of a GPU bound frame fills (almost) the whole frame, while a CPU
+	// bound frame leaves the GPU idle part of the time
+	return AverageGpuTime() >= AverageCpuTime() * 0.9f ? Bottleneck::GPU : Bottleneck::CPU;
+}
+
+void StatsOverlay::Draw() {
+	if (!visible) return;
+
+	ImGui::SetNextWindowBgAlpha(0.75f);
+	if (!ImGui::Begin("Frame statistics", &visible, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoFocusOnAppearing)) {
+		ImGui::End();
+		return;
+	}
+
+	auto cpu = AverageCpuTime();
+	auto gpu = AverageGpuTime();
+	switch (bottleneck()) {
+		case Bottleneck::CPU: ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "CPU bound"); break;
+		case Bottleneck::GPU: ImGui::TextColored(ImVec4(0.3f, 0.7f, 1.0f, 1.0f), "GPU bound"); break;
+		case Bottleneck::Unknown: ImGui::Text("GPU timing unavailable"); break;
+	}
+
+	// Share the scale between both graphs so they can be compared directly
+	auto scale = std::max({ 1000.0f / 60.0f, *std::max_element(cpuHistory.begin(), cpuHistory.end()), *std::max_element(gpuHistory.begin(), gpuHistory.end()) });
+	auto offset = static_cast<int>(count < historySize ? 0 : next);
+	ImGui::Text("CPU %.2f ms", cpu);
+	ImGui::PlotLines("##cpu", cpuHistory.data(), static_cast<int>(count), offset, nullptr, 0.0f, scale, ImVec2(240, 40));
+	if (hasGpu) {
+		ImGui::Text("GPU %.2f ms", gpu);
+		ImGui::PlotLines("##gpu", gpuHistory.data(), static_cast<int>(count), offset, nullptr, 0.0f, scale, ImVec2(240, 40));
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Draw calls: %u", counters.drawCalls);
+	ImGui::Text("Triangles: %llu", static_cast<unsigned long long>(counters.triangles));
+	ImGui::Text("State changes: %u", counters.stateChanges);
+	ImGui::Text("Uploads: %.1f KiB", static_cast<f64>(counters.uploadBytes) / 1024.0);
+
+	if (!passes.empty()) {
+		ImGui::Separator();
+		for (const auto& pass : passes) {
+			ImGui::Text("%*s%s: %.3f ms", static_cast<int>(pass.depth * 2), "", pass.name, pass.duration);
+		}
+	}
+	ImGui::End();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include "Engine.hpp"
+#include "render/GpuTimer.hpp"
+#include "render/RenderStats.hpp"
+
+namespace HOEngine {
+
+/// ImGui window showing CPU and GPU frame times side by side, along with the
+/// `RenderStats` counters and GPU pass timings, to tell CPU bound frames from GPU
+/// bound ones at a glance.
+class StatsOverlay {
+public:
+	static constexpr usize historySize = 120;
+
+	enum class Bottleneck {
+		Unknown,
+		CPU,
+		GPU,
+	};
+
+private:
+	std::array<f32, historySize> cpuHistory{};
+	std::array<f32, historySize> gpuHistory{};
+	usize next = 0;
+	usize count = 0;
+	RenderStats::Counters counters;
+	std::vector<GpuTimer::PassTiming> passes;
+	bool hasGpu = false;
+
+public:
+	bool visible = true;
+
+	/// Record one frame. `cpuFrameTime` is the time in milliseconds the CPU spent
+	/// on the frame, excluding waiting for vsync. `gpu` may be null if GPU timing
+	/// is unavailable.
+	void Update(f64 cpuFrameTime, const GpuTimer* gpu, const RenderStats::Counters& frameCounters);
+	/// Issue the ImGui calls, between `ImGui::NewFrame` and `ImGui::Render`.
+	void Draw();
+
+	/// Which side limits the frame rate, on average over the history.
+	Bottleneck bottleneck() const;
+	f32 AverageCpuTime() const { return Average(cpuHistory); }
+	f32 AverageGpuTime() const { return Average(gpuHistory); }
+
+private:
+	f32 Average(const std::array<f32, historySize>& history) const;
+};
+
+} // namespace HOEngine
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+#include "Terrain.hpp"
+#include "Arena.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "Simd.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	constexpr u32 keyMask = (1u << 28) - 1;
+	constexpr f32 maxSample = 65535.0f;
+
+	const char* vertexSource = R"(#version 330 core
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in float inMorphHeight;
+uniform mat4 viewProj;
+uniform vec3 camera;
+// Distance where morphing starts, and one over the distance it takes
+uniform vec2 morph;
+out vec3 normal;
+void main() {
+	float k = clamp((distance(camera, inPos) - morph.x) * morph.y, 0.0, 1.0);
+	normal = inNormal;
+	gl_Position = viewProj * vec4(inPos.x, mix(inPos.y, inMorphHeight, k), inPos.z, 1.0);
+}
+)";
+
+	const char* fragmentSource = R"(#version 330 core
+in vec3 normal;
+out vec4 fragColor;
+void main() {
+	vec3 n = normalize(normal);
+	vec3 albedo = mix(vec3(0.42, 0.38, 0.33), vec3(0.30, 0.45, 0.20), smoothstep(0.75, 0.9, n.y));
+	float light = 0.25 + 0.75 * max(dot(n, normalize(vec3(0.4, 1.0, 0.3))), 0.0);
+	fragColor = vec4(albedo * light, 1.0);
+}
+)";
+
+	u32 KeyLevel(Terrain::NodeKey key) { return static_cast<u32>(key >> 56); }
+	u32 KeyX(Terrain::NodeKey key) { return static_cast<u32>(key >> 28) & keyMask; }
+	u32 KeyZ(Terrain::NodeKey key) { return static_cast<u32>(key) & keyMask; }
+}
+
+void TerrainVertex::SetupPointers() {
+	VertexAttributes<float[3], float[3], float[1]>::SetupPointers();
+}
+static_assert(sizeof(TerrainVertex) == VertexAttributes<float[3], float[3], float[1]>::bytes);
+
+std::optional<Heightmap> Heightmap::Open(const std::string& path, u32 width, u32 height) {
+	if (width < 2 || height < 2) return std::nullopt;
+	auto file = MappedFile::Open(path);
+	if (!file || file->size() != usize{ width } * height * sizeof(u16)) return std::nullopt;
+	Heightmap result;
+	result.file = std::move(file);
+	result.width_ = width;
+	result.height_ = height;
+	return result;
+}
+
+std::optional<Heightmap> Heightmap::Open(const std::string& path) {
+	auto file = MappedFile::Open(path);
+	if (!file) return std::nullopt;
+	auto side = static_cast<u32>(std::sqrt(static_cast<f64>(file->size() / sizeof(u16))));
+	// Rounding of the square root either way
+	while (usize{ side } * side * sizeof(u16) > file->size()) --side;
+	while (usize{ side + 1 } * (side + 1) * sizeof(u16) <= file->size()) ++side;
+	if (side < 2 || usize{ side } * side * sizeof(u16) != file->size()) return std::nullopt;
+	Heightmap result;
+	result.file = std::move(file);
+	result.width_ = result.height_ = side;
+	return result;
+}
+
+Heightmap::Heightmap(std::vector<u16> samples, u32 width, u32 height)
+	: owned{ std::move(samples) }
+	, width_{ width }
+	, height_{ height } {
+	if (width < 2 || height < 2) throw std::runtime_error("Heightmaps need at least 2 by 2 samples");
+	if (owned.size() != usize{ width } * height) throw std::runtime_error("Heightmap sample count doesn't match its size");
+}
+
+u16 Heightmap::At(i64 x, i64 z) const {
+	x = std::clamp<i64>(x, 0, width_ - 1);
+	z = std::clamp<i64>(z, 0, height_ - 1);
+	return data()[static_cast<usize>(z) * width_ + static_cast<usize>(x)];
+}
+
+Terrain::Terrain(Heightmap heightmap, Config config)
+	: heightmap_{ std::move(heightmap) }
+	, config{ config } {
+	if (config.chunkSize < 4 || config.chunkSize > 256 || !std::has_single_bit(config.chunkSize)) {
+		throw std::runtime_error("Terrain chunk size must be a power of two between 4 and 256");
+	}
+	this->config.lodLevels = std::clamp(config.lodLevels, 1u, 16u);
+	this->config.maxChunks = std::max(config.maxChunks, 1u);
+
+	// Quads quarter by quarter, each split along the diagonal the morph heights assume
+	auto n = config.chunkSize;
+	auto half = n / 2;
+	indices_.reserve(usize{ n } * n * 6);
+	for (u32 quarter = 0; quarter < 4; ++quarter) {
+		auto x0 = (quarter & 1) * half;
+		auto z0 = (quarter >> 1) * half;
+		for (auto j = z0; j < z0 + half; ++j) {
+			for (auto i = x0; i < x0 + half; ++i) {
+				auto a = j * (n + 1) + i;
+				auto b = a + 1;
+				auto c = a + n + 1;
+				auto d = c + 1;
+				indices_.insert(indices_.end(), { a, c, d, a, d, b });
+			}
+		}
+	}
+}
+
+f32 Terrain::Range(u32 level) const {
+	if (level + 1 >= levels.size()) return config.viewDistance;
+	return config.lodDistance * static_cast<f32>(1u << level);
+}
+
+AABB Terrain::NodeBounds(u32 level, u32 x, u32 z) const {
+	auto size = NodeSize(level);
+	auto heights = levels[level].heights[usize{ z } * levels[level].nodesX + x];
+	auto extentX = static_cast<f32>(heightmap_.width() - 1) * config.cellSize;
+	auto extentZ = static_cast<f32>(heightmap_.height() - 1) * config.cellSize;
+	auto min = glm::vec3(static_cast<f32>(x) * size, heights.x, static_cast<f32>(z) * size);
+	auto max = glm::vec3(std::min(min.x + size, extentX), heights.y, std::min(min.z + size, extentZ));
+	return AABB{ config.origin + min, config.origin + max };
+}
+
+f32 Terrain::NodeDistance2(u32 level, u32 x, u32 z, const glm::vec3& camera) const {
+	auto bounds = NodeBounds(level, x, z);
+	auto d = glm::max(glm::max(bounds.min - camera, camera - bounds.max), glm::vec3(0.0f));
+	return glm::dot(d, d);
+}
+
+f64 Terrain::BytesPerSquareKm(u32 level) const {
+	auto sizeKm = static_cast<f64>(NodeSize(level)) / 1000.0;
+	return static_cast<f64>(verticesPerChunk() * sizeof(TerrainVertex)) / (sizeKm * sizeKm);
+}
+
+f32 Terrain::HeightAt(f32 x, f32 z) const {
+	auto fx = std::clamp((x - config.origin.x) / config.cellSize, 0.0f, static_cast<f32>(heightmap_.width() - 1));
+	auto fz = std::clamp((z - config.origin.z) / config.cellSize, 0.0f, static_cast<f32>(heightmap_.height() - 1));
+	auto ix = static_cast<i64>(fx);
+	auto iz = static_cast<i64>(fz);
+	auto tx = fx - static_cast<f32>(ix);
+	auto tz = fz - static_cast<f32>(iz);
+	auto h00 = static_cast<f32>(heightmap_.At(ix, iz));
+	auto h10 = static_cast<f32>(heightmap_.At(ix + 1, iz));
+	auto h01 = static_cast<f32>(heightmap_.At(ix, iz + 1));
+	auto h11 = static_cast<f32>(heightmap_.At(ix + 1, iz + 1));
+	auto h = (h00 + (h10 - h00) * tx) * (1.0f - tz) + (h01 + (h11 - h01) * tx) * tz;
+	return config.origin.y + h * config.heightRange / maxSample;
+}
+
+void Terrain::BuildLevels(ThreadPool& pool) {
+	HOENGINE_PROFILE_SCOPE("Terrain::BuildLevels");
+	auto cellsX = heightmap_.width() - 1;
+	auto cellsZ = heightmap_.height() - 1;
+	levels.resize(config.lodLevels);
+	for (u32 l = 0; l < levels.size(); ++l) {
+		auto size = config.chunkSize << l;
+		levels[l].nodesX = (cellsX + size - 1) / size;
+		levels[l].nodesZ = (cellsZ + size - 1) / size;
+		levels[l].heights.resize(usize{ levels[l].nodesX } * levels[l].nodesZ);
+	}
+
+	// Finest level from the samples, each level above from the one below
+	auto scale = config.heightRange / maxSample;
+	auto& first = levels[0];
+	auto n = i64{ config.chunkSize };
+	pool.ParallelFor(first.nodesZ, 1, [&](usize begin, usize end) {
+		for (auto z = begin; z < end; ++z) {
+			for (u32 x = 0; x < first.nodesX; ++x) {
+				u16 low = 0xffff, high = 0;
+				for (auto j = static_cast<i64>(z) * n; j <= (static_cast<i64>(z) + 1) * n; ++j) {
+					for (auto i = i64{ x } * n; i <= (i64{ x } + 1) * n; ++i) {
+						auto h = heightmap_.At(i, j);
+						low = std::min(low, h);
+						high = std::max(high, h);
+					}
+				}
+				first.heights[z * first.nodesX + x] = glm::vec2(static_cast<f32>(low) * scale, static_cast<f32>(high) * scale);
+			}
+		}
+	});
+	for (u32 l = 1; l < levels.size(); ++l) {
+		const auto& below = levels[l - 1];
+		auto& level = levels[l];
+		for (u32 z = 0; z < level.nodesZ; ++z) {
+			for (u32 x = 0; x < level.nodesX; ++x) {
+				glm::vec2 range(std::numeric_limits<f32>::max(), std::numeric_limits<f32>::lowest());
+				for (u32 child = 0; child < 4; ++child) {
+					auto cx = x * 2 + (child & 1);
+					auto cz = z * 2 + (child >> 1);
+					if (cx >= below.nodesX || cz >= below.nodesZ) continue;
+					auto h = below.heights[usize{ cz } * below.nodesX + cx];
+					range = glm::vec2(std::min(range.x, h.x), std::max(range.y, h.y));
+				}
+				level.heights[usize{ z } * level.nodesX + x] = range;
+			}
+		}
+	}
+	for (auto& level : levels) {
+		for (auto& h : level.heights) h += glm::vec2(config.origin.y);
+	}
+}
+
+void Terrain::GenerateChunk(u32 level, u32 x, u32 z, std::span<TerrainVertex> out) const {
+	const auto n = config.chunkSize;
+	const auto step = i64{ 1 } << level;
+	const auto x0 = i64{ x } * (i64{ n } << level);
+	const auto z0 = i64{ z } * (i64{ n } << level);
+	const auto scale = config.heightRange / maxSample;
+	const auto lastX = i64{ heightmap_.width() } - 1;
+	const auto lastZ = i64{ heightmap_.height() } - 1;
+	const bool coarsest = level + 1 >= config.lodLevels;
+
+	// Heights with a border of one vertex, rows padded so that the last four
+	// vertices of a row can be loaded at once
+	ScratchArena scratch;
+	const auto rowLength = ((n + 4) & ~3u) + 2;
+	std::pmr::vector<f32> heights(usize{ rowLength } * (n + 3), scratch.resource());
+	for (u32 j = 0; j < n + 3; ++j) {
+		auto sz = z0 + (i64{ j } - 1) * step;
+		for (u32 i = 0; i < rowLength; ++i) {
+			heights[j * rowLength + i] = static_cast<f32>(heightmap_.At(x0 + (i64{ i } - 1) * step, sz)) * scale;
+		}
+	}
+	auto h = [&](u32 i, u32 j) { return heights[(j + 1) * rowLength + i + 1]; };
+
+	// Central differences, four vertices at a time
+	auto rise = F32x4::Set1(2.0f * static_cast<f32>(step) * config.cellSize);
+	alignas(16) f32 nx[4], ny[4], nz[4];
+	for (u32 j = 0; j <= n; ++j) {
+		const auto* row = heights.data() + (j + 1) * rowLength;
+		auto vz = std::min(z0 + i64{ j } * step, lastZ);
+		for (u32 i = 0; i <= n; i += 4) {
+			auto dx = F32x4::LoadUnaligned(row + i) - F32x4::LoadUnaligned(row + i + 2);
+			auto dz = F32x4::LoadUnaligned(row - rowLength + i + 1) - F32x4::LoadUnaligned(row + rowLength + i + 1);
+			auto invLength = F32x4::Set1(1.0f) / Sqrt(MulAdd(dx, dx, MulAdd(dz, dz, rise * rise)));
+			(dx * invLength).Store(nx);
+			(rise * invLength).Store(ny);
+			(dz * invLength).Store(nz);
+			for (u32 lane = 0; lane < 4 && i + lane <= n; ++lane) {
+				auto vi = i + lane;
+				auto vx = std::min(x0 + i64{ vi } * step, lastX);
+				// Where the vertex lies on the coarser level's triangles
+				auto morph = h(vi, j);
+				if (!coarsest) {
+					auto oddX = (vi & 1) != 0;
+					auto oddZ = (j & 1) != 0;
+					if (oddX && oddZ) {
+						morph = (h(vi - 1, j - 1) + h(vi + 1, j + 1)) * 0.5f;
+					} else if (oddX) {
+						morph = (h(vi - 1, j) + h(vi + 1, j)) * 0.5f;
+					} else if (oddZ) {
+						morph = (h(vi, j - 1) + h(vi, j + 1)) * 0.5f;
+					}
+				}
+				auto& vert = out[j * (n + 1) + vi];
+				vert.pos = config.origin + glm::vec3(static_cast<f32>(vx) * config.cellSize, h(vi, j), static_cast<f32>(vz) * config.cellSize);
+				vert.normal = glm::vec3(nx[lane], ny[lane], nz[lane]);
+				vert.morphHeight = config.origin.y + morph;
+			}
+		}
+	}
+}
+
+void Terrain::Want(u32 level, u32 x, u32 z, const glm::vec3& camera) {
+	const auto& lv = levels[level];
+	if (x >= lv.nodesX || z >= lv.nodesZ) return;
+	auto range = Range(level) * (1.0f + config.prefetch);
+	auto distance2 = NodeDistance2(level, x, z, camera);
+	if (distance2 >= range * range) return;
+	auto key = Key(level, x, z);
+	if (!chunks.contains(key)) wanted.push_back({ distance2, key });
+	if (level == 0) return;
+	for (u32 child = 0; child < 4; ++child) Want(level - 1, x * 2 + (child & 1), z * 2 + (child >> 1), camera);
+}
+
+void Terrain::Update(ThreadPool& pool, const glm::vec3& camera) {
+	HOENGINE_PROFILE_SCOPE("Terrain::Update");
+	auto start = std::chrono::steady_clock::now();
+	if (levels.empty()) BuildLevels(pool);
+
+	// Drop what went out of range, past the hysteresis
+	stats_.evicted = 0;
+	for (auto it = chunks.begin(); it != chunks.end();) {
+		auto level = KeyLevel(it->first);
+		auto keep = Range(level) * (1.0f + config.prefetch + config.hysteresis);
+		if (NodeDistance2(level, KeyX(it->first), KeyZ(it->first), camera) < keep * keep) {
+			++it;
+			continue;
+		}
+		if (it->second.slot != noSlot) freeSlots.push_back(it->second.slot);
+		it = chunks.erase(it);
+		++stats_.evicted;
+	}
+
+	// Coarsest levels first so there is always something to draw, then nearest first
+	wanted.clear();
+	auto top = static_cast<u32>(levels.size() - 1);
+	for (u32 z = 0; z < levels[top].nodesZ; ++z) {
+		for (u32 x = 0; x < levels[top].nodesX; ++x) Want(top, x, z, camera);
+	}
+	std::sort(wanted.begin(), wanted.end(), [](const auto& a, const auto& b) {
+		auto la = KeyLevel(a.second), lb = KeyLevel(b.second);
+		return la != lb ? la > lb : a.first < b.first;
+	});
+	auto room = config.maxChunks > chunks.size() ? config.maxChunks - chunks.size() : 0;
+	auto count = std::min<usize>({ wanted.size(), config.maxGenerated, room });
+	stats_.overflows = wanted.size() > room ? wanted.size() - room : 0;
+
+	std::vector<std::pair<NodeKey, Chunk>> generated(count);
+	std::vector<f64> times(count);
+	pool.ParallelTasks(count, [&](usize i) {
+		auto chunkStart = std::chrono::steady_clock::now();
+		auto key = wanted[i].second;
+		auto& [chunkKey, chunk] = generated[i];
+		chunkKey = key;
+		chunk.vertices.resize(verticesPerChunk());
+		GenerateChunk(KeyLevel(key), KeyX(key), KeyZ(key), chunk.vertices);
+		times[i] = MillisecondsSince(chunkStart);
+	});
+	for (auto& [key, chunk] : generated) chunks.emplace(key, std::move(chunk));
+
+	f64 total = 0;
+	for (auto t : times) total += t;
+	stats_.generated = count;
+	stats_.chunkTime = count > 0 ? total / static_cast<f64>(count) : 0.0;
+	stats_.pending = wanted.size() - count;
+	stats_.chunks = chunks.size();
+	stats_.chunkBytes = chunks.size() * verticesPerChunk() * sizeof(TerrainVertex);
+	HOENGINE_PROFILE_COUNTER("Terrain chunks", stats_.chunks);
+	stats_.updateTime = MillisecondsSince(start);
+}
+
+bool Terrain::SelectNode(u32 level, u32 x, u32 z, const glm::vec3& camera, const Frustum* frustum, std::vector<DrawNode>& out) const {
+	const auto& lv = levels[level];
+	// Past the edge of the map, nothing to cover
+	if (x >= lv.nodesX || z >= lv.nodesZ) return true;
+	auto range = Range(level);
+	auto distance2 = NodeDistance2(level, x, z, camera);
+	auto key = Key(level, x, z);
+	if (distance2 >= range * range || !chunks.contains(key)) return false;
+	if (frustum && !frustum->Overlaps(NodeBounds(level, x, z))) return true;
+
+	auto finer = level > 0 ? Range(level - 1) : 0.0f;
+	if (level == 0 || distance2 >= finer * finer) {
+		out.push_back(DrawNode{ key, level, wholeNode });
+		return true;
+	}
+	for (u32 quarter = 0; quarter < 4; ++quarter) {
+		if (!SelectNode(level - 1, x * 2 + (quarter & 1), z * 2 + (quarter >> 1), camera, frustum, out)) {
+			out.push_back(DrawNode{ key, level, quarter });
+		}
+	}
+	return true;
+}
+
+void Terrain::Select(const glm::vec3& camera, const Frustum* frustum, std::vector<DrawNode>& out) const {
+	out.clear();
+	if (levels.empty()) return;
+	auto top = static_cast<u32>(levels.size() - 1);
+	for (u32 z = 0; z < levels[top].nodesZ; ++z) {
+		for (u32 x = 0; x < levels[top].nodesX; ++x) SelectNode(top, x, z, camera, frustum, out);
+	}
+}
+
+bool Terrain::SetupGL() {
+	if (program) return true;
+	program = ShaderProgram::FromSource(vertexSource, fragmentSource);
+	if (!program) return false;
+	auto location = [&](const char* name) { return glGetUniformLocation(*program, name); };
+	uniforms = Uniforms{ location("viewProj"), location("camera"), location("morph") };
+
+	auto chunkBytes = verticesPerChunk() * sizeof(TerrainVertex);
+	vao.emplace();
+	vertexBuffer.emplace();
+	indexBuffer.emplace();
+	glBindVertexArray(*vao);
+	glBindBuffer(GL_ARRAY_BUFFER, *vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(chunkBytes * config.maxChunks), nullptr, GL_DYNAMIC_DRAW);
+	TerrainVertex::SetupPointers();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices_.size() * sizeof(GLuint)), indices_.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	freeSlots.clear();
+	for (auto slot = config.maxChunks; slot > 0; --slot) freeSlots.push_back(slot - 1);
+	return true;
+}
+
+void Terrain::Draw(const glm::mat4& view, const glm::mat4& proj, const glm::vec3& camera) {
+	if (levels.empty() || !SetupGL()) return;
+	auto& stats = RenderStats::Global();
+
+	// Chunks never outnumber the slots, `Update` keeps to `maxChunks`
+	auto chunkBytes = verticesPerChunk() * sizeof(TerrainVertex);
+	glBindBuffer(GL_ARRAY_BUFFER, *vertexBuffer);
+	for (auto& [key, chunk] : chunks) {
+		if (chunk.slot != noSlot || freeSlots.empty()) continue;
+		chunk.slot = freeSlots.back();
+		freeSlots.pop_back();
+		glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(usize{ chunk.slot } * chunkBytes), static_cast<GLsizeiptr>(chunkBytes), chunk.vertices.data());
+		stats.Upload(chunkBytes);
+		chunk.vertices = {};
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	auto viewProj = proj * view;
+	auto frustum = Frustum::FromMatrix(viewProj);
+	Select(camera, &frustum, selected);
+
+	glUseProgram(*program);
+	glUniformMatrix4fv(uniforms.viewProj, 1, GL_FALSE, &viewProj[0][0]);
+	glUniform3fv(uniforms.camera, 1, &camera[0]);
+	glBindVertexArray(*vao);
+	stats.StateChange();
+
+	auto quarterCount = indices_.size() / 4;
+	auto top = static_cast<u32>(levels.size() - 1);
+	stats_.triangles = 0;
+	for (const auto& node : selected) {
+		auto slot = chunks.find(node.key)->second.slot;
+		if (slot == noSlot) continue;
+		// The coarsest level has nothing to morph to
+		auto end = Range(node.level);
+		auto begin = end * (1.0f - config.morphRatio);
+		glUniform2f(uniforms.morph, begin, node.level < top && end > begin ? 1.0f / (end - begin) : 0.0f);
+		auto first = node.quarter == wholeNode ? 0 : node.quarter * quarterCount;
+		auto count = node.quarter == wholeNode ? indices_.size() : quarterCount;
+		glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(count), GL_UNSIGNED_INT,
+			BufferOffset(first * sizeof(GLuint)), static_cast<GLint>(slot * verticesPerChunk()));
+		stats.Draw(GL_TRIANGLES, static_cast<i64>(count));
+		stats_.triangles += count / 3;
+	}
+	stats_.nodes = selected.size();
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Engine.hpp"
+#include "Bounds.hpp"
+#include "GLWrapper.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+
+namespace HOEngine {
+
+/// Vertex of a terrain chunk.
+struct TerrainVertex {
+	static void SetupPointers();
+
+	glm::vec3 pos;
+	glm::vec3 normal;
+	/// Height of the vertex on the next coarser level's mesh, where it morphs to as
+	/// the chunk nears the end of its range.
+	f32 morphHeight;
+};
+
+/// Grid of 16-bit height samples, row after row along +x. Memory mapped when read
+/// from a raw file, so only the parts of a large map actually used get paged in.
+class Heightmap {
+private:
+	std::optional<MappedFile> file;
+	std::vector<u16> owned;
+	u32 width_ = 0;
+	u32 height_ = 0;
+
+public:
+	/// Map a headerless little-endian 16-bit file of `width` by `height` samples, or
+	/// `std::nullopt` if it can't be mapped or its size doesn't match.
+	static std::optional<Heightmap> Open(const std::string& path, u32 width, u32 height);
+	/// Same as above for square maps, the side being deduced from the file size.
+	static std::optional<Heightmap> Open(const std::string& path);
+
+	/// Throws if `samples` doesn't hold `width * height` samples, or either is below 2.
+	Heightmap(std::vector<u16> samples, u32 width, u32 height);
+
+	const u16* data() const { return file ? reinterpret_cast<const u16*>(file->data()) : owned.data(); }
+	/// Sample at `x, z`, clamped to the edges.
+	u16 At(i64 x, i64 z) const;
+	u32 width() const { return width_; }
+	u32 height() const { return height_; }
+	usize byteSize() const { return usize{ width_ } * height_ * sizeof(u16); }
+
+private:
+	Heightmap() = default;
+};
+
+/// Terrain over a heightmap, drawn as a quadtree of chunks with continuous
+/// distance-dependent level of detail (CDLOD).
+///
+/// A chunk is a grid of `chunkSize` quads. At level 0 its vertices are one sample
+/// apart, each level above covers twice the area with vertices twice as far apart.
+/// Level `l` is used within `lodDistance * 2^l` of the camera; nearing that range
+/// its vertices morph towards the coarser level, so neighbouring chunks one level
+/// apart meet without cracks or popping. Quadtree nodes whose children aren't all
+/// in range draw the quarters left over, which is why the shared index buffer lists
+/// the quads quarter by quarter.
+///
+/// Chunks are streamed around the camera: `Update` generates the missing ones
+/// (coarsest and nearest first, in parallel on the pool, normals four vertices at a
+/// time with `F32x4`) and drops those gone out of range. It needs no GL context,
+/// so generation and memory can be measured headless. `Draw` uploads new chunks
+/// into slots of one vertex buffer and draws every node with a base vertex offset.
+class Terrain {
+public:
+	struct Config {
+		/// World position of the first sample, at height 0.
+		glm::vec3 origin{ 0.0f };
+		/// Distance between samples.
+		f32 cellSize = 1.0f;
+		/// Height of the largest sample value.
+		f32 heightRange = 512.0f;
+		/// Quads along each side of a chunk, a power of two between 4 and 256.
+		u32 chunkSize = 64;
+		u32 lodLevels = 6;
+		/// Range of level 0, doubling with each level.
+		f32 lodDistance = 128.0f;
+		/// Fraction of a level's range, at its end, over which vertices morph.
+		f32 morphRatio = 0.3f;
+		/// Range of the coarsest level, beyond which nothing is loaded.
+		f32 viewDistance = 8192.0f;
+		/// Extra fraction of a level's range within which its chunks are loaded
+		/// ahead, and beyond which loaded chunks are kept before being dropped.
+		f32 prefetch = 0.25f;
+		f32 hysteresis = 0.25f;
+		/// Chunks resident at once, which is also the number of slots of the
+		/// vertex buffer.
+		u32 maxChunks = 512;
+		/// Chunks `Update` may generate in one call.
+		u32 maxGenerated = 64;
+	};
+
+	struct Stats {
+		usize chunks = 0;
+		/// Vertex memory of the resident chunks.
+		usize chunkBytes = 0;
+		/// Chunks in range but not resident after the last `Update`.
+		usize pending = 0;
+		/// Chunks the last `Update` left out because `maxChunks` were resident.
+		usize overflows = 0;
+		usize generated = 0;
+		usize evicted = 0;
+		/// Wall time of the last `Update`, and CPU time it spent per chunk
+		/// generated, in milliseconds.
+		f64 updateTime = 0;
+		f64 chunkTime = 0;
+		/// Nodes and triangles of the last `Draw`.
+		usize nodes = 0;
+		usize triangles = 0;
+	};
+
+	using NodeKey = u64;
+
+	/// Node selected for drawing.
+	struct DrawNode {
+		NodeKey key;
+		u32 level;
+		/// Quarter of the node to draw, `wholeNode` for all of it.
+		u32 quarter;
+	};
+	static constexpr u32 wholeNode = 4;
+
+private:
+	struct Chunk {
+		/// Dropped once uploaded.
+		std::vector<TerrainVertex> vertices;
+		u32 slot = noSlot;
+	};
+	static constexpr u32 noSlot = ~0u;
+
+	struct Level {
+		u32 nodesX;
+		u32 nodesZ;
+		/// Lowest and highest height of each node.
+		std::vector<glm::vec2> heights;
+	};
+
+	Heightmap heightmap_;
+	Config config;
+	std::vector<Level> levels;
+	std::vector<GLuint> indices_;
+	std::unordered_map<NodeKey, Chunk> chunks;
+	/// Missing chunks within range, reused by `Update`.
+	std::vector<std::pair<f32, NodeKey>> wanted;
+	std::vector<DrawNode> selected;
+	Stats stats_;
+
+	/// Uniform locations of `program`, resolved once by `SetupGL`.
+	struct Uniforms {
+		GLint viewProj, camera, morph;
+	};
+
+	std::optional<ShaderProgram> program;
+	Uniforms uniforms{};
+	std::optional<StateObject> vao;
+	std::optional<BufferObject> vertexBuffer;
+	std::optional<BufferObject> indexBuffer;
+	std::vector<u32> freeSlots;
+
+public:
+	Terrain(Heightmap heightmap, Config config);
+	explicit Terrain(Heightmap heightmap) : Terrain(std::move(heightmap), Config{}) {}
+
+	static NodeKey Key(u32 level, u32 x, u32 z) { return (NodeKey{ level } << 56) | (NodeKey{ x } << 28) | z; }
+
+	/// Stream chunks in and out around `camera`.
+	void Update(ThreadPool& pool, const glm::vec3& camera);
+	/// Nodes to draw from `camera`, among the resident ones, culled by `frustum` when given.
+	void Select(const glm::vec3& camera, const Frustum* frustum, std::vector<DrawNode>& out) const;
+	/// Upload the chunks generated since the last call and draw the terrain.
+	void Draw(const glm::mat4& view, const glm::mat4& proj, const glm::vec3& camera);
+
+	/// Vertices of a node, `verticesPerChunk()` of them, into `out`.
+	void GenerateChunk(u32 level, u32 x, u32 z, std::span<TerrainVertex> out) const;
+	/// Terrain height under a world position, interpolated between samples.
+	f32 HeightAt(f32 x, f32 z) const;
+	/// Valid once `Update` ran, like `levelCount`.
+	AABB NodeBounds(u32 level, u32 x, u32 z) const;
+
+	u32 levelCount() const { return static_cast<u32>(levels.size()); }
+	u32 verticesPerChunk() const { return (config.chunkSize + 1) * (config.chunkSize + 1); }
+	/// Shared by every chunk, quarter after quarter.
+	std::span<const GLuint> indices() const { return indices_; }
+	/// Side of a node in world units.
+	f32 NodeSize(u32 level) const { return static_cast<f32>(config.chunkSize << level) * config.cellSize; }
+	/// Vertex memory per square kilometre of terrain, world units being metres,
+	/// when drawn entirely at `level`.
+	f64 BytesPerSquareKm(u32 level) const;
+	const Heightmap& heightmap() const { return heightmap_; }
+	const Stats& stats() const { return stats_; }
+
+private:
+	void BuildLevels(ThreadPool& pool);
+	/// Squared distance from `camera` to a node's bounds.
+	f32 NodeDistance2(u32 level, u32 x, u32 z, const glm::vec3& camera) const;
+	f32 Range(u32 level) const;
+	void Want(u32 level, u32 x, u32 z, const glm::vec3& camera);
+	/// False if the node is out of range or not resident, for its parent to cover it.
+	bool SelectNode(u32 level, u32 x, u32 z, const glm::vec3& camera, const Frustum* frustum, std::vector<DrawNode>& out) const;
+	bool SetupGL();
+};
+
+} // namespace HOEngine
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory_resource>
+#include "TextureCache.hpp"
+#include "Arena.hpp"
+#include "Profiler.hpp"
+#include "Timing.hpp"
+#include "RenderStats.hpp"
+
+using namespace HOEngine;
+
+TextureCache::TextureCache(Config config)
+	: config{ config }
+	, placeholder{ TextureFormat::RGBA8, 1, 1, 1 }
+	, ring{ GL_PIXEL_UNPACK_BUFFER, config.uploadBudget } {
+	const u8 grey[4] = { 128, 128, 128, 255 };
+	placeholder.Upload(0, grey);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (usize i = 0; i < std::max<usize>(config.threads, 1); ++i) {
+		threads.emplace_back([this]() { LoaderLoop(); });
+	}
+}
+
+TextureCache::~TextureCache() noexcept {
+	{
+		std::lock_guard lock{mutex};
+		stopping = true;
+	}
+	cv.notify_all();
+	for (auto& thread : threads) thread.join();
+}
+
+void TextureCache::LoaderLoop() {
+	HOENGINE_PROFILE_THREAD("Textures");
+	while (true) {
+		LoadRequest request;
+		{
+			std::unique_lock lock{mutex};
+			cv.wait(lock, [&]() { return stopping || !requests.empty(); });
+			if (stopping) return;
+			request = std::move(requests.front());
+			requests.pop_front();
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::unique_ptr<Image> image;
+		{
+			HOENGINE_PROFILE_SCOPE("TextureCache::Decode");
+			try {
+				auto decoded = ReadImageFile(request.path, config.srgb, config.mipFilter, request.firstLevel);
+				if (decoded) image = std::make_unique<Image>(std::move(*decoded));
+			} catch (const std::exception&) {
+				image.reset();
+			}
+		}
+
+		std::lock_guard lock{mutex};
+		results.push_back(LoadResult{ request.id, request.generation, std::move(image), MillisecondsSince(start) });
+	}
+}
+
+TextureID TextureCache::Load(const std::string& path) {
+	if (auto it = byPath.find(path); it != byPath.end()) {
+		++entries[it->second].refs;
+		return it->second;
+	}
+
+	TextureID id;
+	if (!freeEntries.empty()) {
+		id = freeEntries.back();
+		freeEntries.pop_back();
+	} else {
+		id = static_cast<TextureID>(entries.size());
+		entries.emplace_back();
+	}
+	auto& entry = entries[id];
+	entry.path = path;
+	entry.refs = 1;
+	entry.lastUsed = frame;
+	byPath.emplace(path, id);
+	Request(id, 0);
+	return id;
+}
+
+void TextureCache::Release(TextureID id) {
+	if (id >= entries.size() || entries[id].refs == 0) return;
+	auto& entry = entries[id];
+	if (--entry.refs > 0) return;
+
+	byPath.erase(entry.path);
+	// Loads still in flight for it are dropped once they come back
+	auto generation = entry.generation + 1;
+	entry = Entry{};
+	entry.generation = generation;
+	freeEntries.push_back(id);
+}
+
+GLuint TextureCache::Use(TextureID id) {
+	if (id >= entries.size() || entries[id].refs == 0) return placeholder;
+	auto& entry = entries[id];
+	entry.lastUsed = frame;
+	if (entry.texture) return *entry.texture;
+	// A first load can be sampled as soon as its coarsest level is in
+	if (entry.incoming && entry.incoming->baseLevel() < entry.incoming->levels()) return *entry.incoming;
+	return placeholder;
+}
+
+bool TextureCache::IsResident(TextureID id) const {
+	if (id >= entries.size() || entries[id].refs == 0) return false;
+	const auto& entry = entries[id];
+	return entry.texture && !entry.loading && !entry.image;
+}
+
+void TextureCache::Request(TextureID id, u32 firstLevel) {
+	auto& entry = entries[id];
+	entry.loading = true;
+	entry.loadingLevels = firstLevel;
+	{
+		std::lock_guard lock{mutex};
+		requests.push_back(LoadRequest{ id, entry.generation, entry.path, firstLevel });
+	}
+	cv.notify_one();
+}
+
+void TextureCache::Update() {
+	HOENGINE_PROFILE_SCOPE("TextureCache::Update");
+	auto start = std::chrono::steady_clock::now();
+	CollectResults();
+	UploadLevels();
+	EnforceBudget();
+
+	stats_.textures = 0;
+	stats_.residentBytes = 0;
+	stats_.pendingLoads = 0;
+	stats_.pendingBytes = 0;
+	for (const auto& entry : entries) {
+		if (entry.refs == 0) continue;
+		++stats_.textures;
+		if (entry.texture) stats_.residentBytes += entry.texture->byteSize();
+		if (entry.incoming) stats_.residentBytes += entry.incoming->byteSize();
+		if (entry.loading) ++stats_.pendingLoads;
+		if (entry.image) {
+			for (u32 level = 0; level < entry.nextLevel; ++level) stats_.pendingBytes += entry.image->levels[level].size;
+		}
+	}
+	HOENGINE_PROFILE_COUNTER("Resident texture bytes", stats_.residentBytes);
+	stats_.updateTime = MillisecondsSince(start);
+	++frame;
+}
+
+void TextureCache::CollectResults() {
+	std::vector<LoadResult> finished;
+	{
+		std::lock_guard lock{mutex};
+		finished.swap(results);
+	}
+
+	stats_.decodeTime = 0;
+	if (finished.empty()) return;
+	for (auto& result : finished) {
+		stats_.decodeTime += result.decodeTime;
+		auto& entry = entries[result.id];
+		// Released meanwhile, the slot possibly reused
+		if (entry.generation != result.generation || entry.refs == 0) continue;
+
+		entry.loading = false;
+		if (!result.image || result.image->levels.empty() || !IsTextureFormatSupported(result.image->format)) {
+			++stats_.failures;
+			entry.failed = true;
+			continue;
+		}
+		auto& image = *result.image;
+		auto levels = static_cast<u32>(image.levels.size());
+		if (entry.fileLevels == 0) {
+			entry.format = image.format;
+			entry.fileWidth = image.width();
+			entry.fileHeight = image.height();
+			entry.fileLevels = image.droppedLevels + levels;
+		}
+		entry.loadingLevels = image.droppedLevels;
+		entry.incoming.emplace(image.format, image.width(), image.height(), levels);
+		entry.nextLevel = levels;
+		entry.image = std::move(result.image);
+		uploads.push_back(result.id);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureCache::UploadLevels() {
+	if (uploads.empty()) return;
+
+	struct PendingUpload {
+		Texture* texture;
+		u32 level;
+		GLintptr offset;
+	};
+
+	ScratchArena scratch;
+	std::pmr::vector<PendingUpload> pending(scratch.resource());
+	std::pmr::vector<TextureID> completed(scratch.resource());
+	auto budget = config.uploadBudget;
+	auto mapped = false;
+	while (!uploads.empty() && budget > 0) {
+		auto id = uploads.front();
+		auto& entry = entries[id];
+		if (!entry.image || entry.nextLevel == 0) {
+			uploads.pop_front();
+			continue;
+		}
+
+		// Coarsest first, so the texture sharpens as levels come in
+		auto level = entry.nextLevel - 1;
+		auto data = entry.image->LevelData(level);
+		if (data.size() > ring.regionSize()) {
+			// Too large for the ring, uploaded straight from memory, alone in its frame
+			if (budget < config.uploadBudget) break;
+			entry.incoming->Upload(level, data.data());
+			RenderStats::Global().Upload(data.size());
+			budget = 0;
+		} else {
+			if (data.size() > budget) break;
+			if (!mapped) {
+				ring.BeginFrame();
+				mapped = true;
+			}
+			auto alloc = ring.Allocate(data.size());
+			if (!alloc) break;
+			std::memcpy(alloc->ptr, data.data(), data.size());
+			pending.push_back(PendingUpload{ &*entry.incoming, level, alloc->offset });
+			budget -= data.size();
+		}
+		++stats_.uploads;
+		stats_.uploadedBytes += data.size();
+
+		if (--entry.nextLevel == 0) {
+			completed.push_back(id);
+			uploads.pop_front();
+		}
+	}
+
+	if (mapped) {
+		ring.Commit();
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.handle());
+		for (const auto& upload : pending) {
+			upload.texture->Upload(upload.level, reinterpret_cast<const void*>(upload.offset));
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		ring.EndFrame();
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Swapped in only now, the uploads above pointing into `incoming`
+	for (auto id : completed) {
+		auto& entry = entries[id];
+		entry.texture = std::move(entry.incoming);
+		entry.incoming.reset();
+		entry.image.reset();
+		entry.droppedLevels = entry.loadingLevels;
+	}
+}
+
+usize TextureCache::ChainBytes(const Entry& entry, u32 droppedLevels) const {
+	usize total = 0;
+	for (auto level = droppedLevels; level < entry.fileLevels; ++level) {
+		total += TextureLevelSize(entry.format, std::max(entry.fileWidth >> level, 1u), std::max(entry.fileHeight >> level, 1u));
+	}
+	return total;
+}
+
+void TextureCache::EnforceBudget() {
+	// Bytes once every load in flight has landed, so loads already under way to
+	// shrink textures aren't asked for again
+	auto projected = [&](const Entry& entry) -> usize {
+		if (entry.loading || entry.image) return ChainBytes(entry, entry.loadingLevels);
+		return entry.texture ? entry.texture->byteSize() : 0;
+	};
+	usize resident = 0;
+	for (const auto& entry : entries) {
+		if (entry.refs > 0) resident += projected(entry);
+	}
+
+	// Give textures used this frame back the finest levels that fit
+	for (TextureID id = 0; id < entries.size(); ++id) {
+		auto& entry = entries[id];
+		if (entry.refs == 0 || !entry.texture || entry.loading || entry.image) continue;
+		if (entry.droppedLevels == 0 || entry.lastUsed != frame) continue;
+		auto current = entry.texture->byteSize();
+		auto target = entry.droppedLevels;
+		while (target > 0 && resident - current + ChainBytes(entry, target - 1) <= config.residencyBudget) --target;
+		if (target == entry.droppedLevels) continue;
+		resident = resident - current + ChainBytes(entry, target);
+		Request(id, target);
+		++stats_.restores;
+	}
+	if (resident <= config.residencyBudget) return;
+
+	// Then drop one level from the least recently used textures, until under budget
+	ScratchArena scratch;
+	std::pmr::vector<TextureID> candidates(scratch.resource());
+	for (TextureID id = 0; id < entries.size(); ++id) {
+		const auto& entry = entries[id];
+		if (entry.refs == 0 || !entry.texture || entry.loading || entry.image) continue;
+		if (entry.texture->levels() - entry.texture->baseLevel() <= 1 || frame - entry.lastUsed < config.evictAfterFrames) continue;
+		candidates.push_back(id);
+	}
+	std::sort(candidates.begin(), candidates.end(), [&](TextureID a, TextureID b) {
+		return entries[a].lastUsed < entries[b].lastUsed;
+	});
+	// The coarser levels are already there, so no need to load anything
+	for (auto id : candidates) {
+		if (resident <= config.residencyBudget) break;
+		auto& entry = entries[id];
+		resident -= entry.texture->byteSize();
+		entry.texture->DropBaseLevel();
+		resident += entry.texture->byteSize();
+		++entry.droppedLevels;
+		++stats_.evictions;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Engine.hpp"
+#include "GLWrapper.hpp"
+#include "Image.hpp"
+
+namespace HOEngine {
+
+using TextureID = u32;
+constexpr TextureID noTexture = ~0u;
+
+/// Textures loaded from files in the background, within a video memory budget.
+///
+/// Files are read and decoded on loader threads (TGA files get their mips
+/// generated there too), then `Update` copies their levels into a ring of pixel
+/// unpack buffers, coarsest first, at most `uploadBudget` bytes per frame. A new
+/// texture can be sampled from its first level on, until then `Use` hands out a
+/// grey placeholder.
+///
+/// When resident textures go over `residencyBudget`, those unused for
+/// `evictAfterFrames` frames, least recently used first, lose their finest level
+/// in place, halving their size each time. Textures evicted that way are reloaded
+/// with their finest levels once used again, budget permitting.
+///
+/// Every method must be called from the thread owning the GL context.
+class TextureCache {
+public:
+	struct Config {
+		/// Video memory of the resident textures.
+		usize residencyBudget = 256 * 1024 * 1024;
+		/// Bytes uploaded per `Update`, which is also the size of each region of the
+		/// upload ring. Levels larger than that are uploaded straight from memory,
+		/// alone in their frame.
+		usize uploadBudget = 16 * 1024 * 1024;
+		/// Frames a texture stays unused before it may lose mips.
+		u32 evictAfterFrames = 120;
+		MipFilter mipFilter = MipFilter::Kaiser;
+		/// Whether TGA files hold sRGB colors. Cooked textures carry their own format.
+		bool srgb = true;
+		usize threads = 1;
+	};
+
+	struct Stats {
+		usize textures = 0;
+		/// Video memory of the textures, including those being uploaded.
+		usize residentBytes = 0;
+		/// Files being decoded, and decoded bytes waiting to be uploaded.
+		usize pendingLoads = 0;
+		usize pendingBytes = 0;
+		/// Levels uploaded, and their size.
+		u64 uploads = 0;
+		u64 uploadedBytes = 0;
+		/// Times a texture lost, or got back, its finest levels.
+		u64 evictions = 0;
+		u64 restores = 0;
+		u64 failures = 0;
+		/// Decoding time of the files collected by the last `Update`, and wall time
+		/// of the last `Update`, in milliseconds.
+		f64 decodeTime = 0;
+		f64 updateTime = 0;
+	};
+
+private:
+	struct Entry {
+		std::string path;
+		u32 refs = 0;
+		/// Bumped whenever the entry is reused or reloaded, to drop stale loads.
+		u32 generation = 0;
+		std::optional<Texture> texture;
+		/// Being uploaded from `image`, replacing `texture` once complete.
+		std::optional<Texture> incoming;
+		std::unique_ptr<Image> image;
+		/// Next level of `image` to upload, counting down.
+		u32 nextLevel = 0;
+		/// Levels of the file dropped from `texture`, and from the one being loaded.
+		u32 droppedLevels = 0;
+		u32 loadingLevels = 0;
+		/// Format, size and levels of the file, known once it was loaded.
+		TextureFormat format = TextureFormat::RGBA8;
+		u32 fileWidth = 0;
+		u32 fileHeight = 0;
+		u32 fileLevels = 0;
+		bool loading = false;
+		bool failed = false;
+		u64 lastUsed = 0;
+	};
+
+	struct LoadRequest {
+		TextureID id;
+		u32 generation;
+		std::string path;
+		u32 firstLevel;
+	};
+
+	struct LoadResult {
+		TextureID id;
+		u32 generation;
+		/// Empty on failure.
+		std::unique_ptr<Image> image;
+		f64 decodeTime;
+	};
+
+	Config config;
+	std::vector<Entry> entries;
+	std::vector<TextureID> freeEntries;
+	std::unordered_map<std::string, TextureID> byPath;
+	/// Entries with an image to upload, in the order they were decoded.
+	std::deque<TextureID> uploads;
+	Texture placeholder;
+	StreamingBuffer ring;
+	u64 frame = 0;
+	Stats stats_;
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<LoadRequest> requests;
+	std::vector<LoadResult> results;
+	bool stopping = false;
+
+public:
+	/// Requires a current context.
+	explicit TextureCache(Config config);
+	TextureCache() : TextureCache(Config{}) {}
+	~TextureCache() noexcept;
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	/// Start loading the texture at `path`, or add a reference to it if loaded already.
+	TextureID Load(const std::string& path);
+	/// Drop a reference, the texture being freed along with the last one.
+	void Release(TextureID id);
+	/// Texture to sample for `id`, the placeholder until it's loaded or if it
+	/// failed to. Marks it used this frame.
+	GLuint Use(TextureID id);
+	/// Whether every level of `id` that fits the budget is uploaded.
+	bool IsResident(TextureID id) const;
+	/// Upload decoded textures and enforce the budget, once per frame.
+	void Update();
+
+	const Stats& stats() const { return stats_; }
+
+private:
+	void LoaderLoop();
+	void Request(TextureID id, u32 firstLevel);
+	void CollectResults();
+	void UploadLevels();
+	void EnforceBudget();
+	/// Bytes of a texture of `entry`'s file, without its `droppedLevels` finest levels.
+	usize ChainBytes(const Entry& entry, u32 droppedLevels) const;
+};
+
+} // namespace HOEngine
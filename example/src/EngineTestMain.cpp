@@ -0,0 +1,42 @@
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include "tests/Test.hpp"
+
+/// Runs the tests registered with `HOENGINE_TEST`, or with `--bench` the
+/// benchmarks registered with `HOENGINE_BENCH`. Any other argument only runs the
+/// cases whose name contains it. Returns non-zero if a case failed.
+int32_t main(int32_t argc, char** argv) {
+	using namespace HOEngine::Test;
+	auto kind = Kind::Test;
+	const char* filter = nullptr;
+	for (int32_t i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--bench") == 0) {
+			kind = Kind::Bench;
+		} else {
+			filter = argv[i];
+		}
+	}
+
+	u32 passed = 0;
+	u32 failed = 0;
+	u32 skipped = 0;
+	for (const auto& test : Registry()) {
+		if (test.kind != kind || (filter && !std::strstr(test.name, filter))) continue;
+		std::printf("[ RUN  ] %s\n", test.name);
+		std::fflush(stdout);
+		try {
+			test.function();
+			std::printf("[  OK  ] %s\n", test.name);
+			++passed;
+		} catch (const Skipped& skip) {
+			std::printf("[ SKIP ] %s: %s\n", test.name, skip.what());
+			++skipped;
+		} catch (const std::exception& error) {
+			std::printf("[ FAIL ] %s: %s\n", test.name, error.what());
+			++failed;
+		}
+	}
+	std::printf("%u passed, %u failed, %u skipped\n", passed, failed, skipped);
+	return failed == 0 ? 0 : 1;
+}
@@ -7,6 +7,13 @@
 #include "Engine.hpp"
 #include "MonadicUtil.hpp"
 #include "GLWrapper.hpp"
+#include "GLTrace.hpp"
+#include "Arena.hpp"
+#include "FramePipeline.hpp"
+#include "render/GpuTimer.hpp"
+#include "render/RenderGraph.hpp"
+#include "render/RenderStats.hpp"
+#include "render/StatsOverlay.hpp"
 
 void ResizeCallback(GLFWwindow* handle, int32_t width, int32_t height) {
 	auto window = HOEngine::Window::FromGLFW(handle);
@@ -51,6 +58,9 @@ public:
 			std::cerr << "Unable to initialize OpenGL, aborting\n";
 			return;
 		}
+		// Only does something when built with HOENGINE_GL_TRACE
+		HOEngine::GLTrace::Install();
+		HOEngine::GLTrace::SetReportOutput(&std::cerr, 600);
 
 		HOEngine::StateObject vao;
 		HOEngine::BufferObject vbo;
@@ -97,45 +107,43 @@ public:
 		bool showDemoWindow = false;
 		ImVec2 fboDim(128, 96);
 		// Data for triangle rendering
-		float time = 0;
- 
-		GLuint tex;
-		glGenTextures(1, &tex);
-		HOEngine::ScopeGuard texRelease([&]() { glDeleteTextures(1, &tex); });
-		glBindTexture(GL_TEXTURE_2D, tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, window->width(), window->height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
- 
-		GLuint fbo;
-		glGenFramebuffers(1, &fbo);
-		HOEngine::ScopeGuard fboRelease([&]() { glDeleteFramebuffers(1, &fbo); });
-		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
- 
-		while (!glfwWindowShouldClose(*window)) {
-			glfwPollEvents();
- 
-			// Render our triangle
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-			{
-				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-				glClearColor(175.0f / 255.0f, 175.0f / 255.0f, 175.0f / 255.0f, 1.0f);
- 
-				glUseProgram(program);
-				glUniform1f(glGetUniformLocation(program, "coefR"), static_cast<float>(std::sin(time)) * 0.5f + 0.5f);
-				glUniform1f(glGetUniformLocation(program, "coefG"), static_cast<float>(std::sin(time + 3.1415926535f / 2)) * 0.5f + 0.5f);
-				glUniform1f(glGetUniformLocation(program, "coefB"), static_cast<float>(std::sin(time + 3.1415926535f)) * 0.5f + 0.5f);
- 
-				glBindVertexArray(vao);
-				glDrawArrays(GL_TRIANGLES, 0, 1 * 3);
-				glBindVertexArray(0);
-			}
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
- 
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glClearColor(175.0f / 255.0f, 175.0f / 255.0f, 175.0f / 255.0f, 1.0f);
- 
+		// The triangle's colors are driven by simulation time at a fixed tick rate, so
+		// they cycle at the same speed regardless of the frame rate
+		constexpr float colorCycleSpeed = 0.6f;
+		HOEngine::FramePipeline pipeline([](f64, u64, HOEngine::TransformSnapshot&) {});
+		pipeline.Start();
+		// Frame statistics
+		HOEngine::GpuTimer gpuTimer;
+		HOEngine::StatsOverlay statsOverlay;
+		auto& renderStats = HOEngine::RenderStats::Global();
+ 
+		// The triangle's target follows the window size, the graph reallocates it on
+		// the first frame after a resize
+		HOEngine::RenderTargetPool targetPool;
+		HOEngine::RenderGraph graph;
+		auto triangleColor = graph.CreateTarget("Triangle color", {
+			.format = HOEngine::TextureFormat::RGBA8,
+			.clearColor = glm::vec4(175.0f / 255.0f, 175.0f / 255.0f, 175.0f / 255.0f, 1.0f),
+		});
+		float time = 0.0f;
+
+		// Render our triangle
+		auto trianglePass = graph.AddPass("Triangle", [&](const HOEngine::RenderGraph&) {
+			HOEngine::GpuTimer::Scope pass(gpuTimer, "Triangle");
+			glUseProgram(program);
+			glUniform1f(glGetUniformLocation(program, "coefR"), static_cast<float>(std::sin(time)) * 0.5f + 0.5f);
+			glUniform1f(glGetUniformLocation(program, "coefG"), static_cast<float>(std::sin(time + 3.1415926535f / 2)) * 0.5f + 0.5f);
+			glUniform1f(glGetUniformLocation(program, "coefB"), static_cast<float>(std::sin(time + 3.1415926535f)) * 0.5f + 0.5f);
+ 
+			glBindVertexArray(vao);
+			glDrawArrays(GL_TRIANGLES, 0, 1 * 3);
+			glBindVertexArray(0);
+			renderStats.StateChange(2);
+			renderStats.Draw(GL_TRIANGLES, 1 * 3);
+		});
+		graph.Write(trianglePass, triangleColor);
+
+		auto imguiPass = graph.AddPass("ImGui", [&](const HOEngine::RenderGraph& graph) {
 			ImGui_ImplOpenGL3_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
@@ -150,19 +158,55 @@ public:
 			ImGui::SliderFloat("Width", &fboDim.x, 16.0f, 1024.0f);
 			ImGui::SliderFloat("Height", &fboDim.y, 12.0f, 768.0f);
 			ImGui::End();
+
+			const auto& pacing = pipeline.pacing();
+			auto frameTimes = pacing.History();
+			ImGui::Begin("Frame pacing");
+			ImGui::Text("p50 %.2f ms, p99 %.2f ms", pacing.P50() * 1000.0, pacing.P99() * 1000.0);
+			ImGui::Text("Missed deadlines: %llu / %llu", static_cast<unsigned long long>(pacing.missed()), static_cast<unsigned long long>(pacing.frames()));
+			ImGui::PlotLines("Frame time", frameTimes.data(), static_cast<int>(frameTimes.size()));
+			const auto& arenaStats = HOEngine::FrameArena::Global().Previous().stats();
+			ImGui::Text("Frame arena: %zu KiB, %llu allocations", arenaStats.bytesUsed / 1024, static_cast<unsigned long long>(arenaStats.allocations));
+			const auto& graphStats = graph.stats();
+			ImGui::Text("Render graph: %zu passes, %zu culled, %zu KiB saved by aliasing", graphStats.passes, graphStats.culledPasses, graphStats.SavedBytes() / 1024);
+			ImGui::End();
  
 			ImGui::Begin("Rendering framebuffer");
-			ImGui::Image((void*)(intptr_t) tex, fboDim);
+			ImGui::Image((void*)(intptr_t) graph.texture(triangleColor), fboDim);
 			ImGui::End();
+
+			statsOverlay.Draw();
  
-			glClear(GL_COLOR_BUFFER_BIT);
+			HOEngine::GpuTimer::Scope pass(gpuTimer, "ImGui");
 			glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			ImGui::Render();
 			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		});
+		graph.Read(imguiPass, triangleColor);
+		graph.Write(imguiPass, HOEngine::RenderGraph::backbuffer);
+ 
+		while (!glfwWindowShouldClose(*window)) {
+			pipeline.BeginFrame();
+			gpuTimer.BeginFrame();
+			HOEngine::GLTrace::BeginFrame();
+			auto cpuStart = std::chrono::steady_clock::now();
+			HOEngine::Window::PollEvents();
+			time = static_cast<float>(pipeline.RenderTime()) * colorCycleSpeed;
+			graph.Execute(targetPool, window->dim());
+
+			gpuTimer.EndFrame();
+			renderStats.EndFrame();
+			HOEngine::GLTrace::EndFrame();
+			HOEngine::FrameArena::Global().EndFrame();
+			// Measured before swapping, which may block on vsync or on the GPU
+			auto cpuTime = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+			statsOverlay.Update(cpuTime, &gpuTimer, renderStats.lastFrame());
  
 			glfwSwapBuffers(*window);
-			time += 0.01f;
+			pipeline.EndFrame();
 		}
+		pipeline.Stop();
 	}
 };
  
@@ -59,8 +59,8 @@ public:
 
 		auto cube = Ng::Entity::NewObject();
 		auto camera = Ng::Entity::New();
-		camera.AddComponent(std::make_unique<Ng::TransformComponent>());
-		camera.AddComponent(std::make_unique<Ng::CameraComponent>());
+		camera.AddComponent(Ng::MakeComponent<Ng::TransformComponent>());
+		camera.AddComponent(Ng::MakeComponent<Ng::CameraComponent>());
 
 		// Cube initialization
 		auto& mesh = *cube.GetComponent<Ng::MeshComponent>();
@@ -126,7 +126,7 @@ public:
 			glDrawElements(GL_TRIANGLE_STRIP, mesh.indices.size() / 3, GL_UNSIGNED_SHORT, 0);
 
 			glfwSwapBuffers(*window);
-			glfwPollEvents();
+			Ng::Window::PollEvents();
 		}
 	}
 };
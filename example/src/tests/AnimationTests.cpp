@@ -0,0 +1,132 @@
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/gtc/quaternion.hpp>
+#include "anim/Animation.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	constexpr u32 boneCount = 60;
+
+	/// Chains of 10 bones hanging off the root.
+	std::shared_ptr<Skeleton> MakeSkeleton() {
+		auto skeleton = std::make_shared<Skeleton>();
+		BoneTransform rest;
+		rest.translation = glm::vec3(0.0f, 0.1f, 0.0f);
+		for (u32 bone = 0; bone < boneCount; ++bone) {
+			auto parent = bone == 0 ? -1 : static_cast<i32>(bone % 10 == 0 ? 0 : bone - 1);
+			skeleton->AddBone("b" + std::to_string(bone), parent, rest);
+		}
+		return skeleton;
+	}
+
+	/// Four seconds of every bone swaying around Z, with the root walking along X.
+	RawClip MakeRawClip() {
+		RawClip raw;
+		raw.frameRate = 30.0f;
+		raw.frameCount = 120;
+		raw.tracks.resize(boneCount);
+		for (u32 bone = 0; bone < boneCount; ++bone) {
+			for (u32 frame = 0; frame < raw.frameCount; ++frame) {
+				BoneTransform transform;
+				transform.translation = glm::vec3(bone == 0 ? static_cast<f32>(frame) * 0.01f : 0.0f, 0.1f, 0.0f);
+				auto angle = 0.3f * std::sin(static_cast<f32>(frame) * 0.1f + static_cast<f32>(bone));
+				transform.rotation = glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+				raw.tracks[bone].push_back(transform);
+			}
+		}
+		return raw;
+	}
+}
+
+HOENGINE_TEST(AnimationClipSamplesCloseToRaw) {
+	auto raw = MakeRawClip();
+	auto clip = AnimationClip::Compress(raw);
+	std::vector<BoneGroup> pose(BoneGroupCount(boneCount));
+	for (u32 frame = 0; frame < raw.frameCount; ++frame) {
+		clip.Sample(static_cast<f32>(frame) / raw.frameRate, false, pose);
+		for (u32 bone = 0; bone < boneCount; ++bone) {
+			auto sampled = pose[bone / 4].Get(bone % 4);
+			const auto& expected = raw.tracks[bone][frame];
+			HOENGINE_CHECK(1.0f - std::abs(glm::dot(sampled.rotation, expected.rotation)) < 1e-3f);
+			HOENGINE_CHECK(glm::length(sampled.translation - expected.translation) < 1e-3f);
+		}
+	}
+}
+
+HOENGINE_TEST(SkeletonPaletteMatchesHierarchy) {
+	auto skeleton = MakeSkeleton();
+	auto clip = AnimationClip::Compress(MakeRawClip());
+	std::vector<BoneGroup> pose(BoneGroupCount(boneCount));
+	std::vector<glm::mat4> model(boneCount), palette(boneCount);
+
+	// The rest pose skins to the bind pose
+	skeleton->RestPose(pose);
+	skeleton->ComputePalette(pose, model, palette);
+	for (const auto& matrix : palette) {
+		for (u32 column = 0; column < 4; ++column) HOENGINE_CHECK(glm::length(matrix[column] - glm::mat4(1.0f)[column]) < 1e-4f);
+	}
+
+	clip.Sample(1.234f, true, pose);
+	skeleton->ComputePalette(pose, model, palette);
+	std::vector<glm::mat4> expected(boneCount);
+	for (u32 bone = 0; bone < boneCount; ++bone) {
+		auto local = pose[bone / 4].Get(bone % 4).Matrix();
+		auto parent = skeleton->bone(bone).parent;
+		expected[bone] = parent >= 0 ? expected[static_cast<u32>(parent)] * local : local;
+		auto skinning = expected[bone] * skeleton->bone(bone).inverseBind;
+		for (u32 column = 0; column < 4; ++column) HOENGINE_CHECK(glm::length(palette[bone][column] - skinning[column]) < 1e-4f);
+	}
+}
+
+HOENGINE_BENCH(AnimationSkinning) {
+	auto skeleton = MakeSkeleton();
+	auto clip = std::make_shared<AnimationClip>(AnimationClip::Compress(MakeRawClip()));
+	ThreadPool pool;
+	AnimationSystem system;
+
+	// Two blended layers per character
+	constexpr u32 characters = 500;
+	auto storage = EntitiesStorage::New();
+	for (u32 i = 0; i < characters; ++i) {
+		auto animator = MakeComponent<AnimatorComponent>();
+		animator->skeleton = skeleton;
+		animator->layers[0].clip = clip;
+		animator->layers[0].time = static_cast<f32>(i) * 0.01f;
+		animator->layers[1].clip = clip;
+		animator->layers[1].weight = 0.5f;
+		animator->layers[1].speed = 1.3f;
+		auto entity = Entity::New();
+		entity.AddComponent(std::move(animator));
+		storage.Add(std::move(entity));
+	}
+	constexpr u32 frames = 60;
+	f64 updateTime = 0;
+	for (u32 frame = 0; frame < frames; ++frame) {
+		system.Update(pool, storage, 1.0f / 60.0f);
+		updateTime += system.stats().updateTime;
+	}
+	Test::Report("500 characters x 60 bones, update", updateTime / frames, "ms");
+
+	SkinnedMeshComponent mesh;
+	for (u32 i = 0; i < 200000; ++i) {
+		SkinnedVertex vertex{};
+		vertex.pos = glm::vec3(static_cast<f32>(i % 7) * 0.1f, static_cast<f32>(i % 13) * 0.1f, 0.0f);
+		vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+		vertex.bones[0] = i % boneCount;
+		vertex.bones[1] = (i + 1) % boneCount;
+		vertex.weights = glm::vec4(0.7f, 0.3f, 0.0f, 0.0f);
+		mesh.vertices.push_back(vertex);
+	}
+	std::vector<BoneGroup> pose(BoneGroupCount(boneCount));
+	std::vector<glm::mat4> model(boneCount), palette(boneCount);
+	clip->Sample(1.0f, true, pose);
+	skeleton->ComputePalette(pose, model, palette);
+	std::vector<SimpleVertex> out(mesh.vertices.size());
+	auto skinTime = Test::MeasureMilliseconds([&] { system.Skin(pool, mesh, palette, out); }, 10);
+	Test::Report("200k vertices, CPU skinning", skinTime, "ms");
+	Test::Report("skinned vertices per ms", static_cast<f64>(mesh.vertices.size()) / skinTime, "vertices/ms");
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "phys/Broadphase.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Every overlapping pair of live bodies, except static against static.
+	std::vector<BodyPair> BruteForcePairs(const Broadphase& broadphase, const std::vector<u32>& bodies) {
+		std::vector<BodyPair> pairs;
+		for (usize i = 0; i < bodies.size(); ++i) {
+			for (usize j = i + 1; j < bodies.size(); ++j) {
+				auto a = std::min(bodies[i], bodies[j]);
+				auto b = std::max(bodies[i], bodies[j]);
+				if (broadphase.kind(a) == BodyKind::Static && broadphase.kind(b) == BodyKind::Static) continue;
+				if (broadphase.box(a).Overlaps(broadphase.box(b))) pairs.push_back(BodyPair{ a, b });
+			}
+		}
+		std::sort(pairs.begin(), pairs.end());
+		return pairs;
+	}
+}
+
+HOENGINE_TEST(BroadphaseMatchesBruteForce) {
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<f32> position(0.0f, 50.0f);
+	std::uniform_real_distribution<f32> size(0.2f, 2.0f);
+	std::uniform_real_distribution<f32> step(-0.3f, 0.3f);
+	auto randomBox = [&] {
+		return AABB::FromCenterExtents(glm::vec3(position(rng), position(rng), position(rng)), glm::vec3(size(rng)));
+	};
+
+	Broadphase::Config config;
+	config.regionSize = 64;
+	Broadphase broadphase(config);
+	ThreadPool pool(2);
+	std::vector<u32> bodies;
+	for (u32 i = 0; i < 1000; ++i) bodies.push_back(broadphase.Add(randomBox(), i % 5 == 0 ? BodyKind::Static : BodyKind::Dynamic));
+
+	for (u32 frame = 0; frame < 20; ++frame) {
+		for (auto body : bodies) {
+			if (broadphase.kind(body) == BodyKind::Static && frame % 7 != 0) continue;
+			auto box = broadphase.box(body);
+			auto offset = glm::vec3(step(rng), step(rng), step(rng));
+			broadphase.Move(body, AABB{ box.min + offset, box.max + offset });
+		}
+		for (u32 i = 0; i < 20; ++i) {
+			auto index = rng() % bodies.size();
+			broadphase.Remove(bodies[index]);
+			bodies.erase(bodies.begin() + static_cast<std::ptrdiff_t>(index));
+			bodies.push_back(broadphase.Add(randomBox(), i % 4 == 0 ? BodyKind::Static : BodyKind::Dynamic));
+		}
+		HOENGINE_CHECK(broadphase.Update(pool) == BruteForcePairs(broadphase, bodies));
+	}
+}
+
+HOENGINE_BENCH(BroadphaseScaling) {
+	ThreadPool pool;
+	for (usize count : { usize{ 10000 }, usize{ 100000 }, usize{ 1000000 } }) {
+		std::mt19937 rng(3);
+		// Same density at every scale, about one neighbour per body
+		std::uniform_real_distribution<f32> position(0.0f, std::cbrt(static_cast<f32>(count)) * 4.0f);
+		std::uniform_real_distribution<f32> step(-0.05f, 0.05f);
+		Broadphase broadphase;
+		std::vector<AABB> boxes;
+		for (usize i = 0; i < count; ++i) {
+			boxes.push_back(AABB::FromCenterExtents(glm::vec3(position(rng), position(rng), position(rng)), glm::vec3(1.0f)));
+			broadphase.Add(boxes.back(), i % 10 == 0 ? BodyKind::Static : BodyKind::Dynamic);
+		}
+		broadphase.Update(pool);
+
+		constexpr u32 steps = 10;
+		f64 sortTime = 0;
+		f64 pairTime = 0;
+		usize pairs = 0;
+		for (u32 frame = 0; frame < steps; ++frame) {
+			for (usize i = 0; i < count; ++i) {
+				if (i % 10 == 0) continue;
+				auto offset = glm::vec3(step(rng), step(rng), step(rng));
+				boxes[i] = AABB{ boxes[i].min + offset, boxes[i].max + offset };
+				broadphase.Move(static_cast<u32>(i), boxes[i]);
+			}
+			broadphase.Update(pool);
+			sortTime += broadphase.stats().sortTime;
+			pairTime += broadphase.stats().pairTime;
+			pairs += broadphase.stats().pairs;
+		}
+		auto label = std::to_string(count) + " bodies";
+		Test::Report((label + ", sort").c_str(), sortTime / steps, "ms");
+		Test::Report((label + ", pairs").c_str(), pairTime / steps, "ms");
+		Test::Report((label + ", pairs per step").c_str(), static_cast<f64>(pairs) / steps, "");
+	}
+}
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+#include "render/ClusteredLights.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	constexpr f32 near = 0.1f;
+	constexpr f32 far = 300.0f;
+
+	glm::mat4 View() { return glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)); }
+	glm::mat4 Projection() { return glm::perspective(1.2f, 16.0f / 9.0f, near, far); }
+
+	void AddRandomLights(LightClusters& clusters, u32 count) {
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<f32> position(-100.0f, 100.0f);
+		std::uniform_real_distribution<f32> radius(1.0f, 8.0f);
+		for (u32 i = 0; i < count; ++i) {
+			auto pos = glm::vec3(position(rng), position(rng) * 0.2f, position(rng) - 120.0f);
+			clusters.Add(pos, radius(rng), glm::vec3(1.0f), 1.0f);
+		}
+	}
+}
+
+HOENGINE_TEST(LightClustersBinConservatively) {
+	LightClusters clusters;
+	AddRandomLights(clusters, 1000);
+	ThreadPool pool(2);
+	clusters.Build(pool, View(), Projection(), near, far);
+	HOENGINE_CHECK(clusters.stats().visibleLights > 0);
+
+	// Every light containing a point must be listed by the point's cluster
+	const auto& config = clusters.config();
+	auto invProj = glm::inverse(Projection());
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<f32> logDepth(0.0f, 1.0f);
+	u32 checked = 0;
+	for (u32 sample = 0; sample < 4000; ++sample) {
+		auto ndcX = unit(rng);
+		auto ndcY = unit(rng);
+		auto depth = near * std::pow(far / near, logDepth(rng));
+		auto onNear = invProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+		auto point = glm::vec3(onNear) / onNear.w;
+		point *= depth / -point.z;
+
+		auto tileX = std::min(config.tilesX - 1, static_cast<u32>((ndcX * 0.5f + 0.5f) * static_cast<f32>(config.tilesX)));
+		auto tileY = std::min(config.tilesY - 1, static_cast<u32>((ndcY * 0.5f + 0.5f) * static_cast<f32>(config.tilesY)));
+		auto range = clusters.ranges()[clusters.ClusterIndex(tileX, tileY, clusters.SliceOf(depth))];
+		auto begin = clusters.indices().begin() + range.offset;
+		auto end = begin + range.count;
+		for (u32 i = 0; i < clusters.lights().size(); ++i) {
+			const auto& light = clusters.lights()[i];
+			if (glm::length(glm::vec3(light.posRadius) - point) >= light.posRadius.w * 0.999f) continue;
+			HOENGINE_CHECK(std::find(begin, end, i) != end);
+			++checked;
+		}
+	}
+	HOENGINE_CHECK(checked > 0);
+}
+
+HOENGINE_BENCH(LightClusters10k) {
+	LightClusters clusters;
+	AddRandomLights(clusters, 10000);
+	ThreadPool single(0);
+	ThreadPool pool;
+	Test::Report("clusters", static_cast<f64>(clusters.clusterCount()), "");
+
+	auto build = [&](ThreadPool& threads) {
+		return Test::MeasureMilliseconds([&] { clusters.Build(threads, View(), Projection(), near, far); });
+	};
+	Test::Report("build, single thread", build(single), "ms");
+	Test::Report("build, thread pool", build(pool), "ms");
+	Test::Report("lights", static_cast<f64>(clusters.stats().lights), "");
+	Test::Report("visible lights", static_cast<f64>(clusters.stats().visibleLights), "");
+	Test::Report("light indices", static_cast<f64>(clusters.stats().indices), "");
+	Test::Report("max lights per cluster", static_cast<f64>(clusters.stats().maxPerCluster), "");
+}
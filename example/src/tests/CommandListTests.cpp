@@ -0,0 +1,167 @@
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "render/CommandList.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Mock backend writing every command it receives as a line of text.
+	class RecordingBackend : public RenderBackend {
+	public:
+		std::vector<std::string> log;
+
+		void BindProgram(GLuint program) override { Log("program " + std::to_string(program)); }
+		void BindVertexArray(GLuint vao) override { Log("vao " + std::to_string(vao)); }
+		void BindTexture(u32 unit, GLenum target, GLuint texture) override {
+			Log("texture " + std::to_string(unit) + " " + std::to_string(target) + " " + std::to_string(texture));
+		}
+		void Uniform(GLint location, f32 value) override { Log("f32 " + std::to_string(location) + " " + std::to_string(value)); }
+		void Uniform(GLint location, i32 value) override { Log("i32 " + std::to_string(location) + " " + std::to_string(value)); }
+		void Uniform(GLint location, const glm::vec4& value) override {
+			Log("vec4 " + std::to_string(location) + " " + std::to_string(value.x) + " " + std::to_string(value.w));
+		}
+		void Uniform(GLint location, const glm::mat4& value) override {
+			Log("mat4 " + std::to_string(location) + " " + std::to_string(value[0][0]) + " " + std::to_string(value[3][2]));
+		}
+		void DrawArrays(GLenum mode, i32 first, i32 count, i32 instances) override {
+			Log("arrays " + std::to_string(mode) + " " + std::to_string(first) + " " + std::to_string(count) + " " + std::to_string(instances));
+		}
+		void DrawElements(GLenum mode, i32 count, GLenum indexType, usize indexOffset, i32 baseVertex, i32 instances) override {
+			Log("elements " + std::to_string(mode) + " " + std::to_string(count) + " " + std::to_string(indexType) + " "
+				+ std::to_string(indexOffset) + " " + std::to_string(baseVertex) + " " + std::to_string(instances));
+		}
+
+	private:
+		void Log(std::string line) { log.push_back(std::move(line)); }
+	};
+
+	u64 CallsTo(const GLTrace::Report& report, const char* name) {
+		for (const auto& call : report.calls) {
+			if (std::strcmp(call.name, name) == 0) return call.calls;
+		}
+		return 0;
+	}
+}
+
+HOENGINE_TEST(CommandListReplaysInRecordingOrder) {
+	auto matrix = glm::mat4(2.0f);
+	matrix[3][2] = -5.0f;
+	CommandList list;
+	list.BindProgram(3);
+	list.Uniform(0, 1.5f);
+	list.Uniform(1, 7);
+	list.Uniform(2, glm::vec4(0.25f, 0.0f, 0.0f, 4.0f));
+	list.Uniform(3, matrix);
+	list.BindVertexArray(9);
+	list.BindTexture(2, GL_TEXTURE_2D, 11);
+	list.DrawArrays(GL_TRIANGLES, 6, 36);
+	list.DrawElements(GL_LINES, 24, GL_UNSIGNED_SHORT, 128, -4, 10);
+	HOENGINE_CHECK(list.size() == 9 && list.bytes() > 0);
+
+	RecordingBackend backend;
+	list.Replay(backend);
+	auto expected = std::vector<std::string>{
+		"program 3",
+		"f32 0 " + std::to_string(1.5f),
+		"i32 1 7",
+		"vec4 2 " + std::to_string(0.25f) + " " + std::to_string(4.0f),
+		"mat4 3 " + std::to_string(2.0f) + " " + std::to_string(-5.0f),
+		"vao 9",
+		"texture 2 " + std::to_string(GL_TEXTURE_2D) + " 11",
+		"arrays " + std::to_string(GL_TRIANGLES) + " 6 36 1",
+		"elements " + std::to_string(GL_LINES) + " 24 " + std::to_string(GL_UNSIGNED_SHORT) + " 128 -4 10",
+	};
+	HOENGINE_CHECK(backend.log == expected);
+
+	list.Clear();
+	HOENGINE_CHECK(list.empty() && list.bytes() == 0);
+	backend.log.clear();
+	list.Replay(backend);
+	HOENGINE_CHECK(backend.log.empty());
+}
+
+HOENGINE_TEST(CommandListValidatesInDebugBuilds) {
+#ifndef NDEBUG
+	NullBackend backend;
+	CommandList noProgram;
+	noProgram.BindVertexArray(1);
+	noProgram.DrawArrays(GL_TRIANGLES, 0, 3);
+	HOENGINE_CHECK_THROWS(noProgram.Replay(backend));
+
+	CommandList noVAO;
+	noVAO.BindProgram(1);
+	noVAO.Uniform(0, 1.0f);
+	noVAO.DrawArrays(GL_TRIANGLES, 0, 3);
+	HOENGINE_CHECK_THROWS(noVAO.Replay(backend));
+
+	// Bindings don't carry over from one list to the next
+	CommandList draw;
+	draw.DrawArrays(GL_TRIANGLES, 0, 3);
+	HOENGINE_CHECK_THROWS(ReplayAll({ noVAO, draw }, backend));
+#else
+	HOENGINE_SKIP("command lists are only validated in debug builds");
+#endif
+}
+
+HOENGINE_TEST(CommandListParallelRecordingIsOrderedByChunk) {
+	constexpr usize count = 1000;
+	constexpr usize grain = 16;
+	auto record = [](CommandList& list, usize begin, usize end) {
+		// The first chunks finish last
+		if (begin < 4 * grain) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		list.BindProgram(1);
+		list.BindVertexArray(1);
+		for (auto i = begin; i < end; ++i) list.DrawArrays(GL_POINTS, static_cast<i32>(i), 1);
+	};
+
+	ThreadPool pool(3);
+	std::vector<CommandList> lists;
+	RecordParallel(pool, count, grain, lists, record);
+	HOENGINE_CHECK(lists.size() == (count + grain - 1) / grain);
+
+	// Replay order only depends on the chunk index, not on which thread finished first
+	RecordingBackend backend;
+	ReplayAll(lists, backend);
+	std::vector<std::string> expected;
+	for (usize i = 0; i < count; ++i) {
+		if (i % grain == 0) {
+			expected.push_back("program 1");
+			expected.push_back("vao 1");
+		}
+		expected.push_back("arrays " + std::to_string(GL_POINTS) + " " + std::to_string(i) + " 1 1");
+	}
+	HOENGINE_CHECK(backend.log == expected);
+
+	// Recording again reuses the lists
+	RecordParallel(pool, 40, grain, lists, record);
+	HOENGINE_CHECK(lists.size() == 3 && lists[2].size() == 2 + 8);
+}
+
+HOENGINE_TEST(CommandListGLBackendSkipsRedundantBinds) {
+	Test::FakeGL gl;
+	CommandList list;
+	for (i32 i = 0; i < 4; ++i) {
+		list.BindProgram(5);
+		list.BindVertexArray(6);
+		list.BindTexture(0, GL_TEXTURE_2D, 7);
+		list.Uniform(0, static_cast<f32>(i));
+		list.DrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0, i);
+	}
+	list.DrawArrays(GL_TRIANGLES, 0, 3, 2);
+
+	GLBackend backend;
+	GLTrace::BeginFrame();
+	list.Replay(backend);
+	GLTrace::EndFrame();
+	const auto& report = GLTrace::LastReport();
+	HOENGINE_CHECK(report.redundantBinds == 0);
+	HOENGINE_CHECK(CallsTo(report, "glUseProgram") == 1 && CallsTo(report, "glBindVertexArray") == 1);
+	HOENGINE_CHECK(CallsTo(report, "glBindTexture") == 1 && CallsTo(report, "glUniform1f") == 4);
+	// Base vertex 0 takes the plain draw, the others the base vertex variant
+	HOENGINE_CHECK(CallsTo(report, "glDrawElements") == 1 && CallsTo(report, "glDrawElementsInstancedBaseVertex") == 3);
+	HOENGINE_CHECK(CallsTo(report, "glDrawArraysInstanced") == 1);
+}
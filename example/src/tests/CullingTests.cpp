@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "render/Culling.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	struct CullingScene {
+		std::vector<AABB> boxes;
+		AABBArray array;
+		DynamicBVH tree;
+		Frustum frustum;
+		std::vector<u32> expected;
+	};
+
+	CullingScene MakeCullingScene(usize count) {
+		CullingScene scene;
+		std::mt19937 rng(3);
+		std::uniform_real_distribution<f32> position(-500.0f, 500.0f);
+		std::uniform_real_distribution<f32> extent(0.5f, 3.0f);
+		for (usize i = 0; i < count; ++i) {
+			auto center = glm::vec3(position(rng), position(rng) * 0.2f, position(rng));
+			auto box = AABB::FromCenterExtents(center, glm::vec3(extent(rng)));
+			scene.boxes.push_back(box);
+			scene.array.Push(box);
+			scene.tree.Insert(box, static_cast<u32>(i));
+		}
+		auto viewProj = glm::perspective(1.2f, 16.0f / 9.0f, 0.1f, 400.0f)
+			* glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(100.0f, 0.0f, 50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		scene.frustum = Frustum::FromMatrix(viewProj);
+		for (usize i = 0; i < count; ++i) {
+			if (scene.frustum.Overlaps(scene.boxes[i])) scene.expected.push_back(static_cast<u32>(i));
+		}
+		return scene;
+	}
+
+	std::vector<u32> Sorted(std::vector<u32> indices) {
+		std::sort(indices.begin(), indices.end());
+		return indices;
+	}
+}
+
+HOENGINE_TEST(TransformBoundsMatchTransformMat) {
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<f32> unit(-1.0f, 1.0f);
+	auto local = AABB{ glm::vec3(-1.0f, -2.0f, -0.5f), glm::vec3(2.0f, 1.0f, 0.5f) };
+	for (u32 i = 0; i < 100; ++i) {
+		TransformComponent transform;
+		transform.pos = glm::vec3(unit(rng), unit(rng), unit(rng)) * 10.0f;
+		transform.rot = glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+		transform.scale = glm::vec3(1.5f + unit(rng), 1.5f + unit(rng), 1.5f + unit(rng));
+
+		// The bounds are exactly those of the transformed corners
+		auto matrix = transform.TransformMat();
+		AABB corners;
+		for (u32 corner = 0; corner < 8; ++corner) {
+			auto point = glm::vec3(corner & 1 ? local.max.x : local.min.x, corner & 2 ? local.max.y : local.min.y, corner & 4 ? local.max.z : local.min.z);
+			corners.Extend(glm::vec3(matrix * glm::vec4(point, 1.0f)));
+		}
+		auto bounds = transform.TransformBounds(local);
+		HOENGINE_CHECK(glm::length(bounds.min - corners.min) < 1e-3f);
+		HOENGINE_CHECK(glm::length(bounds.max - corners.max) < 1e-3f);
+	}
+}
+
+HOENGINE_TEST(CullingMatchesBruteForce) {
+	auto scene = MakeCullingScene(20000);
+	HOENGINE_CHECK(!scene.expected.empty() && scene.expected.size() < scene.boxes.size());
+	ThreadPool pool(3);
+	std::vector<u32> visible;
+	CullAABBs(scene.frustum, scene.array, 0, scene.array.size(), visible);
+	HOENGINE_CHECK(visible == scene.expected);
+	visible.clear();
+	CullAABBsParallel(pool, scene.frustum, scene.array, visible);
+	HOENGINE_CHECK(visible == scene.expected);
+	visible.clear();
+	CullBVH(scene.frustum, scene.tree, visible);
+	HOENGINE_CHECK(Sorted(visible) == scene.expected);
+	std::vector<u32> parallel;
+	CullBVHParallel(pool, scene.frustum, scene.tree, parallel);
+	HOENGINE_CHECK(Sorted(parallel) == scene.expected);
+}
+
+HOENGINE_BENCH(Culling1M) {
+	auto scene = MakeCullingScene(1000000);
+	Test::Report("objects", static_cast<f64>(scene.boxes.size()), "");
+	Test::Report("visible", static_cast<f64>(scene.expected.size()), "");
+	ThreadPool pool;
+	Test::Report("worker threads", static_cast<f64>(pool.threadCount()), "");
+
+	std::vector<u32> visible;
+	auto run = [&](const char* label, auto&& cull) {
+		auto time = Test::MeasureMilliseconds([&] {
+			visible.clear();
+			cull();
+		});
+		HOENGINE_CHECK(Sorted(visible) == scene.expected);
+		Test::Report(label, time, "ms");
+	};
+	run("flat SoA, single thread", [&] { CullAABBs(scene.frustum, scene.array, 0, scene.array.size(), visible); });
+	run("flat SoA, thread pool", [&] { CullAABBsParallel(pool, scene.frustum, scene.array, visible); });
+	run("BVH, single thread", [&] { CullBVH(scene.frustum, scene.tree, visible); });
+	run("BVH, thread pool", [&] { CullBVHParallel(pool, scene.frustum, scene.tree, visible); });
+}
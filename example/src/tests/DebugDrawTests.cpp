@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "render/DebugDraw.hpp"
+#include "ThreadPool.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Collect once to drop what other tests left behind.
+	DebugDrawFrame EmptyFrame() {
+		DebugDrawFrame frame;
+		DebugDraw::Collect(frame, 0.0f);
+		return DebugDrawFrame{};
+	}
+}
+
+HOENGINE_TEST(DebugDrawMergesThreads) {
+	auto frame = EmptyFrame();
+	ThreadPool pool(3);
+	pool.ParallelTasks(64, [](usize i) {
+		auto layer = i % 2 ? DebugLayer::Overlay : DebugLayer::Depth;
+		DebugDraw::Line(glm::vec3(0.0f), glm::vec3(static_cast<f32>(i)), static_cast<u32>(i), layer);
+	});
+	DebugDraw::Box(AABB{ glm::vec3(-1.0f), glm::vec3(1.0f) }, DebugDraw::red);
+	DebugDraw::Collect(frame, 0.016f);
+	HOENGINE_CHECK(frame.VertexCount(DebugLayer::Depth) == 32 * 2 + 24);
+	HOENGINE_CHECK(frame.VertexCount(DebugLayer::Overlay) == 32 * 2);
+
+	// Every line came through once, whole
+	std::vector<u32> seen(64, 0);
+	for (const auto& vertices : frame.vertices) {
+		for (usize v = 0; v < vertices.size(); v += 2) {
+			HOENGINE_CHECK(vertices[v].color == vertices[v + 1].color);
+			if (vertices[v].color < 64) ++seen[vertices[v].color];
+		}
+	}
+	for (auto count : seen) HOENGINE_CHECK(count == 1);
+
+	// Lines without a duration last one frame
+	DebugDraw::Collect(frame, 0.016f);
+	HOENGINE_CHECK(frame.VertexCount(DebugLayer::Depth) == 0 && frame.VertexCount(DebugLayer::Overlay) == 0);
+}
+
+HOENGINE_TEST(DebugDrawCollectsWhileThreadsDraw) {
+	auto frame = EmptyFrame();
+	constexpr u32 threadCount = 3;
+	constexpr u32 linesPerThread = 20000;
+	std::atomic<u32> done{ 0 };
+	std::vector<std::thread> threads;
+	for (u32 t = 0; t < threadCount; ++t) {
+		threads.emplace_back([&done, t] {
+			for (u32 i = 0; i < linesPerThread; ++i) {
+				DebugDraw::Line(glm::vec3(static_cast<f32>(t)), glm::vec3(static_cast<f32>(i)), t);
+			}
+			done.fetch_add(1);
+		});
+	}
+
+	// Lines land in whichever frame collects them, but none is lost or duplicated
+	std::vector<usize> lines(threadCount, 0);
+	auto count = [&] {
+		const auto& vertices = frame.vertices[static_cast<usize>(DebugLayer::Depth)];
+		for (usize v = 0; v < vertices.size(); v += 2) {
+			HOENGINE_CHECK(vertices[v].color == vertices[v + 1].color && vertices[v].color < threadCount);
+			++lines[vertices[v].color];
+		}
+	};
+	while (done.load() < threadCount) {
+		DebugDraw::Collect(frame, 0.016f);
+		count();
+	}
+	for (auto& thread : threads) thread.join();
+	DebugDraw::Collect(frame, 0.016f);
+	count();
+	for (auto total : lines) HOENGINE_CHECK(total == linesPerThread);
+}
+
+HOENGINE_TEST(DebugDrawExpiresTimedLines) {
+	auto frame = EmptyFrame();
+	DebugDraw::Line(glm::vec3(0.0f), glm::vec3(1.0f), DebugDraw::red, DebugLayer::Depth, 0.25f);
+	DebugDraw::Sphere(glm::vec3(0.0f), 1.0f, DebugDraw::green, DebugLayer::Depth, 1.0f);
+	DebugDraw::Cross(glm::vec3(0.0f), 1.0f, DebugDraw::blue);
+	const auto depth = static_cast<usize>(DebugLayer::Depth);
+
+	// Timed lines are aged from the frame after they were collected
+	DebugDraw::Collect(frame, 0.1f);
+	HOENGINE_CHECK(frame.vertices[depth].size() == 6 && frame.timed[depth].size() == 2);
+	HOENGINE_CHECK(frame.timedVertices[depth].size() == 2 + 96);
+	DebugDraw::Collect(frame, 0.1f);
+	DebugDraw::Collect(frame, 0.1f);
+	HOENGINE_CHECK(frame.vertices[depth].empty() && frame.timed[depth].size() == 2);
+
+	// The line runs out first, and the sphere moves up in its place
+	DebugDraw::Collect(frame, 0.1f);
+	HOENGINE_CHECK(frame.timed[depth].size() == 1 && frame.timed[depth][0].vertices == 96);
+	HOENGINE_CHECK(frame.timedVertices[depth].size() == 96);
+	for (const auto& vertex : frame.timedVertices[depth]) HOENGINE_CHECK(vertex.color == DebugDraw::green);
+	HOENGINE_CHECK(std::abs(frame.timed[depth][0].remaining - 0.7f) < 1e-5f);
+
+	DebugDraw::Collect(frame, 1.0f);
+	HOENGINE_CHECK(frame.VertexCount(DebugLayer::Depth) == 0 && frame.timed[depth].empty());
+}
+
+HOENGINE_TEST(DebugDrawRendererRestoresDepthState) {
+	Test::FakeGL gl;
+	EmptyFrame();
+	auto before = DepthState::Apply(DepthState{ true, GL_LEQUAL, true });
+	DebugDrawRenderer renderer;
+	for (u32 frame = 0; frame < 2; ++frame) {
+		DebugDraw::Box(AABB{ glm::vec3(-1.0f), glm::vec3(1.0f) }, DebugDraw::red);
+		DebugDraw::Cross(glm::vec3(0.0f), 1.0f, DebugDraw::blue, DebugLayer::Overlay);
+		GLTrace::BeginFrame();
+		renderer.Draw(glm::mat4(1.0f), 0.016f);
+		GLTrace::EndFrame();
+		HOENGINE_CHECK(renderer.stats().lines == 12 + 3 && renderer.stats().draws == 2);
+		// Neither location lookups nor state queries once set up
+		const auto& report = GLTrace::LastReport();
+		if (frame > 0) HOENGINE_CHECK(report.locationLookups == 0 && report.syncPoints == 0);
+		HOENGINE_CHECK((DepthState::Current() == DepthState{ true, GL_LEQUAL, true }));
+	}
+	DepthState::Apply(before);
+}
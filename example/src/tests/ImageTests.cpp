@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "render/Image.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// TGA header followed by `body`.
+	std::vector<std::byte> MakeTGA(u8 type, u16 width, u16 height, u8 bits, u8 descriptor, const std::vector<u8>& body) {
+		std::vector<u8> bytes(18, 0);
+		bytes[2] = type;
+		bytes[12] = static_cast<u8>(width);
+		bytes[13] = static_cast<u8>(width >> 8);
+		bytes[14] = static_cast<u8>(height);
+		bytes[15] = static_cast<u8>(height >> 8);
+		bytes[16] = bits;
+		bytes[17] = descriptor;
+		bytes.insert(bytes.end(), body.begin(), body.end());
+		std::vector<std::byte> result(bytes.size());
+		std::memcpy(result.data(), bytes.data(), bytes.size());
+		return result;
+	}
+
+	u32 PixelAt(const Image& image, u32 level, u32 x, u32 y) {
+		u32 pixel;
+		std::memcpy(&pixel, image.LevelData(level).data() + (y * image.levels[level].width + x) * 4, 4);
+		return pixel;
+	}
+
+	/// Uncompressed image with a full chain of random pixels.
+	Image MakeMipmapped(u32 width, u32 height) {
+		auto image = Image::Uncompressed(width, height, false);
+		std::mt19937 rng(11);
+		for (auto& byte : image.data) byte = static_cast<std::byte>(rng());
+		GenerateMips(image, MipFilter::Kaiser);
+		return image;
+	}
+}
+
+HOENGINE_TEST(ImageDecodesTGA) {
+	// 3x2, BGR, bottom row first
+	auto raw = DecodeTGA(MakeTGA(2, 3, 2, 24, 0, {
+		1, 2, 3, 4, 5, 6, 7, 8, 9,
+		10, 11, 12, 13, 14, 15, 16, 17, 18,
+	}), false);
+	HOENGINE_CHECK(raw && raw->format == TextureFormat::RGBA8 && raw->width() == 3 && raw->height() == 2);
+	HOENGINE_CHECK(raw->levels.size() == 1 && raw->data.size() == 3 * 2 * 4);
+	HOENGINE_CHECK(PixelAt(*raw, 0, 0, 0) == 0xff010203u && PixelAt(*raw, 0, 2, 1) == 0xff101112u);
+
+	// The same pixels run-length encoded with alpha, top row first: a run of two
+	// repeated pixels, then raw packets
+	auto rle = DecodeTGA(MakeTGA(10, 3, 2, 32, 0x20, {
+		0x81, 10, 11, 12, 200,
+		0x00, 16, 17, 18, 201,
+		0x02, 1, 2, 3, 202, 4, 5, 6, 203, 7, 8, 9, 204,
+	}), true);
+	HOENGINE_CHECK(rle && rle->format == TextureFormat::SRGBA8);
+	HOENGINE_CHECK(PixelAt(*rle, 0, 0, 0) == 0xca010203u && PixelAt(*rle, 0, 2, 0) == 0xcc070809u);
+	HOENGINE_CHECK(PixelAt(*rle, 0, 0, 1) == 0xc80a0b0cu && PixelAt(*rle, 0, 1, 1) == 0xc80a0b0cu);
+	HOENGINE_CHECK(PixelAt(*rle, 0, 2, 1) == 0xc9101112u);
+
+	// Grayscale, right to left
+	auto grey = DecodeTGA(MakeTGA(3, 2, 1, 8, 0x10, { 40, 90 }), false);
+	HOENGINE_CHECK(grey && PixelAt(*grey, 0, 0, 0) == 0xff5a5a5au && PixelAt(*grey, 0, 1, 0) == 0xff282828u);
+}
+
+HOENGINE_TEST(ImageRejectsMalformedTGA) {
+	std::vector<u8> pixels(4 * 4 * 3, 0);
+	auto valid = MakeTGA(2, 4, 4, 24, 0, pixels);
+	HOENGINE_CHECK(DecodeTGA(valid, false));
+	// Header cut short
+	HOENGINE_CHECK(!DecodeTGA(std::span(valid).first(17), false));
+	// Color mapped, and unsupported depths
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(1, 4, 4, 8, 0, pixels), false));
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(2, 4, 4, 16, 0, pixels), false));
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(3, 4, 4, 24, 0, pixels), false));
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(2, 0, 4, 24, 0, pixels), false));
+	// Fewer pixels than the size says
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(2, 4, 4, 24, 0, std::vector<u8>(pixels.begin(), pixels.end() - 1)), false));
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(2, 0xffff, 0xffff, 32, 0, pixels), false));
+	// Runs past the last pixel, raw packets cut short, packets missing
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(11, 2, 2, 8, 0, { 0x84, 7 }), false));
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(11, 2, 2, 8, 0, { 0x03, 1, 2, 3 }), false));
+	HOENGINE_CHECK(!DecodeTGA(MakeTGA(11, 2, 2, 8, 0, { 0x81, 7 }), false));
+	HOENGINE_CHECK(DecodeTGA(MakeTGA(11, 2, 2, 8, 0, { 0x81, 7, 0x81, 8 }), false));
+}
+
+HOENGINE_TEST(ImageGeneratesMips) {
+	auto checkLevels = [](const Image& image, u32 width, u32 height) {
+		HOENGINE_CHECK(image.levels.size() == Texture::MipCount(width, height));
+		usize offset = 0;
+		for (u32 level = 0; level < image.levels.size(); ++level) {
+			const auto& info = image.levels[level];
+			HOENGINE_CHECK(info.offset == offset && info.width == std::max(width >> level, 1u) && info.height == std::max(height >> level, 1u));
+			offset += info.size;
+		}
+		HOENGINE_CHECK(offset == image.data.size());
+	};
+	// Every pixel of the mips is `color`, give or take rounding
+	auto checkColor = [](const Image& image, u32 color) {
+		for (u32 level = 1; level < image.levels.size(); ++level) {
+			for (u32 y = 0; y < image.levels[level].height; ++y) {
+				for (u32 x = 0; x < image.levels[level].width; ++x) {
+					auto pixel = PixelAt(image, level, x, y);
+					for (u32 shift = 0; shift < 32; shift += 8) {
+						auto difference = static_cast<i32>((pixel >> shift) & 0xff) - static_cast<i32>((color >> shift) & 0xff);
+						HOENGINE_CHECK(std::abs(difference) <= 1);
+					}
+				}
+			}
+		}
+	};
+
+	for (auto srgb : { false, true }) {
+		// Black and white checkers average to middle grey, in linear space
+		auto image = Image::Uncompressed(64, 16, srgb);
+		auto* pixels = reinterpret_cast<u32*>(image.data.data());
+		for (u32 y = 0; y < 16; ++y) {
+			for (u32 x = 0; x < 64; ++x) pixels[y * 64 + x] = (x + y) % 2 ? 0xffffffffu : 0xff000000u;
+		}
+		auto checkers = image;
+		GenerateMips(checkers, MipFilter::Box);
+		checkLevels(checkers, 64, 16);
+		// The first level is kept as is
+		HOENGINE_CHECK(std::memcmp(checkers.data.data(), image.data.data(), image.data.size()) == 0);
+		checkColor(checkers, srgb ? 0xffbcbcbcu : 0xff808080u);
+
+		// The Kaiser filter's weights add up to one, so flat colors stay flat
+		std::fill(pixels, pixels + 64 * 16, 0x80c08040u);
+		GenerateMips(image, MipFilter::Kaiser);
+		checkLevels(image, 64, 16);
+		checkColor(image, 0x80c08040u);
+	}
+
+	Image compressed;
+	compressed.format = TextureFormat::BC1;
+	compressed.levels.push_back(Image::Level{ 0, 8, 4, 4 });
+	compressed.data.resize(8);
+	HOENGINE_CHECK_THROWS(GenerateMips(compressed, MipFilter::Box));
+}
+
+HOENGINE_TEST(ImageCookedRoundTrips) {
+	auto image = MakeMipmapped(32, 8);
+	auto cooked = CookImage(image);
+	auto read = ReadCookedImage(cooked);
+	HOENGINE_CHECK(read && read->format == image.format && read->droppedLevels == 0);
+	HOENGINE_CHECK(read->data == image.data && read->levels.size() == image.levels.size());
+
+	// Skipped levels are left out, the rest laid out from the start
+	auto reduced = ReadCookedImage(cooked, 2);
+	HOENGINE_CHECK(reduced && reduced->droppedLevels == 2 && reduced->width() == 8 && reduced->height() == 2);
+	HOENGINE_CHECK(reduced->levels.size() == image.levels.size() - 2 && reduced->levels[0].offset == 0);
+	HOENGINE_CHECK(std::equal(reduced->data.begin(), reduced->data.end(), image.data.begin() + static_cast<std::ptrdiff_t>(image.levels[2].offset)));
+	// Matches dropping them after the fact
+	auto dropped = image;
+	dropped.DropLevels(2);
+	HOENGINE_CHECK(reduced->data == dropped.data && reduced->droppedLevels == dropped.droppedLevels);
+	// The coarsest level is always kept
+	auto coarsest = ReadCookedImage(cooked, 100);
+	HOENGINE_CHECK(coarsest && coarsest->levels.size() == 1 && coarsest->width() == 1 && coarsest->droppedLevels == 5);
+
+	HOENGINE_CHECK(!ReadCookedImage(std::span(cooked).first(cooked.size() - 1)));
+	HOENGINE_CHECK(!ReadCookedImage(std::span(cooked).first(20)));
+	auto badMagic = cooked;
+	badMagic[0] = std::byte{ 'X' };
+	HOENGINE_CHECK(!ReadCookedImage(badMagic));
+	// Level sizes must match the size in the header
+	auto badSize = cooked;
+	badSize[16] = std::byte{ 64 };
+	HOENGINE_CHECK(!ReadCookedImage(badSize));
+}
@@ -0,0 +1,127 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "MeshBVH.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Bumpy height field of `2 * n * n` triangles over a 10 x 10 square.
+	MeshComponent MakeHeightField(u32 n) {
+		MeshComponent mesh;
+		for (u32 z = 0; z <= n; ++z) {
+			for (u32 x = 0; x <= n; ++x) {
+				auto fx = static_cast<f32>(x);
+				auto fz = static_cast<f32>(z);
+				SimpleVertex vertex{};
+				vertex.pos = glm::vec3(fx, std::sin(fx * 0.3f) * 2.0f + std::cos(fz * 0.2f) * 3.0f, fz) * (10.0f / static_cast<f32>(n));
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (u32 z = 0; z < n; ++z) {
+			for (u32 x = 0; x < n; ++x) {
+				GLuint a = z * (n + 1) + x;
+				GLuint c = a + n + 1;
+				mesh.indices.insert(mesh.indices.end(), { a, c, a + 1, a + 1, c, c + 1 });
+			}
+		}
+		return mesh;
+	}
+
+	/// Closest hit by testing every triangle.
+	RayHit BruteForceHit(const MeshComponent& mesh, const Ray& ray) {
+		RayHit hit;
+		for (u32 i = 0; i < mesh.indices.size() / 3; ++i) {
+			auto v0 = mesh.vertices[mesh.indices[3 * i]].pos;
+			auto e1 = mesh.vertices[mesh.indices[3 * i + 1]].pos - v0;
+			auto e2 = mesh.vertices[mesh.indices[3 * i + 2]].pos - v0;
+			auto p = glm::cross(ray.dir, e2);
+			auto det = glm::dot(e1, p);
+			if (det == 0.0f) continue;
+			auto invDet = 1.0f / det;
+			auto s = ray.origin - v0;
+			auto u = glm::dot(s, p) * invDet;
+			if (u < 0.0f || u > 1.0f) continue;
+			auto q = glm::cross(s, e1);
+			auto v = glm::dot(ray.dir, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f) continue;
+			auto t = glm::dot(e2, q) * invDet;
+			if (t > ray.tMin && t < std::min(ray.tMax, hit.t)) {
+				hit.t = t;
+				hit.triangle = i;
+			}
+		}
+		return hit;
+	}
+}
+
+HOENGINE_TEST(MeshBVHMatchesBruteForce) {
+	auto mesh = MakeHeightField(20);
+	ThreadPool pool(2);
+	MeshBVH bvh;
+	bvh.Build(pool, mesh);
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<f32> unit(0.0f, 1.0f);
+	std::vector<Ray> rays;
+	for (u32 i = 0; i < 1000; ++i) {
+		Ray ray;
+		ray.origin = glm::vec3(unit(rng) * 14.0f - 2.0f, 8.0f, unit(rng) * 14.0f - 2.0f);
+		ray.dir = glm::normalize(glm::vec3(unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f));
+		if (i % 7 == 0) ray.tMax = unit(rng) * 8.0f;
+		rays.push_back(ray);
+	}
+	std::vector<RayHit> packetHits(rays.size());
+	bvh.Cast(pool, rays, packetHits);
+
+	u32 hits = 0;
+	for (usize i = 0; i < rays.size(); ++i) {
+		auto expected = BruteForceHit(mesh, rays[i]);
+		RayHit hit;
+		bvh.Intersect(rays[i], hit);
+		HOENGINE_CHECK(hit.IsHit() == expected.IsHit());
+		HOENGINE_CHECK(packetHits[i].IsHit() == expected.IsHit());
+		HOENGINE_CHECK(bvh.Occluded(rays[i]) == expected.IsHit());
+		if (!expected.IsHit()) continue;
+		HOENGINE_CHECK(std::abs(hit.t - expected.t) < 1e-4f);
+		HOENGINE_CHECK(std::abs(packetHits[i].t - expected.t) < 1e-4f);
+		++hits;
+	}
+	HOENGINE_CHECK(hits > 0 && hits < rays.size());
+}
+
+HOENGINE_BENCH(MeshBVHRays) {
+	ThreadPool pool;
+	auto mesh = MakeHeightField(700);
+	MeshBVH bvh;
+	bvh.Build(pool, mesh);
+	Test::Report("triangles", static_cast<f64>(bvh.stats().triangles), "");
+	Test::Report("build", bvh.stats().buildTime, "ms");
+
+	// Coherent 512 x 512 camera rays, ordered in 2 x 2 quads so packets share a pixel block
+	constexpr u32 size = 512;
+	auto viewProj = glm::perspective(1.2f, 1.0f, 0.1f, 100.0f)
+		* glm::lookAt(glm::vec3(5.0f, 12.0f, -5.0f), glm::vec3(5.0f, 0.0f, 5.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	std::vector<Ray> rays;
+	for (u32 y = 0; y < size; y += 2) {
+		for (u32 x = 0; x < size; x += 2) {
+			for (u32 k = 0; k < 4; ++k) {
+				auto ndc = (glm::vec2(x + (k & 1), y + (k >> 1)) + 0.5f) / static_cast<f32>(size) * 2.0f - 1.0f;
+				rays.push_back(Ray::FromNdc(viewProj, ndc));
+			}
+		}
+	}
+	std::vector<RayHit> hits(rays.size());
+	auto packetTime = Test::MeasureMilliseconds([&] { bvh.Cast(pool, rays, hits); });
+	auto singleTime = Test::MeasureMilliseconds([&] {
+		for (usize i = 0; i < rays.size(); ++i) {
+			hits[i] = RayHit{};
+			bvh.Intersect(rays[i], hits[i]);
+		}
+	}, 2);
+	auto rayCount = static_cast<f64>(rays.size());
+	Test::Report("packets, thread pool", rayCount / packetTime / 1000.0, "Mrays/s");
+	Test::Report("single rays, one thread", rayCount / singleTime / 1000.0, "Mrays/s");
+}
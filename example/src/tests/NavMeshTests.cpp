@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "nav/NavMesh.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Box mesh from `min` to `max`, in world space.
+	EntityID AddBox(EntitiesStorage& storage, const glm::vec3& min, const glm::vec3& max) {
+		auto mesh = MakeComponent<MeshComponent>();
+		for (u32 corner = 0; corner < 8; ++corner) {
+			SimpleVertex vertex{};
+			vertex.pos = glm::vec3(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z);
+			mesh->vertices.push_back(vertex);
+		}
+		const GLuint faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+		for (const auto& face : faces) mesh->indices.insert(mesh->indices.end(), { face[0], face[1], face[2], face[0], face[2], face[3] });
+		mesh->RecomputeBounds();
+		auto transform = MakeComponent<TransformComponent>();
+		transform->rot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		transform->scale = glm::vec3(1.0f);
+		auto entity = Entity::New();
+		entity.AddComponent(std::move(mesh));
+		entity.AddComponent(std::move(transform));
+		return storage.Add(std::move(entity));
+	}
+}
+
+HOENGINE_TEST(NavMeshFindsPathsAroundObstacles) {
+	auto storage = EntitiesStorage::New();
+	AddBox(storage, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(40.0f, 0.0f, 40.0f));
+	auto wall = AddBox(storage, glm::vec3(18.0f, 0.0f, 0.0f), glm::vec3(20.0f, 3.0f, 30.0f));
+	// Too tall to climb, its top is unreachable
+	AddBox(storage, glm::vec3(2.0f, 0.0f, 34.0f), glm::vec3(6.0f, 5.0f, 39.0f));
+
+	ThreadPool pool(2);
+	NavMesh::Config config;
+	config.tileSize = 32;
+	NavMesh nav(config);
+	nav.Build(pool, storage);
+	HOENGINE_CHECK(nav.stats().polys > 0);
+
+	NavQuery query(4096);
+	PathResult result;
+	nav.FindPath(query, PathRequest{ glm::vec3(5.0f, 0.0f, 5.0f), glm::vec3(35.0f, 0.0f, 5.0f) }, result);
+	HOENGINE_CHECK(result.status == PathStatus::Found);
+	// Goes around the end of the wall
+	auto farthest = 0.0f;
+	for (const auto& point : result.points) farthest = std::max(farthest, point.z);
+	HOENGINE_CHECK(farthest >= 30.0f);
+
+	nav.FindPath(query, PathRequest{ glm::vec3(5.0f, 0.0f, 5.0f), glm::vec3(4.0f, 5.0f, 36.0f) }, result);
+	HOENGINE_CHECK(result.status != PathStatus::Found);
+
+	// Extending the wall across the floor cuts the path
+	auto* mesh = storage.Get(wall)->GetComponent<MeshComponent>();
+	for (auto& vertex : mesh->vertices) {
+		if (vertex.pos.z > 29.0f) vertex.pos.z = 40.0f;
+	}
+	mesh->RecomputeBounds();
+	nav.Rebuild(pool, storage, AABB{ glm::vec3(18.0f, 0.0f, 0.0f), glm::vec3(20.0f, 3.0f, 40.0f) });
+	HOENGINE_CHECK(nav.stats().tilesBuilt < nav.stats().tiles);
+	nav.FindPath(query, PathRequest{ glm::vec3(5.0f, 0.0f, 5.0f), glm::vec3(35.0f, 0.0f, 5.0f) }, result);
+	HOENGINE_CHECK(result.status != PathStatus::Found);
+}
+
+HOENGINE_TEST(NavMeshFindPathsSharesQueriesAcrossJobs) {
+	auto storage = EntitiesStorage::New();
+	AddBox(storage, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(64.0f, 0.0f, 64.0f));
+	for (u32 i = 0; i < 4; ++i) {
+		auto corner = glm::vec3(static_cast<f32>(i) * 14.0f + 6.0f, 0.0f, 10.0f);
+		AddBox(storage, corner, corner + glm::vec3(3.0f, 4.0f, 40.0f));
+	}
+	ThreadPool pool(3);
+	NavMesh::Config config;
+	config.queryGrain = 2;
+	NavMesh nav(config);
+	nav.Build(pool, storage);
+
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<f32> position(1.0f, 63.0f);
+	std::vector<PathRequest> requests;
+	for (u32 i = 0; i < 300; ++i) {
+		requests.push_back(PathRequest{ glm::vec3(position(rng), 0.0f, position(rng)), glm::vec3(position(rng), 0.0f, position(rng)) });
+	}
+	std::vector<PathResult> results(requests.size());
+	nav.FindPaths(pool, requests, results);
+	// 150 jobs, but never more than one per thread at a time
+	HOENGINE_CHECK(nav.queryCount() == pool.threadCount() + 1);
+
+	// Jobs sharing a query would corrupt each other's searches
+	NavQuery query(config.maxSearchNodes);
+	PathResult expected;
+	for (usize i = 0; i < requests.size(); ++i) {
+		nav.FindPath(query, requests[i], expected);
+		HOENGINE_CHECK(results[i].status == expected.status && results[i].nodes == expected.nodes);
+		HOENGINE_CHECK(results[i].points == expected.points);
+	}
+}
+
+HOENGINE_BENCH(NavMeshQueries) {
+	// 256 x 256 floor with a grid of pillars
+	auto storage = EntitiesStorage::New();
+	AddBox(storage, glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(256.0f, 0.0f, 256.0f));
+	for (u32 z = 0; z < 12; ++z) {
+		for (u32 x = 0; x < 12; ++x) {
+			auto corner = glm::vec3(static_cast<f32>(x) * 21.0f + 10.0f, 0.0f, static_cast<f32>(z) * 21.0f + 10.0f);
+			AddBox(storage, corner, corner + glm::vec3(6.0f, 4.0f, 6.0f));
+		}
+	}
+	ThreadPool single(0);
+	ThreadPool pool;
+	NavMesh nav;
+	nav.Build(pool, storage);
+	Test::Report("tiles", static_cast<f64>(nav.stats().tiles), "");
+	Test::Report("polygons", static_cast<f64>(nav.stats().polys), "");
+	Test::Report("build", nav.stats().buildTime, "ms");
+
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<f32> position(1.0f, 255.0f);
+	std::vector<PathRequest> requests;
+	for (u32 i = 0; i < 2000; ++i) {
+		requests.push_back(PathRequest{ glm::vec3(position(rng), 0.0f, position(rng)), glm::vec3(position(rng), 0.0f, position(rng)) });
+	}
+	std::vector<PathResult> results(requests.size());
+	for (auto* threads : { &single, &pool }) {
+		auto best = 0.0;
+		for (u32 run = 0; run < 3; ++run) {
+			nav.FindPaths(*threads, requests, results);
+			best = std::max(best, nav.stats().QueriesPerSecond());
+		}
+		Test::Report(threads == &single ? "queries, single thread" : "queries, thread pool", best, "queries/s");
+	}
+	usize found = 0;
+	for (const auto& result : results) found += result.status == PathStatus::Found;
+	Test::Report("paths found", static_cast<f64>(found), "");
+}
@@ -0,0 +1,48 @@
+#include <glm/glm.hpp>
+#include "render/OcclusionCulling.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Screen aligned quad at window depth 0.5 for an identity view projection.
+	MeshComponent MakeQuad(f32 minX, f32 maxX, f32 minY, f32 maxY) {
+		MeshComponent quad;
+		SimpleVertex vertex{};
+		for (auto pos : { glm::vec3(minX, minY, 0.0f), glm::vec3(maxX, minY, 0.0f), glm::vec3(maxX, maxY, 0.0f), glm::vec3(minX, maxY, 0.0f) }) {
+			vertex.pos = pos;
+			quad.vertices.push_back(vertex);
+		}
+		quad.indices = { 0, 1, 2, 0, 2, 3 };
+		quad.RecomputeBounds();
+		return quad;
+	}
+}
+
+HOENGINE_TEST(OcclusionBufferOccludesBoxesBehind) {
+	OcclusionBuffer buffer(128, 64);
+	buffer.AddOccluder(MakeQuad(-0.5f, 0.5f, -0.5f, 0.5f), glm::mat4(1.0f));
+	buffer.Rasterize();
+	HOENGINE_CHECK(buffer.DepthAt(64, 32) == 0.5f && buffer.DepthAt(0, 0) == 1.0f);
+
+	auto box = [](f32 minZ) { return AABB{ glm::vec3(-0.25f, -0.25f, minZ), glm::vec3(0.25f, 0.25f, 0.9f) }; };
+	HOENGINE_CHECK(!buffer.IsVisible(box(0.5f), glm::mat4(1.0f)));
+	HOENGINE_CHECK(buffer.IsVisible(box(-0.5f), glm::mat4(1.0f)));
+	HOENGINE_CHECK(buffer.IsVisible(AABB{ glm::vec3(-0.9f, -0.25f, 0.5f), glm::vec3(0.9f, 0.25f, 0.9f) }, glm::mat4(1.0f)));
+}
+
+HOENGINE_TEST(OcclusionBufferOddPyramidLevelsStayConservative) {
+	// 448 pixels wide, level 6 is 7 texels of 64 pixels
+	OcclusionBuffer buffer(448, 32);
+	buffer.backfaceCulling = false;
+	// Covers the left 384 pixels, the odd texel of level 6 stays at the far plane
+	buffer.AddOccluder(MakeQuad(-1.0f, 5.0f / 7.0f, -1.0f, 1.0f), glm::mat4(1.0f));
+	buffer.Rasterize();
+	HOENGINE_CHECK(buffer.DepthAt(383, 16) == 0.5f && buffer.DepthAt(384, 16) == 1.0f);
+
+	// Wide enough to be tested against a coarse level including the odd column
+	auto box = AABB{ glm::vec3(-1.0f, -1.0f, 0.5f), glm::vec3(1.0f, 1.0f, 0.9f) };
+	HOENGINE_CHECK(buffer.IsVisible(box, glm::mat4(1.0f)));
+	auto hidden = AABB{ glm::vec3(-1.0f, -1.0f, 0.5f), glm::vec3(0.7f, 1.0f, 0.9f) };
+	HOENGINE_CHECK(!buffer.IsVisible(hidden, glm::mat4(1.0f)));
+}
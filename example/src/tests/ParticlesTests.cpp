@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "render/Particles.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	ParticleEmitterComponent* AddEmitter(EntitiesStorage& world, glm::vec3 pos) {
+		auto entity = Entity::New();
+		auto transform = MakeComponent<TransformComponent>();
+		transform->pos = pos;
+		transform->rot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		entity.AddComponent(std::move(transform));
+		auto emitter = MakeComponent<ParticleEmitterComponent>();
+		auto settings = emitter.get();
+		entity.AddComponent(std::move(emitter));
+		world.Add(std::move(entity));
+		return settings;
+	}
+
+	/// Particles moving along x at one unit per second, shrinking to nothing at death.
+	void MakeLinear(ParticleEmitterComponent& settings, f32 lifetimeMin, f32 lifetimeMax) {
+		settings.lifetimeMin = lifetimeMin;
+		settings.lifetimeMax = lifetimeMax;
+		settings.velocity = glm::vec3(1.0f, 0.0f, 0.0f);
+		settings.velocityJitter = glm::vec3(0.0f);
+		settings.acceleration = glm::vec3(0.0f);
+		settings.sizeStart = 1.0f;
+		settings.sizeEnd = 0.0f;
+	}
+}
+
+HOENGINE_TEST(ParticlesCompactDeadParticles) {
+	auto world = EntitiesStorage::New();
+	auto origin = glm::vec3(10.0f, 0.0f, 0.0f);
+	auto& settings = *AddEmitter(world, origin);
+	MakeLinear(settings, 0.45f, 0.45f);
+	settings.rate = 1000.0f;
+
+	// Small jobs, so that dead particles are collected by many of them
+	ParticleSystem::Config config;
+	config.particleGrain = 16;
+	ParticleSystem particles(config);
+	ThreadPool pool(3);
+	particles.Gather(world);
+	HOENGINE_CHECK(particles.emitterCount() == 1);
+
+	for (u32 step = 0; step < 12; ++step) {
+		particles.Update(pool, 0.1f);
+		const auto& stats = particles.stats();
+		HOENGINE_CHECK(stats.spawned == 100);
+		// Particles spawned 5 steps ago, aged 0.5s, are the first to die
+		HOENGINE_CHECK(stats.died == (step < 5 ? 0 : 100));
+		HOENGINE_CHECK(particles.particleCount(0) == std::min(step + 1, 5u) * 100);
+		HOENGINE_CHECK(stats.particles == particles.particleCount(0));
+	}
+
+	// Every particle left is alive, and its state was moved as a whole: the
+	// distance travelled matches the age read back through the size
+	std::vector<ParticleInstance> instances(particles.particleCount(0));
+	particles.WriteInstances(pool, 0, instances.data());
+	for (const auto& instance : instances) {
+		HOENGINE_CHECK(instance.size > 0.0f);
+		auto age = (1.0f - instance.size) * 0.45f;
+		HOENGINE_CHECK(std::abs(instance.pos.x - origin.x - age) < 1e-4f);
+		HOENGINE_CHECK(instance.pos.y == origin.y && instance.pos.z == origin.z);
+	}
+}
+
+HOENGINE_TEST(ParticlesCountLiveParticles) {
+	auto world = EntitiesStorage::New();
+	std::vector<ParticleEmitterComponent*> settings;
+	for (u32 i = 0; i < 3; ++i) {
+		settings.push_back(AddEmitter(world, glm::vec3(static_cast<f32>(i), 0.0f, 0.0f)));
+		MakeLinear(*settings.back(), 0.05f, 0.6f);
+		settings.back()->rate = 6000.0f;
+		settings.back()->maxParticles = 1000 + i * 333;
+	}
+
+	ParticleSystem::Config config;
+	config.particleGrain = 64;
+	ParticleSystem particles(config);
+	ThreadPool pool(3);
+	particles.Gather(world);
+	usize spawned = 0, died = 0;
+	for (u32 step = 0; step < 60; ++step) {
+		particles.Update(pool, 1.0f / 60.0f);
+		spawned += particles.stats().spawned;
+		died += particles.stats().died;
+
+		usize live = 0;
+		for (usize e = 0; e < particles.emitterCount(); ++e) {
+			HOENGINE_CHECK(particles.particleCount(e) <= settings[e]->maxParticles);
+			live += particles.particleCount(e);
+		}
+		HOENGINE_CHECK(live == spawned - died && live == particles.stats().particles);
+	}
+	HOENGINE_CHECK(died > 0);
+	// Caps are reached: particles live 0.3s on average, 1900 are spawned in that time
+	HOENGINE_CHECK(particles.particleCount(0) == 1000);
+
+	for (usize e = 0; e < particles.emitterCount(); ++e) {
+		std::vector<ParticleInstance> instances(particles.particleCount(e));
+		particles.WriteInstances(pool, e, instances.data());
+		for (const auto& instance : instances) HOENGINE_CHECK(instance.size > 0.0f && instance.pos.x - static_cast<f32>(e) < 0.6f);
+	}
+
+	// Removing an emitter forgets its particles
+	world.Remove(world.IDAt(0));
+	particles.Gather(world);
+	particles.Update(pool, 1.0f / 60.0f);
+	HOENGINE_CHECK(particles.emitterCount() == 2);
+}
+
+HOENGINE_TEST(ParticlesDrawWithoutLookups) {
+	Test::FakeGL gl;
+	auto world = EntitiesStorage::New();
+	AddEmitter(world, glm::vec3(0.0f));
+	AddEmitter(world, glm::vec3(1.0f))->gpuSimulated = true;
+
+	ParticleSystem particles;
+	ThreadPool pool(1);
+	StreamingBuffer buffer(GL_ARRAY_BUFFER, 1 << 20);
+	auto view = glm::lookAt(glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	auto proj = glm::perspective(1.0f, 1.5f, 0.1f, 100.0f);
+	for (u32 frame = 0; frame < 3; ++frame) {
+		GLTrace::BeginFrame();
+		particles.Gather(world);
+		particles.Update(pool, 0.1f);
+		buffer.BeginFrame();
+		particles.Upload(pool, buffer);
+		buffer.Commit();
+		particles.Draw(buffer, view, proj);
+		GLTrace::EndFrame();
+		// Uniform locations are resolved with the programs, on the first frame only
+		if (frame > 0) HOENGINE_CHECK(GLTrace::LastReport().locationLookups == 0);
+	}
+}
+
+HOENGINE_BENCH(ParticlesUpdate1M) {
+	auto world = EntitiesStorage::New();
+	for (u32 i = 0; i < 4; ++i) {
+		auto& settings = *AddEmitter(world, glm::vec3(static_cast<f32>(i) * 10.0f, 0.0f, 0.0f));
+		settings.maxParticles = 250000;
+		settings.rate = 1e6f;
+		settings.lifetimeMin = 5.0f;
+		settings.lifetimeMax = 10.0f;
+		settings.drag = 0.1f;
+	}
+	ParticleSystem particles;
+	ThreadPool pool;
+	particles.Gather(world);
+	// Fill every emitter up to its cap
+	for (u32 i = 0; i < 30; ++i) particles.Update(pool, 1.0f / 60.0f);
+	usize total = 0;
+	for (usize e = 0; e < particles.emitterCount(); ++e) total += particles.particleCount(e);
+	Test::Report("particles", static_cast<f64>(total), "");
+
+	std::vector<ParticleInstance> instances(total);
+	auto update = Test::MeasureMilliseconds([&] { particles.Update(pool, 1.0f / 60.0f); });
+	auto write = Test::MeasureMilliseconds([&] {
+		usize offset = 0;
+		for (usize e = 0; e < particles.emitterCount(); ++e) {
+			particles.WriteInstances(pool, e, instances.data() + offset);
+			offset += particles.particleCount(e);
+		}
+	});
+	Test::Report("Update", update, "ms");
+	Test::Report("WriteInstances", write, "ms");
+	Test::Report("Update + WriteInstances", static_cast<f64>(total) / (update + write) / 1000.0, "Mparticles/s");
+}
@@ -0,0 +1,92 @@
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "phys/Physics.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Spheres raining on a ground box, a stack of boxes and a hanging chain.
+	std::unique_ptr<PhysicsSystem> MakeScene(u32 spheres) {
+		auto physics = std::make_unique<PhysicsSystem>();
+		BodyDesc ground;
+		ground.shape = ShapeType::Box;
+		ground.size = glm::vec3(200.0f, 1.0f, 200.0f);
+		ground.pos = glm::vec3(0.0f, -1.0f, 0.0f);
+		ground.mass = 0.0f;
+		physics->AddBody(ground);
+
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<f32> horizontal(-60.0f, 60.0f);
+		std::uniform_real_distribution<f32> height(1.0f, 30.0f);
+		for (u32 i = 0; i < spheres; ++i) {
+			BodyDesc sphere;
+			sphere.size = glm::vec3(0.5f);
+			sphere.pos = glm::vec3(horizontal(rng), height(rng), horizontal(rng));
+			physics->AddBody(sphere);
+		}
+		for (u32 i = 0; i < 5; ++i) {
+			BodyDesc box;
+			box.shape = ShapeType::Box;
+			box.size = glm::vec3(0.5f);
+			box.pos = glm::vec3(80.0f, 0.5f + static_cast<f32>(i), 0.0f);
+			physics->AddBody(box);
+		}
+		BodyDesc anchor;
+		anchor.mass = 0.0f;
+		anchor.pos = glm::vec3(-80.0f, 20.0f, 0.0f);
+		auto previous = physics->AddBody(anchor);
+		for (u32 i = 1; i <= 5; ++i) {
+			BodyDesc link;
+			link.size = glm::vec3(0.3f);
+			link.pos = glm::vec3(-80.0f + static_cast<f32>(i), 20.0f, 0.0f);
+			auto body = physics->AddBody(link);
+			physics->AddDistanceJoint(previous, body, glm::vec3(0.0f), glm::vec3(0.0f));
+			previous = body;
+		}
+		return physics;
+	}
+}
+
+HOENGINE_TEST(PhysicsIsDeterministicAcrossThreadCounts) {
+	auto reference = MakeScene(500);
+	ThreadPool single(0);
+	for (u32 step = 0; step < 120; ++step) reference->Step(single, 1.0f / 60.0f);
+	HOENGINE_CHECK(reference->stats().contacts > 0);
+
+	for (usize threads : { usize{ 1 }, usize{ 3 } }) {
+		auto physics = MakeScene(500);
+		ThreadPool pool(threads);
+		for (u32 step = 0; step < 120; ++step) physics->Step(pool, 1.0f / 60.0f);
+		// Bit for bit, not just close
+		for (u32 body = 0; body < reference->stats().bodies; ++body) {
+			auto expectedPos = reference->position(body);
+			auto actualPos = physics->position(body);
+			auto expectedRot = reference->orientation(body);
+			auto actualRot = physics->orientation(body);
+			HOENGINE_CHECK(std::memcmp(&expectedPos, &actualPos, sizeof(expectedPos)) == 0);
+			HOENGINE_CHECK(std::memcmp(&expectedRot, &actualRot, sizeof(expectedRot)) == 0);
+		}
+	}
+}
+
+HOENGINE_BENCH(PhysicsStep) {
+	ThreadPool single(0);
+	ThreadPool pool;
+	for (auto* threads : { &single, &pool }) {
+		auto physics = MakeScene(2000);
+		constexpr u32 steps = 300;
+		f64 time = 0;
+		usize bodySteps = 0;
+		for (u32 step = 0; step < steps; ++step) {
+			physics->Step(*threads, 1.0f / 60.0f);
+			time += physics->stats().stepTime;
+			bodySteps += physics->stats().awakeBodies;
+		}
+		auto label = threads == &single ? std::string("single thread") : std::to_string(pool.threadCount()) + " worker threads";
+		Test::Report((label + ", step").c_str(), time / steps, "ms");
+		Test::Report((label + ", awake bodies per ms").c_str(), static_cast<f64>(bodySteps) / time, "bodies/ms");
+	}
+}
@@ -0,0 +1,138 @@
+#include <vector>
+#include "RangeAllocator.hpp"
+#include "render/MeshArena.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+HOENGINE_TEST(RangeAllocatorAllocatesInOrder) {
+	RangeAllocator alloc(100);
+	auto a = alloc.Allocate(10);
+	auto b = alloc.Allocate(30);
+	HOENGINE_CHECK(a && b);
+	HOENGINE_CHECK(a->offset == 0 && a->size == 10);
+	HOENGINE_CHECK(b->offset == 10 && b->size == 30);
+	HOENGINE_CHECK(alloc.OffsetOf(b->handle) == 10);
+
+	auto stats = alloc.GetStats();
+	HOENGINE_CHECK(stats.usedSize == 40 && stats.freeSize == 60);
+	HOENGINE_CHECK(stats.allocationCount == 2 && stats.freeBlockCount == 1);
+	HOENGINE_CHECK(!alloc.Allocate(61));
+}
+
+HOENGINE_TEST(RangeAllocatorCoalescesFreedNeighbours) {
+	RangeAllocator alloc(64);
+	auto a = alloc.Allocate(16);
+	auto b = alloc.Allocate(16);
+	auto c = alloc.Allocate(16);
+	auto d = alloc.Allocate(16);
+	HOENGINE_CHECK(a && b && c && d);
+
+	alloc.Free(a->handle);
+	alloc.Free(c->handle);
+	HOENGINE_CHECK(alloc.GetStats().freeBlockCount == 2);
+	HOENGINE_CHECK(alloc.GetStats().Fragmentation() > 0.0f);
+	// Joins both free neighbours into one block
+	alloc.Free(b->handle);
+	auto stats = alloc.GetStats();
+	HOENGINE_CHECK(stats.freeBlockCount == 1 && stats.largestFreeBlock == 48);
+	HOENGINE_CHECK(stats.Fragmentation() == 0.0f);
+
+	auto e = alloc.Allocate(48);
+	HOENGINE_CHECK(e && e->offset == 0);
+	alloc.Free(d->handle);
+	alloc.Free(e->handle);
+	HOENGINE_CHECK(alloc.GetStats().freeSize == 64 && alloc.GetStats().freeBlockCount == 1);
+}
+
+HOENGINE_TEST(RangeAllocatorGrows) {
+	RangeAllocator alloc(32);
+	auto a = alloc.Allocate(24);
+	HOENGINE_CHECK(a);
+	HOENGINE_CHECK(!alloc.Allocate(16));
+
+	// The free tail is extended in place
+	alloc.Grow(64);
+	HOENGINE_CHECK(alloc.capacity() == 64);
+	HOENGINE_CHECK(alloc.GetStats().freeBlockCount == 1);
+	auto b = alloc.Allocate(40);
+	HOENGINE_CHECK(b && b->offset == 24);
+
+	// A used tail gets a new free block after it
+	alloc.Grow(80);
+	HOENGINE_CHECK(alloc.GetStats().freeSize == 16);
+	HOENGINE_CHECK(alloc.Allocate(16));
+}
+
+HOENGINE_TEST(RangeAllocatorDefragments) {
+	RangeAllocator alloc(100);
+	std::vector<RangeAllocator::Handle> handles;
+	for (u32 i = 0; i < 10; ++i) handles.push_back(alloc.Allocate(10)->handle);
+	for (u32 i = 0; i < 10; i += 2) alloc.Free(handles[i]);
+	HOENGINE_CHECK(alloc.GetStats().freeBlockCount == 5);
+
+	auto moves = alloc.Defragment();
+	HOENGINE_CHECK(moves.size() == 5);
+	for (usize i = 0; i < moves.size(); ++i) {
+		HOENGINE_CHECK(moves[i].to == i * 10 && moves[i].size == 10);
+		HOENGINE_CHECK(alloc.OffsetOf(moves[i].handle) == moves[i].to);
+	}
+	auto stats = alloc.GetStats();
+	HOENGINE_CHECK(stats.freeBlockCount == 1 && stats.largestFreeBlock == 50);
+	HOENGINE_CHECK(alloc.Allocate(50));
+}
+
+HOENGINE_TEST(RangeAllocatorRejectsZeroSize) {
+	RangeAllocator alloc(16);
+	HOENGINE_CHECK(!alloc.Allocate(0));
+	HOENGINE_CHECK(alloc.GetStats().freeSize == 16);
+}
+
+HOENGINE_TEST(RangeAllocatorDetectsDoubleFree) {
+#ifdef NDEBUG
+	RangeAllocator alloc(32);
+	auto a = alloc.Allocate(8);
+	auto b = alloc.Allocate(8);
+	alloc.Free(a->handle);
+	// `b` merges into the free block before it, its node is released
+	alloc.Free(b->handle);
+	HOENGINE_CHECK_THROWS(alloc.Free(b->handle));
+	HOENGINE_CHECK_THROWS(alloc.Free(a->handle));
+	HOENGINE_CHECK_THROWS(alloc.Free(1000));
+	auto stats = alloc.GetStats();
+	HOENGINE_CHECK(stats.freeBlockCount == 1 && stats.freeSize == 32);
+#else
+	HOENGINE_SKIP("double frees assert in debug builds");
+#endif
+}
+
+HOENGINE_TEST(MeshArenaEmptyMeshes) {
+	Test::FakeGL gl;
+	auto arena = MeshArena::ForSimpleVertex(4, 6);
+	auto empty = arena.Add(nullptr, 0, nullptr, 0);
+	auto range = arena.Range(empty);
+	HOENGINE_CHECK(range.vertexCount == 0 && range.indexCount == 0);
+	HOENGINE_CHECK(arena.GetStats().grows == 0);
+
+	std::vector<SimpleVertex> vertices(3);
+	auto pointsOnly = arena.Add(vertices.data(), 3, nullptr, 0);
+	HOENGINE_CHECK(arena.Range(pointsOnly).vertexCount == 3 && arena.Range(pointsOnly).indexCount == 0);
+	HOENGINE_CHECK(arena.DrawCommand(empty).count == 0);
+
+	arena.Remove(empty);
+	arena.Remove(pointsOnly);
+	auto stats = arena.GetStats();
+	HOENGINE_CHECK(stats.meshCount == 0 && stats.vertices.usedSize == 0 && stats.indices.usedSize == 0);
+}
+
+HOENGINE_TEST(MeshArenaGrowsBuffers) {
+	Test::FakeGL gl;
+	auto arena = MeshArena::ForSimpleVertex(4, 6);
+	std::vector<SimpleVertex> vertices(10);
+	std::vector<GLuint> indices(12, 0);
+	auto mesh = arena.Add(vertices.data(), 10, indices.data(), 12);
+	auto stats = arena.GetStats();
+	HOENGINE_CHECK(stats.grows == 2);
+	HOENGINE_CHECK(stats.vertices.capacity >= 10 && stats.indices.capacity >= 12);
+	HOENGINE_CHECK(arena.Range(mesh).vertexCount == 10 && arena.Range(mesh).indexCount == 12);
+}
@@ -0,0 +1,162 @@
+#include <string>
+#include <vector>
+#include "render/RenderGraph.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	RenderTargetDesc Desc(TextureFormat format, f32 scale = 1.0f) {
+		RenderTargetDesc desc;
+		desc.format = format;
+		desc.scale = scale;
+		return desc;
+	}
+
+	/// Deferred frame with bloom, plus a debug view nothing reads.
+	struct DeferredGraph {
+		RenderGraph graph;
+		RenderResourceID albedo, normal, depth, hdr, bloomA, bloomB, ldr, debug;
+		std::vector<std::string> executed;
+
+		DeferredGraph() {
+			albedo = graph.CreateTarget("Albedo", Desc(TextureFormat::RGBA8));
+			normal = graph.CreateTarget("Normal", Desc(TextureFormat::RGBA16F));
+			depth = graph.CreateTarget("Depth", Desc(TextureFormat::Depth24Stencil8));
+			hdr = graph.CreateTarget("HDR", Desc(TextureFormat::RGBA16F));
+			bloomA = graph.CreateTarget("BloomA", Desc(TextureFormat::RGBA16F, 0.5f));
+			bloomB = graph.CreateTarget("BloomB", Desc(TextureFormat::RGBA16F, 0.5f));
+			ldr = graph.CreateTarget("LDR", Desc(TextureFormat::RGBA8));
+			debug = graph.CreateTarget("Debug", Desc(TextureFormat::RGBA8));
+
+			auto pass = Pass("GBuffer");
+			graph.Write(pass, albedo);
+			graph.Write(pass, normal);
+			graph.Write(pass, depth);
+			pass = Pass("Debug");
+			graph.Read(pass, depth);
+			graph.Write(pass, debug);
+			pass = Pass("Lighting");
+			graph.Read(pass, albedo);
+			graph.Read(pass, normal);
+			graph.Read(pass, depth);
+			graph.Write(pass, hdr);
+			pass = Pass("BloomDown");
+			graph.Read(pass, hdr);
+			graph.Write(pass, bloomA);
+			pass = Pass("BloomBlur");
+			graph.Read(pass, bloomA);
+			graph.Write(pass, bloomB);
+			pass = Pass("Tonemap");
+			graph.Read(pass, hdr);
+			graph.Read(pass, bloomB);
+			graph.Write(pass, ldr);
+			pass = Pass("FXAA");
+			graph.Read(pass, ldr);
+			graph.Write(pass, RenderGraph::backbuffer);
+		}
+
+		RenderPassID Pass(const std::string& name) {
+			return graph.AddPass(name, [this, name](const RenderGraph&) { executed.push_back(name); });
+		}
+	};
+}
+
+HOENGINE_TEST(RenderGraphCullsAndAliases) {
+	DeferredGraph deferred;
+	auto& graph = deferred.graph;
+	graph.Compile(Dimension{ 1920, 1080 });
+	const auto& stats = graph.stats();
+	HOENGINE_CHECK(stats.passes == 7 && stats.culledPasses == 1);
+	for (const auto& compiled : graph.compiledPasses()) HOENGINE_CHECK(graph.passName(compiled.pass) != "Debug");
+
+	// LDR reuses the albedo texture, the second bloom target the first one's after blurring is done
+	HOENGINE_CHECK(stats.textures < stats.targets && stats.SavedBytes() > 0);
+	HOENGINE_CHECK(graph.physicalTarget(deferred.ldr) == graph.physicalTarget(deferred.albedo));
+	HOENGINE_CHECK(graph.physicalTarget(deferred.hdr) != graph.physicalTarget(deferred.normal));
+	HOENGINE_CHECK(graph.targetSize(deferred.bloomA).width == 960 && graph.targetSize(deferred.bloomA).height == 540);
+	// First writes are cleared, since the texture may hold another target's pixels
+	const auto& lighting = graph.compiledPasses()[1];
+	HOENGINE_CHECK(lighting.clears.size() == 1 && lighting.clears[0] == deferred.hdr);
+	HOENGINE_CHECK(lighting.barriers.size() == 3);
+
+	// Marking the debug view as output keeps its pass, and its texture to itself
+	graph.MarkOutput(deferred.debug);
+	graph.Compile(Dimension{ 1920, 1080 });
+	HOENGINE_CHECK(graph.stats().culledPasses == 0);
+	for (auto target : { deferred.albedo, deferred.normal, deferred.depth, deferred.hdr, deferred.ldr }) {
+		HOENGINE_CHECK(graph.physicalTarget(target) != graph.physicalTarget(deferred.debug));
+	}
+}
+
+HOENGINE_TEST(RenderGraphChainNeedsTwoTextures) {
+	RenderGraph graph;
+	auto noop = [](const RenderGraph&) {};
+	auto previous = graph.CreateTarget("T0", RenderTargetDesc{});
+	graph.Write(graph.AddPass("P0", noop), previous);
+	for (u32 i = 1; i < 64; ++i) {
+		auto target = graph.CreateTarget("T" + std::to_string(i), RenderTargetDesc{});
+		auto pass = graph.AddPass("P" + std::to_string(i), noop);
+		graph.Read(pass, previous);
+		graph.Write(pass, target);
+		previous = target;
+	}
+	auto out = graph.AddPass("Out", noop);
+	graph.Read(out, previous);
+	graph.Write(out, RenderGraph::backbuffer);
+	graph.Compile(Dimension{ 1920, 1080 });
+	HOENGINE_CHECK(graph.stats().targets == 64 && graph.stats().textures == 2);
+}
+
+HOENGINE_TEST(RenderGraphRejectsInvalidGraphs) {
+	auto noop = [](const RenderGraph&) {};
+	{
+		RenderGraph graph;
+		auto target = graph.CreateTarget("T", RenderTargetDesc{});
+		auto pass = graph.AddPass("ReadsUnwritten", noop);
+		graph.Read(pass, target);
+		graph.Write(pass, RenderGraph::backbuffer);
+		HOENGINE_CHECK_THROWS(graph.Compile(Dimension{ 8, 8 }));
+	}
+	{
+		RenderGraph graph;
+		auto target = graph.CreateTarget("T", RenderTargetDesc{});
+		graph.Write(graph.AddPass("Writes", noop), target);
+		auto pass = graph.AddPass("ReadsAndWrites", noop);
+		graph.Read(pass, target);
+		graph.Write(pass, target);
+		graph.Write(pass, RenderGraph::backbuffer);
+		HOENGINE_CHECK_THROWS(graph.Compile(Dimension{ 8, 8 }));
+	}
+	{
+		// Attachments of different sizes can't form one framebuffer
+		RenderGraph graph;
+		auto small = RenderTargetDesc{};
+		small.width = 4;
+		small.height = 4;
+		auto pass = graph.AddPass("Mismatched", noop);
+		auto full = graph.CreateTarget("Full", RenderTargetDesc{});
+		graph.Write(pass, graph.CreateTarget("Small", small));
+		graph.Write(pass, full);
+		graph.MarkOutput(full);
+		HOENGINE_CHECK_THROWS(graph.Compile(Dimension{ 8, 8 }));
+	}
+	RenderGraph graph;
+	HOENGINE_CHECK_THROWS(graph.CreateTarget("Compressed", Desc(TextureFormat::BC1)));
+}
+
+HOENGINE_TEST(RenderGraphExecutesInOrder) {
+	Test::FakeGL gl;
+	DeferredGraph deferred;
+	RenderTargetPool pool;
+	deferred.graph.Execute(pool, Dimension{ 640, 360 });
+	auto expected = std::vector<std::string>{ "GBuffer", "Lighting", "BloomDown", "BloomBlur", "Tonemap", "FXAA" };
+	HOENGINE_CHECK(deferred.executed == expected);
+	HOENGINE_CHECK(deferred.graph.texture(deferred.hdr) != 0);
+	HOENGINE_CHECK(pool.stats().textures == deferred.graph.stats().textures);
+
+	// Minimized, nothing runs
+	deferred.executed.clear();
+	deferred.graph.Execute(pool, Dimension{ 0, 0 });
+	HOENGINE_CHECK(deferred.executed.empty());
+}
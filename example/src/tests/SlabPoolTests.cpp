@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Entity.hpp"
+#include "SlabPool.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+HOENGINE_TEST(SlabPoolGrowsByChunks) {
+	SlabPool pool("Grow", 24, 8, 4096);
+	auto stats = pool.stats();
+	HOENGINE_CHECK(stats.slotSize == 24 && stats.chunks == 0);
+	auto perChunk = stats.slotsPerChunk;
+	HOENGINE_CHECK(perChunk >= 16 && perChunk * 24 <= 4096);
+
+	std::vector<void*> slots;
+	for (usize i = 0; i < perChunk; ++i) slots.push_back(pool.Allocate());
+	HOENGINE_CHECK(pool.stats().chunks == 1 && pool.stats().Occupancy() == 1.0);
+	// One more slot than fits takes a second chunk
+	slots.push_back(pool.Allocate());
+	stats = pool.stats();
+	HOENGINE_CHECK(stats.chunks == 2 && stats.chunksInUse == 2);
+	HOENGINE_CHECK(stats.liveSlots == perChunk + 1 && stats.peakLiveSlots == perChunk + 1);
+
+	// Slots don't overlap
+	std::sort(slots.begin(), slots.end());
+	for (usize i = 1; i < slots.size(); ++i) {
+		HOENGINE_CHECK(static_cast<std::byte*>(slots[i]) - static_cast<std::byte*>(slots[i - 1]) >= 24);
+	}
+	for (auto slot : slots) pool.Free(slot);
+	stats = pool.stats();
+	HOENGINE_CHECK(stats.liveSlots == 0 && stats.allocations == perChunk + 1 && stats.frees == perChunk + 1);
+	// A single empty chunk is kept around
+	HOENGINE_CHECK(stats.chunks == 1 && stats.chunksInUse == 0);
+}
+
+HOENGINE_TEST(SlabPoolReusesFreedSlots) {
+	SlabPool pool("Reuse", 40, 8, 4096);
+	std::vector<void*> slots;
+	for (usize i = 0; i < 10; ++i) slots.push_back(pool.Allocate());
+
+	// Free lists are LIFO: the last freed slot is handed out first
+	pool.Free(slots[3]);
+	pool.Free(slots[7]);
+	HOENGINE_CHECK(pool.stats().Fragmentation() > 0.0);
+	HOENGINE_CHECK(pool.Allocate() == slots[7]);
+	HOENGINE_CHECK(pool.Allocate() == slots[3]);
+	// Then the untouched tail of the chunk
+	auto next = pool.Allocate();
+	HOENGINE_CHECK(std::find(slots.begin(), slots.end(), next) == slots.end());
+	HOENGINE_CHECK(pool.stats().chunks == 1 && pool.stats().liveSlots == 11);
+
+	// Churn stays within the chunk
+	for (u32 i = 0; i < 1000; ++i) pool.Free(pool.Allocate());
+	HOENGINE_CHECK(pool.stats().chunks == 1);
+
+	pool.Free(next);
+	for (auto slot : slots) pool.Free(slot);
+	pool.Free(nullptr);
+	HOENGINE_CHECK(pool.stats().liveSlots == 0);
+}
+
+HOENGINE_TEST(SlabPoolAlignsSlots) {
+	for (usize alignment : { usize{ 1 }, usize{ 16 }, usize{ 64 }, usize{ 256 } }) {
+		SlabPool pool("Align", 20, alignment, 4096);
+		HOENGINE_CHECK(pool.stats().slotSize % alignment == 0 && pool.stats().slotSize >= 20);
+		std::vector<void*> slots;
+		for (u32 i = 0; i < 200; ++i) {
+			auto slot = pool.Allocate();
+			HOENGINE_CHECK(reinterpret_cast<std::uintptr_t>(slot) % std::max(alignment, alignof(void*)) == 0);
+			slots.push_back(slot);
+		}
+		HOENGINE_CHECK(pool.stats().chunks > 1);
+		for (auto slot : slots) pool.Free(slot);
+	}
+}
+
+HOENGINE_TEST(SlabPoolBacksComponents) {
+	auto& pool = ComponentPool<TransformComponent>();
+	auto before = pool.stats();
+	{
+		auto component = MakeComponent<TransformComponent>();
+		HOENGINE_CHECK(component.get_deleter().pool == &pool);
+		HOENGINE_CHECK(reinterpret_cast<std::uintptr_t>(component.get()) % alignof(TransformComponent) == 0);
+		HOENGINE_CHECK(pool.stats().liveSlots == before.liveSlots + 1);
+	}
+	auto after = pool.stats();
+	HOENGINE_CHECK(after.liveSlots == before.liveSlots && after.frees == before.frees + 1);
+}
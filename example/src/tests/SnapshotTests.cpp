@@ -0,0 +1,128 @@
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Snapshot.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	Entity MakeObject(f32 x, u32 vertexCount) {
+		auto entity = Entity::NewObject();
+		auto transform = entity.GetComponent<TransformComponent>();
+		transform->pos = glm::vec3(x, 1.0f, -x);
+		transform->rot = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		transform->scale = glm::vec3(1.0f);
+		auto mesh = entity.GetComponent<MeshComponent>();
+		for (u32 i = 0; i < vertexCount; ++i) {
+			SimpleVertex vertex{};
+			vertex.pos = glm::vec3(static_cast<f32>(i), x, 0.0f);
+			mesh->vertices.push_back(vertex);
+			mesh->indices.push_back(i);
+		}
+		mesh->RecomputeBounds();
+		return entity;
+	}
+
+	/// Objects with meshes of various sizes, a light and a tombstone.
+	EntitiesStorage MakeWorld(std::vector<EntityID>& ids) {
+		auto world = EntitiesStorage::New();
+		for (u32 i = 0; i < 8; ++i) ids.push_back(world.Add(MakeObject(static_cast<f32>(i), i * 3)));
+		auto light = MakeComponent<DotLightComponent>();
+		light->strength = 2.0f;
+		world.Get(ids[2])->AddComponent(std::move(light));
+		world.Remove(ids[5]);
+		return world;
+	}
+
+	Snapshot Load(std::vector<std::byte> bytes) {
+		auto snapshot = Snapshot::FromBytes(std::move(bytes));
+		if (!snapshot) throw std::runtime_error("snapshot rejected");
+		return std::move(*snapshot);
+	}
+}
+
+HOENGINE_TEST(SnapshotRoundTrips) {
+	std::vector<EntityID> ids;
+	auto world = MakeWorld(ids);
+	auto bytes = Snapshot::Save(world);
+	auto snapshot = Load(bytes);
+	HOENGINE_CHECK(!snapshot.isDiff() && snapshot.data().size() == bytes.size());
+
+	auto restored = EntitiesStorage::New();
+	auto stats = snapshot.Restore(restored);
+	HOENGINE_CHECK(stats.entities == 7 && stats.components == 7 * 2 + 1 && stats.skippedColumns == 0);
+	HOENGINE_CHECK(restored.Size() == world.Size() && restored.Capacity() == world.Capacity());
+	HOENGINE_CHECK(!restored.Get(ids[5]));
+	HOENGINE_CHECK(restored.Get(ids[7])->GetComponent<MeshComponent>()->vertices.size() == 21);
+	HOENGINE_CHECK(restored.Get(ids[2])->GetComponent<DotLightComponent>()->strength == 2.0f);
+	// Identical worlds give identical files, tombstones and generations included
+	HOENGINE_CHECK(Snapshot::Save(restored) == bytes);
+	// The tombstone is reused first, with a new generation
+	auto id = restored.Add(Entity::New());
+	HOENGINE_CHECK(id.idx == ids[5].idx && id.gen != ids[5].gen);
+}
+
+HOENGINE_TEST(SnapshotDiffAppliesChanges) {
+	std::vector<EntityID> ids;
+	auto world = MakeWorld(ids);
+	auto base = Load(Snapshot::Save(world));
+
+	world.Get(ids[1])->GetComponent<TransformComponent>()->pos.y = 5.0f;
+	world.Get(ids[2])->RemoveComponent(DotLightComponent::uuid);
+	world.Get(ids[3])->GetComponent<MeshComponent>()->vertices.pop_back();
+	world.Remove(ids[4]);
+	world.Add(MakeObject(20.0f, 4));
+	world.Add(MakeObject(21.0f, 4));
+
+	auto diff = Load(Snapshot::SaveDiff(world, base));
+	HOENGINE_CHECK(diff.isDiff() && diff.baseID() == base.id());
+	HOENGINE_CHECK(diff.data().size() < base.data().size());
+	HOENGINE_CHECK_THROWS(Snapshot::SaveDiff(world, diff));
+
+	auto restored = EntitiesStorage::New();
+	base.Restore(restored);
+	auto stats = diff.Restore(restored);
+	// Two changed components, two new entities with two components each, one removed light
+	HOENGINE_CHECK(stats.components == 2 + 2 * 2 && stats.removedComponents == 1);
+	HOENGINE_CHECK(Snapshot::Save(restored) == Snapshot::Save(world));
+
+	// Applying to a storage that isn't the base's is rejected
+	auto bigger = EntitiesStorage::New();
+	for (u32 i = 0; i < 32; ++i) bigger.Add(Entity::New());
+	HOENGINE_CHECK_THROWS(diff.Restore(bigger));
+}
+
+HOENGINE_TEST(SnapshotRejectsMalformedData) {
+	std::vector<EntityID> ids;
+	auto world = MakeWorld(ids);
+	auto bytes = Snapshot::Save(world);
+	HOENGINE_CHECK(!Snapshot::FromBytes({}));
+	HOENGINE_CHECK(!Snapshot::FromBytes(std::vector<std::byte>(bytes.begin(), bytes.begin() + 16)));
+	HOENGINE_CHECK(!Snapshot::FromBytes(std::vector<std::byte>(bytes.begin(), bytes.end() - 16)));
+
+	// Overwrite each word with values that turn offsets, counts and slot indices
+	// out of range. Snapshots are either rejected up front, or restored and
+	// diffed against without reading past the data (caught by AddressSanitizer)
+	usize rejected = 0;
+	for (usize offset = 0; offset + sizeof(u64) <= bytes.size(); offset += sizeof(u64)) {
+		u64 original;
+		std::memcpy(&original, bytes.data() + offset, sizeof(u64));
+		for (u64 value : { ~u64{ 0 }, original + 16, original + bytes.size(), u64{ 1 } << 40 }) {
+			auto corrupted = bytes;
+			std::memcpy(corrupted.data() + offset, &value, sizeof(u64));
+			auto snapshot = Snapshot::FromBytes(std::move(corrupted));
+			if (!snapshot) {
+				++rejected;
+				continue;
+			}
+			auto restored = EntitiesStorage::New();
+			try {
+				snapshot->Restore(restored);
+			} catch (const std::runtime_error&) {
+			}
+			if (!snapshot->isDiff()) Snapshot::SaveDiff(world, *snapshot);
+		}
+	}
+	HOENGINE_CHECK(rejected > 0);
+}
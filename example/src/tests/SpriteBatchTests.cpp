@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "render/Atlas.hpp"
+#include "render/SpriteBatch.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Images of random sizes, each filled with its own index as color.
+	SpriteAtlas MakeAtlas(u32 sprites, SpriteAtlas::Config config) {
+		SpriteAtlas atlas(config);
+		std::mt19937 rng(7);
+		std::uniform_int_distribution<u32> size(8, 96);
+		for (u32 i = 0; i < sprites; ++i) {
+			auto image = Image::Uncompressed(size(rng), size(rng), true);
+			auto* pixels = reinterpret_cast<u32*>(image.data.data());
+			for (usize p = 0; p < image.data.size() / 4; ++p) pixels[p] = 0xff000000u | i;
+			atlas.Add(image);
+		}
+		atlas.Build();
+		return atlas;
+	}
+
+	void AddRandomSprites(SpriteBatch& batch, const SpriteAtlas& atlas, u32 count, std::mt19937& rng) {
+		std::uniform_int_distribution<i32> layer(0, 7);
+		std::uniform_int_distribution<u32> sprite(0, static_cast<u32>(atlas.spriteCount() - 1));
+		for (u32 i = 0; i < count; ++i) {
+			auto pos = glm::vec2(static_cast<f32>(i % 800), static_cast<f32>(i / 800));
+			batch.Add(atlas.region(sprite(rng)), pos, glm::vec2(16.0f), layer(rng), SpriteBatch::white, 0.1f * static_cast<f32>(i));
+		}
+	}
+}
+
+HOENGINE_TEST(SkylinePackerOccupancy) {
+	// Equal squares leave no gaps
+	SkylinePacker tiles(1024, 0, 4);
+	u32 placed = 0;
+	while (tiles.Insert(32, 32)) ++placed;
+	HOENGINE_CHECK(placed == 4 * 32 * 32);
+	HOENGINE_CHECK(tiles.Occupancy() > 0.999f);
+
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<u32> size(4, 40);
+	SkylinePacker random(512, 0, 1);
+	for (u32 i = 0; i < 2000; ++i) random.Insert(size(rng), size(rng));
+	HOENGINE_CHECK(random.Occupancy() > 0.7f);
+}
+
+HOENGINE_TEST(SpriteAtlasPacksWithoutOverlap) {
+	SpriteAtlas::Config config;
+	config.pageSize = 1024;
+	config.padding = 1;
+	auto atlas = MakeAtlas(600, config);
+	HOENGINE_CHECK(atlas.pageCount() > 1);
+	HOENGINE_CHECK(atlas.occupancy() > 0.7f);
+
+	// Each sprite and its extruded border hold its own color only
+	for (SpriteID sprite = 0; sprite < atlas.spriteCount(); ++sprite) {
+		const auto& region = atlas.region(sprite);
+		const auto* pixels = reinterpret_cast<const u32*>(atlas.pageImage(region.page).data.data());
+		for (auto y = region.y - 1; y < region.y + region.height + 1; ++y) {
+			for (auto x = region.x - 1; x < region.x + region.width + 1; ++x) {
+				HOENGINE_CHECK(pixels[y * config.pageSize + x] == (0xff000000u | sprite));
+			}
+		}
+	}
+}
+
+HOENGINE_TEST(SpriteBatchSortsAndDraws) {
+	Test::FakeGL gl;
+	SpriteAtlas::Config atlasConfig;
+	atlasConfig.pageSize = 512;
+	auto atlas = MakeAtlas(100, atlasConfig);
+	atlas.Upload();
+	std::mt19937 rng(3);
+
+	SpriteBatch batch;
+	batch.Begin();
+	AddRandomSprites(batch, atlas, 5000, rng);
+	std::vector<SpriteInstance> instances(batch.size());
+	batch.Write(instances);
+	// Back to front, later layers drawn over earlier ones
+	for (usize i = 1; i < instances.size(); ++i) HOENGINE_CHECK(instances[i].depth <= instances[i - 1].depth);
+	u32 covered = 0;
+	for (const auto& run : batch.runs()) {
+		HOENGINE_CHECK(run.first == covered);
+		covered += run.count;
+	}
+	HOENGINE_CHECK(covered == instances.size());
+
+	batch.Begin();
+	AddRandomSprites(batch, atlas, 5000, rng);
+	batch.Draw(atlas, glm::ortho(0.0f, 800.0f, 0.0f, 600.0f, -1.0f, 1.0f));
+	HOENGINE_CHECK(batch.stats().sprites == 5000 && batch.stats().draws == batch.runs().size());
+}
+
+HOENGINE_TEST(SpriteBatchRestoresDepthState) {
+	Test::FakeGL gl;
+	SpriteAtlas::Config atlasConfig;
+	atlasConfig.pageSize = 512;
+	auto atlas = MakeAtlas(100, atlasConfig);
+	atlas.Upload();
+	std::mt19937 rng(3);
+	auto proj = glm::ortho(0.0f, 800.0f, 0.0f, 600.0f, -1.0f, 1.0f);
+
+	auto before = DepthState::Apply(DepthState{ true, GL_LEQUAL, false });
+	for (auto mode : { SpriteBatch::SortMode::Layer, SpriteBatch::SortMode::Page }) {
+		SpriteBatch::Config config;
+		config.sort = mode;
+		SpriteBatch batch(config);
+		for (u32 frame = 0; frame < 2; ++frame) {
+			batch.Begin();
+			AddRandomSprites(batch, atlas, 1000, rng);
+			GLTrace::BeginFrame();
+			batch.Draw(atlas, proj);
+			GLTrace::EndFrame();
+			// Locations are resolved with the program, and the state to restore is known
+			const auto& report = GLTrace::LastReport();
+			if (frame > 0) HOENGINE_CHECK(report.locationLookups == 0 && report.syncPoints == 0);
+			HOENGINE_CHECK((DepthState::Current() == DepthState{ true, GL_LEQUAL, false }));
+		}
+	}
+	DepthState::Apply(before);
+}
+
+HOENGINE_BENCH(SpriteBatchThroughput) {
+	SpriteAtlas::Config atlasConfig;
+	atlasConfig.pageSize = 1024;
+	atlasConfig.padding = 1;
+	auto atlas = MakeAtlas(600, atlasConfig);
+	Test::Report("atlas pages", static_cast<f64>(atlas.pageCount()), "");
+	Test::Report("atlas occupancy", atlas.occupancy() * 100.0, "%");
+
+	constexpr u32 sprites = 50000;
+	std::mt19937 rng(3);
+	std::vector<SpriteInstance> instances(sprites);
+	for (auto mode : { SpriteBatch::SortMode::Layer, SpriteBatch::SortMode::Page }) {
+		SpriteBatch::Config config;
+		config.sort = mode;
+		SpriteBatch batch(config);
+		auto best = 0.0;
+		usize runs = 0;
+		for (u32 frame = 0; frame < 20; ++frame) {
+			batch.Begin();
+			AddRandomSprites(batch, atlas, sprites, rng);
+			batch.Write(instances);
+			best = std::max(best, batch.stats().SpritesPerMillisecond());
+			runs = batch.runs().size();
+		}
+		auto label = mode == SpriteBatch::SortMode::Layer ? std::string("layer order") : std::string("page order");
+		Test::Report((label + ", 50k sprites sorted and written").c_str(), best, "sprites/ms");
+		Test::Report((label + ", draws").c_str(), static_cast<f64>(runs), "");
+	}
+}
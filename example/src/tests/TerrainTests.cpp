@@ -0,0 +1,101 @@
+#include <cmath>
+#include <string>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include "render/Terrain.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Rolling hills, `size` samples on a side.
+	Heightmap MakeHeightmap(u32 size) {
+		std::vector<u16> samples(usize{ size } * size);
+		for (u32 z = 0; z < size; ++z) {
+			for (u32 x = 0; x < size; ++x) {
+				auto fx = static_cast<f64>(x);
+				auto fz = static_cast<f64>(z);
+				auto height = 32768.0 + 12000.0 * std::sin(fx * 0.01) * std::cos(fz * 0.013) + 3000.0 * std::sin(fx * 0.07 + fz * 0.05);
+				samples[usize{ z } * size + x] = static_cast<u16>(height);
+			}
+		}
+		return Heightmap(std::move(samples), size, size);
+	}
+
+	/// Update until every chunk in range is resident.
+	void StreamIn(Terrain& terrain, ThreadPool& pool, const glm::vec3& camera) {
+		for (u32 i = 0; i < 100; ++i) {
+			terrain.Update(pool, camera);
+			if (terrain.stats().pending == 0 && terrain.stats().generated == 0) break;
+		}
+	}
+}
+
+HOENGINE_TEST(TerrainStreamsAndDraws) {
+	Test::FakeGL gl;
+	ThreadPool pool(2);
+	Terrain::Config config;
+	config.lodLevels = 4;
+	Terrain terrain(MakeHeightmap(513), config);
+	auto camera = glm::vec3(256.0f, 0.0f, 256.0f);
+	camera.y = terrain.HeightAt(camera.x, camera.z) + 2.0f;
+	StreamIn(terrain, pool, camera);
+	HOENGINE_CHECK(terrain.stats().chunks > 0 && terrain.stats().pending == 0);
+
+	// The selected nodes tile the whole map exactly once
+	std::vector<Terrain::DrawNode> nodes;
+	terrain.Select(camera, nullptr, nodes);
+	auto area = 0.0;
+	for (const auto& node : nodes) {
+		auto size = static_cast<f64>(terrain.NodeSize(node.level));
+		area += node.quarter == Terrain::wholeNode ? size * size : size * size / 4.0;
+	}
+	HOENGINE_CHECK(std::abs(area - 512.0 * 512.0) < 1.0);
+
+	auto view = glm::lookAt(camera, camera + glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	auto proj = glm::perspective(1.2f, 16.0f / 9.0f, 0.1f, 4000.0f);
+	terrain.Draw(view, proj, camera);
+	HOENGINE_CHECK(terrain.stats().nodes > 0 && terrain.stats().triangles > 0);
+	// Uniform locations were resolved by the first draw
+	GLTrace::BeginFrame();
+	terrain.Draw(view, proj, camera);
+	GLTrace::EndFrame();
+	HOENGINE_CHECK(GLTrace::LastReport().locationLookups == 0);
+}
+
+HOENGINE_BENCH(TerrainChunks) {
+	ThreadPool pool;
+	Terrain::Config config;
+	config.viewDistance = 4000.0f;
+	Terrain terrain(MakeHeightmap(2049), config);
+	Test::Report("heightmap", static_cast<f64>(terrain.heightmap().byteSize()) / 1048576.0, "MB");
+
+	auto camera = glm::vec3(1000.0f, 0.0f, 1000.0f);
+	camera.y = terrain.HeightAt(camera.x, camera.z) + 2.0f;
+	terrain.Update(pool, camera);
+	const auto& stats = terrain.stats();
+	Test::Report("first update, chunks generated", static_cast<f64>(stats.generated), "");
+	Test::Report("first update, CPU time per chunk", stats.chunkTime, "ms");
+	Test::Report("first update, wall time", stats.updateTime, "ms");
+	StreamIn(terrain, pool, camera);
+	Test::Report("resident chunks", static_cast<f64>(stats.chunks), "");
+	Test::Report("resident vertex memory", static_cast<f64>(stats.chunkBytes) / 1048576.0, "MB");
+	Test::Report("memory per chunk", static_cast<f64>(stats.chunkBytes) / static_cast<f64>(stats.chunks) / 1024.0, "KB");
+	for (u32 level = 0; level < terrain.levelCount(); ++level) {
+		auto label = "level " + std::to_string(level) + " density";
+		Test::Report(label.c_str(), terrain.BytesPerSquareKm(level) / 1048576.0, "MB/km2");
+	}
+
+	// Walk across the map, streaming as we go
+	f64 updateTime = 0;
+	usize generated = 0;
+	constexpr u32 steps = 200;
+	for (u32 step = 0; step < steps; ++step) {
+		camera.x += 5.0f;
+		terrain.Update(pool, camera);
+		updateTime += stats.updateTime;
+		generated += stats.generated;
+	}
+	Test::Report("walking, update", updateTime / steps, "ms");
+	Test::Report("walking, chunks generated", static_cast<f64>(generated), "");
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Engine.hpp"
+#include "GLTrace.hpp"
+
+/// Minimal test and benchmark registry for `engine_tests`. Tests run by default
+/// and under ctest, benchmarks with `--bench`, see `EngineTestMain.cpp`.
+///
+/// ```
+/// HOENGINE_TEST(RangeAllocatorCoalesces) {
+///     HOENGINE_CHECK(alloc.GetStats().freeBlockCount == 1);
+/// }
+/// ```
+#define HOENGINE_TEST(name) HOENGINE_TEST_CASE(name, ::HOEngine::Test::Kind::Test)
+#define HOENGINE_BENCH(name) HOENGINE_TEST_CASE(name, ::HOEngine::Test::Kind::Bench)
+#define HOENGINE_TEST_CASE(name, kind) \
+	static void name(); \
+	static const ::HOEngine::Test::Registrar name##Registrar{ #name, kind, name }; \
+	static void name()
+
+/// Fail the running test, its remaining checks are skipped.
+#define HOENGINE_CHECK(expr) \
+	do { \
+		if (!(expr)) throw ::HOEngine::Test::Failure(__FILE__ ":" + std::to_string(__LINE__) + ": " #expr); \
+	} while (false)
+#define HOENGINE_CHECK_THROWS(expr) \
+	do { \
+		auto thrown = false; \
+		try { \
+			expr; \
+		} catch (const std::exception&) { \
+			thrown = true; \
+		} \
+		HOENGINE_CHECK(thrown && "throws: " #expr); \
+	} while (false)
+/// End the running test without failing it, e.g. for lack of a GL backend.
+#define HOENGINE_SKIP(reason) throw ::HOEngine::Test::Skipped(reason)
+
+namespace HOEngine::Test {
+
+enum class Kind : u8 {
+	Test,
+	Bench,
+};
+
+struct Case {
+	const char* name;
+	Kind kind;
+	void (*function)();
+};
+
+class Failure : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+class Skipped : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+inline std::vector<Case>& Registry() {
+	static std::vector<Case> cases;
+	return cases;
+}
+
+struct Registrar {
+	Registrar(const char* name, Kind kind, void (*function)()) {
+		Registry().push_back(Case{ name, kind, function });
+	}
+};
+
+/// Fake GL backend of `GLTrace` for the lifetime of the object, so code issuing
+/// GL calls runs without a context. Only available when built with
+/// `HOENGINE_GL_TRACE`, tests needing it skip themselves otherwise.
+class FakeGL {
+public:
+	FakeGL() {
+		if (!GLTrace::InstallFake()) HOENGINE_SKIP("needs the fake GL backend, build with HOENGINE_GL_TRACE");
+	}
+	~FakeGL() noexcept { GLTrace::Uninstall(); }
+	FakeGL(const FakeGL&) = delete;
+	FakeGL& operator=(const FakeGL&) = delete;
+};
+
+/// Fastest of `repeats` runs of `function`, in milliseconds.
+template <typename F>
+f64 MeasureMilliseconds(F&& function, u32 repeats = 5) {
+	auto best = 0.0;
+	for (u32 i = 0; i < repeats; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		function();
+		auto time = std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || time < best) best = time;
+	}
+	return best;
+}
+
+/// Print one benchmark result line.
+inline void Report(const char* label, f64 value, const char* unit) {
+	std::printf("    %-48s %12.3f %s\n", label, value, unit);
+}
+
+} // namespace HOEngine::Test
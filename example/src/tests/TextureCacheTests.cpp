@@ -0,0 +1,98 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "render/TextureCache.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Cooked 256x256 texture with a full chain, in the temporary directory.
+	std::string WriteTexture(const char* name) {
+		auto image = Image::Uncompressed(256, 256, false);
+		GenerateMips(image, MipFilter::Box);
+		auto bytes = CookImage(image);
+		auto path = (std::filesystem::temp_directory_path() / name).string();
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		return path;
+	}
+
+	/// Update, calling `use` before each frame, until nothing is left to load or upload.
+	void Settle(TextureCache& cache, const std::function<void()>& use) {
+		for (u32 frame = 0; frame < 5000; ++frame) {
+			use();
+			cache.Update();
+			// A few frames more, so that unused textures get evicted
+			if (frame > 10 && cache.stats().pendingLoads == 0 && cache.stats().pendingBytes == 0) return;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+HOENGINE_TEST(TextureCacheEnforcesBudget) {
+	Test::FakeGL gl;
+	std::vector<std::string> paths;
+	for (auto name : { "hoengine_cache_0.tex", "hoengine_cache_1.tex", "hoengine_cache_2.tex", "hoengine_cache_3.tex" }) {
+		paths.push_back(WriteTexture(name));
+	}
+	usize chainBytes = 0;
+	for (u32 size = 256; size > 0; size /= 2) chainBytes += TextureLevelSize(TextureFormat::RGBA8, size, size);
+
+	// Room for two and a half textures: dropping the finest level of two of them fits
+	TextureCache::Config config;
+	config.residencyBudget = chainBytes * 5 / 2;
+	config.evictAfterFrames = 2;
+	TextureCache cache(config);
+	std::vector<TextureID> ids;
+	for (const auto& path : paths) ids.push_back(cache.Load(path));
+	HOENGINE_CHECK(cache.Load(paths[0]) == ids[0]);
+	cache.Release(ids[0]);
+
+	// Textures in use are kept whole, even over budget
+	Settle(cache, [&] {
+		for (auto id : ids) cache.Use(id);
+	});
+	const auto& stats = cache.stats();
+	HOENGINE_CHECK(stats.failures == 0 && stats.textures == 4);
+	HOENGINE_CHECK(stats.residentBytes == 4 * chainBytes && stats.evictions == 0);
+	for (auto id : ids) HOENGINE_CHECK(cache.IsResident(id));
+	HOENGINE_CHECK(stats.uploads == 4 * Texture::MipCount(256, 256));
+
+	// The last two stop being used, and lose their finest level
+	Settle(cache, [&] {
+		cache.Use(ids[0]);
+		cache.Use(ids[1]);
+	});
+	HOENGINE_CHECK(stats.evictions == 2 && stats.restores == 0);
+	HOENGINE_CHECK(stats.residentBytes == 4 * chainBytes - 2 * TextureLevelSize(TextureFormat::RGBA8, 256, 256));
+	HOENGINE_CHECK(stats.residentBytes <= config.residencyBudget);
+	for (auto id : ids) HOENGINE_CHECK(cache.IsResident(id));
+	// Levels are dropped in place, without loading or uploading anything
+	HOENGINE_CHECK(stats.uploads == 4 * Texture::MipCount(256, 256));
+
+	// Once there's room again, the evicted textures get their finest level back
+	auto uploads = stats.uploads;
+	cache.Release(ids[0]);
+	cache.Release(ids[1]);
+	Settle(cache, [&] {
+		cache.Use(ids[2]);
+		cache.Use(ids[3]);
+	});
+	HOENGINE_CHECK(stats.textures == 2 && stats.restores == 2);
+	HOENGINE_CHECK(stats.residentBytes == 2 * chainBytes);
+	HOENGINE_CHECK(stats.uploads == uploads + 2 * Texture::MipCount(256, 256));
+	HOENGINE_CHECK(cache.IsResident(ids[2]) && cache.IsResident(ids[3]));
+
+	// Missing files fail and keep the placeholder
+	auto missing = cache.Load((std::filesystem::temp_directory_path() / "hoengine_cache_missing.tex").string());
+	Settle(cache, [] {});
+	HOENGINE_CHECK(stats.failures == 1 && !cache.IsResident(missing));
+	HOENGINE_CHECK(cache.Use(missing) == cache.Use(noTexture));
+
+	for (const auto& path : paths) std::filesystem::remove(path);
+}
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "WorldPartition.hpp"
+#include "Test.hpp"
+
+using namespace HOEngine;
+
+namespace {
+	/// Exposes the entity a component is attached to.
+	class OwnerProbeComponent : public ComponentUUIDMixin<0x5b0c1f6e2d9a4e71, 0x9f3a7c18b2e64d05> {
+	public:
+		u32 value = 0;
+
+		Entity* Owner() const { return Ent(); }
+		ComponentPtr<OwnerProbeComponent> Clone() const { return MakeComponent<OwnerProbeComponent>(*this); }
+
+	protected:
+		ComponentPtr<Component> CloneImpl() const override { return Clone(); }
+	};
+
+	void RegisterOwnerProbeCodec() {
+		RegisterComponentCodec(ComponentCodec{
+			OwnerProbeComponent::uuid,
+			sizeof(u32),
+			[](const Component& component, std::byte* record, SaveContext&) {
+				auto value = dynamic_cast<const OwnerProbeComponent&>(component).value;
+				std::memcpy(record, &value, sizeof(value));
+			},
+			[](const std::byte* record, std::span<const std::byte>, RestoreContext&) -> ComponentPtr<> {
+				auto probe = MakeComponent<OwnerProbeComponent>();
+				std::memcpy(&probe->value, record, sizeof(probe->value));
+				return probe;
+			},
+		});
+	}
+}
+
+HOENGINE_TEST(EntityCopiesAndMovesReattachComponents) {
+	auto entity = Entity::New();
+	entity.AddComponent(MakeComponent<OwnerProbeComponent>());
+	HOENGINE_CHECK(entity.GetComponent<OwnerProbeComponent>()->Owner() == &entity);
+
+	auto moved = std::move(entity);
+	HOENGINE_CHECK(moved.GetComponent<OwnerProbeComponent>()->Owner() == &moved);
+	auto copy = moved;
+	HOENGINE_CHECK(copy.GetComponent<OwnerProbeComponent>()->Owner() == &copy);
+
+	// Growing the storage moves every entity already in it
+	auto world = EntitiesStorage::New();
+	auto id = world.Add(std::move(copy));
+	for (u32 i = 0; i < 100; ++i) world.Add(Entity::New());
+	HOENGINE_CHECK(world.Get(id)->GetComponent<OwnerProbeComponent>()->Owner() == world.Get(id));
+}
+
+HOENGINE_TEST(WorldPartitionStreamedEntitiesOwnTheirComponents) {
+	RegisterOwnerProbeCodec();
+	auto source = EntitiesStorage::New();
+	for (u32 i = 0; i < 64; ++i) {
+		auto entity = Entity::New();
+		auto transform = MakeComponent<TransformComponent>();
+		transform->pos = glm::vec3(static_cast<f32>(i % 8) * 16.0f, 0.0f, static_cast<f32>(i / 8) * 16.0f);
+		entity.AddComponent(std::move(transform));
+		auto probe = MakeComponent<OwnerProbeComponent>();
+		probe->value = i;
+		entity.AddComponent(std::move(probe));
+		source.Add(std::move(entity));
+	}
+
+	WorldPartition::Config config;
+	config.cellSize = 32.0f;
+	config.loadRadius = 1000.0f;
+	WorldPartition partition(std::make_unique<MemoryCellSource>(WorldPartition::Split(source, config.cellSize)), config);
+	auto world = EntitiesStorage::New();
+	for (u32 i = 0; i < 1000 && world.Size() < source.Size(); ++i) {
+		partition.Update(world, glm::vec3(64.0f, 0.0f, 64.0f));
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	HOENGINE_CHECK(world.Size() == source.Size());
+
+	// The staged storage the entities were decoded into is gone by now
+	u32 probes = 0;
+	for (usize i = 0; i < world.Capacity(); ++i) {
+		auto entity = world.At(i);
+		if (!entity) continue;
+		auto probe = entity->GetComponent<OwnerProbeComponent>();
+		HOENGINE_CHECK(probe && probe->Owner() == entity);
+		++probes;
+	}
+	HOENGINE_CHECK(probes == source.Size());
+	partition.UnloadAll(world);
+	HOENGINE_CHECK(world.Size() == 0);
+}